@@ -10,6 +10,14 @@
 ### env parameter: SANITIZER
 ### env parameter: JBPF_THREADS_LARGE
 ### env parameter: JBPF_EXPERIMENTAL_FEATURES
+### env parameter: USE_JBPF_HOOK_TRAMPOLINE
+### env parameter: USE_JBPF_QSBR
+### env parameter: USE_JBPF_CODELET_PERF_STATS
+### env parameter: USE_JBPF_RUNTIME_BUDGETS
+### env parameter: USE_JBPF_STATIC_KEYS
+### env parameter: USE_JBPF_DEFERRED_HOOKS
+### env parameter: USE_JBPF_PERF_COUNTERS
+### env parameter: USE_JBPF_TRACE
 ### env parameter: CLANG_FORMAT_CHECK
 ### env parameter: CPP_CHECK
 ### env parameter: BUILD_TESTING
@@ -66,6 +74,62 @@ get_flags() {
     else 
         OUTPUT="$OUTPUT Building with experimental features unset\n"
     fi
+    if [[ "$USE_JBPF_HOOK_TRAMPOLINE" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with fused hook trampolines\n"
+        FLAGS="$FLAGS -DUSE_JBPF_HOOK_TRAMPOLINE=on"
+    else
+        OUTPUT="$OUTPUT Building without fused hook trampolines\n"
+        FLAGS="$FLAGS -DUSE_JBPF_HOOK_TRAMPOLINE=off"
+    fi
+    if [[ "$USE_JBPF_QSBR" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with quiescent-state based reclamation\n"
+        FLAGS="$FLAGS -DUSE_JBPF_QSBR=on"
+    else
+        OUTPUT="$OUTPUT Building with epoch based reclamation\n"
+        FLAGS="$FLAGS -DUSE_JBPF_QSBR=off"
+    fi
+    if [[ "$USE_JBPF_CODELET_PERF_STATS" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with per-codelet perf stats\n"
+        FLAGS="$FLAGS -DUSE_JBPF_CODELET_PERF_STATS=on"
+    else
+        OUTPUT="$OUTPUT Building without per-codelet perf stats\n"
+        FLAGS="$FLAGS -DUSE_JBPF_CODELET_PERF_STATS=off"
+    fi
+    if [[ "$USE_JBPF_RUNTIME_BUDGETS" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with codelet runtime budgets\n"
+        FLAGS="$FLAGS -DUSE_JBPF_RUNTIME_BUDGETS=on"
+    else
+        OUTPUT="$OUTPUT Building without codelet runtime budgets\n"
+        FLAGS="$FLAGS -DUSE_JBPF_RUNTIME_BUDGETS=off"
+    fi
+    if [[ "$USE_JBPF_STATIC_KEYS" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with hook static keys\n"
+        FLAGS="$FLAGS -DUSE_JBPF_STATIC_KEYS=on"
+    else
+        OUTPUT="$OUTPUT Building without hook static keys\n"
+        FLAGS="$FLAGS -DUSE_JBPF_STATIC_KEYS=off"
+    fi
+    if [[ "$USE_JBPF_DEFERRED_HOOKS" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with deferred hooks\n"
+        FLAGS="$FLAGS -DUSE_JBPF_DEFERRED_HOOKS=on"
+    else
+        OUTPUT="$OUTPUT Building without deferred hooks\n"
+        FLAGS="$FLAGS -DUSE_JBPF_DEFERRED_HOOKS=off"
+    fi
+    if [[ "$USE_JBPF_PERF_COUNTERS" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with perf counters\n"
+        FLAGS="$FLAGS -DUSE_JBPF_PERF_COUNTERS=on"
+    else
+        OUTPUT="$OUTPUT Building without perf counters\n"
+        FLAGS="$FLAGS -DUSE_JBPF_PERF_COUNTERS=off"
+    fi
+    if [[ "$USE_JBPF_TRACE" == "1" ]]; then
+        OUTPUT="$OUTPUT Building with the flight recorder\n"
+        FLAGS="$FLAGS -DUSE_JBPF_TRACE=on"
+    else
+        OUTPUT="$OUTPUT Building without the flight recorder\n"
+        FLAGS="$FLAGS -DUSE_JBPF_TRACE=off"
+    fi
     if [[ "$CLANG_FORMAT_CHECK" == "1" ]]; then
         OUTPUT="$OUTPUT Checking with clang-format\n"
         FLAGS="$FLAGS -DCLANG_FORMAT_CHECK=on"
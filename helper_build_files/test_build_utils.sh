@@ -192,6 +192,134 @@ if ! test_flags_not_contains "-DJBPF_EXPERIMENTAL_FEATURES" "When JBPF_EXPERIMEN
     exit 1
 fi
 
+### env parameter: USE_JBPF_HOOK_TRAMPOLINE
+USE_JBPF_HOOK_TRAMPOLINE=1
+if ! test_flags "-DUSE_JBPF_HOOK_TRAMPOLINE=on" "When USE_JBPF_HOOK_TRAMPOLINE=1 flags should contain -DUSE_JBPF_HOOK_TRAMPOLINE=on"; then
+    exit 1
+fi
+
+USE_JBPF_HOOK_TRAMPOLINE=0
+if ! test_flags "-DUSE_JBPF_HOOK_TRAMPOLINE=off" "When USE_JBPF_HOOK_TRAMPOLINE=0 flags should contain -DUSE_JBPF_HOOK_TRAMPOLINE=off"; then
+    exit 1
+fi
+
+USE_JBPF_HOOK_TRAMPOLINE=
+if ! test_flags "-DUSE_JBPF_HOOK_TRAMPOLINE=off" "When USE_JBPF_HOOK_TRAMPOLINE is unset flags should contain -DUSE_JBPF_HOOK_TRAMPOLINE=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_QSBR
+USE_JBPF_QSBR=1
+if ! test_flags "-DUSE_JBPF_QSBR=on" "When USE_JBPF_QSBR=1 flags should contain -DUSE_JBPF_QSBR=on"; then
+    exit 1
+fi
+
+USE_JBPF_QSBR=0
+if ! test_flags "-DUSE_JBPF_QSBR=off" "When USE_JBPF_QSBR=0 flags should contain -DUSE_JBPF_QSBR=off"; then
+    exit 1
+fi
+
+USE_JBPF_QSBR=
+if ! test_flags "-DUSE_JBPF_QSBR=off" "When USE_JBPF_QSBR is unset flags should contain -DUSE_JBPF_QSBR=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_CODELET_PERF_STATS
+USE_JBPF_CODELET_PERF_STATS=1
+if ! test_flags "-DUSE_JBPF_CODELET_PERF_STATS=on" "When USE_JBPF_CODELET_PERF_STATS=1 flags should contain -DUSE_JBPF_CODELET_PERF_STATS=on"; then
+    exit 1
+fi
+
+USE_JBPF_CODELET_PERF_STATS=0
+if ! test_flags "-DUSE_JBPF_CODELET_PERF_STATS=off" "When USE_JBPF_CODELET_PERF_STATS=0 flags should contain -DUSE_JBPF_CODELET_PERF_STATS=off"; then
+    exit 1
+fi
+
+USE_JBPF_CODELET_PERF_STATS=
+if ! test_flags "-DUSE_JBPF_CODELET_PERF_STATS=off" "When USE_JBPF_CODELET_PERF_STATS is unset flags should contain -DUSE_JBPF_CODELET_PERF_STATS=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_RUNTIME_BUDGETS
+USE_JBPF_RUNTIME_BUDGETS=1
+if ! test_flags "-DUSE_JBPF_RUNTIME_BUDGETS=on" "When USE_JBPF_RUNTIME_BUDGETS=1 flags should contain -DUSE_JBPF_RUNTIME_BUDGETS=on"; then
+    exit 1
+fi
+
+USE_JBPF_RUNTIME_BUDGETS=0
+if ! test_flags "-DUSE_JBPF_RUNTIME_BUDGETS=off" "When USE_JBPF_RUNTIME_BUDGETS=0 flags should contain -DUSE_JBPF_RUNTIME_BUDGETS=off"; then
+    exit 1
+fi
+
+USE_JBPF_RUNTIME_BUDGETS=
+if ! test_flags "-DUSE_JBPF_RUNTIME_BUDGETS=off" "When USE_JBPF_RUNTIME_BUDGETS is unset flags should contain -DUSE_JBPF_RUNTIME_BUDGETS=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_STATIC_KEYS
+USE_JBPF_STATIC_KEYS=1
+if ! test_flags "-DUSE_JBPF_STATIC_KEYS=on" "When USE_JBPF_STATIC_KEYS=1 flags should contain -DUSE_JBPF_STATIC_KEYS=on"; then
+    exit 1
+fi
+
+USE_JBPF_STATIC_KEYS=0
+if ! test_flags "-DUSE_JBPF_STATIC_KEYS=off" "When USE_JBPF_STATIC_KEYS=0 flags should contain -DUSE_JBPF_STATIC_KEYS=off"; then
+    exit 1
+fi
+
+USE_JBPF_STATIC_KEYS=
+if ! test_flags "-DUSE_JBPF_STATIC_KEYS=off" "When USE_JBPF_STATIC_KEYS is unset flags should contain -DUSE_JBPF_STATIC_KEYS=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_DEFERRED_HOOKS
+USE_JBPF_DEFERRED_HOOKS=1
+if ! test_flags "-DUSE_JBPF_DEFERRED_HOOKS=on" "When USE_JBPF_DEFERRED_HOOKS=1 flags should contain -DUSE_JBPF_DEFERRED_HOOKS=on"; then
+    exit 1
+fi
+
+USE_JBPF_DEFERRED_HOOKS=0
+if ! test_flags "-DUSE_JBPF_DEFERRED_HOOKS=off" "When USE_JBPF_DEFERRED_HOOKS=0 flags should contain -DUSE_JBPF_DEFERRED_HOOKS=off"; then
+    exit 1
+fi
+
+USE_JBPF_DEFERRED_HOOKS=
+if ! test_flags "-DUSE_JBPF_DEFERRED_HOOKS=off" "When USE_JBPF_DEFERRED_HOOKS is unset flags should contain -DUSE_JBPF_DEFERRED_HOOKS=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_PERF_COUNTERS
+USE_JBPF_PERF_COUNTERS=1
+if ! test_flags "-DUSE_JBPF_PERF_COUNTERS=on" "When USE_JBPF_PERF_COUNTERS=1 flags should contain -DUSE_JBPF_PERF_COUNTERS=on"; then
+    exit 1
+fi
+
+USE_JBPF_PERF_COUNTERS=0
+if ! test_flags "-DUSE_JBPF_PERF_COUNTERS=off" "When USE_JBPF_PERF_COUNTERS=0 flags should contain -DUSE_JBPF_PERF_COUNTERS=off"; then
+    exit 1
+fi
+
+USE_JBPF_PERF_COUNTERS=
+if ! test_flags "-DUSE_JBPF_PERF_COUNTERS=off" "When USE_JBPF_PERF_COUNTERS is unset flags should contain -DUSE_JBPF_PERF_COUNTERS=off"; then
+    exit 1
+fi
+
+### env parameter: USE_JBPF_TRACE
+USE_JBPF_TRACE=1
+if ! test_flags "-DUSE_JBPF_TRACE=on" "When USE_JBPF_TRACE=1 flags should contain -DUSE_JBPF_TRACE=on"; then
+    exit 1
+fi
+
+USE_JBPF_TRACE=0
+if ! test_flags "-DUSE_JBPF_TRACE=off" "When USE_JBPF_TRACE=0 flags should contain -DUSE_JBPF_TRACE=off"; then
+    exit 1
+fi
+
+USE_JBPF_TRACE=
+if ! test_flags "-DUSE_JBPF_TRACE=off" "When USE_JBPF_TRACE is unset flags should contain -DUSE_JBPF_TRACE=off"; then
+    exit 1
+fi
+
 ### env parameter: CLANG_FORMAT_CHECK
 CLANG_FORMAT_CHECK=1
 if ! test_flags "-DCLANG_FORMAT_CHECK=on" "When CLANG_FORMAT_CHECK=1 flags should contain -DCLANG_FORMAT_CHECK=on"; then
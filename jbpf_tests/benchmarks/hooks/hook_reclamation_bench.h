@@ -0,0 +1,32 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef HOOK_RECLAMATION_BENCH_H
+#define HOOK_RECLAMATION_BENCH_H
+
+#include <stdint.h>
+
+#include "jbpf_hook_defs.h"
+
+/* Number of hook calls between two quiescent states, e.g. one per TTI */
+#define BENCH_CALLS_PER_QUIESCENT_STATE (16)
+
+struct bench_data
+{
+    uint64_t value;
+};
+
+int
+bench_epoch_register(jbpf_jit_fn codelet);
+int
+bench_epoch_remove(jbpf_jit_fn codelet);
+void
+bench_epoch_run(struct bench_data* data, int iterations);
+
+int
+bench_qsbr_register(jbpf_jit_fn codelet);
+int
+bench_qsbr_remove(jbpf_jit_fn codelet);
+void
+bench_qsbr_run(struct bench_data* data, int iterations);
+
+#endif
@@ -0,0 +1,41 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * Hook with the epoch based read side: every call enters and leaves an epoch section. Only built without
+ * USE_JBPF_QSBR, as the read side of a hook must match the reclamation of the library.
+ */
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+#include "hook_reclamation_bench.h"
+
+DECLARE_JBPF_HOOK(
+    bench_epoch,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct bench_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(bench_epoch)
+
+int
+bench_epoch_register(jbpf_jit_fn codelet)
+{
+    /* Keep the perf stats out of the measurement */
+    __jbpf_hook_bench_epoch.jbpf_perf_active = false;
+    return jbpf_register_codelet_bench_epoch(codelet, DEFAULT_RUNTIME_THRESHOLD, 1);
+}
+
+int
+bench_epoch_remove(jbpf_jit_fn codelet)
+{
+    return jbpf_remove_codelet_hook_bench_epoch(codelet);
+}
+
+void
+bench_epoch_run(struct bench_data* data, int iterations)
+{
+    for (int i = 0; i < iterations; i++) {
+        hook_bench_epoch(data, i);
+    }
+}
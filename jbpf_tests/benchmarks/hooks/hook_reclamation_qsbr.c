@@ -0,0 +1,45 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * Hook with the QSBR read side: calls do not use any synchronization primitive and the thread announces a
+ * quiescent state every BENCH_CALLS_PER_QUIESCENT_STATE calls. Only built with USE_JBPF_QSBR, as the read side of a
+ * hook must match the reclamation of the library.
+ */
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+#include "hook_reclamation_bench.h"
+
+DECLARE_JBPF_HOOK(
+    bench_qsbr,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct bench_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(bench_qsbr)
+
+int
+bench_qsbr_register(jbpf_jit_fn codelet)
+{
+    /* Keep the perf stats out of the measurement */
+    __jbpf_hook_bench_qsbr.jbpf_perf_active = false;
+    return jbpf_register_codelet_bench_qsbr(codelet, DEFAULT_RUNTIME_THRESHOLD, 1);
+}
+
+int
+bench_qsbr_remove(jbpf_jit_fn codelet)
+{
+    return jbpf_remove_codelet_hook_bench_qsbr(codelet);
+}
+
+void
+bench_qsbr_run(struct bench_data* data, int iterations)
+{
+    for (int i = 0; i < iterations; i++) {
+        hook_bench_qsbr(data, i);
+        if ((i % BENCH_CALLS_PER_QUIESCENT_STATE) == 0) {
+            jbpf_quiescent();
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * This benchmark compares the cost of calling a hook with the two read sides available in jbpf:
+ * 1. Epoch based reclamation (default), where each hook call enters and leaves an epoch section.
+ * 2. Quiescent-state based reclamation (USE_JBPF_QSBR), where hook calls do not use any synchronization primitive
+ *    and threads periodically call jbpf_quiescent().
+ *
+ * The read side of a hook must match the reclamation of the library, so the benchmark measures the read side of the
+ * build, and the two read sides are compared by running it from a build with and without USE_JBPF_QSBR. It registers
+ * a native codelet to the hook and runs NUM_THREADS threads that call the hook NUM_ITERATIONS times. It reports the
+ * average time per hook call.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "jbpf.h"
+#include "jbpf_defs.h"
+#include "hook_reclamation_bench.h"
+
+#define NUM_THREADS (4)
+#define NUM_ITERATIONS (10000000)
+
+typedef void (*bench_run_fn)(struct bench_data* data, int iterations);
+
+struct bench_thread_args
+{
+    bench_run_fn run;
+    uint64_t elapsed_ns;
+};
+
+static pthread_barrier_t bench_barrier;
+
+static uint64_t
+bench_codelet(void* mem, size_t mem_len)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+    struct bench_data* data = (struct bench_data*)(uintptr_t)ctx->data;
+
+    data->value++;
+    return 0;
+}
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void*
+bench_thread(void* arg)
+{
+    struct bench_thread_args* args = arg;
+    struct bench_data data = {0};
+    uint64_t start;
+
+    jbpf_register_thread();
+    pthread_barrier_wait(&bench_barrier);
+
+    start = bench_now_ns();
+    args->run(&data, NUM_ITERATIONS);
+    args->elapsed_ns = bench_now_ns() - start;
+
+    assert(data.value == NUM_ITERATIONS);
+
+    jbpf_cleanup_thread();
+    return NULL;
+}
+
+static void
+bench_mode(const char* name, bench_run_fn run)
+{
+    pthread_t threads[NUM_THREADS];
+    struct bench_thread_args args[NUM_THREADS];
+    uint64_t total_ns = 0;
+
+    pthread_barrier_init(&bench_barrier, NULL, NUM_THREADS);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i].run = run;
+        args[i].elapsed_ns = 0;
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        total_ns += args[i].elapsed_ns;
+    }
+    pthread_barrier_destroy(&bench_barrier);
+
+    printf(
+        "%-6s: %d threads x %d calls, %.2f ns per hook call\n",
+        name,
+        NUM_THREADS,
+        NUM_ITERATIONS,
+        (double)total_ns / ((double)NUM_THREADS * NUM_ITERATIONS));
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+#ifdef JBPF_QSBR
+    assert(bench_qsbr_register(bench_codelet) == 0);
+    bench_mode("qsbr", bench_qsbr_run);
+    assert(bench_qsbr_remove(bench_codelet) == 0);
+#else
+    assert(bench_epoch_register(bench_codelet) == 0);
+    bench_mode("epoch", bench_epoch_run);
+    assert(bench_epoch_remove(bench_codelet) == 0);
+#endif
+
+    jbpf_stop();
+    return 0;
+}
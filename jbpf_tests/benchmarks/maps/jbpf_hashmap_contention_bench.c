@@ -0,0 +1,147 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * This benchmark compares the update path of the two hashmap map types under writer contention:
+ * 1. JBPF_MAP_TYPE_HASHMAP, where the writers serialize on a single lock of the map, and an update returns
+ *    JBPF_MAP_BUSY if another writer holds it.
+ * 2. JBPF_MAP_TYPE_CONCURRENT_HASHMAP, where the writers only serialize with the writers of the same bucket.
+ *
+ * NUM_THREADS threads update NUM_KEYS keys shared by all the threads, like hook threads updating a flow table, and
+ * retry each update until it is not busy. The benchmark reports the average time per successful update and the
+ * number of busy retries per update. Updates that fail otherwise are counted separately and not retried.
+ * The concurrent hashmap overwrites the values of existing keys in place, so none of its updates may fail. The
+ * hashmap replaces the node of the key on each update, so its updates can fail while the replaced nodes wait for a
+ * grace period.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "jbpf.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_int.h"
+
+#define NUM_THREADS (8)
+#define NUM_ITERATIONS (1000000)
+#define NUM_KEYS (1024)
+#define MAX_ENTRIES (64 * 1024)
+
+struct bench_thread_args
+{
+    struct jbpf_map* map;
+    int id;
+    uint64_t elapsed_ns;
+    uint64_t busy;
+    uint64_t errors;
+};
+
+static pthread_barrier_t bench_barrier;
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void*
+bench_thread(void* arg)
+{
+    struct bench_thread_args* args = arg;
+    uint64_t start, value;
+    uint32_t key;
+    int res;
+
+    jbpf_register_thread();
+    pthread_barrier_wait(&bench_barrier);
+
+    start = bench_now_ns();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        key = (uint32_t)(i * NUM_THREADS + args->id) % NUM_KEYS;
+        value = i;
+        // JBPF_MAP_TYPE_HASHMAP reports a busy map as -JBPF_MAP_BUSY on updates
+        while ((res = __jbpf_map_update_elem(args->map, &key, &value, 0)) == JBPF_MAP_BUSY || res == -JBPF_MAP_BUSY) {
+            args->busy++;
+        }
+        if (res != JBPF_MAP_SUCCESS) {
+            args->errors++;
+        }
+    }
+    args->elapsed_ns = bench_now_ns() - start;
+
+    jbpf_cleanup_thread();
+    return NULL;
+}
+
+static double
+bench_map(const char* name, int type, uint64_t* num_errors)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint64_t),
+        .max_entries = MAX_ENTRIES,
+    };
+    pthread_t threads[NUM_THREADS];
+    struct bench_thread_args args[NUM_THREADS];
+    uint64_t total_ns = 0, busy = 0, errors = 0;
+    struct jbpf_map* map;
+    double ns_per_update;
+
+    map = __jbpf_create_map(name, &map_def, NULL);
+    assert(map);
+
+    pthread_barrier_init(&bench_barrier, NULL, NUM_THREADS);
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i] = (struct bench_thread_args){.map = map, .id = i};
+        pthread_create(&threads[i], NULL, bench_thread, &args[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        total_ns += args[i].elapsed_ns;
+        busy += args[i].busy;
+        errors += args[i].errors;
+    }
+    pthread_barrier_destroy(&bench_barrier);
+
+    __jbpf_destroy_map(map);
+
+    *num_errors = errors;
+    ns_per_update = (double)total_ns / ((double)NUM_THREADS * NUM_ITERATIONS);
+    printf(
+        "%-18s: %d threads x %d updates, %.2f ns per update, %.3f busy retries per update, %lu errors\n",
+        name,
+        NUM_THREADS,
+        NUM_ITERATIONS,
+        ns_per_update,
+        (double)busy / ((double)NUM_THREADS * NUM_ITERATIONS),
+        errors);
+    return ns_per_update;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    double hashmap_ns, concurrent_ns;
+    uint64_t hashmap_errors, concurrent_errors;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    hashmap_ns = bench_map("hashmap", JBPF_MAP_TYPE_HASHMAP, &hashmap_errors);
+    concurrent_ns = bench_map("concurrent_hashmap", JBPF_MAP_TYPE_CONCURRENT_HASHMAP, &concurrent_errors);
+    printf("concurrent_hashmap/hashmap: %.2f\n", concurrent_ns / hashmap_ns);
+
+    // All the keys fit in the map, and updates of existing keys do not need a new node
+    assert(concurrent_errors == 0);
+
+    jbpf_stop();
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * This benchmark compares the cost per key of single-key and batched map operations, for each map type that supports
+ * batches:
+ * 1. A lookup of each key with jbpf_map_lookup_elem and a copy of its value, vs jbpf_map_lookup_batch.
+ * 2. An update of each key with jbpf_map_update_elem, vs jbpf_map_update_batch.
+ *
+ * The map holds NUM_KEYS keys, more than fit in the private caches of a core, and the keys are accessed in a random
+ * order, like the flows of a hook that processes a burst of packets. The benchmark reports the average time per key
+ * for batches of 1 to JBPF_MAP_BATCH_MAX_KEYS keys, where the batches overlap the cache misses of their keys. All the
+ * keys are in the map, so every lookup finds its key. A run in which an update fails is reported as failed instead of
+ * with its time, since it did not do all of its updates.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "jbpf.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_int.h"
+
+#define NUM_KEYS (128 * 1024)
+#define MAX_ENTRIES (128 * 1024)
+#define NUM_OPS (1024 * 1024)
+
+static uint32_t bench_keys[NUM_OPS];
+static uint64_t bench_values[JBPF_MAP_BATCH_MAX_KEYS];
+/* A struct jbpf_map_batch_values: the found mask of a batch lookup, followed by its values */
+static uint64_t bench_lookup_values[1 + JBPF_MAP_BATCH_MAX_KEYS];
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Returns the time per key in ns, or a negative value if an update failed */
+static double
+bench_single(struct jbpf_map* map, uint32_t batch_size, bool update)
+{
+    uint64_t start;
+    uint64_t* value;
+    int num_errors = 0;
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < NUM_OPS; i += batch_size) {
+        for (uint32_t j = 0; j < batch_size; j++) {
+            if (update) {
+                bench_values[j] = i + j;
+                if (__jbpf_map_update_elem(map, &bench_keys[i + j], &bench_values[j], 0) != 0)
+                    num_errors++;
+            } else {
+                value = __jbpf_map_lookup_elem(map, &bench_keys[i + j]);
+                if (value)
+                    memcpy(&bench_values[j], value, sizeof(uint64_t));
+            }
+        }
+    }
+    if (num_errors > 0)
+        return -1;
+    return (double)(bench_now_ns() - start) / NUM_OPS;
+}
+
+/* Returns the time per key in ns, or a negative value if an update failed */
+static double
+bench_batch(struct jbpf_map* map, uint32_t batch_size, bool update)
+{
+    uint32_t keys_size = batch_size * sizeof(uint32_t);
+    uint32_t values_size = batch_size * sizeof(uint64_t);
+    uint64_t start;
+    int num_errors = 0;
+    int res;
+
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < NUM_OPS; i += batch_size) {
+        if (update) {
+            for (uint32_t j = 0; j < batch_size; j++)
+                bench_values[j] = i + j;
+            res = __jbpf_map_update_batch(map, &bench_keys[i], keys_size, bench_values, values_size);
+            if (res != (int)batch_size)
+                num_errors++;
+        } else {
+            res = __jbpf_map_lookup_batch(
+                map, &bench_keys[i], keys_size, bench_lookup_values, sizeof(uint64_t) + values_size);
+            assert(res == (int)batch_size);
+        }
+    }
+    if (num_errors > 0)
+        return -1;
+    return (double)(bench_now_ns() - start) / NUM_OPS;
+}
+
+static void
+bench_print_result(double ns)
+{
+    if (ns < 0)
+        printf(" %14s", "failed");
+    else
+        printf(" %11.2f ns", ns);
+}
+
+static void
+bench_map(const char* name, int type)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint64_t),
+        .max_entries = MAX_ENTRIES,
+    };
+    struct jbpf_map* map;
+    uint64_t value;
+
+    map = __jbpf_create_map(name, &map_def, NULL);
+    assert(map);
+
+    for (uint32_t key = 0; key < NUM_KEYS; key++) {
+        value = key;
+        assert(__jbpf_map_update_elem(map, &key, &value, 0) == 0);
+    }
+
+    printf("%s\n", name);
+    printf("  %5s %14s %14s %14s %14s\n", "batch", "lookup_elem", "lookup_batch", "update_elem", "update_batch");
+    for (uint32_t batch_size = 1; batch_size <= JBPF_MAP_BATCH_MAX_KEYS; batch_size *= 2) {
+        printf("  %5u", batch_size);
+        bench_print_result(bench_single(map, batch_size, false));
+        bench_print_result(bench_batch(map, batch_size, false));
+        bench_print_result(bench_single(map, batch_size, true));
+        bench_print_result(bench_batch(map, batch_size, true));
+        printf("\n");
+    }
+
+    __jbpf_destroy_map(map);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    uint32_t seed = 1;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    // The same random keys for every map and batch size, all of them in the map
+    for (int i = 0; i < NUM_OPS; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        bench_keys[i] = seed % NUM_KEYS;
+    }
+
+    printf("Time per key, %d keys in random order\n", NUM_OPS);
+    bench_map("array", JBPF_MAP_TYPE_ARRAY);
+    bench_map("hashmap", JBPF_MAP_TYPE_HASHMAP);
+    bench_map("concurrent_hashmap", JBPF_MAP_TYPE_CONCURRENT_HASHMAP);
+    bench_map("lru_hashmap", JBPF_MAP_TYPE_LRU_HASHMAP);
+    bench_map("per_thread_hashmap", JBPF_MAP_TYPE_PER_THREAD_HASHMAP);
+    bench_map("per_thread_lru_hashmap", JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP);
+
+    jbpf_stop();
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * This benchmark measures the startup cost of jbpf:
+ * 1. The average time taken by the calibration of the clock ticks, over NUM_ITERATIONS calibrations.
+ * 2. The time taken by jbpf_init() and jbpf_stop().
+ *
+ * It also compares the calibrated tick frequency to a reference measured over REFERENCE_PERIOD_NS, and reports the
+ * difference in parts per million.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "jbpf.h"
+#include "jbpf_perf.h"
+
+#define NUM_ITERATIONS (10)
+#define REFERENCE_PERIOD_NS (1000000000ULL)
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double
+bench_reference_tick_freq(void)
+{
+    uint64_t start_ns, start_ticks, end_ns, end_ticks;
+
+    start_ticks = jbpf_start_time();
+    start_ns = bench_now_ns();
+    do {
+        end_ns = bench_now_ns();
+    } while (end_ns - start_ns < REFERENCE_PERIOD_NS);
+    end_ticks = jbpf_end_time();
+
+    return (double)(end_ticks - start_ticks) / (double)(end_ns - start_ns) * 1e9;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    uint64_t start, calibrate_ns = 0, init_ns, stop_ns;
+    double reference_freq;
+
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        start = bench_now_ns();
+        _jbpf_calibrate_ticks();
+        calibrate_ns += bench_now_ns() - start;
+    }
+
+    reference_freq = bench_reference_tick_freq();
+    printf(
+        "calibration: %.3f ms, tick frequency %lu, reference %.0f, difference %.1f ppm\n",
+        (double)calibrate_ns / NUM_ITERATIONS / 1e6,
+        g_jbpf_tick_freq,
+        reference_freq,
+        ((double)g_jbpf_tick_freq - reference_freq) / reference_freq * 1e6);
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+
+    start = bench_now_ns();
+    assert(jbpf_init(&config) == 0);
+    init_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    jbpf_stop();
+    stop_ns = bench_now_ns() - start;
+
+    printf("jbpf_init: %.3f ms, jbpf_stop: %.3f ms\n", (double)init_ns / 1e6, (double)stop_ns / 1e6);
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+ * This benchmark measures the overhead of the flight recorder (USE_JBPF_TRACE):
+ * 1. The average time taken to record one codelet invocation in the ring of the calling thread, over NUM_ITERATIONS
+ *    records.
+ * 2. The average time taken by a call of a hook with a native codelet that does nothing, which includes the record
+ *    when jbpf is built with USE_JBPF_TRACE. Building the benchmark with and without USE_JBPF_TRACE gives the
+ *    overhead per hook call.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_trace.h"
+#include "jbpf_defs.h"
+
+#define NUM_ITERATIONS (10000000)
+#define RING_SIZE (4096)
+
+DECLARE_JBPF_HOOK(
+    bench_trace,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(uint64_t* value, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)value; ctx.data_end = (uint64_t)(void*)(value + 1);))
+
+DEFINE_JBPF_HOOK(bench_trace)
+
+static uint64_t
+bench_codelet(void* mem, size_t mem_len)
+{
+    return 0;
+}
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_codelet codelet = {0};
+    uint64_t value = 0, start, record_ns, hook_ns;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.trace_config.ring_size = RING_SIZE;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+#ifdef JBPF_TRACE
+    assert(jbpf_trace_rings[get_jbpf_hook_thread_id()].records != NULL);
+#else
+    printf("jbpf is built without USE_JBPF_TRACE, nothing is recorded\n");
+#endif
+
+    start = bench_now_ns();
+    for (uint64_t i = 0; i < NUM_ITERATIONS; i++) {
+        _jbpf_trace_log(&__jbpf_hook_bench_trace, &codelet, i, i + 10, 0);
+    }
+    record_ns = bench_now_ns() - start;
+
+    assert(jbpf_register_codelet_bench_trace(bench_codelet, 0, 1) == 0);
+    start = bench_now_ns();
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        hook_bench_trace(&value, 1);
+    }
+    hook_ns = bench_now_ns() - start;
+    assert(jbpf_remove_codelet_hook_bench_trace(bench_codelet) == 0);
+
+    printf(
+        "record: %.2f ns, hook call: %.2f ns\n",
+        (double)record_ns / NUM_ITERATIONS,
+        (double)hook_ns / NUM_ITERATIONS);
+
+    jbpf_stop();
+    return 0;
+}
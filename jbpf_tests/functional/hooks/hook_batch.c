@@ -0,0 +1,110 @@
+/*
+ * The purpose of this test is to check that a batch hook passes all the elements of a batch to its codelets in a single
+ * call.
+ *
+ * This test does the following:
+ * 1. It registers 2 native functions as codelets of a batch hook.
+ * 2. It calls the hook with a batch of elements and checks that each codelet was called once, with a jbpf_batch_ctx
+ *    that spans all the elements of the batch.
+ * 3. It calls the hook with an empty batch and checks that no codelet was called.
+ * 4. It removes the codelets and checks that calling the hook does not run any codelet.
+ */
+
+#include <assert.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+
+#define BATCH_SIZE (32)
+
+struct batch_elem
+{
+    int value;
+};
+
+DECLARE_JBPF_BATCH_HOOK(test_batch, struct batch_elem)
+
+DEFINE_JBPF_BATCH_HOOK(test_batch)
+
+static int num_calls = 0;
+static int last_sum = 0;
+
+static uint64_t
+check_batch(void* mem, size_t mem_len)
+{
+    struct jbpf_batch_ctx* ctx = mem;
+    struct batch_elem* elems = (struct batch_elem*)(uintptr_t)ctx->data;
+    struct batch_elem* elems_end = (struct batch_elem*)(uintptr_t)ctx->data_end;
+    int sum = 0;
+
+    assert(mem_len == sizeof(struct jbpf_batch_ctx));
+    assert(ctx->ctx_id == 3);
+    assert(ctx->meta_data == 0);
+    assert(elems + ctx->num_elems == elems_end);
+
+    for (struct batch_elem* e = elems; e < elems_end; e++) {
+        sum += e->value;
+    }
+    last_sum = sum;
+    num_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_first(void* mem, size_t mem_len)
+{
+    return check_batch(mem, mem_len);
+}
+
+static uint64_t
+codelet_second(void* mem, size_t mem_len)
+{
+    return check_batch(mem, mem_len);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct batch_elem elems[BATCH_SIZE];
+    int expected_sum = 0;
+
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        elems[i].value = i;
+        expected_sum += i;
+    }
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_test_batch(codelet_first, 1000, 2) == 0);
+    assert(jbpf_register_codelet_test_batch(codelet_second, 1000, 1) == 0);
+
+    // Each codelet is called once for the whole batch
+    hook_test_batch(elems, BATCH_SIZE, 3);
+    assert(num_calls == 2);
+    assert(last_sum == expected_sum);
+
+    // Partial batch
+    num_calls = 0;
+    hook_test_batch(elems, 4, 3);
+    assert(num_calls == 2);
+    assert(last_sum == 0 + 1 + 2 + 3);
+
+    // Empty batches do not run the codelets
+    num_calls = 0;
+    hook_test_batch(elems, 0, 3);
+    assert(num_calls == 0);
+
+    assert(jbpf_remove_codelet_hook_test_batch(codelet_first) == 0);
+    assert(jbpf_remove_codelet_hook_test_batch(codelet_second) == 0);
+    hook_test_batch(elems, BATCH_SIZE, 3);
+    assert(num_calls == 0);
+
+    jbpf_stop();
+    return 0;
+}
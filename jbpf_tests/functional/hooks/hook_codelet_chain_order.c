@@ -0,0 +1,118 @@
+/*
+ * The purpose of this test is to check that a hook runs its chain of codelets in priority order.
+ *
+ * This test does the following:
+ * 1. It registers 3 native functions as codelets of a hook, with different priorities and runtime thresholds.
+ * 2. It calls the hook and checks that all codelets were called in priority order, with the context of the hook
+ *    and with the runtime threshold of each codelet set.
+ * 3. It removes the middle codelet, calls the hook again and checks that only the remaining codelets were called.
+ * 4. It removes the remaining codelets and checks that calling the hook does not run any codelet.
+ * The same checks apply whether the hook walks the codelet array or runs a fused trampoline (USE_JBPF_HOOK_TRAMPOLINE).
+ */
+
+#include <assert.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+
+#define MAX_CALLS (8)
+
+struct chain_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_chain,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct chain_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_chain)
+
+static int calls[MAX_CALLS];
+static int num_calls = 0;
+
+static void
+check_codelet_call(int id, void* mem, size_t mem_len, jbpf_runtime_threshold_t threshold)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+    struct chain_data* data = (struct chain_data*)(uintptr_t)ctx->data;
+
+    JBPF_UNUSED(data);
+    assert(mem_len == sizeof(struct jbpf_generic_ctx));
+    assert(ctx->ctx_id == 7);
+    assert(data->value == 42);
+    assert(e_runtime_threshold == threshold);
+    assert(num_calls < MAX_CALLS);
+    calls[num_calls++] = id;
+}
+
+static uint64_t
+codelet_high(void* mem, size_t mem_len)
+{
+    check_codelet_call(1, mem, mem_len, 1000);
+    return 0;
+}
+
+static uint64_t
+codelet_mid(void* mem, size_t mem_len)
+{
+    check_codelet_call(2, mem, mem_len, 2000);
+    return 0;
+}
+
+static uint64_t
+codelet_low(void* mem, size_t mem_len)
+{
+    check_codelet_call(3, mem, mem_len, 3000);
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct chain_data data = {.value = 42};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    // Register out of order, the hook must keep them sorted by priority
+    assert(jbpf_register_codelet_test_chain(codelet_mid, 2000, 2) == 0);
+    assert(jbpf_register_codelet_test_chain(codelet_low, 3000, 1) == 0);
+    assert(jbpf_register_codelet_test_chain(codelet_high, 1000, 3) == 0);
+
+    // The same codelet cannot be registered twice
+    assert(jbpf_register_codelet_test_chain(codelet_mid, 2000, 2) != 0);
+
+    hook_test_chain(&data, 7);
+    assert(num_calls == 3);
+    assert(calls[0] == 1);
+    assert(calls[1] == 2);
+    assert(calls[2] == 3);
+
+    num_calls = 0;
+    assert(jbpf_remove_codelet_hook_test_chain(codelet_mid) == 0);
+    hook_test_chain(&data, 7);
+    assert(num_calls == 2);
+    assert(calls[0] == 1);
+    assert(calls[1] == 3);
+
+    num_calls = 0;
+    assert(jbpf_remove_codelet_hook_test_chain(codelet_high) == 0);
+    assert(jbpf_remove_codelet_hook_test_chain(codelet_low) == 0);
+    hook_test_chain(&data, 7);
+    assert(num_calls == 0);
+
+    // Nothing left to remove
+    assert(jbpf_remove_codelet_hook_test_chain(codelet_low) != 0);
+
+    jbpf_stop();
+    return 0;
+}
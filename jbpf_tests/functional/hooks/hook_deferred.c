@@ -0,0 +1,169 @@
+/*
+ * The purpose of this test is to check that the codelets of a deferred hook run on a jbpf worker thread, on a copy of
+ * the hook context, and that the calls dropped because of a full ring are reported in the perf stats.
+ *
+ * This test does the following:
+ * 1. It registers a native codelet to a hook and a native codelet to the report_stats hook, and defers the hook.
+ * 2. It calls the hook with different values, changing the data after each call, and checks that the codelet ran
+ *    on another thread with the value of each call, in order.
+ * 3. It blocks the codelet, calls the hook more times than the ring can hold and checks that the dropped calls are
+ *    reported in deferred_drops of the perf stats.
+ * If jbpf is built without USE_JBPF_DEFERRED_HOOKS, it checks that the hook cannot be deferred and runs inline.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define RING_SIZE (8)
+#define NUM_HOOK_CALLS (32)
+#define MAX_WAIT_ITERATIONS (1000)
+
+struct deferred_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_deferred,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct deferred_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_deferred)
+
+static pthread_t main_thread;
+static int values[NUM_HOOK_CALLS];
+static int num_calls = 0;
+static int num_other_thread_calls = 0;
+static int blocked = 0;
+static uint64_t num_drops = 0;
+
+static uint64_t
+codelet_deferred(void* mem, size_t mem_len)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+    struct deferred_data* data = (struct deferred_data*)(uintptr_t)ctx->data;
+
+    assert(mem_len == sizeof(struct jbpf_generic_ctx));
+    assert(ctx->ctx_id == 7);
+    assert(data + 1 == (struct deferred_data*)(uintptr_t)ctx->data_end);
+
+    while (__atomic_load_n(&blocked, __ATOMIC_SEQ_CST)) {
+        usleep(100);
+    }
+
+    if (!pthread_equal(pthread_self(), main_thread)) {
+        num_other_thread_calls++;
+    }
+    values[num_calls % NUM_HOOK_CALLS] = data->value;
+    __atomic_add_fetch(&num_calls, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static uint64_t
+codelet_report_stats(void* mem, size_t mem_len)
+{
+    struct jbpf_stats_ctx* ctx = mem;
+    struct jbpf_perf_hook_list* hook_list = (struct jbpf_perf_hook_list*)(uintptr_t)ctx->data;
+
+    for (int i = 0; i < hook_list->num_reported_hooks; i++) {
+        if (strcmp(hook_list->perf_data[i].hook_name, "test_deferred") == 0) {
+            __atomic_add_fetch(&num_drops, hook_list->deferred_drops[i], __ATOMIC_SEQ_CST);
+        }
+    }
+    return 0;
+}
+
+static void
+wait_for_calls(int expected)
+{
+    for (int i = 0; i < MAX_WAIT_ITERATIONS && __atomic_load_n(&num_calls, __ATOMIC_SEQ_CST) < expected; i++) {
+        usleep(1000);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct deferred_data data;
+
+    main_thread = pthread_self();
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.deferred_config.num_workers = 1;
+    config.deferred_config.ring_size = RING_SIZE;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_test_deferred(codelet_deferred, 0, 1) == 0);
+    assert(jbpf_register_codelet_report_stats(codelet_report_stats, 0, 1) == 0);
+
+#ifdef JBPF_DEFERRED_HOOKS
+    assert(jbpf_hook_set_deferred(&__jbpf_hook_test_deferred, true) == 0);
+
+    // Each call is copied, so changing the data after the call does not change what the codelet sees
+    for (int i = 0; i < RING_SIZE; i++) {
+        data.value = i;
+        hook_test_deferred(&data, 7);
+        data.value = -1;
+    }
+    wait_for_calls(RING_SIZE);
+    assert(num_calls == RING_SIZE);
+    assert(num_other_thread_calls == RING_SIZE);
+    for (int i = 0; i < RING_SIZE; i++) {
+        assert(values[i] == i);
+    }
+
+    // Fill the ring while the worker is blocked in the codelet. The slot of the blocked call is only released
+    // once the codelet returns, so the ring can only take RING_SIZE - 1 more calls
+    __atomic_store_n(&blocked, 1, __ATOMIC_SEQ_CST);
+    data.value = 0;
+    hook_test_deferred(&data, 7);
+    usleep(10000);
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_deferred(&data, 7);
+    }
+    __atomic_store_n(&blocked, 0, __ATOMIC_SEQ_CST);
+    wait_for_calls(2 * RING_SIZE);
+    assert(num_calls == 2 * RING_SIZE);
+
+    // The maintenance thread may also report the stats, so the drops are counted across all reports
+    for (int i = 0; i < MAX_WAIT_ITERATIONS && __atomic_load_n(&num_drops, __ATOMIC_SEQ_CST) <
+                                                   NUM_HOOK_CALLS - (RING_SIZE - 1);
+         i++) {
+        jbpf_report_perf_stats();
+    }
+    assert(num_drops == NUM_HOOK_CALLS - (RING_SIZE - 1));
+
+    assert(jbpf_hook_set_deferred(&__jbpf_hook_test_deferred, false) == 0);
+#else
+    assert(jbpf_hook_set_deferred(&__jbpf_hook_test_deferred, true) != 0);
+
+    data.value = 3;
+    hook_test_deferred(&data, 7);
+    assert(num_calls == 1);
+    assert(num_other_thread_calls == 0);
+    assert(values[0] == 3);
+#endif
+
+    // Invalid hooks cannot be deferred
+    assert(jbpf_hook_set_deferred(NULL, true) != 0);
+
+    assert(jbpf_remove_codelet_hook_test_deferred(codelet_deferred) == 0);
+    assert(jbpf_remove_codelet_hook_report_stats(codelet_report_stats) == 0);
+
+    jbpf_stop();
+    return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * The purpose of this test is to check that the hooks only run a codelet when the context matches its pre-filter,
+ * and that the filtered calls are reported in the per-codelet perf stats.
+ *
+ * This test does the following:
+ * 1. It loads 3 native codelets with a pre-filter to a hook with a hook transaction: one that requires a ctx_id,
+ *    one that requires a value in the data or a different ctx_id, and one whose field lies outside of the data.
+ * 2. It calls the hook with different values and ctx_ids and checks how many times each codelet ran.
+ * 3. If jbpf is built with USE_JBPF_CODELET_PERF_STATS, it checks that the executed and filtered calls of each
+ *    codelet are reported.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define NUM_HOOK_CALLS (20)
+#define MAX_REPORTS (50)
+
+struct filter_data
+{
+    uint32_t value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_filter,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct filter_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_filter)
+
+static int ctx_id_calls = 0;
+static int any_calls = 0;
+static int out_of_bounds_calls = 0;
+
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t executed[3] = {0};
+static uint64_t filtered[3] = {0};
+
+static uint64_t
+codelet_ctx_id(void* mem, size_t mem_len)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+    assert(ctx->ctx_id == 7);
+    ctx_id_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_any(void* mem, size_t mem_len)
+{
+    any_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_out_of_bounds(void* mem, size_t mem_len)
+{
+    out_of_bounds_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_report_stats(void* mem, size_t mem_len)
+{
+    static const char* names[3] = {"ctx_id", "any", "out_of_bounds"};
+    struct jbpf_stats_ctx* ctx = mem;
+    struct jbpf_perf_hook_list* hook_list = (struct jbpf_perf_hook_list*)(uintptr_t)ctx->data;
+
+    pthread_mutex_lock(&report_mutex);
+    for (int i = 0; i < hook_list->num_reported_codelets; i++) {
+        struct jbpf_perf_codelet_data* codelet_data = &hook_list->codelet_perf_data[i];
+        for (int j = 0; j < 3; j++) {
+            if (strcmp(codelet_data->codelet_name, names[j]) == 0) {
+                executed[j] += codelet_data->perf_data.num;
+                filtered[j] += codelet_data->num_filtered;
+            }
+        }
+    }
+    pthread_mutex_unlock(&report_mutex);
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_txn txn;
+    struct filter_data data;
+    jbpf_codelet_filter_t ctx_id_filter = {
+        .combine = JBPF_FILTER_ALL,
+        .num_conditions = 1,
+        .conditions = {
+            {.base = JBPF_FILTER_BASE_CTX,
+             .op = JBPF_FILTER_OP_EQ,
+             .size = 4,
+             .offset = offsetof(struct jbpf_generic_ctx, ctx_id),
+             .value = 7}}};
+    jbpf_codelet_filter_t any_filter = {
+        .combine = JBPF_FILTER_ANY,
+        .num_conditions = 2,
+        .conditions = {
+            {.base = JBPF_FILTER_BASE_DATA,
+             .op = JBPF_FILTER_OP_GT,
+             .size = 4,
+             .offset = offsetof(struct filter_data, value),
+             .value = 100},
+            {.base = JBPF_FILTER_BASE_CTX,
+             .op = JBPF_FILTER_OP_EQ,
+             .size = 4,
+             .offset = offsetof(struct jbpf_generic_ctx, ctx_id),
+             .value = 1}}};
+    jbpf_codelet_filter_t out_of_bounds_filter = {
+        .combine = JBPF_FILTER_ALL,
+        .num_conditions = 1,
+        .conditions = {
+            {.base = JBPF_FILTER_BASE_DATA,
+             .op = JBPF_FILTER_OP_NE,
+             .size = 4,
+             .offset = sizeof(struct filter_data),
+             .value = 0}}};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_report_stats(codelet_report_stats, 0, 1) == 0);
+
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_filter, codelet_ctx_id, "ctx_id", 0, 3) == 0);
+    assert(jbpf_hook_txn_filter_codelet(&txn, &__jbpf_hook_test_filter, codelet_ctx_id, &ctx_id_filter) == 0);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_filter, codelet_any, "any", 0, 2) == 0);
+    assert(jbpf_hook_txn_filter_codelet(&txn, &__jbpf_hook_test_filter, codelet_any, &any_filter) == 0);
+    assert(
+        jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_filter, codelet_out_of_bounds, "out_of_bounds", 0, 1) == 0);
+    assert(
+        jbpf_hook_txn_filter_codelet(&txn, &__jbpf_hook_test_filter, codelet_out_of_bounds, &out_of_bounds_filter) ==
+        0);
+    // Only staged codelets can be filtered
+    assert(jbpf_hook_txn_filter_codelet(&txn, &__jbpf_hook_test_filter, codelet_report_stats, &ctx_id_filter) != 0);
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+
+    // Odd calls have ctx_id 7 and even calls ctx_id 1. Calls from 11 on have a value above 100
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        data.value = i * 10;
+        hook_test_filter(&data, i % 2 ? 7 : 1);
+    }
+
+    assert(ctx_id_calls == NUM_HOOK_CALLS / 2);
+    assert(any_calls == NUM_HOOK_CALLS / 2 + 5);
+    assert(out_of_bounds_calls == 0);
+
+    // The maintenance thread may also report the stats, so the calls are counted across all reports
+    for (int i = 0; i < MAX_REPORTS; i++) {
+        jbpf_report_perf_stats();
+        pthread_mutex_lock(&report_mutex);
+        bool done = filtered[0] + filtered[1] + filtered[2] == NUM_HOOK_CALLS / 2 + 5 + NUM_HOOK_CALLS &&
+                    executed[0] + executed[1] == NUM_HOOK_CALLS + 5;
+        pthread_mutex_unlock(&report_mutex);
+        if (done) {
+            break;
+        }
+    }
+
+#if defined(JBPF_CODELET_PERF_STATS) && !defined(DISABLE_JBPF_PERF_STATS)
+    pthread_mutex_lock(&report_mutex);
+    assert(executed[0] == NUM_HOOK_CALLS / 2);
+    assert(filtered[0] == NUM_HOOK_CALLS / 2);
+    assert(executed[1] == NUM_HOOK_CALLS / 2 + 5);
+    assert(filtered[1] == 5);
+    assert(executed[2] == 0);
+    assert(filtered[2] == NUM_HOOK_CALLS);
+    pthread_mutex_unlock(&report_mutex);
+#endif
+
+    assert(jbpf_remove_codelet_hook_test_filter(codelet_ctx_id) == 0);
+    assert(jbpf_remove_codelet_hook_test_filter(codelet_any) == 0);
+    assert(jbpf_remove_codelet_hook_test_filter(codelet_out_of_bounds) == 0);
+    assert(jbpf_remove_codelet_hook_report_stats(codelet_report_stats) == 0);
+
+    jbpf_stop();
+    return 0;
+}
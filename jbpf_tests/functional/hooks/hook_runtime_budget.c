@@ -0,0 +1,133 @@
+/*
+ * The purpose of this test is to check that a codelet that keeps exceeding its runtime threshold is quarantined.
+ *
+ * This test does the following:
+ * 1. It registers a slow and a fast native codelet to a hook, with a runtime threshold that only the slow one exceeds,
+ *    and a native codelet to the codelet_quarantined hook.
+ * 2. It calls the hook more times than the allowed number of overruns.
+ * 3. If jbpf is built with USE_JBPF_RUNTIME_BUDGETS, it checks that the slow codelet stops running, that it is
+ *    removed from the hook and that a quarantine event is reported for it, while the fast codelet keeps running.
+ *    Otherwise, it checks that both codelets run on every call.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define MAX_OVERRUNS (5)
+#define NUM_HOOK_CALLS (20)
+#define RUNTIME_THRESHOLD_NS (50000)
+#define MAX_WAIT_ITERATIONS (500)
+
+struct budget_test_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_runtime_budget,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct budget_test_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_runtime_budget)
+
+static volatile int slow_calls = 0;
+static volatile int fast_calls = 0;
+static volatile int num_events = 0;
+static struct jbpf_codelet_quarantine_event last_event;
+
+static uint64_t
+codelet_slow(void* mem, size_t mem_len)
+{
+    slow_calls++;
+    usleep(1000);
+    return 0;
+}
+
+static uint64_t
+codelet_fast(void* mem, size_t mem_len)
+{
+    fast_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_quarantined(void* mem, size_t mem_len)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+
+    memcpy(&last_event, (void*)(uintptr_t)ctx->data, sizeof(last_event));
+    __atomic_add_fetch(&num_events, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_txn txn;
+    struct budget_test_data data = {.value = 1};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.runtime_budget_config.max_overruns = MAX_OVERRUNS;
+    config.runtime_budget_config.window_ms = 60000;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_codelet_quarantined(codelet_quarantined, 0, 1) == 0);
+
+    jbpf_hook_txn_init(&txn);
+    assert(
+        jbpf_hook_txn_add_codelet(
+            &txn, &__jbpf_hook_test_runtime_budget, codelet_slow, "slow", RUNTIME_THRESHOLD_NS, 2) == 0);
+    assert(
+        jbpf_hook_txn_add_codelet(
+            &txn, &__jbpf_hook_test_runtime_budget, codelet_fast, "fast", RUNTIME_THRESHOLD_NS, 1) == 0);
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_runtime_budget(&data, 1);
+    }
+    assert(fast_calls == NUM_HOOK_CALLS);
+
+#ifdef JBPF_RUNTIME_BUDGETS
+    // The slow codelet is skipped as soon as it exceeds its budget
+    assert(slow_calls == MAX_OVERRUNS + 1);
+
+    // The maintenance thread removes it and reports the quarantine
+    for (int i = 0; i < MAX_WAIT_ITERATIONS && __atomic_load_n(&num_events, __ATOMIC_SEQ_CST) == 0; i++) {
+        usleep(10000);
+    }
+    assert(num_events == 1);
+    assert(strcmp(last_event.hook_name, "test_runtime_budget") == 0);
+    assert(strcmp(last_event.codelet_name, "slow") == 0);
+    assert(last_event.runtime_threshold == RUNTIME_THRESHOLD_NS);
+    assert(last_event.num_overruns == MAX_OVERRUNS + 1);
+
+    assert(jbpf_remove_codelet_hook_test_runtime_budget(codelet_slow) != 0);
+
+    hook_test_runtime_budget(&data, 1);
+    assert(slow_calls == MAX_OVERRUNS + 1);
+    assert(fast_calls == NUM_HOOK_CALLS + 1);
+#else
+    assert(slow_calls == NUM_HOOK_CALLS);
+    assert(num_events == 0);
+    assert(jbpf_remove_codelet_hook_test_runtime_budget(codelet_slow) == 0);
+#endif
+
+    assert(jbpf_remove_codelet_hook_test_runtime_budget(codelet_fast) == 0);
+    assert(jbpf_remove_codelet_hook_codelet_quarantined(codelet_quarantined) == 0);
+
+    jbpf_stop();
+    return 0;
+}
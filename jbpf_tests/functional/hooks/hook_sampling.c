@@ -0,0 +1,124 @@
+/*
+ * The purpose of this test is to check that sampled codelets only run on a part of the calls of their hook.
+ *
+ * This test does the following:
+ * 1. It loads 4 native codelets to a hook with a hook transaction: one without sampling, one that runs on 1 in 4
+ *    calls, one that runs at most once per hour and one that runs at most once per second with bursts of 3 calls.
+ * 2. It calls the hook a number of times and checks how many times each codelet ran.
+ * 3. It checks that a codelet with an invalid sampling cannot be loaded.
+ */
+
+#include <assert.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+
+#define NUM_HOOK_CALLS (100)
+#define SAMPLING_RATIO (4)
+#define SAMPLING_BURST (3)
+
+struct sampling_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_sampling,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct sampling_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_sampling)
+
+static int all_calls = 0;
+static int ratio_calls = 0;
+static int interval_calls = 0;
+static int rate_calls = 0;
+
+static uint64_t
+codelet_all(void* mem, size_t mem_len)
+{
+    all_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_ratio(void* mem, size_t mem_len)
+{
+    ratio_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_interval(void* mem, size_t mem_len)
+{
+    interval_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_rate(void* mem, size_t mem_len)
+{
+    rate_calls++;
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_txn txn;
+    struct sampling_data data = {.value = 1};
+    jbpf_codelet_sampling_t ratio = {.type = JBPF_SAMPLING_RATIO, .value = SAMPLING_RATIO};
+    jbpf_codelet_sampling_t interval = {.type = JBPF_SAMPLING_INTERVAL, .value = 3600ULL * 1000000000ULL};
+    jbpf_codelet_sampling_t rate = {.type = JBPF_SAMPLING_RATE, .value = 1, .burst = SAMPLING_BURST};
+    jbpf_codelet_sampling_t invalid = {.type = JBPF_SAMPLING_RATIO, .value = 0};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_sampling, codelet_all, "all", 0, 4) == 0);
+    assert(
+        jbpf_hook_txn_add_sampled_codelet(&txn, &__jbpf_hook_test_sampling, codelet_ratio, "ratio", 0, 3, &ratio) ==
+        0);
+    assert(
+        jbpf_hook_txn_add_sampled_codelet(
+            &txn, &__jbpf_hook_test_sampling, codelet_interval, "interval", 0, 2, &interval) == 0);
+    assert(
+        jbpf_hook_txn_add_sampled_codelet(&txn, &__jbpf_hook_test_sampling, codelet_rate, "rate", 0, 1, &rate) == 0);
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_sampling(&data, 1);
+    }
+
+    assert(all_calls == NUM_HOOK_CALLS);
+    // The first call of each thread is always part of the sample
+    assert(ratio_calls == NUM_HOOK_CALLS / SAMPLING_RATIO);
+    assert(interval_calls == 1);
+    // The calls are much less than a second apart, so only the burst runs
+    assert(rate_calls == SAMPLING_BURST);
+
+    // A codelet with an invalid sampling is not loaded, and the transaction is not applied
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_sampling, codelet_all) == 0);
+    assert(
+        jbpf_hook_txn_add_sampled_codelet(&txn, &__jbpf_hook_test_sampling, codelet_all, "all", 0, 4, &invalid) == 0);
+    assert(jbpf_hook_txn_commit(&txn) != 0);
+    hook_test_sampling(&data, 1);
+    assert(all_calls == NUM_HOOK_CALLS + 1);
+
+    assert(jbpf_remove_codelet_hook_test_sampling(codelet_all) == 0);
+    assert(jbpf_remove_codelet_hook_test_sampling(codelet_ratio) == 0);
+    assert(jbpf_remove_codelet_hook_test_sampling(codelet_interval) == 0);
+    assert(jbpf_remove_codelet_hook_test_sampling(codelet_rate) == 0);
+
+    jbpf_stop();
+    return 0;
+}
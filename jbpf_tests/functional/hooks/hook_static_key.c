@@ -0,0 +1,106 @@
+/*
+ * The purpose of this test is to check that the call sites of a hook are only enabled while the hook has codelets.
+ *
+ * This test does the following:
+ * 1. It calls a hook without codelets and checks that its call sites are disabled.
+ * 2. It registers 2 codelets to the hook and checks that the call sites are enabled and that both codelets run.
+ * 3. It removes one codelet and checks that the call sites stay enabled and that the other codelet still runs.
+ * 4. It removes the last codelet and checks that the call sites are disabled again and that nothing runs.
+ * 5. It registers a codelet again and checks that it runs.
+ * If jbpf is built without USE_JBPF_STATIC_KEYS, or if the call sites cannot be patched, the call sites are always
+ * reported as enabled.
+ */
+
+#include <assert.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_static_key.h"
+#include "jbpf_defs.h"
+
+struct static_key_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_static_key,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct static_key_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_static_key)
+
+static int first_calls = 0;
+static int second_calls = 0;
+
+static uint64_t
+codelet_first(void* mem, size_t mem_len)
+{
+    first_calls++;
+    return 0;
+}
+
+static uint64_t
+codelet_second(void* mem, size_t mem_len)
+{
+    second_calls++;
+    return 0;
+}
+
+static bool
+call_sites_enabled(void)
+{
+    return jbpf_static_key_enabled(&__jbpf_hook_test_static_key);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct static_key_data data = {.value = 1};
+    bool static_keys;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    static_keys = jbpf_static_key_active();
+
+    jbpf_register_thread();
+
+    hook_test_static_key(&data, 1);
+    assert(call_sites_enabled() == !static_keys);
+
+    assert(jbpf_register_codelet_test_static_key(codelet_first, 1000, 2) == 0);
+    assert(jbpf_register_codelet_test_static_key(codelet_second, 1000, 1) == 0);
+    assert(call_sites_enabled());
+    hook_test_static_key(&data, 1);
+    assert(first_calls == 1);
+    assert(second_calls == 1);
+
+    // The call sites stay enabled while the hook has codelets
+    assert(jbpf_remove_codelet_hook_test_static_key(codelet_first) == 0);
+    assert(call_sites_enabled());
+    hook_test_static_key(&data, 1);
+    assert(first_calls == 1);
+    assert(second_calls == 2);
+
+    assert(jbpf_remove_codelet_hook_test_static_key(codelet_second) == 0);
+    assert(call_sites_enabled() == !static_keys);
+    hook_test_static_key(&data, 1);
+    assert(first_calls == 1);
+    assert(second_calls == 2);
+
+    // Re-enable the hook
+    assert(jbpf_register_codelet_test_static_key(codelet_first, 1000, 1) == 0);
+    assert(call_sites_enabled());
+    hook_test_static_key(&data, 1);
+    assert(first_calls == 2);
+
+    assert(jbpf_remove_codelet_hook_test_static_key(codelet_first) == 0);
+
+    jbpf_stop();
+    return 0;
+}
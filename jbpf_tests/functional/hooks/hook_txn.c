@@ -0,0 +1,136 @@
+/*
+ * The purpose of this test is to check that the codelets of multiple hooks can be installed and removed together
+ * with a hook transaction.
+ *
+ * This test does the following:
+ * 1. It stages the registration of codelets to 2 different hooks and checks that nothing runs before the commit.
+ * 2. It commits the transaction and checks that the codelets of both hooks run, in priority order.
+ * 3. It stages a transaction with an invalid operation (a duplicate codelet) and checks that the commit fails
+ *    without changing any of the hooks.
+ * 4. It removes all the codelets with a single transaction and checks that none of them runs anymore.
+ */
+
+#include <assert.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_defs.h"
+
+#define MAX_CALLS (8)
+
+struct txn_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_txn1,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct txn_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DECLARE_JBPF_HOOK(
+    test_txn2,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct txn_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_txn1)
+DEFINE_JBPF_HOOK(test_txn2)
+
+static int calls[MAX_CALLS];
+static int num_calls = 0;
+
+static void
+record_call(int id)
+{
+    assert(num_calls < MAX_CALLS);
+    calls[num_calls++] = id;
+}
+
+static uint64_t
+codelet_a(void* mem, size_t mem_len)
+{
+    record_call(1);
+    return 0;
+}
+
+static uint64_t
+codelet_b(void* mem, size_t mem_len)
+{
+    record_call(2);
+    return 0;
+}
+
+static uint64_t
+codelet_c(void* mem, size_t mem_len)
+{
+    record_call(3);
+    return 0;
+}
+
+static void
+call_hooks(void)
+{
+    struct txn_data data = {.value = 1};
+
+    num_calls = 0;
+    hook_test_txn1(&data, 1);
+    hook_test_txn2(&data, 2);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_txn txn;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_txn1, codelet_b, NULL, 1000, 1) == 0);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_txn1, codelet_a, NULL, 1000, 2) == 0);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_txn2, codelet_c, NULL, 1000, 1) == 0);
+
+    // Nothing is installed before the commit
+    call_hooks();
+    assert(num_calls == 0);
+
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+    call_hooks();
+    assert(num_calls == 3);
+    assert(calls[0] == 1);
+    assert(calls[1] == 2);
+    assert(calls[2] == 3);
+
+    // A failed transaction does not change any hook
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_txn2, codelet_c) == 0);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_txn1, codelet_a, NULL, 1000, 2) == 0);
+    assert(jbpf_hook_txn_commit(&txn) != 0);
+    call_hooks();
+    assert(num_calls == 3);
+
+    // Remove everything at once
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_txn1, codelet_a) == 0);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_txn1, codelet_b) == 0);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_txn2, codelet_c) == 0);
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+    call_hooks();
+    assert(num_calls == 0);
+
+    // Nothing left to remove
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_remove_codelet(&txn, &__jbpf_hook_test_txn1, codelet_a) == 0);
+    assert(jbpf_hook_txn_commit(&txn) != 0);
+
+    jbpf_stop();
+    return 0;
+}
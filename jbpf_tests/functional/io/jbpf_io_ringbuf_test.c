@@ -0,0 +1,193 @@
+/*
+ * The purpose of this test is to check the output channels of type JBPF_IO_CHANNEL_RINGBUF, when the io lib is used
+ * in standalone mode (i.e., JBPF_IO_LOCAL_PRIMARY).
+ *
+ * This test does the following:
+ * 1. It initializes the io library with a local primary and creates a ring buffer output channel.
+ * 2. It sends records of different sizes and asserts that they are received in order, with their own size, and that
+ * they can be released in any order.
+ * 3. It reserves a record, submits only part of it, and asserts that only the submitted part is received.
+ * 4. It discards a reserved record and asserts that it is not received.
+ * 5. It fills the ring buffer, asserts that the drops are counted, and that the ring buffer can be filled again once
+ * the records are released.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jbpf_io.h"
+#include "jbpf_io_defs.h"
+#include "jbpf_io_channel.h"
+#include "jbpf_io_utils.h"
+
+#define NUM_ELEMS 8
+#define MAX_RECORDS 64
+
+struct test_struct
+{
+    uint8_t payload[64];
+};
+
+struct test_state
+{
+    int num_received;
+    int sizes[MAX_RECORDS];
+    jbpf_channel_buf_ptr bufs[MAX_RECORDS];
+};
+
+struct jbpf_io_stream_id stream_id1 = {
+    .id = {0xF1, 0xFF, 0XFF, 0XFF, 0xFF, 0xFF, 0XFF, 0XFF, 0xFF, 0xFF, 0XFF, 0XFF, 0xFF, 0xFF, 0XFF, 0XC1}};
+
+void
+collect_output_data(
+    struct jbpf_io_channel* io_channel, struct jbpf_io_stream_id* stream_id, void** bufs, int num_bufs, void* ctx)
+{
+    struct test_state* state = ctx;
+
+    assert(io_channel);
+    assert(memcmp(stream_id, &stream_id1, sizeof(stream_id1)) == 0);
+
+    for (int i = 0; i < num_bufs; i++) {
+        assert(state->num_received < MAX_RECORDS);
+        state->bufs[state->num_received] = bufs[i];
+        state->sizes[state->num_received] = jbpf_io_channel_buf_size(bufs[i]);
+        state->num_received++;
+    }
+}
+
+static void
+receive_all(struct jbpf_io_ctx* io_ctx, struct test_state* state)
+{
+    int num_received;
+
+    state->num_received = 0;
+    do {
+        num_received = state->num_received;
+        jbpf_io_channel_handle_out_bufs(io_ctx, collect_output_data, state);
+    } while (state->num_received != num_received);
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_io_config io_config = {0};
+    struct jbpf_io_ctx* io_ctx;
+    jbpf_io_channel_t* io_channel;
+    struct jbpf_io_channel_stats stats;
+    struct test_struct test_data = {0};
+    struct test_state state = {0};
+    uint8_t* buf;
+    int num_sent;
+
+    io_config.type = JBPF_IO_LOCAL_PRIMARY;
+    io_config.local_config.mem_cfg.memory_size = 1024 * 1024 * 1024;
+    strncpy(io_config.jbpf_path, JBPF_DEFAULT_RUN_PATH, JBPF_RUN_PATH_LEN - 1);
+    io_config.jbpf_path[JBPF_RUN_PATH_LEN - 1] = '\0';
+
+    strncpy(io_config.jbpf_namespace, JBPF_DEFAULT_NAMESPACE, JBPF_NAMESPACE_LEN - 1);
+    io_config.jbpf_namespace[JBPF_NAMESPACE_LEN - 1] = '\0';
+
+    io_ctx = jbpf_io_init(&io_config);
+    assert(io_ctx);
+
+    jbpf_io_register_thread();
+
+    io_channel = jbpf_io_create_channel(
+        io_ctx,
+        JBPF_IO_CHANNEL_OUTPUT,
+        JBPF_IO_CHANNEL_RINGBUF,
+        NUM_ELEMS,
+        sizeof(struct test_struct),
+        stream_id1,
+        NULL,
+        0);
+
+    assert(io_channel);
+
+    assert(jbpf_io_channel_get_stats(io_channel, &stats) == 0);
+    assert(stats.depth == 0);
+    assert(stats.capacity >= NUM_ELEMS * sizeof(struct test_struct));
+
+    // Records are only as large as the data sent
+    for (int i = 0; i < 16; i++) {
+        memset(test_data.payload, i, sizeof(test_data.payload));
+        assert(jbpf_io_channel_send_data(io_channel, &test_data, i + 1) == 0);
+    }
+
+    // Data larger than the element size cannot be sent
+    assert(jbpf_io_channel_send_data(io_channel, &test_data, sizeof(test_data) + 1) == -1);
+
+    receive_all(io_ctx, &state);
+    assert(state.num_received == 16);
+    for (int i = 0; i < 16; i++) {
+        assert(state.sizes[i] == i + 1);
+        buf = state.bufs[i];
+        for (int j = 0; j < i + 1; j++) {
+            assert(buf[j] == i);
+        }
+    }
+
+    // Release the records out of order
+    for (int i = 15; i >= 0; i -= 2) {
+        jbpf_io_channel_release_buf(state.bufs[i]);
+    }
+    assert(jbpf_io_channel_get_stats(io_channel, &stats) == 0);
+    assert(stats.depth > 0);
+    for (int i = 0; i < 16; i += 2) {
+        jbpf_io_channel_release_buf(state.bufs[i]);
+    }
+    assert(jbpf_io_channel_get_stats(io_channel, &stats) == 0);
+    assert(stats.depth == 0);
+
+    // A reserved record is returned again until it is submitted, and only the submitted part is received
+    buf = jbpf_io_channel_reserve_buf(io_channel);
+    assert(buf);
+    assert(jbpf_io_channel_reserve_buf(io_channel) == (void*)buf);
+    memset(buf, 0xAB, 5);
+    assert(jbpf_io_channel_submit_buf_size(io_channel, sizeof(struct test_struct) + 1) == -1);
+    assert(jbpf_io_channel_submit_buf_size(io_channel, 5) == 0);
+    assert(jbpf_io_channel_submit_buf(io_channel) == -2);
+
+    // A discarded record is not received
+    buf = jbpf_io_channel_reserve_buf(io_channel);
+    assert(buf);
+    jbpf_io_channel_discard_buf(io_channel);
+
+    receive_all(io_ctx, &state);
+    assert(state.num_received == 1);
+    assert(state.sizes[0] == 5);
+    buf = state.bufs[0];
+    assert(buf[0] == 0xAB && buf[4] == 0xAB);
+    jbpf_io_channel_release_buf(state.bufs[0]);
+
+    // Fill the ring buffer a few times, so that the records wrap around its end
+    for (int round = 0; round < 4; round++) {
+        num_sent = 0;
+        while (jbpf_io_channel_send_data(io_channel, &test_data, sizeof(test_data) - round) == 0) {
+            num_sent++;
+            assert(num_sent <= MAX_RECORDS);
+        }
+        assert(num_sent >= NUM_ELEMS);
+
+        assert(jbpf_io_channel_get_stats(io_channel, &stats) == 0);
+        assert(stats.num_drops == round + 1);
+
+        receive_all(io_ctx, &state);
+        assert(state.num_received == num_sent);
+        for (int i = 0; i < state.num_received; i++) {
+            assert(state.sizes[i] == sizeof(test_data) - round);
+            jbpf_io_channel_release_buf(state.bufs[i]);
+        }
+
+        assert(jbpf_io_channel_get_stats(io_channel, &stats) == 0);
+        assert(stats.depth == 0);
+    }
+
+    jbpf_io_destroy_channel(io_ctx, io_channel);
+
+    jbpf_io_stop();
+
+    return 0;
+}
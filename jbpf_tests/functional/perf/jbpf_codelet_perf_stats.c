@@ -0,0 +1,132 @@
+/*
+ * The purpose of this test is to check that the runtime of each codelet is reported next to the runtime of its hook.
+ *
+ * This test does the following:
+ * 1. It loads 2 named codelets to a hook with a hook transaction and a native codelet to the report_stats hook.
+ * 2. It calls the hook a number of times and triggers the perf reports.
+ * 3. If jbpf is built with USE_JBPF_CODELET_PERF_STATS, it checks that each codelet was reported with its own name,
+ *    the name of its hook and the number of times it was called. Otherwise, it checks that no codelet is reported.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define NUM_HOOK_CALLS (100)
+#define MAX_REPORTS (50)
+
+struct perf_test_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_codelet_perf,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct perf_test_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_codelet_perf)
+
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t first_calls = 0;
+static uint64_t second_calls = 0;
+static int num_reported_codelets = 0;
+
+static uint64_t
+codelet_first(void* mem, size_t mem_len)
+{
+    return 0;
+}
+
+static uint64_t
+codelet_second(void* mem, size_t mem_len)
+{
+    usleep(10);
+    return 0;
+}
+
+static uint64_t
+codelet_report_stats(void* mem, size_t mem_len)
+{
+    struct jbpf_stats_ctx* ctx = mem;
+    struct jbpf_perf_hook_list* hook_list = (struct jbpf_perf_hook_list*)(uintptr_t)ctx->data;
+
+    pthread_mutex_lock(&report_mutex);
+    num_reported_codelets += hook_list->num_reported_codelets;
+    for (int i = 0; i < hook_list->num_reported_codelets; i++) {
+        struct jbpf_perf_codelet_data* codelet_data = &hook_list->codelet_perf_data[i];
+        assert(strcmp(codelet_data->perf_data.hook_name, "test_codelet_perf") == 0);
+        if (strcmp(codelet_data->codelet_name, "first") == 0) {
+            first_calls += codelet_data->perf_data.num;
+        } else if (strcmp(codelet_data->codelet_name, "second") == 0) {
+            second_calls += codelet_data->perf_data.num;
+            assert(codelet_data->perf_data.num == 0 || codelet_data->perf_data.min >= 10000);
+        } else {
+            assert(false);
+        }
+    }
+    pthread_mutex_unlock(&report_mutex);
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct jbpf_hook_txn txn;
+    struct perf_test_data data = {.value = 1};
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_report_stats(codelet_report_stats, 0, 1) == 0);
+
+    jbpf_hook_txn_init(&txn);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_codelet_perf, codelet_first, "first", 0, 2) == 0);
+    assert(jbpf_hook_txn_add_codelet(&txn, &__jbpf_hook_test_codelet_perf, codelet_second, "second", 0, 1) == 0);
+    assert(jbpf_hook_txn_commit(&txn) == 0);
+
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_codelet_perf(&data, 1);
+    }
+
+    // The maintenance thread may also report the stats, so the calls are counted across all reports.
+    // A report collects the stats retired by the previous one, so the calls are reported after a few reports
+    for (int i = 0; i < MAX_REPORTS; i++) {
+        jbpf_report_perf_stats();
+        pthread_mutex_lock(&report_mutex);
+        bool done = first_calls == NUM_HOOK_CALLS && second_calls == NUM_HOOK_CALLS;
+        pthread_mutex_unlock(&report_mutex);
+        if (done) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&report_mutex);
+#if defined(JBPF_CODELET_PERF_STATS) && !defined(DISABLE_JBPF_PERF_STATS)
+    assert(first_calls == NUM_HOOK_CALLS);
+    assert(second_calls == NUM_HOOK_CALLS);
+#else
+    assert(num_reported_codelets == 0);
+#endif
+    pthread_mutex_unlock(&report_mutex);
+
+    assert(jbpf_remove_codelet_hook_test_codelet_perf(codelet_first) == 0);
+    assert(jbpf_remove_codelet_hook_test_codelet_perf(codelet_second) == 0);
+    assert(jbpf_remove_codelet_hook_report_stats(codelet_report_stats) == 0);
+
+    jbpf_stop();
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * The purpose of this test is to check that the metrics snapshot is served on the metrics socket in OpenMetrics text
+ * format.
+ *
+ * This test does the following:
+ * 1. It initializes jbpf with the metrics enabled.
+ * 2. It loads a codeletset with a codelet with a hashmap to hook "test1", and calls the hook to add an entry to the
+ * map.
+ * 3. It reads the socket until the maintenance thread publishes a snapshot with the hook, and checks the runtime
+ * histogram of the hook, the occupancy of the map and the memory usage.
+ * 4. It sends an HTTP request to the socket, and checks that the snapshot is sent as an HTTP response.
+ * 5. It stops jbpf, and checks that the socket is removed.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_int.h"
+#include "jbpf_utils.h"
+
+// Contains the struct and hook definitions
+#include "jbpf_test_def.h"
+
+#define CODELETSET_NAME "metrics_codeletset"
+#define CODELET_NAME "codelet-hashmap"
+#define METRICS_SOCKET "jbpf_metrics_test"
+#define MAX_WAIT_S (10)
+
+static char metrics[1 << 20];
+
+/* Reads the response of the metrics socket to the given request, or to no request if req is NULL */
+static size_t
+read_metrics(const char* path, const char* req)
+{
+    struct sockaddr_un addr = {0};
+    size_t len = 0;
+    ssize_t res;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(fd >= 0);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+
+    if (req) {
+        assert(send(fd, req, strlen(req), 0) == (ssize_t)strlen(req));
+    }
+    while ((res = recv(fd, metrics + len, sizeof(metrics) - 1 - len, 0)) > 0) {
+        len += res;
+    }
+    metrics[len] = '\0';
+    close(fd);
+    return len;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    jbpf_codeletset_load_req_s codset_req = {0};
+    jbpf_codeletset_unload_req_s codset_unload_req = {0};
+    jbpf_codelet_descriptor_s* cod_desc = &codset_req.codelet_descriptor[0];
+    const char* jbpf_path = getenv("JBPF_PATH");
+    char socket_path[JBPF_RUN_PATH_LEN + JBPF_NAMESPACE_LEN + 64];
+    struct packet p = {0};
+    bool published = false;
+
+    assert(jbpf_path != NULL);
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.metrics_config.enable_metrics = true;
+    strcpy(config.metrics_config.metrics_ipc_name, METRICS_SOCKET);
+    snprintf(
+        socket_path, sizeof(socket_path), "%s/%s/%s", config.jbpf_run_path, config.jbpf_namespace, METRICS_SOCKET);
+
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    // The socket is served before the first snapshot is published
+    assert(access(socket_path, F_OK) == 0);
+    assert(read_metrics(socket_path, NULL) > 0);
+    assert(strstr(metrics, "# EOF\n") != NULL);
+
+    // Load the codelet to hook test1
+    strcpy(codset_req.codeletset_id.name, CODELETSET_NAME);
+    codset_req.num_codelet_descriptors = 1;
+    cod_desc->num_in_io_channel = 0;
+    cod_desc->num_out_io_channel = 0;
+    cod_desc->num_linked_maps = 0;
+    snprintf(
+        cod_desc->codelet_path,
+        JBPF_PATH_LEN,
+        "%s/jbpf_tests/test_files/codelets/codelet-hashmap/codelet-hashmap.o",
+        jbpf_path);
+    strcpy(cod_desc->codelet_name, CODELET_NAME);
+    strcpy(cod_desc->hook_name, "test1");
+    assert(jbpf_codeletset_load(&codset_req, NULL) == JBPF_CODELET_LOAD_SUCCESS);
+
+    // A negative counter_a adds the key to the map
+    p.counter_a = -1;
+    hook_test1(&p, 1);
+
+    // Wait for the maintenance thread to publish the runtimes of the hook
+    for (int i = 0; i < MAX_WAIT_S * 10 && !published; i++) {
+        read_metrics(socket_path, NULL);
+        published = strstr(metrics, "jbpf_hook_runtime_seconds_count{hook=\"test1\"} 1\n") != NULL;
+        if (!published) {
+            usleep(100000);
+        }
+    }
+    assert(published);
+
+    assert(strstr(metrics, "# TYPE jbpf_hook_runtime_seconds histogram\n") != NULL);
+    assert(strstr(metrics, "jbpf_hook_runtime_seconds_bucket{hook=\"test1\",le=\"+Inf\"} 1\n") != NULL);
+    assert(
+        strstr(
+            metrics,
+            "jbpf_map_entries{codeletset=\"" CODELETSET_NAME "\",codelet=\"" CODELET_NAME
+            "\",map=\"map1\",type=\"hashmap\"} 1\n") != NULL);
+    assert(
+        strstr(
+            metrics,
+            "jbpf_map_max_entries{codeletset=\"" CODELETSET_NAME "\",codelet=\"" CODELET_NAME
+            "\",map=\"map1\",type=\"hashmap\"} 1\n") != NULL);
+    assert(strstr(metrics, "jbpf_memory_reserved_bytes ") != NULL);
+    assert(strstr(metrics, "jbpf_memory_resident_bytes ") != NULL);
+    assert(strcmp(metrics + strlen(metrics) - strlen("# EOF\n"), "# EOF\n") == 0);
+
+    // The snapshot is sent as an HTTP response to an HTTP request
+    assert(read_metrics(socket_path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n") > 0);
+    assert(strncmp(metrics, "HTTP/1.1 200 OK\r\n", strlen("HTTP/1.1 200 OK\r\n")) == 0);
+    assert(strstr(metrics, "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n") != NULL);
+    assert(strstr(metrics, "\r\n\r\n# TYPE jbpf_hook_runtime_seconds histogram\n") != NULL);
+
+    // Unload the codelet
+    strcpy(codset_unload_req.codeletset_id.name, CODELETSET_NAME);
+    assert(jbpf_codeletset_unload(&codset_unload_req, NULL) == JBPF_CODELET_UNLOAD_SUCCESS);
+
+    jbpf_stop();
+
+    assert(access(socket_path, F_OK) != 0);
+
+    printf("Test completed successfully\n");
+    return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * The purpose of this test is to check that the perf counters of a hook are reported next to its runtime.
+ *
+ * This test does the following:
+ * 1. It loads a native codelet that runs a loop of NUM_LOOP_ITERATIONS iterations to a hook, and a native codelet to
+ *    the report_stats hook.
+ * 2. It calls the hook a number of times and triggers the perf reports until all the calls are reported.
+ * 3. With hardware counters, it checks that at least the instructions of the loop were counted. With software
+ *    counters, it checks that the task clock was counted. If jbpf is built without USE_JBPF_PERF_COUNTERS, or no
+ *    counter can be opened, it checks that no counter is reported. With USE_JBPF_CODELET_PERF_STATS, it also checks
+ *    the counters of the codelet.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define NUM_HOOK_CALLS (100)
+#define NUM_LOOP_ITERATIONS (10000)
+#define MAX_REPORTS (500)
+#define REPORT_WAIT_US (10000)
+
+struct perf_counters_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_perf_counters,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct perf_counters_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_perf_counters)
+
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t num_reported_calls = 0;
+static uint64_t counters[JBPF_PERF_NUM_COUNTERS];
+static uint64_t codelet_counters[JBPF_PERF_NUM_COUNTERS];
+static jbpf_perf_counters_type_t counters_type = JBPF_PERF_COUNTERS_NONE;
+
+static uint64_t
+codelet_perf_counters(void* mem, size_t mem_len)
+{
+    struct jbpf_generic_ctx* ctx = mem;
+    volatile struct perf_counters_data* data = (struct perf_counters_data*)(uintptr_t)ctx->data;
+
+    for (int i = 0; i < NUM_LOOP_ITERATIONS; i++) {
+        data->value++;
+    }
+    return 0;
+}
+
+static uint64_t
+codelet_report_stats(void* mem, size_t mem_len)
+{
+    struct jbpf_stats_ctx* ctx = mem;
+    struct jbpf_perf_hook_list* hook_list = (struct jbpf_perf_hook_list*)(uintptr_t)ctx->data;
+
+    pthread_mutex_lock(&report_mutex);
+    counters_type = hook_list->counters_type;
+    for (int i = 0; i < hook_list->num_reported_hooks; i++) {
+        if (strcmp(hook_list->perf_data[i].hook_name, "test_perf_counters") == 0) {
+            num_reported_calls += hook_list->perf_data[i].num;
+            for (int j = 0; j < JBPF_PERF_NUM_COUNTERS; j++) {
+                counters[j] += hook_list->perf_data[i].counters[j];
+            }
+        }
+    }
+    for (int i = 0; i < hook_list->num_reported_codelets; i++) {
+        if (strcmp(hook_list->codelet_perf_data[i].perf_data.hook_name, "test_perf_counters") == 0) {
+            for (int j = 0; j < JBPF_PERF_NUM_COUNTERS; j++) {
+                codelet_counters[j] += hook_list->codelet_perf_data[i].perf_data.counters[j];
+            }
+        }
+    }
+    pthread_mutex_unlock(&report_mutex);
+    return 0;
+}
+
+static void
+check_no_counters(void)
+{
+    for (int j = 0; j < JBPF_PERF_NUM_COUNTERS; j++) {
+        assert(counters[j] == 0);
+        assert(codelet_counters[j] == 0);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct perf_counters_data data = {.value = 0};
+    uint64_t reported_calls = 0;
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    assert(jbpf_register_codelet_report_stats(codelet_report_stats, 0, 1) == 0);
+    assert(jbpf_register_codelet_test_perf_counters(codelet_perf_counters, 0, 1) == 0);
+
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_perf_counters(&data, 1);
+    }
+    assert(data.value == NUM_HOOK_CALLS * NUM_LOOP_ITERATIONS);
+
+    // The maintenance thread may also report the stats, so the calls are counted across all reports
+    for (int i = 0; i < MAX_REPORTS && reported_calls < NUM_HOOK_CALLS; i++) {
+        jbpf_report_perf_stats();
+        usleep(REPORT_WAIT_US);
+        pthread_mutex_lock(&report_mutex);
+        reported_calls = num_reported_calls;
+        pthread_mutex_unlock(&report_mutex);
+    }
+
+    pthread_mutex_lock(&report_mutex);
+#ifndef DISABLE_JBPF_PERF_STATS
+    assert(num_reported_calls == NUM_HOOK_CALLS);
+#endif
+#ifndef JBPF_PERF_COUNTERS
+    assert(counters_type == JBPF_PERF_COUNTERS_NONE);
+#endif
+    assert(counters_type == jbpf_perf_counters_type());
+
+#ifdef DISABLE_JBPF_PERF_STATS
+    check_no_counters();
+#else
+    if (counters_type == JBPF_PERF_COUNTERS_HW) {
+        // Instructions and cycles
+        assert(counters[0] >= (uint64_t)NUM_HOOK_CALLS * NUM_LOOP_ITERATIONS);
+        assert(counters[1] > 0);
+#ifdef JBPF_CODELET_PERF_STATS
+        // The codelet runs within the hook
+        assert(codelet_counters[0] >= (uint64_t)NUM_HOOK_CALLS * NUM_LOOP_ITERATIONS);
+        assert(codelet_counters[0] <= counters[0]);
+#endif
+    } else if (counters_type == JBPF_PERF_COUNTERS_SW) {
+        // Task clock
+        assert(counters[0] > 0);
+#ifdef JBPF_CODELET_PERF_STATS
+        assert(codelet_counters[0] > 0);
+#endif
+    } else {
+        check_no_counters();
+    }
+#endif
+    pthread_mutex_unlock(&report_mutex);
+
+    assert(jbpf_remove_codelet_hook_test_perf_counters(codelet_perf_counters) == 0);
+    assert(jbpf_remove_codelet_hook_report_stats(codelet_report_stats) == 0);
+
+    jbpf_stop();
+    return 0;
+}
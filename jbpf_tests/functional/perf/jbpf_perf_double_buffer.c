@@ -0,0 +1,102 @@
+/*
+ * The purpose of this test is to check that the perf stats of a hook are collected from preallocated buffers.
+ *
+ * This test does the following:
+ * 1. It checks that the per-thread perf stats are padded to cache lines.
+ * 2. It loads a native codelet to a hook and a native codelet to the report_stats hook, and calls the hook a number of
+ *    times.
+ * 3. It triggers the perf reports until all the calls are reported, and checks that the hook only ever logs to one of
+ *    its 2 initial buffers.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "jbpf.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_agent_hooks.h"
+#include "jbpf_defs.h"
+
+#define NUM_HOOK_CALLS (100)
+#define MAX_REPORTS (50)
+
+struct perf_buf_data
+{
+    int value;
+};
+
+DECLARE_JBPF_HOOK(
+    test_perf_buf,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct perf_buf_data* p, int ctx_id),
+    HOOK_ASSIGN(ctx.ctx_id = ctx_id; ctx.data = (uint64_t)(void*)p; ctx.data_end = (uint64_t)(void*)(p + 1);))
+
+DEFINE_JBPF_HOOK(test_perf_buf)
+
+static uint64_t num_reported_calls = 0;
+
+static uint64_t
+codelet_perf_buf(void* mem, size_t mem_len)
+{
+    return 0;
+}
+
+static uint64_t
+codelet_report_stats(void* mem, size_t mem_len)
+{
+    struct jbpf_stats_ctx* ctx = mem;
+    struct jbpf_perf_hook_list* hook_list = (struct jbpf_perf_hook_list*)(uintptr_t)ctx->data;
+
+    for (int i = 0; i < hook_list->num_reported_hooks; i++) {
+        if (strcmp(hook_list->perf_data[i].hook_name, "test_perf_buf") == 0) {
+            __atomic_add_fetch(&num_reported_calls, hook_list->perf_data[i].num, __ATOMIC_SEQ_CST);
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_config config = {0};
+    struct perf_buf_data data = {.value = 1};
+    struct jbpf_perf_thread_data *first_buf, *second_buf, *active;
+
+    assert(sizeof(struct jbpf_perf_thread_data) % 64 == 0);
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    first_buf = __jbpf_hook_test_perf_buf.perf_data.active;
+    second_buf = __jbpf_hook_test_perf_buf.perf_data.retired;
+    assert(first_buf != NULL && second_buf != NULL && first_buf != second_buf);
+
+    assert(jbpf_register_codelet_report_stats(codelet_report_stats, 0, 1) == 0);
+    assert(jbpf_register_codelet_test_perf_buf(codelet_perf_buf, 0, 1) == 0);
+
+    for (int i = 0; i < NUM_HOOK_CALLS; i++) {
+        hook_test_perf_buf(&data, 1);
+    }
+
+    // The maintenance thread may also report the stats, so the calls are counted across all reports
+    for (int i = 0; i < MAX_REPORTS && __atomic_load_n(&num_reported_calls, __ATOMIC_SEQ_CST) < NUM_HOOK_CALLS; i++) {
+        jbpf_report_perf_stats();
+        active = jbpf_get_perf_data(&__jbpf_hook_test_perf_buf);
+        assert(active == first_buf || active == second_buf);
+    }
+
+#ifndef DISABLE_JBPF_PERF_STATS
+    assert(num_reported_calls == NUM_HOOK_CALLS);
+#endif
+
+    assert(jbpf_remove_codelet_hook_test_perf_buf(codelet_perf_buf) == 0);
+    assert(jbpf_remove_codelet_hook_report_stats(codelet_report_stats) == 0);
+
+    jbpf_stop();
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * The purpose of this test is to check the log-linear histogram of the perf stats and the percentiles computed from it.
+ *
+ * This test does the following:
+ * 1. It checks that every time falls in a bin whose range contains it, that the bins are ordered and that the width
+ *    of a bin is within the configured relative error of the times it holds.
+ * 2. It checks that each power of two is split in JBPF_HIST_SUB_BUCKETS bins.
+ * 3. It fills a histogram with known times and checks the percentiles computed from it.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "jbpf.h"
+#include "jbpf_perf.h"
+
+static void
+check_bin(uint64_t et)
+{
+    uint32_t bin = jbpf_perf_hist_bin(et);
+
+    assert(bin < JBPF_NUM_HIST_BINS);
+    assert(et <= jbpf_perf_hist_bin_max(bin));
+    if (bin > 0) {
+        assert(et > jbpf_perf_hist_bin_max(bin - 1));
+    }
+    if (et >= JBPF_HIST_SUB_BUCKETS && bin < JBPF_NUM_HIST_BINS - 1) {
+        assert((jbpf_perf_hist_bin_max(bin) - et) <= (et >> JBPF_HIST_SUB_BUCKET_BITS));
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    struct jbpf_perf_data perf_data;
+
+    for (uint64_t et = 0; et < 100000; et++) {
+        check_bin(et);
+    }
+    for (int i = 1; i < 64; i++) {
+        check_bin((1ULL << i) - 1);
+        check_bin(1ULL << i);
+        check_bin((1ULL << i) + 1);
+    }
+    assert(jbpf_perf_hist_bin(UINT64_MAX) == JBPF_NUM_HIST_BINS - 1);
+
+    // Each power of two has its own bins
+    assert(jbpf_perf_hist_bin(1023) - jbpf_perf_hist_bin(512) == JBPF_HIST_SUB_BUCKETS - 1);
+    assert(jbpf_perf_hist_bin(1024) == jbpf_perf_hist_bin(1023) + 1);
+
+    // No data
+    memset(&perf_data, 0, sizeof(perf_data));
+    jbpf_perf_compute_percentiles(&perf_data);
+    assert(perf_data.p50 == 0 && perf_data.p90 == 0 && perf_data.p99 == 0 && perf_data.p999 == 0);
+
+    // 990 calls of 100ns, 9 calls of 1000ns and 1 call of 10000ns
+    perf_data.num = 1000;
+    perf_data.min = 100;
+    perf_data.max = 10000;
+    perf_data.hist[jbpf_perf_hist_bin(100)] = 990;
+    perf_data.hist[jbpf_perf_hist_bin(1000)] = 9;
+    perf_data.hist[jbpf_perf_hist_bin(10000)] = 1;
+    jbpf_perf_compute_percentiles(&perf_data);
+    assert(perf_data.p50 == jbpf_perf_hist_bin_max(jbpf_perf_hist_bin(100)));
+    assert(perf_data.p90 == perf_data.p50);
+    assert(perf_data.p99 == perf_data.p50);
+    assert(perf_data.p999 == jbpf_perf_hist_bin_max(jbpf_perf_hist_bin(1000)));
+    assert(perf_data.p50 >= 100 && perf_data.p50 < 100 + (100 >> JBPF_HIST_SUB_BUCKET_BITS) + 1);
+
+    // The percentiles are capped to the maximum
+    perf_data.hist[jbpf_perf_hist_bin(100)] = 0;
+    perf_data.hist[jbpf_perf_hist_bin(1000)] = 0;
+    perf_data.hist[jbpf_perf_hist_bin(10000)] = 1000;
+    jbpf_perf_compute_percentiles(&perf_data);
+    assert(perf_data.p50 == 10000 && perf_data.p999 == 10000);
+
+    return 0;
+}
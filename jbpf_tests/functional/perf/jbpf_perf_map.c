@@ -0,0 +1,119 @@
+/*
+ * The purpose of this test is to check that the JIT-compiled codelets are written to the perf map and the jitdump file.
+ *
+ * This test does the following:
+ * 1. It initializes jbpf with the perf map and the jitdump file enabled, and checks the header of the jitdump file.
+ * 2. It loads a codeletset with a codelet to hook "test1", and checks that the codelet is in /tmp/perf-<pid>.map.
+ * 3. It unloads the codeletset, and checks that the codelet is no longer in the perf map.
+ * 4. It stops jbpf, and checks that the perf map is removed and the load record of the codelet is in the jitdump file.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_int.h"
+#include "jbpf_utils.h"
+
+// Contains the struct and hook definitions
+#include "jbpf_test_def.h"
+
+#define CODELETSET_NAME "perf_map_codeletset"
+#define CODELET_NAME "simple_test1"
+#define CODELET_SYMBOL "jbpf:test1:" CODELET_NAME
+#define JITDUMP_MAGIC (0x4A695444)
+
+/* Returns true if the file contains the given string */
+static bool
+file_contains(const char* path, const char* str)
+{
+    char buf[16384];
+    size_t len;
+    FILE* f;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+
+    for (size_t i = 0; i + strlen(str) <= len; i++) {
+        if (memcmp(&buf[i], str, strlen(str)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    jbpf_codeletset_load_req_s codset_req = {0};
+    jbpf_codeletset_unload_req_s codset_unload_req = {0};
+    jbpf_codelet_descriptor_s* cod_desc = &codset_req.codelet_descriptor[0];
+    const char* jbpf_path = getenv("JBPF_PATH");
+    char perf_map_path[128];
+    char jitdump_path[128];
+    uint32_t magic = 0;
+    FILE* f;
+
+    assert(jbpf_path != NULL);
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.perf_map_config.enable_perf_map = true;
+    config.perf_map_config.enable_jitdump = true;
+
+    snprintf(perf_map_path, sizeof(perf_map_path), "/tmp/perf-%d.map", getpid());
+    snprintf(jitdump_path, sizeof(jitdump_path), "%s/jit-%d.dump", config.perf_map_config.jitdump_dir, getpid());
+
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+    f = fopen(jitdump_path, "r");
+    assert(f != NULL);
+    assert(fread(&magic, sizeof(magic), 1, f) == 1);
+    fclose(f);
+    assert(magic == JITDUMP_MAGIC);
+
+    // Load the codelet to hook test1
+    strcpy(codset_req.codeletset_id.name, CODELETSET_NAME);
+    codset_req.num_codelet_descriptors = 1;
+    cod_desc->num_in_io_channel = 0;
+    cod_desc->num_out_io_channel = 0;
+    cod_desc->num_linked_maps = 0;
+    snprintf(
+        cod_desc->codelet_path,
+        JBPF_PATH_LEN,
+        "%s/jbpf_tests/test_files/codelets/simple_test1/simple_test1.o",
+        jbpf_path);
+    strcpy(cod_desc->codelet_name, CODELET_NAME);
+    strcpy(cod_desc->hook_name, "test1");
+    assert(jbpf_codeletset_load(&codset_req, NULL) == JBPF_CODELET_LOAD_SUCCESS);
+
+    assert(file_contains(perf_map_path, CODELET_SYMBOL));
+
+    // Unload the codelet
+    strcpy(codset_unload_req.codeletset_id.name, CODELETSET_NAME);
+    assert(jbpf_codeletset_unload(&codset_unload_req, NULL) == JBPF_CODELET_UNLOAD_SUCCESS);
+
+    assert(access(perf_map_path, F_OK) == 0);
+    assert(!file_contains(perf_map_path, CODELET_SYMBOL));
+
+    jbpf_stop();
+
+    // The perf map is removed, but the jitdump file is kept for perf inject
+    assert(access(perf_map_path, F_OK) != 0);
+    assert(file_contains(jitdump_path, CODELET_SYMBOL));
+    unlink(jitdump_path);
+
+    printf("Test completed successfully\n");
+    return 0;
+}
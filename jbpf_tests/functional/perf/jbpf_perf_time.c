@@ -43,7 +43,7 @@ main(int argc, char* argv[])
     uint64_t end_time = jbpf_measure_stop_time();
 
     // Log the valid time measurement
-    struct jbpf_perf_data* perf_data = jbpf_get_perf_data(&test_hook);
+    struct jbpf_perf_thread_data* perf_data = jbpf_get_perf_data(&test_hook);
     assert(perf_data != NULL); // Ensure perf_data is not NULL
 
     int res = _jbpf_perf_log(perf_data, start_time, end_time);
@@ -71,8 +71,6 @@ main(int argc, char* argv[])
     assert(perf_data[perf_idx].min == min_time); // Minimum should still be the same
     assert(perf_data[perf_idx].max == max_time); // Maximum should still be the same
 
-    jbpf_free_mem(perf_data); // Free the perf data
-
     jbpf_free_perf_hook(&test_hook);
 
     // Stop
@@ -0,0 +1,203 @@
+/*
+ * The purpose of this test is to check that the flight recorder keeps the last codelet invocations of a thread, and
+ * that they are dumped with the names of their hook and codelet.
+ *
+ * This test does the following:
+ * 1. It initializes jbpf with a flight recorder ring of RING_SIZE records per thread.
+ * 2. It loads a codeletset with a codelet to hook "test1", and calls the hook NUM_CALLS times, which is more than
+ * RING_SIZE.
+ * 3. It dumps the flight recorder, and checks that the dump has the last invocations of the codelet, ordered by time,
+ * with the return value of the codelet.
+ * 4. It checks that a dump requested over the LCM socket is written to the dump directory, and that names outside of
+ * the dump directory are rejected.
+ * 5. It unloads the codelet, and checks that its id is reused once all the other ids are assigned, the oldest released
+ * id first, and that the dump keeps the name of the unloaded codelet for the id.
+ * If jbpf is built without USE_JBPF_TRACE, it checks that the dump fails.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf.h"
+#include "jbpf_int.h"
+#include "jbpf_trace.h"
+#include "jbpf_trace_ext.h"
+#include "jbpf_utils.h"
+
+// Contains the struct and hook definitions
+#include "jbpf_test_def.h"
+
+#define CODELETSET_NAME "trace_codeletset"
+#define CODELET_NAME "simple_test1"
+#define RING_SIZE (8)
+#define NUM_CALLS (RING_SIZE + 5)
+#define DUMP_PATH "/tmp/jbpf_trace_test.bin"
+#define DUMP_DIR "/tmp"
+#define DUMP_NAME "jbpf_trace_test_request.bin"
+#define FILLER_NAME "filler"
+
+/* Reads the names of a dump and returns the id of the given name, or -1 if it is not found */
+static int
+read_names(FILE* f, uint32_t num_names, const char* name)
+{
+    struct jbpf_trace_file_name file_name;
+    char buf[JBPF_HOOK_NAME_LEN];
+    int id = -1;
+
+    for (uint32_t i = 0; i < num_names; i++) {
+        assert(fread(&file_name, sizeof(file_name), 1, f) == 1);
+        assert(file_name.name_len < sizeof(buf));
+        assert(fread(buf, 1, file_name.name_len, f) == file_name.name_len);
+        buf[file_name.name_len] = '\0';
+        if (strcmp(buf, name) == 0) {
+            id = file_name.id;
+        }
+    }
+    return id;
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_config config = {0};
+    jbpf_codeletset_load_req_s codset_req = {0};
+    jbpf_codeletset_unload_req_s codset_unload_req = {0};
+    jbpf_codelet_descriptor_s* cod_desc = &codset_req.codelet_descriptor[0];
+    const char* jbpf_path = getenv("JBPF_PATH");
+    struct jbpf_trace_file_header header;
+    struct jbpf_trace_file_thread thread;
+    struct jbpf_trace_record records[RING_SIZE];
+    struct packet p = {0};
+    struct jbpf_hook* hook;
+    uint16_t id, first_id = JBPF_TRACE_UNKNOWN_CODELET;
+    int hook_id, codelet_id;
+    uint32_t num_records = 0;
+    FILE* f;
+
+    assert(jbpf_path != NULL);
+
+    jbpf_set_default_config_options(&config);
+    config.lcm_ipc_config.has_lcm_ipc_thread = false;
+    config.trace_config.ring_size = RING_SIZE;
+    strcpy(config.trace_config.dump_dir, DUMP_DIR);
+
+    assert(jbpf_init(&config) == 0);
+
+    jbpf_register_thread();
+
+#ifndef JBPF_TRACE
+    assert(jbpf_trace_dump(DUMP_PATH) == -1);
+    assert(jbpf_trace_dump_request(DUMP_NAME) == -1);
+    jbpf_stop();
+    printf("Test completed successfully\n");
+    return 0;
+#endif
+
+    // Load the codelet to hook test1
+    strcpy(codset_req.codeletset_id.name, CODELETSET_NAME);
+    codset_req.num_codelet_descriptors = 1;
+    cod_desc->num_in_io_channel = 0;
+    cod_desc->num_out_io_channel = 0;
+    cod_desc->num_linked_maps = 0;
+    snprintf(
+        cod_desc->codelet_path,
+        JBPF_PATH_LEN,
+        "%s/jbpf_tests/test_files/codelets/simple_test1/simple_test1.o",
+        jbpf_path);
+    strcpy(cod_desc->codelet_name, CODELET_NAME);
+    strcpy(cod_desc->hook_name, "test1");
+    assert(jbpf_codeletset_load(&codset_req, NULL) == JBPF_CODELET_LOAD_SUCCESS);
+
+    for (int i = 0; i < NUM_CALLS; i++) {
+        hook_test1(&p, 1);
+    }
+    assert(p.counter_a == NUM_CALLS);
+
+    assert(jbpf_trace_dump(DUMP_PATH) == 0);
+
+    f = fopen(DUMP_PATH, "rb");
+    assert(f != NULL);
+    assert(fread(&header, sizeof(header), 1, f) == 1);
+    assert(header.magic == JBPF_TRACE_FILE_MAGIC);
+    assert(header.version == JBPF_TRACE_FILE_VERSION);
+    assert(header.record_size == sizeof(struct jbpf_trace_record));
+    assert(header.tick_freq > 0);
+    assert(header.num_threads >= 1);
+
+    hook_id = read_names(f, header.num_hooks, "test1");
+    codelet_id = read_names(f, header.num_codelets, CODELET_NAME);
+    assert(hook_id >= 0);
+    assert(codelet_id > JBPF_TRACE_UNKNOWN_CODELET);
+
+    // Only this thread called a hook
+    for (uint32_t i = 0; i < header.num_threads; i++) {
+        assert(fread(&thread, sizeof(thread), 1, f) == 1);
+        if (thread.num_records == 0) {
+            continue;
+        }
+        assert(num_records == 0);
+        assert(thread.num_records <= RING_SIZE);
+        num_records = thread.num_records;
+        assert(fread(records, sizeof(struct jbpf_trace_record), num_records, f) == num_records);
+    }
+    fclose(f);
+    unlink(DUMP_PATH);
+
+    // The oldest record of a full ring is not dumped, as the thread could be overwriting it during the dump
+    assert(num_records == RING_SIZE - 1);
+    for (uint32_t i = 0; i < num_records; i++) {
+        assert(records[i].hook_id == hook_id);
+        assert(records[i].codelet_id == codelet_id);
+        assert(records[i].ret == 0);
+        assert(records[i].start_time <= header.ref_ticks);
+        if (i > 0) {
+            assert(records[i].start_time >= records[i - 1].start_time);
+        }
+    }
+
+    // A dump requested over the LCM socket can only be written to the dump directory
+    assert(jbpf_trace_dump_request(DUMP_PATH) == -1);
+    assert(jbpf_trace_dump_request("../" DUMP_NAME) == -1);
+    assert(jbpf_trace_dump_request("tmp/../../" DUMP_NAME) == -1);
+    assert(jbpf_trace_dump_request("..") == -1);
+    assert(jbpf_trace_dump_request("") == -1);
+    assert(jbpf_trace_dump_request(DUMP_NAME) == 0);
+    assert(access(DUMP_DIR "/" DUMP_NAME, F_OK) == 0);
+    unlink(DUMP_DIR "/" DUMP_NAME);
+
+    // Unload the codelet
+    strcpy(codset_unload_req.codeletset_id.name, CODELETSET_NAME);
+    assert(jbpf_codeletset_unload(&codset_unload_req, NULL) == JBPF_CODELET_UNLOAD_SUCCESS);
+
+    // The id of the unloaded codelet is only reused after all the new ids are assigned
+    hook = jbpf_hook_list.jbpf_hook_p[hook_id];
+    while ((id = jbpf_trace_codelet_id(hook, FILLER_NAME)) != codelet_id) {
+        assert(id != JBPF_TRACE_UNKNOWN_CODELET);
+        if (first_id == JBPF_TRACE_UNKNOWN_CODELET) {
+            first_id = id;
+        }
+    }
+    assert(first_id != JBPF_TRACE_UNKNOWN_CODELET);
+    assert(jbpf_trace_codelet_id(hook, FILLER_NAME) == JBPF_TRACE_UNKNOWN_CODELET);
+    jbpf_trace_codelet_release(first_id);
+    assert(jbpf_trace_codelet_id(hook, FILLER_NAME) == first_id);
+
+    // The records of the unloaded codelet keep its name
+    assert(jbpf_trace_dump(DUMP_PATH) == 0);
+    f = fopen(DUMP_PATH, "rb");
+    assert(f != NULL);
+    assert(fread(&header, sizeof(header), 1, f) == 1);
+    assert(read_names(f, header.num_hooks, "test1") == hook_id);
+    assert(read_names(f, header.num_codelets, CODELET_NAME) == codelet_id);
+    fclose(f);
+    unlink(DUMP_PATH);
+
+    jbpf_stop();
+
+    printf("Test completed successfully\n");
+    return 0;
+}
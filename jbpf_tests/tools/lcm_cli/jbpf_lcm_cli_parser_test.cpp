@@ -48,6 +48,119 @@ test_parse_jbpf_codeletset_load_req()
 
     for (int i = 0; i < JBPF_IO_STREAM_ID_LEN; i++)
         assert(dest.codelet_descriptor[0].out_io_channel[0].stream_id.id[i] == (test_stream_id[i]));
+
+    // Codelets without sampling or filter run on every call of their hook
+    assert(dest.codelet_descriptor[0].sampling.type == JBPF_SAMPLING_NONE);
+    assert(dest.codelet_descriptor[0].filter.num_conditions == 0);
+}
+
+void
+test_parse_jbpf_codelet_sampling()
+{
+    std::stringstream ss;
+    ss << "codelet_descriptor:\n"
+          "  - codelet_name: simple_output\n"
+          "    codelet_path: ${JBPF_PATH}/jbpf_tests/test_files/codelets/simple_output/simple_output.o\n"
+          "    hook_name: test1\n"
+          "    sampling:\n"
+          "      type: rate\n"
+          "      value: 1000\n"
+          "      burst: 10\n"
+          "  - codelet_name: simple_output2\n"
+          "    codelet_path: ${JBPF_PATH}/jbpf_tests/test_files/codelets/simple_output/simple_output.o\n"
+          "    hook_name: test1\n"
+          "    sampling:\n"
+          "      type: ratio\n"
+          "      value: 16\n"
+          "codeletset_id: simple_output_codeletset\n";
+    auto cfg = YAML::Load(ss.str());
+    jbpf_codeletset_load_req dest;
+    std::vector<std::string> codeletset_elems;
+
+    auto ret = jbpf_lcm_cli::parser::parse_jbpf_codeletset_load_req(cfg, &dest, codeletset_elems);
+
+    assert(ret == jbpf_lcm_cli::parser::JBPF_LCM_PARSE_REQ_SUCCESS);
+    assert(dest.num_codelet_descriptors == 2);
+    assert(dest.codelet_descriptor[0].sampling.type == JBPF_SAMPLING_RATE);
+    assert(dest.codelet_descriptor[0].sampling.value == 1000);
+    assert(dest.codelet_descriptor[0].sampling.burst == 10);
+    assert(dest.codelet_descriptor[1].sampling.type == JBPF_SAMPLING_RATIO);
+    assert(dest.codelet_descriptor[1].sampling.value == 16);
+    assert(dest.codelet_descriptor[1].sampling.burst == 0);
+
+    // Unknown sampling modes are rejected
+    std::stringstream invalid;
+    invalid << "codelet_descriptor:\n"
+               "  - codelet_name: simple_output\n"
+               "    codelet_path: ${JBPF_PATH}/jbpf_tests/test_files/codelets/simple_output/simple_output.o\n"
+               "    hook_name: test1\n"
+               "    sampling:\n"
+               "      type: random\n"
+               "      value: 2\n"
+               "codeletset_id: simple_output_codeletset\n";
+    cfg = YAML::Load(invalid.str());
+    ret = jbpf_lcm_cli::parser::parse_jbpf_codeletset_load_req(cfg, &dest, codeletset_elems);
+    assert(ret == jbpf_lcm_cli::parser::JBPF_LCM_PARSE_REQ_FAILED);
+}
+
+void
+test_parse_jbpf_codelet_filter()
+{
+    std::stringstream ss;
+    ss << "codelet_descriptor:\n"
+          "  - codelet_name: simple_output\n"
+          "    codelet_path: ${JBPF_PATH}/jbpf_tests/test_files/codelets/simple_output/simple_output.o\n"
+          "    hook_name: test1\n"
+          "    filter:\n"
+          "      combine: any\n"
+          "      conditions:\n"
+          "        - offset: 28\n"
+          "          size: 4\n"
+          "          op: eq\n"
+          "          value: 7\n"
+          "        - base: data\n"
+          "          offset: 2\n"
+          "          size: 1\n"
+          "          op: mask\n"
+          "          value: 0x80\n"
+          "codeletset_id: simple_output_codeletset\n";
+    auto cfg = YAML::Load(ss.str());
+    jbpf_codeletset_load_req dest;
+    std::vector<std::string> codeletset_elems;
+
+    auto ret = jbpf_lcm_cli::parser::parse_jbpf_codeletset_load_req(cfg, &dest, codeletset_elems);
+
+    assert(ret == jbpf_lcm_cli::parser::JBPF_LCM_PARSE_REQ_SUCCESS);
+    jbpf_codelet_filter_t* filter = &dest.codelet_descriptor[0].filter;
+    assert(filter->combine == JBPF_FILTER_ANY);
+    assert(filter->num_conditions == 2);
+    assert(filter->conditions[0].base == JBPF_FILTER_BASE_CTX);
+    assert(filter->conditions[0].offset == 28);
+    assert(filter->conditions[0].size == 4);
+    assert(filter->conditions[0].op == JBPF_FILTER_OP_EQ);
+    assert(filter->conditions[0].value == 7);
+    assert(filter->conditions[1].base == JBPF_FILTER_BASE_DATA);
+    assert(filter->conditions[1].offset == 2);
+    assert(filter->conditions[1].size == 1);
+    assert(filter->conditions[1].op == JBPF_FILTER_OP_MASK);
+    assert(filter->conditions[1].value == 0x80);
+
+    // Fields must be 1, 2, 4 or 8 bytes long
+    std::stringstream invalid;
+    invalid << "codelet_descriptor:\n"
+               "  - codelet_name: simple_output\n"
+               "    codelet_path: ${JBPF_PATH}/jbpf_tests/test_files/codelets/simple_output/simple_output.o\n"
+               "    hook_name: test1\n"
+               "    filter:\n"
+               "      conditions:\n"
+               "        - offset: 0\n"
+               "          size: 3\n"
+               "          op: eq\n"
+               "          value: 1\n"
+               "codeletset_id: simple_output_codeletset\n";
+    cfg = YAML::Load(invalid.str());
+    ret = jbpf_lcm_cli::parser::parse_jbpf_codeletset_load_req(cfg, &dest, codeletset_elems);
+    assert(ret == jbpf_lcm_cli::parser::JBPF_LCM_PARSE_REQ_FAILED);
 }
 
 void
@@ -69,6 +182,8 @@ int
 main(int argc, char** argv)
 {
     test_parse_jbpf_codeletset_load_req();
+    test_parse_jbpf_codelet_sampling();
+    test_parse_jbpf_codelet_filter();
     test_parse_jbpf_codeletset_unload_req();
 
     return 0;
@@ -0,0 +1,257 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+    This contains unit tests for the arrays created with JBPF_MAP_F_MMAPABLE. It tests the following functions:
+    - jbpf_create_map
+    - jbpf_map_mmap_attach
+    - jbpf_map_mmap_detach
+    - jbpf_map_mmap_publish
+    - jbpf_map_mmap_find
+    - jbpf_map_mmap_attach_path
+    - jbpf_destroy_map
+
+    It tests the following scenarios:
+    - Reading the values of an array from its read-only mapping
+    - Reading the values of the thread copies of a per-thread array from its read-only mapping
+    - Keeping a mapping valid after the map is destroyed, and failing to attach to a destroyed map
+    - Finding and mapping the region of a map from the run path only, as an IPC secondary does
+    - Rejecting the flag for a hashmap
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "jbpf.h"
+#include "jbpf_memory.h"
+#include "jbpf_test_lib.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_impl.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_map_mmap.h"
+#include "jbpf_int.h"
+
+#define TEST_ARRAY_SIZE 1000
+
+static char test_run_path[] = "/tmp/jbpf_map_mmap_test_XXXXXX";
+
+/*
+ * This is run once before all system group tests
+ */
+static int
+system_group_setup(void** state)
+{
+    struct jbpf_agent_mem_config mem_config;
+    struct jbpf_ctx_t* ctx = jbpf_get_ctx();
+
+    mem_config.mem_size = 1024 * 1024;
+    jbpf_memory_setup(&mem_config);
+
+    // The regions and their metadata are created in the run path of the agent
+    assert(mkdtemp(test_run_path) != NULL);
+    strncpy(ctx->jbpf_run_path, test_run_path, JBPF_RUN_PATH_LEN - 1);
+    strncpy(ctx->jbpf_namespace, "mmap_test", JBPF_NAMESPACE_LEN - 1);
+    return 0;
+}
+
+/*
+ * This is run once after all system group tests
+ */
+static int
+system_group_teardown(void** state)
+{
+    rmdir(test_run_path);
+    jbpf_memory_teardown();
+    return 0;
+}
+
+static void
+test_array_mmap(void** state)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = JBPF_MAP_TYPE_ARRAY,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint64_t),
+        .max_entries = TEST_ARRAY_SIZE,
+        .map_flags = JBPF_MAP_F_MMAPABLE,
+    };
+    struct jbpf_mmap_info mmap_info;
+    const struct jbpf_map_mmap_hdr* hdr;
+    struct jbpf_map* array = __jbpf_create_map("map1", &map_def, NULL);
+    assert(array != NULL);
+    assert(array->mmap != NULL);
+    assert(((uintptr_t)array->data % sysconf(_SC_PAGESIZE)) == 0);
+
+    for (uint32_t i = 0; i < TEST_ARRAY_SIZE; ++i) {
+        uint64_t val = i * 10;
+        assert(__jbpf_map_update_elem(array, &i, &val, 0) == 0);
+    }
+
+    hdr = jbpf_map_mmap_attach(array->mmap->mmap_info.mem_name, &mmap_info);
+    assert(hdr != NULL);
+    assert(hdr->map_type == JBPF_MAP_TYPE_ARRAY);
+    assert(hdr->value_size == sizeof(uint64_t));
+    assert(hdr->max_entries == TEST_ARRAY_SIZE);
+    assert(hdr->num_copies == 1);
+    assert(strcmp(hdr->map_name, "map1") == 0);
+
+    for (uint32_t i = 0; i < TEST_ARRAY_SIZE; ++i) {
+        const uint64_t* val = jbpf_map_mmap_value(hdr, 0, i);
+        assert(val != NULL);
+        assert(*val == i * 10);
+    }
+    assert(jbpf_map_mmap_value(hdr, 0, TEST_ARRAY_SIZE) == NULL);
+    assert(jbpf_map_mmap_value(hdr, 1, 0) == NULL);
+
+    // The mapping sees the updates made after it was attached
+    uint32_t key = 7;
+    uint64_t val = 12345;
+    assert(__jbpf_map_update_elem(array, &key, &val, 0) == 0);
+    assert(*(const uint64_t*)jbpf_map_mmap_value(hdr, 0, key) == val);
+
+    assert(jbpf_map_mmap_detach(&mmap_info) == 0);
+    __jbpf_destroy_map(array);
+}
+
+static void
+test_per_thread_array_mmap(void** state)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = JBPF_MAP_TYPE_PER_THREAD_ARRAY,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint32_t),
+        .max_entries = TEST_ARRAY_SIZE,
+        .map_flags = JBPF_MAP_F_MMAPABLE | JBPF_MAP_F_MMAP_HUGEPAGES,
+    };
+    struct jbpf_mmap_info mmap_info;
+    const struct jbpf_map_mmap_hdr* hdr;
+    struct jbpf_map* map = __jbpf_create_map("map2", &map_def, NULL);
+    assert(map != NULL);
+    struct jbpf_map* copies = map->data;
+
+    for (uint32_t t = 0; t < JBPF_MAX_NUM_REG_THREADS; t++) {
+        uint32_t key = t;
+        uint32_t val = t + 1;
+        assert(jbpf_bpf_array_update_elem(&copies[t], &key, &val, 0) == 0);
+    }
+
+    hdr = jbpf_map_mmap_attach(map->mmap->mmap_info.mem_name, &mmap_info);
+    assert(hdr != NULL);
+    assert(hdr->num_copies == JBPF_MAX_NUM_REG_THREADS);
+    assert(hdr->copy_stride % sysconf(_SC_PAGESIZE) == 0);
+
+    for (uint32_t t = 0; t < JBPF_MAX_NUM_REG_THREADS; t++) {
+        assert(*(const uint32_t*)jbpf_map_mmap_value(hdr, t, t) == t + 1);
+        assert(*(const uint32_t*)jbpf_map_mmap_value(hdr, t, (t + 1) % TEST_ARRAY_SIZE) == 0);
+    }
+
+    assert(jbpf_map_mmap_detach(&mmap_info) == 0);
+    __jbpf_destroy_map(map);
+}
+
+static void
+test_mmap_after_destroy(void** state)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = JBPF_MAP_TYPE_ARRAY,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint32_t),
+        .max_entries = TEST_ARRAY_SIZE,
+        .map_flags = JBPF_MAP_F_MMAPABLE,
+    };
+    struct jbpf_mmap_info mmap_info, mmap_info2;
+    const struct jbpf_map_mmap_hdr* hdr;
+    char mem_name[JBPF_MAP_MMAP_NAME_LEN] = {0};
+    struct jbpf_map* array = __jbpf_create_map("map3", &map_def, NULL);
+    assert(array != NULL);
+
+    uint32_t key = 3;
+    uint32_t val = 33;
+    assert(__jbpf_map_update_elem(array, &key, &val, 0) == 0);
+
+    strncpy(mem_name, array->mmap->mmap_info.mem_name, JBPF_MAP_MMAP_NAME_LEN - 1);
+    hdr = jbpf_map_mmap_attach(mem_name, &mmap_info);
+    assert(hdr != NULL);
+
+    __jbpf_destroy_map(array);
+
+    // The existing mapping stays valid, but the region cannot be attached to anymore
+    assert(*(const uint32_t*)jbpf_map_mmap_value(hdr, 0, key) == val);
+    assert(jbpf_map_mmap_attach(mem_name, &mmap_info2) == NULL);
+    assert(jbpf_map_mmap_detach(&mmap_info) == 0);
+}
+
+static void
+test_mmap_secondary(void** state)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = JBPF_MAP_TYPE_ARRAY,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint32_t),
+        .max_entries = TEST_ARRAY_SIZE,
+        .map_flags = JBPF_MAP_F_MMAPABLE,
+    };
+    struct jbpf_ctx_t* ctx = jbpf_get_ctx();
+    struct jbpf_mmap_info mmap_info;
+    const struct jbpf_map_mmap_hdr* hdr;
+    char mem_name[JBPF_MAP_MMAP_NAME_LEN] = {0};
+    struct jbpf_map* array = __jbpf_create_map("map5", &map_def, NULL);
+    assert(array != NULL);
+
+    uint32_t key = 5;
+    uint32_t val = 55;
+    assert(__jbpf_map_update_elem(array, &key, &val, 0) == 0);
+
+    // The agent publishes the region under the names of each codelet linked to the map
+    assert(jbpf_map_mmap_publish(test_run_path, "set1", "codelet1", "map5", array->mmap->mmap_info.mem_name) == 0);
+    assert(jbpf_map_mmap_publish(test_run_path, "set1", "codelet2", "shared", array->mmap->mmap_info.mem_name) == 0);
+
+    // A secondary has no agent state, only the run path of the agent
+    ctx->jbpf_run_path[0] = '\0';
+    assert(jbpf_map_mmap_find(test_run_path, "set1", "codelet2", "shared", mem_name, sizeof(mem_name)) == 0);
+    assert(strcmp(mem_name, array->mmap->mmap_info.mem_name) == 0);
+    assert(jbpf_map_mmap_find(test_run_path, "set1", "codelet1", "shared", mem_name, sizeof(mem_name)) == -1);
+    assert(jbpf_map_mmap_find(test_run_path, "set2", "codelet1", "map5", mem_name, sizeof(mem_name)) == -1);
+    assert(jbpf_map_mmap_find(test_run_path, "set1", "codelet1", "map5", mem_name, 4) == -1);
+
+    assert(jbpf_map_mmap_find(test_run_path, "set1", "codelet1", "map5", mem_name, sizeof(mem_name)) == 0);
+    hdr = jbpf_map_mmap_attach_path(test_run_path, mem_name, &mmap_info);
+    assert(hdr != NULL);
+    assert(strcmp(hdr->map_name, "map5") == 0);
+    assert(*(const uint32_t*)jbpf_map_mmap_value(hdr, 0, key) == val);
+    assert(jbpf_map_mmap_detach(&mmap_info) == 0);
+    strncpy(ctx->jbpf_run_path, test_run_path, JBPF_RUN_PATH_LEN - 1);
+
+    // The entries are removed when the codelets are unloaded
+    jbpf_map_mmap_unpublish(test_run_path, "set1", "codelet1", "map5");
+    jbpf_map_mmap_unpublish(test_run_path, "set1", "codelet2", "shared");
+    assert(jbpf_map_mmap_find(test_run_path, "set1", "codelet1", "map5", mem_name, sizeof(mem_name)) == -1);
+    __jbpf_destroy_map(array);
+}
+
+static void
+test_hashmap_mmap_rejected(void** state)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = JBPF_MAP_TYPE_HASHMAP,
+        .key_size = sizeof(uint32_t),
+        .value_size = sizeof(uint32_t),
+        .max_entries = TEST_ARRAY_SIZE,
+        .map_flags = JBPF_MAP_F_MMAPABLE,
+    };
+    assert(__jbpf_create_map("map4", &map_def, NULL) == NULL);
+}
+
+int
+main(int argc, char** argv)
+{
+    const jbpf_test tests[] = {
+        JBPF_CREATE_TEST(test_array_mmap, NULL, NULL, NULL),
+        JBPF_CREATE_TEST(test_per_thread_array_mmap, NULL, NULL, NULL),
+        JBPF_CREATE_TEST(test_mmap_after_destroy, NULL, NULL, NULL),
+        JBPF_CREATE_TEST(test_mmap_secondary, NULL, NULL, NULL),
+        JBPF_CREATE_TEST(test_hashmap_mmap_rejected, NULL, NULL, NULL),
+    };
+
+    int num_tests = sizeof(tests) / sizeof(jbpf_test);
+    return jbpf_run_test(tests, num_tests, system_group_setup, system_group_teardown);
+}
@@ -0,0 +1,323 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+    This contains unit tests for the batched map operations. It tests the following functions:
+    - jbpf_bpf_map_lookup_batch
+    - jbpf_bpf_map_update_batch
+    - jbpf_bpf_map_delete_batch
+
+    It tests the following scenarios:
+    - Updating, looking up and deleting a batch of keys, for each hashmap type
+    - Looking up and deleting a batch with keys that do not exist, and the mask of the keys found by a lookup
+    - Updating a batch that does not fit in the map
+    - Updating and looking up a batch of indexes of an array, and rejecting deletes
+    - Rejecting empty and oversized batches
+*/
+
+#include <assert.h>
+#include "jbpf_memory.h"
+#include "jbpf_test_lib.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_impl.h"
+#include "jbpf_int.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_map_batch.h"
+#include "jbpf_utils.h"
+
+#define TEST_MAP_SIZE 48
+#define TEST_BATCH_SIZE 32
+
+/*
+ * This is run once before all system group tests
+ */
+static int
+system_group_setup(void** state)
+{
+    struct jbpf_agent_mem_config mem_config;
+    mem_config.mem_size = 1024 * 1024 * 1024;
+    __test_setup();
+    jbpf_memory_setup(&mem_config);
+    return 0;
+}
+
+/*
+ * This is run once after all system group tests
+ */
+static int
+system_group_teardown(void** state)
+{
+    jbpf_memory_teardown();
+    return 0;
+}
+
+static struct jbpf_map*
+create_map(int type, uint32_t key_size, uint32_t value_size)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = key_size,
+        .value_size = value_size,
+        .max_entries = TEST_MAP_SIZE,
+    };
+
+    struct jbpf_map* map = __jbpf_create_map("map1", &map_def, NULL);
+    assert(map != NULL);
+    return map;
+}
+
+/* The batches of a per-thread map run on the copy of the calling thread, which is the first copy here */
+static struct jbpf_map*
+batch_map(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+
+    if (map->type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP || map->type == JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP)
+        return &((struct jbpf_map*)map->data)[0];
+    return map;
+}
+
+static int
+test_setup_array(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_ARRAY, sizeof(uint32_t), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_setup_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_HASHMAP, sizeof(int), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_setup_concurrent_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_CONCURRENT_HASHMAP, sizeof(int), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_setup_per_thread_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_PER_THREAD_HASHMAP, sizeof(int), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_setup_lru_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_LRU_HASHMAP, sizeof(int), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_setup_per_thread_lru_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP, sizeof(int), sizeof(uint64_t));
+    return 0;
+}
+
+static int
+test_teardown(void** state)
+{
+    __jbpf_destroy_map((struct jbpf_map*)*state);
+    return 0;
+}
+
+static void
+test_hashmap_batch(void** state)
+{
+    struct jbpf_map* map = batch_map(state);
+    int keys[TEST_BATCH_SIZE * 2];
+    uint64_t values[TEST_BATCH_SIZE * 2];
+    uint64_t found;
+    int ret;
+
+    // Update the even keys in a single batch
+    for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+        keys[i] = i * 2;
+        values[i] = 1000 + i * 2;
+    }
+    ret = jbpf_bpf_map_update_batch(map, keys, values, TEST_BATCH_SIZE);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_BATCH_SIZE);
+
+    // Look up the even and the odd keys, and only the even keys are found
+    for (int i = 0; i < TEST_BATCH_SIZE * 2; i++) {
+        keys[i] = i;
+        values[i] = UINT64_MAX;
+    }
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, TEST_BATCH_SIZE * 2, &found);
+    assert(ret == TEST_BATCH_SIZE);
+    assert(found == 0x5555555555555555ULL);
+    for (int i = 0; i < TEST_BATCH_SIZE * 2; i++) {
+        if (i % 2 == 0)
+            assert(values[i] == 1000 + i);
+        else
+            assert(values[i] == UINT64_MAX);
+    }
+
+    // Existing keys are overwritten
+    values[0] = 7;
+    ret = jbpf_bpf_map_update_batch(map, keys, values, 1);
+    assert(ret == 1);
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, 1, &found);
+    assert(ret == 1);
+    assert(found == 1);
+    assert(values[0] == 7);
+
+    // Only the keys that exist are counted as deleted
+    ret = jbpf_bpf_map_delete_batch(map, keys, TEST_BATCH_SIZE * 2);
+    assert(ret == TEST_BATCH_SIZE);
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, TEST_BATCH_SIZE * 2, &found);
+    assert(ret == 0);
+    assert(found == 0);
+    ret = jbpf_bpf_map_delete_batch(map, keys, TEST_BATCH_SIZE);
+    assert(ret == 0);
+}
+
+static void
+test_hashmap_batch_full(void** state)
+{
+    struct jbpf_map* map = batch_map(state);
+    int keys[JBPF_MAP_BATCH_MAX_KEYS];
+    uint64_t values[JBPF_MAP_BATCH_MAX_KEYS];
+    uint64_t found;
+    int ret;
+
+    for (int i = 0; i < JBPF_MAP_BATCH_MAX_KEYS; i++) {
+        keys[i] = i;
+        values[i] = i;
+    }
+
+    // The batch stops at the first key that does not fit
+    ret = jbpf_bpf_map_update_batch(map, keys, values, JBPF_MAP_BATCH_MAX_KEYS);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_MAP_SIZE);
+
+    ret = jbpf_bpf_map_update_batch(map, &keys[TEST_MAP_SIZE], &values[TEST_MAP_SIZE], 1);
+    assert(ret == JBPF_MAP_FULL);
+
+    // The mask covers a batch of JBPF_MAP_BATCH_MAX_KEYS keys
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, JBPF_MAP_BATCH_MAX_KEYS, &found);
+    assert(ret == TEST_MAP_SIZE);
+    assert(found == (1ULL << TEST_MAP_SIZE) - 1);
+}
+
+static void
+test_lru_hashmap_batch_evict(void** state)
+{
+    struct jbpf_map* map = batch_map(state);
+    int keys[JBPF_MAP_BATCH_MAX_KEYS];
+    uint64_t values[JBPF_MAP_BATCH_MAX_KEYS];
+    uint64_t found;
+    int ret;
+
+    for (int i = 0; i < JBPF_MAP_BATCH_MAX_KEYS; i++) {
+        keys[i] = i;
+        values[i] = i;
+    }
+
+    // The keys that do not fit evict the least recently used ones, which are the first keys of the batch
+    ret = jbpf_bpf_map_update_batch(map, keys, values, JBPF_MAP_BATCH_MAX_KEYS);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_BATCH_MAX_KEYS);
+
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, JBPF_MAP_BATCH_MAX_KEYS - TEST_MAP_SIZE, &found);
+    assert(ret == 0);
+    assert(found == 0);
+    ret = jbpf_bpf_map_lookup_batch(
+        map, &keys[JBPF_MAP_BATCH_MAX_KEYS - TEST_MAP_SIZE], values, TEST_MAP_SIZE, &found);
+    assert(ret == TEST_MAP_SIZE);
+    assert(found == (1ULL << TEST_MAP_SIZE) - 1);
+    for (int i = 0; i < TEST_MAP_SIZE; i++)
+        assert(values[i] == JBPF_MAP_BATCH_MAX_KEYS - TEST_MAP_SIZE + i);
+}
+
+static void
+test_array_batch(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    uint32_t keys[TEST_BATCH_SIZE];
+    uint64_t values[TEST_BATCH_SIZE];
+    uint64_t found;
+    int ret;
+
+    for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+        keys[i] = TEST_MAP_SIZE - 1 - i;
+        values[i] = i + 1;
+    }
+    ret = jbpf_bpf_map_update_batch(map, keys, values, TEST_BATCH_SIZE);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_BATCH_SIZE);
+
+    for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+        uint64_t* val = jbpf_bpf_array_lookup_elem(map, &keys[i]);
+        assert(val && *val == i + 1);
+        values[i] = 0;
+    }
+
+    // Indexes out of the array are skipped by lookups, and stop updates
+    keys[1] = TEST_MAP_SIZE;
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, TEST_BATCH_SIZE, &found);
+    assert(ret == TEST_BATCH_SIZE - 1);
+    assert(found == (((1ULL << TEST_BATCH_SIZE) - 1) & ~2ULL));
+    assert(values[0] == 1 && values[1] == 0 && values[2] == 3);
+
+    ret = jbpf_bpf_map_update_batch(map, keys, values, TEST_BATCH_SIZE);
+    assert(ret == 1);
+    ret = jbpf_bpf_map_update_batch(map, &keys[1], values, 1);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_delete_batch(map, keys, TEST_BATCH_SIZE);
+    assert(ret == JBPF_MAP_ERROR);
+}
+
+static void
+test_batch_invalid_size(void** state)
+{
+    struct jbpf_map* map = batch_map(state);
+    int keys[JBPF_MAP_BATCH_MAX_KEYS + 1] = {0};
+    uint64_t values[JBPF_MAP_BATCH_MAX_KEYS + 1] = {0};
+    uint64_t found;
+    int ret;
+
+    ret = jbpf_bpf_map_update_batch(map, keys, values, 0);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_update_batch(map, keys, values, JBPF_MAP_BATCH_MAX_KEYS + 1);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_lookup_batch(map, keys, NULL, 1, &found);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_lookup_batch(map, keys, values, 1, NULL);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_delete_batch(map, NULL, 1);
+    assert(ret == JBPF_MAP_ERROR);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_map* state;
+    const jbpf_test tests[] = {
+        JBPF_CREATE_TEST(test_hashmap_batch, test_setup_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch, test_setup_concurrent_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch, test_setup_per_thread_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch, test_setup_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch, test_setup_per_thread_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch_full, test_setup_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch_full, test_setup_concurrent_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_batch_full, test_setup_per_thread_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_lru_hashmap_batch_evict, test_setup_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_lru_hashmap_batch_evict, test_setup_per_thread_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_array_batch, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_batch_invalid_size, test_setup_hashmap, test_teardown, &state),
+    };
+
+    int num_tests = sizeof(tests) / sizeof(jbpf_test);
+    return jbpf_run_test(tests, num_tests, system_group_setup, system_group_teardown);
+}
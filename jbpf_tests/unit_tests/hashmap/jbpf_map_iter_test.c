@@ -0,0 +1,329 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+    This contains unit tests for the cursor-based map iteration. It tests the following functions:
+    - jbpf_bpf_map_iterate
+    - jbpf_bpf_map_iterate_per_thread
+
+    It tests the following scenarios:
+    - Iterating over all the entries with a buffer of a few entries, for each map type
+    - Deleting entries during an iteration, where the entries that are kept are returned exactly once
+    - Iterating over the thread copies of a per-thread map
+    - Iterating over an empty map, a busy map, and with a buffer smaller than an entry
+*/
+
+#include <assert.h>
+#include <string.h>
+#include "jbpf_memory.h"
+#include "jbpf_test_lib.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_impl.h"
+#include "jbpf_int.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_hashmap.h"
+#include "jbpf_bpf_map_batch.h"
+#include "jbpf_bpf_map_iter.h"
+#include "jbpf_utils.h"
+
+#define TEST_MAP_SIZE 48
+#define TEST_NUM_KEYS 40
+#define TEST_NUM_THREADS 4
+#define TEST_CHUNK_ENTRIES 3
+
+struct test_entry
+{
+    int key;
+    uint64_t value;
+} __attribute__((packed));
+
+/*
+ * This is run once before all system group tests
+ */
+static int
+system_group_setup(void** state)
+{
+    struct jbpf_agent_mem_config mem_config;
+    mem_config.mem_size = 1024 * 1024 * 1024;
+    __test_setup();
+    jbpf_memory_setup(&mem_config);
+    return 0;
+}
+
+/*
+ * This is run once after all system group tests
+ */
+static int
+system_group_teardown(void** state)
+{
+    jbpf_memory_teardown();
+    return 0;
+}
+
+/* A map with a key of type int and a value of type uint64_t. Only the copies of the first TEST_NUM_THREADS threads of
+ * a per-thread map are filled and iterated over */
+static struct jbpf_map*
+create_map(int type)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = sizeof(int),
+        .value_size = sizeof(uint64_t),
+        .max_entries = TEST_MAP_SIZE,
+    };
+
+    struct jbpf_map* map = __jbpf_create_map("map1", &map_def, NULL);
+    assert(map != NULL);
+    return map;
+}
+
+static int
+test_setup_array(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_ARRAY);
+    return 0;
+}
+
+static int
+test_setup_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_HASHMAP);
+    return 0;
+}
+
+static int
+test_setup_concurrent_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_CONCURRENT_HASHMAP);
+    return 0;
+}
+
+static int
+test_setup_lru_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_LRU_HASHMAP);
+    return 0;
+}
+
+static int
+test_setup_per_thread_array(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_PER_THREAD_ARRAY);
+    return 0;
+}
+
+static int
+test_setup_per_thread_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_PER_THREAD_HASHMAP);
+    return 0;
+}
+
+static int
+test_setup_per_thread_lru_hashmap(void** state)
+{
+    *state = create_map(JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP);
+    return 0;
+}
+
+static int
+test_teardown(void** state)
+{
+    __jbpf_destroy_map((struct jbpf_map*)*state);
+    return 0;
+}
+
+/* Key i holds the value 1000 * (offset + 1) + i */
+static void
+fill_map(struct jbpf_map* map, int num_keys, int offset)
+{
+    int keys[TEST_NUM_KEYS];
+    uint64_t values[TEST_NUM_KEYS];
+    int ret;
+
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+        values[i] = 1000 * (offset + 1) + i;
+    }
+    ret = jbpf_bpf_map_update_batch(map, keys, values, num_keys);
+    JBPF_UNUSED(ret);
+    assert(ret == num_keys);
+}
+
+/* Iterate until the cursor is back to 0, and count how many times each key is returned */
+static void
+iterate_all(struct jbpf_map* map, int num_slots, int* seen, int max_key)
+{
+    struct test_entry entries[TEST_CHUNK_ENTRIES];
+    uint64_t cursor = 0;
+    int calls = 0;
+    int ret;
+
+    do {
+        if (num_slots > 0)
+            ret = jbpf_bpf_map_iterate_per_thread(map, num_slots, &cursor, entries, sizeof(entries));
+        else
+            ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+        assert(ret >= 0 && ret <= TEST_CHUNK_ENTRIES);
+        for (int i = 0; i < ret; i++) {
+            assert(entries[i].key >= 0 && entries[i].key < max_key);
+            assert(entries[i].value % 1000 == (uint64_t)entries[i].key);
+            seen[entries[i].key]++;
+        }
+        assert(++calls < TEST_MAP_SIZE * TEST_NUM_THREADS);
+    } while (cursor != 0);
+}
+
+static void
+test_map_iterate(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    int num_keys = map->type == JBPF_MAP_TYPE_ARRAY ? TEST_MAP_SIZE : TEST_NUM_KEYS;
+    int seen[TEST_MAP_SIZE] = {0};
+
+    if (map->type != JBPF_MAP_TYPE_ARRAY)
+        fill_map(map, num_keys, 0);
+    else
+        for (uint32_t i = 0; i < TEST_MAP_SIZE; i++)
+            *(uint64_t*)jbpf_bpf_array_lookup_elem(map, &i) = 1000 + i;
+
+    // Each key is returned exactly once, a few entries per call
+    iterate_all(map, 0, seen, TEST_MAP_SIZE);
+    for (int i = 0; i < TEST_MAP_SIZE; i++)
+        assert(seen[i] == (i < num_keys ? 1 : 0));
+}
+
+static void
+test_map_iterate_delete(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    struct test_entry entries[TEST_CHUNK_ENTRIES * 3];
+    int seen[TEST_NUM_KEYS] = {0};
+    int deleted[TEST_NUM_KEYS] = {0};
+    uint64_t cursor = 0;
+    int ret;
+
+    fill_map(map, TEST_NUM_KEYS, 0);
+
+    // After each call, delete the first entry returned and a key that may not have been returned yet. The buffer
+    // holds whole bucket chains, so that the deletes do not shift the entries of a chain returned in part
+    do {
+        ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+        assert(ret >= 0);
+        for (int i = 0; i < ret; i++)
+            seen[entries[i].key]++;
+        if (ret > 0 && !deleted[entries[0].key]) {
+            jbpf_bpf_map_delete_batch(map, &entries[0].key, 1);
+            deleted[entries[0].key] = 1;
+        }
+        for (int key = TEST_NUM_KEYS - 1; key >= 0; key--) {
+            if (!deleted[key] && !seen[key]) {
+                jbpf_bpf_map_delete_batch(map, &key, 1);
+                deleted[key] = 1;
+                break;
+            }
+        }
+    } while (cursor != 0);
+
+    // The keys that were never deleted were returned exactly once, and no key twice
+    for (int i = 0; i < TEST_NUM_KEYS; i++) {
+        assert(seen[i] <= 1);
+        if (!deleted[i])
+            assert(seen[i] == 1);
+    }
+}
+
+static void
+test_map_iterate_per_thread(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    struct jbpf_map* copies = map->data;
+    int seen[TEST_MAP_SIZE] = {0};
+
+    // Thread t holds the keys 0 to 10 * (t + 1) - 1, or all the indexes of an array
+    for (int t = 0; t < TEST_NUM_THREADS; t++) {
+        if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY)
+            for (uint32_t i = 0; i < TEST_MAP_SIZE; i++)
+                *(uint64_t*)jbpf_bpf_array_lookup_elem(&copies[t], &i) = 1000 * (t + 1) + i;
+        else
+            fill_map(&copies[t], 10 * (t + 1), t);
+    }
+
+    // Each key is returned once for each copy that holds it
+    iterate_all(map, TEST_NUM_THREADS, seen, TEST_MAP_SIZE);
+    for (int i = 0; i < TEST_MAP_SIZE; i++) {
+        if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY)
+            assert(seen[i] == TEST_NUM_THREADS);
+        else
+            assert(seen[i] == (i < 10 * TEST_NUM_THREADS ? TEST_NUM_THREADS - i / 10 : 0));
+    }
+
+    // Only the first copies are iterated over
+    memset(seen, 0, sizeof(seen));
+    iterate_all(map, 1, seen, TEST_MAP_SIZE);
+    for (int i = 0; i < TEST_MAP_SIZE; i++) {
+        if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY)
+            assert(seen[i] == 1);
+        else
+            assert(seen[i] == (i < 10 ? 1 : 0));
+    }
+}
+
+static void
+test_map_iterate_invalid(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    jbpf_hashmap_t* hmap = map->data;
+    struct test_entry entries[TEST_CHUNK_ENTRIES];
+    uint64_t cursor = 0;
+    int ret;
+
+    // An empty map completes in a single call
+    ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+    JBPF_UNUSED(ret);
+    assert(ret == 0);
+    assert(cursor == 0);
+
+    // The buffer must hold at least one entry
+    fill_map(map, TEST_NUM_KEYS, 0);
+    ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(struct test_entry) - 1);
+    assert(ret == JBPF_MAP_ERROR);
+
+    // A busy map leaves the cursor unchanged
+    ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+    assert(ret == TEST_CHUNK_ENTRIES);
+    assert(cursor != 0);
+    uint64_t prev_cursor = cursor;
+    ck_spinlock_lock(&hmap->lock);
+    ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+    ck_spinlock_unlock(&hmap->lock);
+    assert(ret == JBPF_MAP_BUSY);
+    assert(cursor == prev_cursor);
+
+    // Maps that do not hold entries, and per-thread iterations of maps that are not per-thread, are rejected
+    map->type = JBPF_MAP_TYPE_RINGBUF;
+    ret = jbpf_bpf_map_iterate(map, &cursor, entries, sizeof(entries));
+    map->type = JBPF_MAP_TYPE_HASHMAP;
+    assert(ret == JBPF_MAP_ERROR);
+    ret = jbpf_bpf_map_iterate_per_thread(map, 1, &cursor, entries, sizeof(entries));
+    assert(ret == JBPF_MAP_ERROR);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_map* state;
+    const jbpf_test tests[] = {
+        JBPF_CREATE_TEST(test_map_iterate, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate, test_setup_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate, test_setup_concurrent_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate, test_setup_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_delete, test_setup_concurrent_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_delete, test_setup_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_per_thread, test_setup_per_thread_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_per_thread, test_setup_per_thread_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_per_thread, test_setup_per_thread_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_map_iterate_invalid, test_setup_hashmap, test_teardown, &state),
+    };
+
+    int num_tests = sizeof(tests) / sizeof(jbpf_test);
+    return jbpf_run_test(tests, num_tests, system_group_setup, system_group_teardown);
+}
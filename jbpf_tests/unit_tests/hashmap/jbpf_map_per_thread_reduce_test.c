@@ -0,0 +1,334 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+    This contains unit tests for the aggregated read path of the per-thread maps. It tests the following functions:
+    - jbpf_bpf_map_reduce
+    - jbpf_bpf_map_dump_aggregated
+
+    It tests the following scenarios:
+    - Reducing a key of a JBPF_MAP_TYPE_PER_THREAD_ARRAY with each operation
+    - Reducing signed elements
+    - Reducing all the keys of a JBPF_MAP_TYPE_PER_THREAD_ARRAY at once
+    - Reducing a key of a JBPF_MAP_TYPE_PER_THREAD_HASHMAP that only some threads have
+    - Dumping JBPF_MAP_TYPE_PER_THREAD_HASHMAP and JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP maps with each key once
+    - Dumping a JBPF_MAP_TYPE_PER_THREAD_ARRAY into a buffer that is too small
+    - Rejecting invalid flags
+*/
+
+#include <assert.h>
+#include "jbpf_memory.h"
+#include "jbpf_test_lib.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_impl.h"
+#include "jbpf_int.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_spsc_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_map_reduce.h"
+#include "jbpf_utils.h"
+
+#define TEST_NUM_THREADS 4
+#define TEST_MAP_SIZE 64
+
+/*
+ * This is run once before all system group tests
+ */
+static int
+system_group_setup(void** state)
+{
+    struct jbpf_agent_mem_config mem_config;
+    mem_config.mem_size = 1024 * 1024 * 1024;
+    __test_setup();
+    jbpf_memory_setup(&mem_config);
+    return 0;
+}
+
+/*
+ * This is run once after all system group tests
+ */
+static int
+system_group_teardown(void** state)
+{
+    jbpf_memory_teardown();
+    return 0;
+}
+
+/* Only the copies of the first TEST_NUM_THREADS threads are filled and reduced */
+static struct jbpf_map*
+create_per_thread_map(int type, uint32_t key_size, uint32_t value_size)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = key_size,
+        .value_size = value_size,
+        .max_entries = TEST_MAP_SIZE,
+    };
+
+    struct jbpf_map* map = __jbpf_create_map("map1", &map_def, NULL);
+    assert(map != NULL);
+    return map;
+}
+
+static int
+test_setup_array(void** state)
+{
+    struct jbpf_map* map = create_per_thread_map(JBPF_MAP_TYPE_PER_THREAD_ARRAY, sizeof(uint32_t), sizeof(uint64_t));
+    struct jbpf_map* copies = map->data;
+
+    // Thread t holds (i + 1) * (t + 1) at index i
+    for (uint32_t t = 0; t < TEST_NUM_THREADS; t++) {
+        for (uint32_t i = 0; i < TEST_MAP_SIZE; i++) {
+            uint64_t* val = jbpf_bpf_array_lookup_elem(&copies[t], &i);
+            assert(val);
+            *val = (uint64_t)(i + 1) * (t + 1);
+        }
+    }
+    *state = map;
+    return 0;
+}
+
+static int
+test_setup_hashmap(void** state)
+{
+    struct jbpf_map* map = create_per_thread_map(JBPF_MAP_TYPE_PER_THREAD_HASHMAP, sizeof(int), sizeof(uint32_t));
+    *state = map;
+    return 0;
+}
+
+static int
+test_setup_lru_hashmap(void** state)
+{
+    struct jbpf_map* map = create_per_thread_map(JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP, sizeof(int), sizeof(uint32_t));
+    *state = map;
+    return 0;
+}
+
+static int
+test_teardown(void** state)
+{
+    __jbpf_destroy_map((struct jbpf_map*)*state);
+    return 0;
+}
+
+static void
+test_array_reduce_key(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    uint32_t key = 9;
+    uint64_t out = 0;
+    int ret;
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_SUM);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out == 10 * (1 + 2 + 3 + 4));
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_MIN);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out == 10);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_MAX);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out == 40);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_OR);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out == (10 | 20 | 30 | 40));
+
+    // Only the copies of the registered threads are reduced
+    ret = jbpf_bpf_map_reduce(map, 2, &key, &out, sizeof(out), JBPF_MAP_REDUCE_SUM);
+    assert(ret == 2);
+    assert(out == 30);
+
+    key = TEST_MAP_SIZE;
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_SUM);
+    assert(ret == 0);
+}
+
+static void
+test_array_reduce_signed(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    struct jbpf_map* copies = map->data;
+    uint32_t key = 0;
+    int32_t out[2];
+    int ret;
+
+    // Each value holds two int32_t elements
+    for (int t = 0; t < TEST_NUM_THREADS; t++) {
+        int32_t* val = jbpf_bpf_array_lookup_elem(&copies[t], &key);
+        val[0] = t - 2;
+        val[1] = 2 - t;
+    }
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, out, sizeof(out), JBPF_MAP_REDUCE_MIN | JBPF_MAP_REDUCE_S32);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out[0] == -2 && out[1] == -1);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, out, sizeof(out), JBPF_MAP_REDUCE_MAX | JBPF_MAP_REDUCE_S32);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out[0] == 1 && out[1] == 2);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, out, sizeof(out), JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_S32);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out[0] == -2 && out[1] == 2);
+
+    // Unsigned elements compare the negative values as large values
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, out, sizeof(out), JBPF_MAP_REDUCE_MAX | JBPF_MAP_REDUCE_U32);
+    assert(ret == TEST_NUM_THREADS);
+    assert(out[0] == -1 && out[1] == -1);
+}
+
+static void
+test_array_reduce_all_keys(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    uint64_t out[TEST_MAP_SIZE];
+    uint32_t key = 0;
+    int ret;
+
+    ret = jbpf_bpf_map_reduce(
+        map, TEST_NUM_THREADS, &key, out, sizeof(out), JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_ALL_KEYS);
+    JBPF_UNUSED(ret);
+    assert(ret == TEST_NUM_THREADS);
+    for (int i = 0; i < TEST_MAP_SIZE; i++) {
+        assert(out[i] == (uint64_t)(i + 1) * 10);
+    }
+
+    // The whole array must fit in the buffer
+    ret = jbpf_bpf_map_reduce(
+        map, TEST_NUM_THREADS, &key, out, sizeof(out) - 1, JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_ALL_KEYS);
+    assert(ret == JBPF_MAP_ERROR);
+}
+
+static void
+test_array_dump_aggregated(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    uint8_t data[TEST_MAP_SIZE * (sizeof(uint32_t) + sizeof(uint64_t))];
+    uint32_t pair_size = sizeof(uint32_t) + sizeof(uint64_t);
+    int count;
+
+    count = jbpf_bpf_map_dump_aggregated(map, TEST_NUM_THREADS, data, sizeof(data), JBPF_MAP_REDUCE_MAX);
+    JBPF_UNUSED(count);
+    assert(count == TEST_MAP_SIZE);
+    for (uint32_t i = 0; i < TEST_MAP_SIZE; i++) {
+        uint32_t key;
+        uint64_t val;
+        memcpy(&key, &data[i * pair_size], sizeof(key));
+        memcpy(&val, &data[i * pair_size + sizeof(uint32_t)], sizeof(val));
+        assert(key == i);
+        assert(val == (uint64_t)(i + 1) * TEST_NUM_THREADS);
+    }
+
+    // Only the pairs that fit are dumped
+    count = jbpf_bpf_map_dump_aggregated(map, TEST_NUM_THREADS, data, pair_size * 3 + 1, JBPF_MAP_REDUCE_MAX);
+    assert(count == 3);
+}
+
+static void
+test_hashmap_reduce_and_dump(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    struct jbpf_map* copies = map->data;
+    struct
+    {
+        int key;
+        uint32_t val;
+    } data[TEST_MAP_SIZE];
+    int seen[TEST_MAP_SIZE] = {0};
+    uint32_t out;
+    int key;
+    int ret;
+
+    // Thread t holds the keys that are multiples of t + 1, with the value t + 1
+    for (int t = 0; t < TEST_NUM_THREADS; t++) {
+        for (key = 0; key < TEST_MAP_SIZE; key += t + 1) {
+            uint32_t val = t + 1;
+            if (map->type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP)
+                ret = jbpf_bpf_spsc_hashmap_update_elem(&copies[t], &key, &val, 0);
+            else
+                ret = jbpf_bpf_spsc_lru_hashmap_update_elem(&copies[t], &key, &val, 0);
+            assert(ret == JBPF_MAP_SUCCESS);
+        }
+    }
+
+    key = 6;
+    ret = jbpf_bpf_map_reduce(
+        map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_U32);
+    JBPF_UNUSED(ret);
+    assert(ret == 3);
+    assert(out == 1 + 2 + 3);
+
+    key = 7;
+    ret = jbpf_bpf_map_reduce(
+        map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_MAX | JBPF_MAP_REDUCE_U32);
+    assert(ret == 1);
+    assert(out == 1);
+
+    key = TEST_MAP_SIZE;
+    ret = jbpf_bpf_map_reduce(
+        map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_U32);
+    assert(ret == 0);
+
+    // Each key is dumped once, with the sum of the threads that have it
+    ret = jbpf_bpf_map_dump_aggregated(
+        map, TEST_NUM_THREADS, data, sizeof(data), JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_U32);
+    assert(ret == TEST_MAP_SIZE);
+    for (int i = 0; i < TEST_MAP_SIZE; i++) {
+        uint32_t expected = 0;
+        key = data[i].key;
+        assert(key >= 0 && key < TEST_MAP_SIZE);
+        assert(!seen[key]);
+        seen[key] = 1;
+        for (int t = 0; t < TEST_NUM_THREADS; t++) {
+            if (key % (t + 1) == 0)
+                expected += t + 1;
+        }
+        assert(data[i].val == expected);
+    }
+
+    ret = jbpf_bpf_map_dump_aggregated(
+        map, TEST_NUM_THREADS, data, sizeof(data[0]) * 5, JBPF_MAP_REDUCE_SUM | JBPF_MAP_REDUCE_U32);
+    assert(ret == 5);
+}
+
+static void
+test_reduce_invalid_flags(void** state)
+{
+    struct jbpf_map* map = (struct jbpf_map*)*state;
+    uint32_t key = 0;
+    uint64_t out;
+    int ret;
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), JBPF_MAP_REDUCE_OR + 1);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out), 0x40);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, &key, &out, sizeof(out) - 1, JBPF_MAP_REDUCE_SUM);
+    assert(ret == JBPF_MAP_ERROR);
+
+    ret = jbpf_bpf_map_reduce(map, TEST_NUM_THREADS, NULL, &out, sizeof(out), JBPF_MAP_REDUCE_SUM);
+    assert(ret == JBPF_MAP_ERROR);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_map* state;
+    const jbpf_test tests[] = {
+        JBPF_CREATE_TEST(test_array_reduce_key, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_array_reduce_signed, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_array_reduce_all_keys, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_array_dump_aggregated, test_setup_array, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_reduce_and_dump, test_setup_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_reduce_and_dump, test_setup_lru_hashmap, test_teardown, &state),
+        JBPF_CREATE_TEST(test_reduce_invalid_flags, test_setup_array, test_teardown, &state),
+    };
+
+    int num_tests = sizeof(tests) / sizeof(jbpf_test);
+    return jbpf_run_test(tests, num_tests, system_group_setup, system_group_teardown);
+}
@@ -0,0 +1,271 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+/*
+    This contains unit tests for JBPF_MAP_TYPE_LRU_HASHMAP and JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP. It tests the
+    following functions:
+    - jbpf_bpf_lru_hashmap_create
+    - jbpf_bpf_lru_hashmap_update_elem / jbpf_bpf_spsc_lru_hashmap_update_elem
+    - jbpf_bpf_lru_hashmap_lookup_elem / jbpf_bpf_spsc_lru_hashmap_lookup_elem
+    - jbpf_bpf_lru_hashmap_delete_elem / jbpf_bpf_spsc_lru_hashmap_delete_elem
+    - jbpf_bpf_lru_hashmap_dump
+    - jbpf_bpf_lru_hashmap_clear
+    - jbpf_bpf_lru_hashmap_destroy
+
+    It tests the following scenarios:
+    - Adding a key to a full hashmap evicts the least recently added key
+    - Looking up or updating a key makes it the most recently used key, so that it is not evicted
+    - Adding a key after deleting a key from a full hashmap does not evict any key
+    - Dumping the hashmap from the most to the least recently used key
+    - Clearing the hashmap and adding keys again without eviction
+*/
+
+#include <assert.h>
+#include "jbpf_memory.h"
+#include "jbpf_test_lib.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_impl.h"
+#include "jbpf_int.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_utils.h"
+
+#define TEST_HASHMAP_SIZE 1000
+
+/*
+ * This is run once before all system group tests
+ */
+static int
+system_group_setup(void** state)
+{
+    struct jbpf_agent_mem_config mem_config;
+    mem_config.mem_size = 1024 * 1024 * 1024;
+    __test_setup();
+    jbpf_memory_setup(&mem_config);
+    return 0;
+}
+
+/*
+ * This is run once after all system group tests
+ */
+static int
+system_group_teardown(void** state)
+{
+    jbpf_memory_teardown();
+    return 0;
+}
+
+static struct jbpf_map*
+create_hashmap(int type)
+{
+    struct jbpf_load_map_def map_def = {
+        .type = type,
+        .key_size = sizeof(int),
+        .value_size = sizeof(int),
+        .max_entries = TEST_HASHMAP_SIZE,
+    };
+
+    struct jbpf_map* map = calloc(1, sizeof(struct jbpf_map));
+    assert(map != NULL);
+
+    map->data = jbpf_bpf_lru_hashmap_create(&map_def);
+    assert(map->data != NULL);
+    map->key_size = map_def.key_size;
+    map->value_size = map_def.value_size;
+    map->type = map_def.type;
+    map->max_entries = map_def.max_entries;
+
+    return map;
+}
+
+static int
+test_setup(void** state)
+{
+    struct jbpf_map* map = create_hashmap(JBPF_MAP_TYPE_LRU_HASHMAP);
+    for (int i = 0; i < TEST_HASHMAP_SIZE; ++i) {
+        int key = i;
+        int val = i;
+        int ret = jbpf_bpf_lru_hashmap_update_elem(map, &key, &val, 0);
+        JBPF_UNUSED(ret);
+        assert(ret == JBPF_MAP_SUCCESS);
+    }
+    *state = map;
+    return 0;
+}
+
+static int
+test_setup_per_thread(void** state)
+{
+    struct jbpf_map* map = create_hashmap(JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP);
+    for (int i = 0; i < TEST_HASHMAP_SIZE; ++i) {
+        int key = i;
+        int val = i;
+        int ret = jbpf_bpf_spsc_lru_hashmap_update_elem(map, &key, &val, 0);
+        JBPF_UNUSED(ret);
+        assert(ret == JBPF_MAP_SUCCESS);
+    }
+    *state = map;
+    return 0;
+}
+
+static int
+test_teardown(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    jbpf_bpf_lru_hashmap_destroy(hashmap);
+    free(hashmap);
+    return 0;
+}
+
+static void
+test_hashmap_evict_least_recently_added(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == TEST_HASHMAP_SIZE);
+    assert(jbpf_bpf_lru_hashmap_evictions(hashmap) == 0);
+
+    for (int i = 0; i < TEST_HASHMAP_SIZE / 2; ++i) {
+        int key = i + TEST_HASHMAP_SIZE;
+        int ret = jbpf_bpf_lru_hashmap_update_elem(hashmap, &key, &key, 0);
+        JBPF_UNUSED(ret);
+        assert(ret == JBPF_MAP_SUCCESS);
+    }
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == TEST_HASHMAP_SIZE);
+    assert(jbpf_bpf_lru_hashmap_evictions(hashmap) == TEST_HASHMAP_SIZE / 2);
+
+    for (int i = 0; i < TEST_HASHMAP_SIZE + TEST_HASHMAP_SIZE / 2; ++i) {
+        int key = i;
+        int* val = (int*)jbpf_bpf_lru_hashmap_lookup_elem(hashmap, &key);
+        JBPF_UNUSED(val);
+        if (i < TEST_HASHMAP_SIZE / 2) {
+            assert(!val);
+        } else {
+            assert(val);
+            assert(*val == i);
+        }
+    }
+}
+
+static void
+test_hashmap_lookup_and_update_refresh_recency(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    int key = 0;
+    int val = 9999;
+    int* res = (int*)jbpf_bpf_spsc_lru_hashmap_lookup_elem(hashmap, &key);
+    JBPF_UNUSED(res);
+    assert(res);
+    key = 1;
+    int ret = jbpf_bpf_spsc_lru_hashmap_update_elem(hashmap, &key, &val, 0);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_SUCCESS);
+    assert(jbpf_bpf_spsc_lru_hashmap_evictions(hashmap) == 0);
+
+    // Keys 2 and 3 are now the least recently used keys
+    for (int i = 0; i < 2; ++i) {
+        key = TEST_HASHMAP_SIZE + i;
+        ret = jbpf_bpf_spsc_lru_hashmap_update_elem(hashmap, &key, &key, 0);
+        assert(ret == JBPF_MAP_SUCCESS);
+    }
+    assert(jbpf_bpf_spsc_lru_hashmap_evictions(hashmap) == 2);
+
+    for (int i = 0; i < 4; ++i) {
+        key = i;
+        res = (int*)jbpf_bpf_spsc_lru_hashmap_lookup_elem(hashmap, &key);
+        if (i < 2) {
+            assert(res);
+        } else {
+            assert(!res);
+        }
+    }
+    key = 1;
+    res = (int*)jbpf_bpf_spsc_lru_hashmap_lookup_elem(hashmap, &key);
+    assert(*res == 9999);
+}
+
+static void
+test_hashmap_delete_then_add_without_eviction(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    int key = TEST_HASHMAP_SIZE / 2;
+    int ret = jbpf_bpf_lru_hashmap_delete_elem(hashmap, &key);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_SUCCESS);
+    ret = jbpf_bpf_lru_hashmap_delete_elem(hashmap, &key);
+    assert(ret == JBPF_MAP_ERROR);
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == TEST_HASHMAP_SIZE - 1);
+
+    key = TEST_HASHMAP_SIZE;
+    ret = jbpf_bpf_lru_hashmap_update_elem(hashmap, &key, &key, 0);
+    assert(ret == JBPF_MAP_SUCCESS);
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == TEST_HASHMAP_SIZE);
+    assert(jbpf_bpf_lru_hashmap_evictions(hashmap) == 0);
+
+    key = 0;
+    int* val = (int*)jbpf_bpf_lru_hashmap_lookup_elem(hashmap, &key);
+    JBPF_UNUSED(val);
+    assert(val);
+    assert(*val == 0);
+}
+
+static void
+test_hashmap_dump_in_recency_order(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    int data[TEST_HASHMAP_SIZE * 2];
+    int key = 0;
+
+    // Key 0 becomes the most recently used key
+    int* val = (int*)jbpf_bpf_lru_hashmap_lookup_elem(hashmap, &key);
+    JBPF_UNUSED(val);
+    assert(val);
+
+    unsigned int count = jbpf_bpf_lru_hashmap_dump(hashmap, data, sizeof(data), 0);
+    JBPF_UNUSED(count);
+    assert(count == TEST_HASHMAP_SIZE);
+    assert(data[0] == 0 && data[1] == 0);
+    for (int i = 1; i < TEST_HASHMAP_SIZE; ++i) {
+        assert(data[i * 2] == TEST_HASHMAP_SIZE - i);
+        assert(data[i * 2 + 1] == TEST_HASHMAP_SIZE - i);
+    }
+
+    // Only the most recently used keys that fit are dumped
+    count = jbpf_bpf_lru_hashmap_dump(hashmap, data, sizeof(int) * 2 * 10, 0);
+    assert(count == 10);
+    assert(data[0] == 0);
+}
+
+static void
+test_hashmap_clear(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    int ret = jbpf_bpf_lru_hashmap_clear(hashmap);
+    JBPF_UNUSED(ret);
+    assert(ret == JBPF_MAP_SUCCESS);
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == 0);
+
+    for (int i = 0; i < TEST_HASHMAP_SIZE; ++i) {
+        int key = i + TEST_HASHMAP_SIZE;
+        int* val = (int*)jbpf_bpf_lru_hashmap_lookup_elem(hashmap, &i);
+        JBPF_UNUSED(val);
+        assert(!val);
+        ret = jbpf_bpf_lru_hashmap_update_elem(hashmap, &key, &key, 0);
+        assert(ret == JBPF_MAP_SUCCESS);
+    }
+    assert(jbpf_bpf_lru_hashmap_size(hashmap) == TEST_HASHMAP_SIZE);
+    assert(jbpf_bpf_lru_hashmap_evictions(hashmap) == 0);
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_map* state;
+    const jbpf_test tests[] = {
+        JBPF_CREATE_TEST(test_hashmap_evict_least_recently_added, test_setup, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_evict_least_recently_added, test_setup_per_thread, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_lookup_and_update_refresh_recency, test_setup_per_thread, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_delete_then_add_without_eviction, test_setup, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_dump_in_recency_order, test_setup, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_clear, test_setup, test_teardown, &state),
+    };
+
+    int num_tests = sizeof(tests) / sizeof(jbpf_test);
+    return jbpf_run_test(tests, num_tests, system_group_setup, system_group_teardown);
+}
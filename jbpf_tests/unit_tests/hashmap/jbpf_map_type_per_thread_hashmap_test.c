@@ -18,6 +18,7 @@
     - Update an existing key in a full hashmap (single entry and multiple entries hashmap)
     - Delete a key that exists in the hashmap twice
     - Mixed add, delete, and lookup operations
+    - Replacing the keys of a full hashmap one at a time, which leaves deleted slots to be reused or rehashed
 */
 
 #include <assert.h>
@@ -371,6 +372,36 @@ test_hashmap_delete_twice(void** state)
     assert(ret3 == JBPF_MAP_ERROR);
 }
 
+static void
+test_hashmap_replace_keys_of_a_full_map(void** state)
+{
+    struct jbpf_map* hashmap = (struct jbpf_map*)*state;
+    for (int round = 1; round <= 10; ++round) {
+        for (int i = 0; i < TEST_HASHMAP_SIZE; ++i) {
+            int old_key = i + (round - 1) * TEST_HASHMAP_SIZE;
+            int key = i + round * TEST_HASHMAP_SIZE;
+            int ret = jbpf_bpf_spsc_hashmap_delete_elem((struct jbpf_map*)hashmap, &old_key);
+            JBPF_UNUSED(ret);
+            assert(ret == JBPF_MAP_SUCCESS);
+            ret = jbpf_bpf_spsc_hashmap_update_elem((struct jbpf_map*)hashmap, &key, &key, 0);
+            assert(ret == JBPF_MAP_SUCCESS);
+        }
+        assert(jbpf_bpf_spsc_hashmap_size(hashmap) == TEST_HASHMAP_SIZE);
+        for (int i = 0; i < TEST_HASHMAP_SIZE; ++i) {
+            int old_key = i + (round - 1) * TEST_HASHMAP_SIZE;
+            int key = i + round * TEST_HASHMAP_SIZE;
+            int* val = (int*)jbpf_bpf_spsc_hashmap_lookup_elem((struct jbpf_map*)hashmap, &old_key);
+            JBPF_UNUSED(val);
+            assert(!val);
+            val = (int*)jbpf_bpf_spsc_hashmap_lookup_elem((struct jbpf_map*)hashmap, &key);
+            assert(val);
+            assert(*val == key);
+            // The values are 8-byte aligned
+            assert(((uintptr_t)val & (sizeof(uint64_t) - 1)) == 0);
+        }
+    }
+}
+
 int
 main(int argc, char** argv)
 {
@@ -392,6 +423,7 @@ main(int argc, char** argv)
         JBPF_CREATE_TEST(test_hashmap_update_existing_key_to_a_full_map, test_setup_full_map, test_teardown, &state),
         JBPF_CREATE_TEST(
             test_hashmap_update_existing_key_to_a_full_map, test_setup_full_map_single, test_teardown, &state),
+        JBPF_CREATE_TEST(test_hashmap_replace_keys_of_a_full_map, test_setup_full_map, test_teardown, &state),
     };
 
     int num_tests = sizeof(tests) / sizeof(jbpf_test);
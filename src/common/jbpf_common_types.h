@@ -39,6 +39,101 @@ typedef uint32_t jbpf_codelet_priority_t;
  */
 typedef uint64_t jbpf_runtime_threshold_t;
 
+/**
+ * @brief Sampling modes of a codelet.
+ * @details With sampling, a hook only runs the codelet on some of its calls. The check is done natively by the hook,
+ * separately for each thread, before entering the codelet.
+ * @ingroup core
+ */
+typedef enum jbpf_codelet_sampling_type
+{
+    JBPF_SAMPLING_NONE = 0, /**< The codelet runs on every call of the hook. */
+    JBPF_SAMPLING_RATIO,    /**< The codelet runs on 1 in `value` calls of the hook. */
+    JBPF_SAMPLING_RATE,     /**< The codelet runs at most `value` times per second, in bursts of `burst` calls. */
+    JBPF_SAMPLING_INTERVAL, /**< The codelet runs at most once every `value` nanoseconds. */
+} jbpf_codelet_sampling_type_e;
+
+/**
+ * @brief Sampling of the hook calls that run a codelet.
+ * @note A zeroed structure disables sampling.
+ * @ingroup core
+ */
+typedef struct __attribute__((packed)) jbpf_codelet_sampling
+{
+    uint32_t type;  /**< Sampling mode, one of `jbpf_codelet_sampling_type_e`. */
+    uint64_t value; /**< Ratio, rate or interval, depending on the mode. */
+    uint32_t burst; /**< Maximum burst of calls for `JBPF_SAMPLING_RATE`. 0 is the same as 1. */
+} jbpf_codelet_sampling_t;
+
+/**
+ * @brief Maximum number of conditions in the pre-filter of a codelet.
+ * @ingroup core
+ */
+#define JBPF_MAX_FILTER_CONDITIONS (4U)
+
+/**
+ * @brief Comparison of a filter condition. All the comparisons are unsigned.
+ * @ingroup core
+ */
+typedef enum jbpf_codelet_filter_op
+{
+    JBPF_FILTER_OP_EQ = 0, /**< field == value */
+    JBPF_FILTER_OP_NE,     /**< field != value */
+    JBPF_FILTER_OP_LT,     /**< field < value */
+    JBPF_FILTER_OP_LE,     /**< field <= value */
+    JBPF_FILTER_OP_GT,     /**< field > value */
+    JBPF_FILTER_OP_GE,     /**< field >= value */
+    JBPF_FILTER_OP_MASK,   /**< (field & value) != 0 */
+} jbpf_codelet_filter_op_e;
+
+/**
+ * @brief Memory a filter condition reads its field from.
+ * @ingroup core
+ */
+typedef enum jbpf_codelet_filter_base
+{
+    JBPF_FILTER_BASE_CTX = 0, /**< The context passed to the codelet. */
+    JBPF_FILTER_BASE_DATA,    /**< The data the context points to, between data and data_end. */
+} jbpf_codelet_filter_base_e;
+
+/**
+ * @brief How the conditions of a filter are combined.
+ * @ingroup core
+ */
+typedef enum jbpf_codelet_filter_combine
+{
+    JBPF_FILTER_ALL = 0, /**< All the conditions must be true (AND). */
+    JBPF_FILTER_ANY,     /**< At least one condition must be true (OR). */
+} jbpf_codelet_filter_combine_e;
+
+/**
+ * @brief A condition on a field of the hook context.
+ * @note A field that lies outside of its base makes the condition false.
+ * @ingroup core
+ */
+typedef struct __attribute__((packed)) jbpf_codelet_filter_cond
+{
+    uint8_t base;    /**< Base of the field, one of `jbpf_codelet_filter_base_e`. */
+    uint8_t op;      /**< Comparison, one of `jbpf_codelet_filter_op_e`. */
+    uint8_t size;    /**< Size of the field in bytes: 1, 2, 4 or 8. */
+    uint32_t offset; /**< Offset of the field from its base. */
+    uint64_t value;  /**< Value the field is compared with. */
+} jbpf_codelet_filter_cond_t;
+
+/**
+ * @brief Pre-filter of a codelet.
+ * @details The hook only runs the codelet if the filter matches. The filter is evaluated natively, before entering
+ * the codelet.
+ * @note A filter without conditions always matches.
+ * @ingroup core
+ */
+typedef struct __attribute__((packed)) jbpf_codelet_filter
+{
+    uint32_t combine;        /**< How the conditions are combined, one of `jbpf_codelet_filter_combine_e`. */
+    uint32_t num_conditions; /**< Number of conditions. @max JBPF_MAX_FILTER_CONDITIONS */
+    jbpf_codelet_filter_cond_t conditions[JBPF_MAX_FILTER_CONDITIONS]; /**< The conditions. */
+} jbpf_codelet_filter_t;
+
 /**
  * @brief Length of the jbpf IO channel name.
  * @details This is the maximum length of the IO channel name.
@@ -12,6 +12,11 @@
 
 /* jbpf MAP flags */
 #define JBPF_MAP_CLEAR_FLAG (1 << 0)
+/* Place the data of a JBPF_MAP_TYPE_ARRAY or JBPF_MAP_TYPE_PER_THREAD_ARRAY map in a shared memory region, that the
+ * host application and the IPC secondaries can map read-only */
+#define JBPF_MAP_F_MMAPABLE (1 << 1)
+/* Back the region of a JBPF_MAP_F_MMAPABLE map with 2MB persistent huge pages, if a hugetlbfs mount is available */
+#define JBPF_MAP_F_MMAP_HUGEPAGES (1 << 2)
 
 /**
  * @brief declare a jbpf output map
@@ -73,6 +78,7 @@
  * @note JBPF_PROG_TYPE_UNSPEC: Unspecified program type
  * @note JBPF_PROG_TYPE_GENERIC: Generic program type
  * @note JBPF_PROG_TYPE_STATS: Performance stats program type
+ * @note JBPF_PROG_TYPE_BATCH: Program type for hooks that pass a batch of elements in a single call
  * @note JBPF_NUM_PROG_TYPES_MAX: Placeholder for the maximum number of program types
  */
 enum jbpf_prog_type
@@ -80,6 +86,7 @@ enum jbpf_prog_type
     JBPF_PROG_TYPE_UNSPEC = 0,
     JBPF_PROG_TYPE_GENERIC,
     JBPF_PROG_TYPE_STATS,
+    JBPF_PROG_TYPE_BATCH,
     JBPF_NUM_PROG_TYPES_MAX,
 };
 
@@ -104,6 +111,14 @@ enum jbpf_prog_type
  * @note JBPF_CONTROL_INPUT_RECEIVE: Receive data from control input
  * @note JBPF_GET_OUTPUT_BUF: Get output buffer pointer
  * @note JBPF_SEND_OUTPUT: Send output
+ * @note JBPF_MAP_REDUCE: Reduce the values of a per-thread map over all the threads
+ * @note JBPF_RINGBUF_RESERVE: Reserve a record of a ringbuf map
+ * @note JBPF_RINGBUF_SUBMIT: Submit the reserved record of a ringbuf map
+ * @note JBPF_RINGBUF_DISCARD: Discard the reserved record of a ringbuf map
+ * @note JBPF_MAP_LOOKUP_BATCH: Copy the values of a batch of keys of a map
+ * @note JBPF_MAP_UPDATE_BATCH: Update a batch of keys of a map
+ * @note JBPF_MAP_DELETE_BATCH: Delete a batch of keys of a map
+ * @note JBPF_MAP_ITERATE: Copy the next entries of a map, from a cursor
  * @note JBPF_NUM_HELPERS_MAX: Placeholder for the maximum number of helper functions
  * @ingroup core
  */
@@ -128,6 +143,14 @@ enum jbpf_helper_type
     JBPF_CONTROL_INPUT_RECEIVE,
     JBPF_GET_OUTPUT_BUF,
     JBPF_SEND_OUTPUT,
+    JBPF_MAP_REDUCE,
+    JBPF_RINGBUF_RESERVE,
+    JBPF_RINGBUF_SUBMIT,
+    JBPF_RINGBUF_DISCARD,
+    JBPF_MAP_LOOKUP_BATCH,
+    JBPF_MAP_UPDATE_BATCH,
+    JBPF_MAP_DELETE_BATCH,
+    JBPF_MAP_ITERATE,
     JBPF_NUM_HELPERS_MAX, // Use this as the starting value for any additional helper functions
 };
 
@@ -145,6 +168,9 @@ enum ubpf_map_type
     JBPF_MAP_TYPE_PER_THREAD_ARRAY = 5,
     JBPF_MAP_TYPE_PER_THREAD_HASHMAP = 6,
     JBPF_MAP_TYPE_OUTPUT = 7,
+    JBPF_MAP_TYPE_CONCURRENT_HASHMAP = 8,
+    JBPF_MAP_TYPE_LRU_HASHMAP = 9,
+    JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP = 10,
     JBPF_MAP_TYPE_MAX,
 };
 
@@ -200,4 +226,23 @@ struct jbpf_stats_ctx
     uint32_t meas_period; /* Period of measurements in ms */
 };
 
+/**
+ * @brief Context for hooks that pass a batch of elements in a single call
+ * @ingroup core
+ * @note The elements are stored contiguously between data and data_end
+ * @param data Pointer to the first element of the batch
+ * @param data_end Pointer to the end of the last element of the batch
+ * @param meta_data Used for the program to store metadata
+ * @param ctx_id Can be used to store a unique context id to identify the caller
+ * @param num_elems Number of elements in the batch
+ */
+struct jbpf_batch_ctx
+{
+    uint64_t data;      /* Pointer to the first element of the batch */
+    uint64_t data_end;  /* Pointer to the end of the last element of the batch */
+    uint64_t meta_data; /* Used for the program to store metadata */
+    uint32_t ctx_id;    /* Can be used to store a unique context id to identify the caller */
+    uint32_t num_elems; /* Number of elements in the batch */
+};
+
 #endif
@@ -11,6 +11,7 @@
 #include <semaphore.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "ubpf.h"
 
@@ -20,16 +21,28 @@
 #include "jbpf_logging.h"
 #include "jbpf_version.h"
 #include "jbpf_hook_defs.h"
+#include "jbpf_hook_trampoline.h"
 #include "jbpf_agent_hooks.h"
 #include "jbpf.h"
 #include "jbpf_memory.h"
 #include "jbpf_int.h"
+#include "jbpf_qsbr.h"
 #include "jbpf_io_channel.h"
 #include "jbpf_io_hash.h"
 #include "jbpf_bpf_hashmap.h"
 #include "jbpf_bpf_spsc_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap.h"
 #include "jbpf_bpf_array.h"
 #include "jbpf_helper_impl.h"
+#include "jbpf_static_key.h"
+#include "jbpf_deferred.h"
+#include "jbpf_perf_map.h"
+#include "jbpf_trace.h"
+#include "jbpf_metrics.h"
+#include "jbpf_bpf_map_iter.h"
+#include "jbpf_map_snapshot.h"
+#include "jbpf_map_mmap.h"
 #include "jbpf_common_types.h"
 
 DEFINE_JBPF_AGENT_HOOK(periodic_call);
@@ -67,6 +80,9 @@ static sem_t jio_thread_sem;
 static sem_t jagent_thread_sem;
 
 static pthread_mutex_t lcm_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Hook transaction of the codeletset being loaded or unloaded, protected by the LCM lock. It is too large for the
+ * stack of the threads that call the LCM API */
+static struct jbpf_hook_txn lcm_hook_txn;
 
 static pthread_t jbpf_maintenance_thread;
 static pthread_t jbpf_io_thread;
@@ -143,6 +159,16 @@ jbpf_codelet_register_map(struct jbpf_codelet* codelet, struct jbpf_map* map)
         return -1;
     }
 
+    // The secondaries find the region of the map by the names that the codelet knows it by
+    if (map->mmap && jbpf_map_mmap_publish(
+                         jbpf_ctx.jbpf_run_path,
+                         codelet->codeletset->codeletset_id.name,
+                         codelet->name,
+                         map->name,
+                         map->mmap->mmap_info.mem_name) != 0) {
+        return -1;
+    }
+
     ck_ht_hash(&map_hash, &codelet->maps, map->name, JBPF_MAP_NAME_LEN);
     ck_ht_entry_set(&map_entry, map_hash, map->name, JBPF_MAP_NAME_LEN, map);
     if (ck_ht_put_spmc(&codelet->maps, map_hash, &map_entry)) {
@@ -150,6 +176,10 @@ jbpf_codelet_register_map(struct jbpf_codelet* codelet, struct jbpf_map* map)
         return 0;
     }
 
+    if (map->mmap) {
+        jbpf_map_mmap_unpublish(
+            jbpf_ctx.jbpf_run_path, codelet->codeletset->codeletset_id.name, codelet->name, map->name);
+    }
     return -1;
 }
 
@@ -168,6 +198,11 @@ jbpf_codelet_deregister_map(struct jbpf_codelet* codelet, struct jbpf_map* map)
     if (ck_ht_remove_spmc(&codelet->maps, map_hash, &map_entry)) {
         jbpf_logger(JBPF_DEBUG, "Map %s was removed!\n", map->name);
     }
+
+    if (map->mmap) {
+        jbpf_map_mmap_unpublish(
+            jbpf_ctx.jbpf_run_path, codelet->codeletset->codeletset_id.name, codelet->name, map->name);
+    }
 }
 
 static struct jbpf_map*
@@ -192,6 +227,39 @@ jbpf_codelet_lookup_map(struct jbpf_codelet* codelet, const char* map_name)
     return NULL;
 }
 
+/* Find a map of a loaded codelet by the names of its codeletset, codelet and map. Called with the LCM lock held, as
+ * the map is destroyed when its codeletset is unloaded */
+static struct jbpf_map*
+jbpf_find_codelet_map(const char* codeletset_name, const char* codelet_name, const char* map_name)
+{
+    ck_ht_entry_t entry;
+    ck_ht_hash_t hash;
+    char codeletset_key[JBPF_CODELETSET_NAME_LEN] = {0};
+    char codelet_key[JBPF_CODELET_NAME_LEN] = {0};
+    struct jbpf_codeletset* codeletset;
+
+    if (!codeletset_name || !codelet_name || !map_name) {
+        return NULL;
+    }
+
+    strncpy(codeletset_key, codeletset_name, JBPF_CODELETSET_NAME_LEN - 1);
+    ck_ht_hash(&hash, &jbpf_ctx.codeletset_registry, codeletset_key, JBPF_CODELETSET_NAME_LEN);
+    ck_ht_entry_key_set(&entry, codeletset_key, JBPF_CODELETSET_NAME_LEN);
+    if (ck_ht_get_spmc(&jbpf_ctx.codeletset_registry, hash, &entry) == false) {
+        return NULL;
+    }
+    codeletset = ck_ht_entry_value(&entry);
+
+    strncpy(codelet_key, codelet_name, JBPF_CODELET_NAME_LEN - 1);
+    ck_ht_hash(&hash, &codeletset->codelets, codelet_key, JBPF_CODELET_NAME_LEN);
+    ck_ht_entry_key_set(&entry, codelet_key, JBPF_CODELET_NAME_LEN);
+    if (ck_ht_get_spmc(&codeletset->codelets, hash, &entry) == false) {
+        return NULL;
+    }
+
+    return jbpf_codelet_lookup_map(ck_ht_entry_value(&entry), map_name);
+}
+
 static int
 _jbpf_create_run_dir(struct jbpf_ctx_t* ctx, char* run_path)
 {
@@ -329,6 +397,60 @@ validate_codeletset(struct jbpf_codeletset_load_req* load_req, jbpf_codeletset_l
             return JBPF_CODELET_PARAM_INVALID;
         }
 
+        // validate sampling
+        jbpf_codelet_sampling_t* sampling = &load_req->codelet_descriptor[i].sampling;
+        if (sampling->type > JBPF_SAMPLING_INTERVAL || (sampling->type != JBPF_SAMPLING_NONE && sampling->value == 0)) {
+            char msg[JBPF_MAX_ERR_MSG_SIZE];
+            sprintf(
+                msg,
+                "codelet %s has an invalid sampling (type %u, value %lu)\n",
+                load_req->codelet_descriptor[i].codelet_name,
+                sampling->type,
+                (uint64_t)sampling->value);
+            jbpf_logger(JBPF_ERROR, "%s", msg);
+            if (err) {
+                strcpy(err->err_msg, msg);
+            }
+            return JBPF_CODELET_PARAM_INVALID;
+        }
+
+        // validate filter
+        jbpf_codelet_filter_t* filter = &load_req->codelet_descriptor[i].filter;
+        if (filter->num_conditions > JBPF_MAX_FILTER_CONDITIONS || filter->combine > JBPF_FILTER_ANY) {
+            char msg[JBPF_MAX_ERR_MSG_SIZE];
+            sprintf(
+                msg,
+                "codelet %s has an invalid filter (%u conditions, combine %u)\n",
+                load_req->codelet_descriptor[i].codelet_name,
+                filter->num_conditions,
+                filter->combine);
+            jbpf_logger(JBPF_ERROR, "%s", msg);
+            if (err) {
+                strcpy(err->err_msg, msg);
+            }
+            return JBPF_CODELET_PARAM_INVALID;
+        }
+        for (uint32_t c = 0; c < filter->num_conditions; c++) {
+            jbpf_codelet_filter_cond_t* cond = &filter->conditions[c];
+            if (cond->base > JBPF_FILTER_BASE_DATA || cond->op > JBPF_FILTER_OP_MASK ||
+                (cond->size != 1 && cond->size != 2 && cond->size != 4 && cond->size != 8)) {
+                char msg[JBPF_MAX_ERR_MSG_SIZE];
+                sprintf(
+                    msg,
+                    "codelet %s has an invalid filter condition %u (base %u, op %u, size %u)\n",
+                    load_req->codelet_descriptor[i].codelet_name,
+                    c,
+                    cond->base,
+                    cond->op,
+                    cond->size);
+                jbpf_logger(JBPF_ERROR, "%s", msg);
+                if (err) {
+                    strcpy(err->err_msg, msg);
+                }
+                return JBPF_CODELET_PARAM_INVALID;
+            }
+        }
+
         // validate in_io_channel
         for (int ch = 0; ch < load_req->codelet_descriptor[i].num_in_io_channel; ch++) {
             jbpf_io_channel_desc_s* chan = &load_req->codelet_descriptor[i].in_io_channel[ch];
@@ -540,7 +662,11 @@ _jbpf_read_binary_file(char* path, size_t* size)
 }
 
 static struct jbpf_map*
-jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const struct jbpf_map_io_def* io_def)
+jbpf_create_map(
+    const char* name,
+    const struct jbpf_load_map_def* map_def,
+    const struct jbpf_map_io_def* io_def,
+    const struct jbpf_codelet* codelet)
 {
     struct jbpf_map* map;
     struct jbpf_map* perthread_maps;
@@ -562,9 +688,27 @@ jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const
     map->key_size = map_def->key_size;
     map->value_size = map_def->value_size;
     map->max_entries = map_def->max_entries;
+    map->map_flags = map_def->map_flags;
     strncpy(map->name, name, JBPF_MAP_NAME_LEN - 1);
     map->name[JBPF_MAP_NAME_LEN - 1] = '\0';
 
+    if (map_def->map_flags & JBPF_MAP_F_MMAPABLE) {
+        if (!jbpf_map_mmap_supported(map_def->type)) {
+            jbpf_logger(JBPF_ERROR, "JBPF_MAP_F_MMAPABLE is not supported by map %s of type %d\n", name, map_def->type);
+            goto map_not_created;
+        }
+        if (jbpf_map_mmap_create(
+                map,
+                map_def,
+                __jbpf_ctx->jbpf_run_path,
+                __jbpf_ctx->jbpf_namespace,
+                codelet ? codelet->codeletset->codeletset_id.name : "",
+                codelet ? codelet->name : "") != 0) {
+            goto map_not_created;
+        }
+        goto map_created;
+    }
+
     switch (map_def->type) {
     case JBPF_MAP_TYPE_ARRAY:
         map->data = jbpf_bpf_array_create(map_def);
@@ -572,6 +716,12 @@ jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const
     case JBPF_MAP_TYPE_HASHMAP:
         map->data = jbpf_bpf_hashmap_create(map_def);
         break;
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        map->data = jbpf_bpf_concurrent_hashmap_create(map_def);
+        break;
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        map->data = jbpf_bpf_lru_hashmap_create(map_def);
+        break;
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         /* Create an array of maps (one per thread)*/
         perthread_maps = jbpf_calloc_mem(sizeof(struct jbpf_map), JBPF_MAX_NUM_REG_THREADS);
@@ -590,6 +740,15 @@ jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const
         }
         map->data = perthread_maps;
         break;
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        /* Create an array of maps (one per thread)*/
+        perthread_maps = jbpf_calloc_mem(sizeof(struct jbpf_map), JBPF_MAX_NUM_REG_THREADS);
+        for (int map_id = 0; map_id < JBPF_MAX_NUM_REG_THREADS; map_id++) {
+            memcpy(&perthread_maps[map_id], map, sizeof(struct jbpf_map));
+            perthread_maps[map_id].data = jbpf_bpf_lru_hashmap_create(map_def);
+        }
+        map->data = perthread_maps;
+        break;
     case JBPF_MAP_TYPE_RINGBUF:
     case JBPF_MAP_TYPE_OUTPUT:
     case JBPF_MAP_TYPE_CONTROL_INPUT:
@@ -602,10 +761,11 @@ jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const
         } else {
             direction = JBPF_IO_CHANNEL_OUTPUT;
         }
+        // Ringbuf maps send records of variable size, the other IO maps buffers of value_size bytes
         map->data = jbpf_io_create_channel(
             __jbpf_ctx->io_ctx,
             direction,
-            JBPF_IO_CHANNEL_QUEUE,
+            map_def->type == JBPF_MAP_TYPE_RINGBUF ? JBPF_IO_CHANNEL_RINGBUF : JBPF_IO_CHANNEL_QUEUE,
             map->max_entries,
             map->value_size,
             io_def->io_desc->stream_id,
@@ -644,6 +804,12 @@ jbpf_destroy_map(struct jbpf_map* map)
 
     jbpf_logger(JBPF_DEBUG, "jbpf_destroy_map(%s) with type %d\n", map->name, map->type);
 
+    if (map->mmap) {
+        jbpf_map_mmap_destroy(map, __jbpf_ctx->jbpf_run_path);
+        jbpf_free_mem(map);
+        return;
+    }
+
     /* Free the map memory */
     switch (map->type) {
     case JBPF_MAP_TYPE_ARRAY:
@@ -652,6 +818,12 @@ jbpf_destroy_map(struct jbpf_map* map)
     case JBPF_MAP_TYPE_HASHMAP:
         jbpf_bpf_hashmap_destroy(map);
         break;
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        jbpf_bpf_concurrent_hashmap_destroy(map);
+        break;
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        jbpf_bpf_lru_hashmap_destroy(map);
+        break;
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         perthread_maps = map->data;
         for (int map_id = 0; map_id < JBPF_MAX_NUM_REG_THREADS; map_id++) {
@@ -666,6 +838,13 @@ jbpf_destroy_map(struct jbpf_map* map)
         }
         jbpf_free_mem(perthread_maps);
         break;
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_maps = map->data;
+        for (int map_id = 0; map_id < JBPF_MAX_NUM_REG_THREADS; map_id++) {
+            jbpf_bpf_lru_hashmap_destroy(&perthread_maps[map_id]);
+        }
+        jbpf_free_mem(perthread_maps);
+        break;
     case JBPF_MAP_TYPE_RINGBUF:
     case JBPF_MAP_TYPE_CONTROL_INPUT:
     case JBPF_MAP_TYPE_OUTPUT:
@@ -743,7 +922,7 @@ jbpf_do_map_relocation(
                     0) {
                     io_def.io_desc = &codelet_ctx->codelet_desc->out_io_channel[channel_idx];
                     io_def.obj_files = &codelet_ctx->obj_files->out_io_obj_files[channel_idx];
-                    map = jbpf_create_map(symbol_name, &map_def, &io_def);
+                    map = jbpf_create_map(symbol_name, &map_def, &io_def, codelet);
                     break;
                 }
             }
@@ -754,12 +933,12 @@ jbpf_do_map_relocation(
                     0) {
                     io_def.io_desc = &codelet_ctx->codelet_desc->in_io_channel[channel_idx];
                     io_def.obj_files = &codelet_ctx->obj_files->in_io_obj_files[channel_idx];
-                    map = jbpf_create_map(symbol_name, &map_def, &io_def);
+                    map = jbpf_create_map(symbol_name, &map_def, &io_def, codelet);
                     break;
                 }
             }
         } else {
-            map = jbpf_create_map(symbol_name, &map_def, NULL);
+            map = jbpf_create_map(symbol_name, &map_def, NULL, codelet);
         }
 
         if (!map) {
@@ -791,7 +970,7 @@ jbpf_do_map_relocation(
         // Otherwise, just reference it
         if (linked_map->ref_count == 0) {
             jbpf_logger(JBPF_DEBUG, "First reference to shared map %s, so let's create it\n", symbol_name);
-            map = jbpf_create_map(symbol_name, &map_def, NULL);
+            map = jbpf_create_map(symbol_name, &map_def, NULL, codelet);
 
             if (!map) {
                 jbpf_logger(JBPF_ERROR, "jbpf shared map '%s' could not be created\n", symbol_name);
@@ -815,7 +994,8 @@ jbpf_do_map_relocation(
             /* Next we need to make sure that the map is actually of the same type and size */
             if ((linked_map->map->type != map_def.type) || (linked_map->map->key_size != map_def.key_size) ||
                 (linked_map->map->value_size != map_def.value_size) ||
-                (linked_map->map->max_entries != map_def.max_entries)) {
+                (linked_map->map->max_entries != map_def.max_entries) ||
+                (linked_map->map->map_flags != map_def.map_flags)) {
 
                 jbpf_logger(
                     JBPF_ERROR, "jbpf map '%s' definition is not the same as of the registered map\n", symbol_name);
@@ -827,10 +1007,12 @@ jbpf_do_map_relocation(
 
             map = jbpf_calloc_mem(1, sizeof(struct jbpf_map));
             map->data = linked_map->map->data;
+            map->mmap = linked_map->map->mmap;
             map->key_size = linked_map->map->key_size;
             map->value_size = linked_map->map->value_size;
             map->max_entries = linked_map->map->max_entries;
             map->type = linked_map->map->type;
+            map->map_flags = linked_map->map->map_flags;
             strncpy(map->name, symbol_name, JBPF_MAP_NAME_LEN - 1);
             map->name[JBPF_MAP_NAME_LEN - 1] = '\0';
 
@@ -938,6 +1120,8 @@ jbpf_create_codelet(
     codelet->codeletset = codeletset;
     codelet->e_runtime_threshold = codelet_desc->runtime_threshold;
     codelet->priority = codelet_desc->priority;
+    codelet->sampling = codelet_desc->sampling;
+    codelet->filter = codelet_desc->filter;
     strncpy(codelet->name, codelet_desc->codelet_name, JBPF_CODELET_NAME_LEN - 1);
     codelet->name[JBPF_CODELET_NAME_LEN - 1] = '\0';
     strncpy(codelet->hook_name, codelet_desc->hook_name, JBPF_HOOK_NAME_LEN - 1);
@@ -980,6 +1164,8 @@ jbpf_create_codelet(
         goto error_vm;
     }
 
+    jbpf_perf_map_add_codelet(codelet->vm, (const void*)codelet->codelet_fn, codelet->name, codelet->hook_name);
+
     return codelet;
 error_vm:
     // Remove maps that were already added
@@ -1001,41 +1187,56 @@ jbpf_destroy_codelet(struct jbpf_codelet* codelet)
 
     jbpf_destroy_codelet_maps(codelet);
 
+    jbpf_perf_map_remove_codelet((const void*)codelet->codelet_fn);
     ubpf_destroy(codelet->vm);
     ck_ht_destroy(&codelet->maps);
     jbpf_free_mem(codelet);
 }
 
-static int
-jbpf_load_codelet(struct jbpf_codelet* codelet)
+static struct jbpf_hook*
+jbpf_find_hook(const char* hook_name)
 {
-    int ret = -1;
-
-    if (!codelet) {
-        jbpf_logger(JBPF_INFO, "jbpf_codelet_load: Make sure that the requested program exists\n");
-        return ret;
-    }
-
     struct jbpf_hook* hook;
 
     for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
         hook = jbpf_hook_list.jbpf_hook_p[i];
         if (hook == NULL)
             continue;
-        if (strcmp(codelet->hook_name, hook->name) == 0) {
-            ret =
-                jbpf_register_codelet_hook(hook, codelet->codelet_fn, codelet->e_runtime_threshold, codelet->priority);
-            if (ret != 0) {
-                jbpf_logger(JBPF_INFO, "Failed to register codelet %s to hook %s\n", codelet->name, hook->name);
-            } else {
-                jbpf_logger(JBPF_INFO, "Registered codelet %s to hook %s\n", codelet->name, hook->name);
-                codelet->loaded = true;
-            }
-            break;
+        if (strncmp(hook_name, hook->name, JBPF_HOOK_NAME_LEN) == 0) {
+            return hook;
         }
     }
+    return NULL;
+}
 
-    return ret;
+/* Stage the registration of a codelet to its hook. The codelet is loaded when the transaction is committed */
+static int
+jbpf_stage_load_codelet(struct jbpf_hook_txn* txn, struct jbpf_codelet* codelet)
+{
+    struct jbpf_hook* hook;
+
+    if (!codelet) {
+        jbpf_logger(JBPF_INFO, "jbpf_codelet_load: Make sure that the requested program exists\n");
+        return -1;
+    }
+
+    hook = jbpf_find_hook(codelet->hook_name);
+    if (!hook) {
+        jbpf_logger(JBPF_INFO, "Failed to find hook %s for codelet %s\n", codelet->hook_name, codelet->name);
+        return -1;
+    }
+
+    if (jbpf_hook_txn_add_sampled_codelet(
+            txn,
+            hook,
+            codelet->codelet_fn,
+            codelet->name,
+            codelet->e_runtime_threshold,
+            codelet->priority,
+            &codelet->sampling) != 0) {
+        return -1;
+    }
+    return jbpf_hook_txn_filter_codelet(txn, hook, codelet->codelet_fn, &codelet->filter);
 }
 
 static int
@@ -1064,6 +1265,55 @@ jbpf_unload_codelet(struct jbpf_codelet* codelet)
     return ret;
 }
 
+/* Find the loaded codelet of a codeletset that runs codelet_fn on a hook. Called with the LCM lock held */
+static struct jbpf_codelet*
+jbpf_find_loaded_codelet(const struct jbpf_hook* hook, jbpf_jit_fn codelet_fn)
+{
+    struct jbpf_ctx_t* __jbpf_ctx = jbpf_get_ctx();
+    ck_ht_iterator_t iterator = CK_HT_ITERATOR_INITIALIZER;
+    ck_ht_iterator_t codelet_iterator;
+    ck_ht_entry_t* cursor;
+    ck_ht_entry_t* codelet_cursor;
+    struct jbpf_codeletset* codeletset;
+    struct jbpf_codelet* codelet;
+
+    while (ck_ht_next(&__jbpf_ctx->codeletset_registry, &iterator, &cursor)) {
+        codeletset = (struct jbpf_codeletset*)ck_ht_entry_value(cursor);
+        ck_ht_iterator_init(&codelet_iterator);
+        while (ck_ht_next(&codeletset->codelets, &codelet_iterator, &codelet_cursor)) {
+            codelet = (struct jbpf_codelet*)ck_ht_entry_value(codelet_cursor);
+            if (codelet->loaded && codelet->codelet_fn == codelet_fn &&
+                strncmp(codelet->hook_name, hook->name, JBPF_HOOK_NAME_LEN) == 0) {
+                return codelet;
+            }
+        }
+    }
+    return NULL;
+}
+
+int
+jbpf_quarantine_codelet(struct jbpf_hook* hook, jbpf_jit_fn codelet_fn)
+{
+    struct jbpf_codelet* codelet;
+    int ret;
+
+    /* The maintenance thread does not wait for a codeletset to be loaded or unloaded, the codelet stays quarantined
+     * and is removed by the next check */
+    if (pthread_mutex_trylock(&lcm_mutex) != 0) {
+        return -1;
+    }
+
+    // A codelet registered to the hook directly rather than by the LCM is not in any codeletset
+    codelet = jbpf_find_loaded_codelet(hook, codelet_fn);
+    ret = jbpf_remove_codelet_hook(hook, codelet_fn);
+    if (ret == 0 && codelet) {
+        codelet->loaded = false;
+    }
+
+    pthread_mutex_unlock(&lcm_mutex);
+    return ret;
+}
+
 static struct jbpf_codelet*
 jbpf_create_codelet_from_files(
     struct jbpf_ctx_t* jbpf_ctx, struct jbpf_codeletset* codeletset, jbpf_codelet_descriptor_s* codelet_desc)
@@ -1443,26 +1693,15 @@ jbpf_codeletset_load(struct jbpf_codeletset_load_req* load_req, jbpf_codeletset_
         }
     }
 
-    // Load codelets to hook
+    // Stage the codelets and install them to their hooks at once, so that the codeletset is activated atomically
+    jbpf_hook_txn_init(&lcm_hook_txn);
     ck_ht_iterator_init(&iterator);
     while (ck_ht_next(&new_codeletset->codelets, &iterator, &cursor) == true) {
         struct jbpf_codelet* codelet;
         codelet = (struct jbpf_codelet*)ck_ht_entry_value(cursor);
-        status = jbpf_load_codelet(codelet);
-
-        if (status == 0) {
-            codelet->loaded = true;
-            // Load program
-            jbpf_logger(
-                JBPF_INFO, "----------------- %s: %s ----------------------\n", codelet->hook_name, codelet->name);
-            jbpf_logger(
-                JBPF_INFO,
-                "hook_name = %s, priority = %d, runtime_threshold = %ld\n",
-                codelet->hook_name,
-                codelet->priority,
-                codelet->e_runtime_threshold);
-            jbpf_logger(JBPF_INFO, "Codelet created and loaded successfully: %s\n", codelet->name);
-        } else {
+        status = jbpf_stage_load_codelet(&lcm_hook_txn, codelet);
+
+        if (status != 0) {
             char msg[JBPF_MAX_ERR_MSG_SIZE];
             sprintf(msg, "Failed at jbpf_load_codelet: %s\n", codelet->name);
             jbpf_logger(JBPF_ERROR, "%s\n", msg);
@@ -1470,8 +1709,40 @@ jbpf_codeletset_load(struct jbpf_codeletset_load_req* load_req, jbpf_codeletset_
             if (err) {
                 strcpy(err->err_msg, msg);
             }
-            break;
+            goto load_req_out;
+        }
+    }
+
+    if (jbpf_hook_txn_commit(&lcm_hook_txn) != 0) {
+        char msg[JBPF_MAX_ERR_MSG_SIZE];
+        sprintf(
+            msg, "Failed to load the codelets of codeletset %s to their hooks\n", new_codeletset->codeletset_id.name);
+        jbpf_logger(JBPF_ERROR, "%s\n", msg);
+        outcome = JBPF_CODELET_LOAD_FAIL;
+        if (err) {
+            strcpy(err->err_msg, msg);
         }
+        goto load_req_out;
+    }
+
+    ck_ht_iterator_init(&iterator);
+    while (ck_ht_next(&new_codeletset->codelets, &iterator, &cursor) == true) {
+        struct jbpf_codelet* codelet;
+        codelet = (struct jbpf_codelet*)ck_ht_entry_value(cursor);
+        codelet->loaded = true;
+        jbpf_logger(JBPF_INFO, "Registered codelet %s to hook %s\n", codelet->name, codelet->hook_name);
+        jbpf_logger(
+            JBPF_INFO, "----------------- %s: %s ----------------------\n", codelet->hook_name, codelet->name);
+        jbpf_logger(
+            JBPF_INFO,
+            "hook_name = %s, priority = %d, runtime_threshold = %ld, sampling = %u/%lu, filter conditions = %u\n",
+            codelet->hook_name,
+            codelet->priority,
+            codelet->e_runtime_threshold,
+            codelet->sampling.type,
+            (uint64_t)codelet->sampling.value,
+            codelet->filter.num_conditions);
+        jbpf_logger(JBPF_INFO, "Codelet created and loaded successfully: %s\n", codelet->name);
     }
 
 load_req_out:
@@ -1541,6 +1812,8 @@ jbpf_codeletset_unload(jbpf_codeletset_unload_req_s* unload_req, jbpf_codeletset
     struct jbpf_codelet* codelet;
     struct jbpf_codelet* codelet_list[JBPF_MAX_CODELETS_IN_CODELETSET];
     int num_codelets = 0;
+    struct jbpf_hook* hook;
+    bool staged = true;
     char msg[JBPF_MAX_ERR_MSG_SIZE];
 
     if (!unload_req) {
@@ -1574,15 +1847,39 @@ jbpf_codeletset_unload(jbpf_codeletset_unload_req_s* unload_req, jbpf_codeletset
 
     codeletset = (struct jbpf_codeletset*)ck_ht_entry_value(&codeletset_entry);
 
-    // Go over each codelet of the codeletset and unload and destroy them
+    // Go over each codelet of the codeletset and stage its removal from its hook
+    jbpf_hook_txn_init(&lcm_hook_txn);
     ck_ht_iterator_init(&iterator);
     while (ck_ht_next(&codeletset->codelets, &iterator, &cursor)) {
         codelet = (struct jbpf_codelet*)ck_ht_entry_value(cursor);
-        jbpf_unload_codelet(codelet);
+        if (codelet->loaded) {
+            hook = jbpf_find_hook(codelet->hook_name);
+            if (!hook || jbpf_hook_txn_remove_codelet(&lcm_hook_txn, hook, codelet->codelet_fn) != 0) {
+                staged = false;
+            }
+        }
         __jbpf_ctx->total_num_codelets--;
         codelet_list[num_codelets++] = codelet;
     }
 
+    // Remove all the codelets with a single grace period. If this fails, remove them one by one. The codelets that
+    // were quarantined are no longer loaded and were already removed from their hooks
+    if (!staged || jbpf_hook_txn_commit(&lcm_hook_txn) != 0) {
+        for (int codelet_idx = 0; codelet_idx < num_codelets; codelet_idx++) {
+            if (codelet_list[codelet_idx]->loaded) {
+                jbpf_unload_codelet(codelet_list[codelet_idx]);
+            }
+        }
+    } else {
+        for (int codelet_idx = 0; codelet_idx < num_codelets; codelet_idx++) {
+            if (codelet_list[codelet_idx]->loaded) {
+                jbpf_logger(JBPF_INFO, "Codelet %s removed successfully\n", codelet_list[codelet_idx]->name);
+            } else {
+                jbpf_logger(JBPF_INFO, "Codelet %s was quarantined\n", codelet_list[codelet_idx]->name);
+            }
+        }
+    }
+
     for (int codelet_idx = 0; codelet_idx < num_codelets; codelet_idx++) {
         jbpf_destroy_codelet(codelet_list[codelet_idx]);
     }
@@ -1609,10 +1906,14 @@ jbpf_agent_thread_start(void* arg)
 
     jbpf_register_thread();
 
+    /* The LCM thread does not call any hooks and blocks waiting for requests */
+    jbpf_thread_offline();
+
     ctx = jbpf_get_ctx();
 
     server_config.load_cb = jbpf_codeletset_load;
     server_config.unload_cb = jbpf_codeletset_unload;
+    server_config.trace_dump_cb = jbpf_trace_dump_request;
 
     snprintf(
         server_config.address.path,
@@ -1648,6 +1949,63 @@ out:
     return NULL;
 }
 
+/* Add the occupancy of the maps of the loaded codeletsets to the metrics, and publish a new snapshot */
+static void
+jbpf_update_metrics(void)
+{
+    ck_ht_iterator_t set_it, codelet_it, map_it;
+    ck_ht_entry_t *set_cursor, *codelet_cursor, *map_cursor;
+
+    if (!jbpf_metrics_enabled()) {
+        return;
+    }
+
+    /* The maps are left out of the snapshot if a codeletset is being loaded or unloaded, as they may be destroyed */
+    if (pthread_mutex_trylock(&lcm_mutex) == 0) {
+        ck_ht_iterator_init(&set_it);
+        while (ck_ht_next(&jbpf_ctx.codeletset_registry, &set_it, &set_cursor) == true) {
+            struct jbpf_codeletset* codeletset = (struct jbpf_codeletset*)ck_ht_entry_value(set_cursor);
+            ck_ht_iterator_init(&codelet_it);
+            while (ck_ht_next(&codeletset->codelets, &codelet_it, &codelet_cursor) == true) {
+                struct jbpf_codelet* codelet = (struct jbpf_codelet*)ck_ht_entry_value(codelet_cursor);
+                ck_ht_iterator_init(&map_it);
+                while (ck_ht_next(&codelet->maps, &map_it, &map_cursor) == true) {
+                    jbpf_metrics_add_map(
+                        codeletset->codeletset_id.name,
+                        codelet->name,
+                        (struct jbpf_map*)ck_ht_entry_value(map_cursor));
+                }
+            }
+        }
+        pthread_mutex_unlock(&lcm_mutex);
+    }
+
+    jbpf_metrics_publish();
+}
+
+static uint64_t
+jbpf_monotonic_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Send the next chunks of the streamed map snapshots. They are held back while a codeletset is being loaded or
+ * unloaded, as their maps may be destroyed */
+static void
+jbpf_stream_map_snapshots(void)
+{
+    if (!jbpf_map_snapshot_pending()) {
+        return;
+    }
+
+    if (pthread_mutex_trylock(&lcm_mutex) == 0) {
+        jbpf_map_snapshot_send(jbpf_find_codelet_map, jbpf_get_num_thread_slots(), jbpf_monotonic_time_ns());
+        pthread_mutex_unlock(&lcm_mutex);
+    }
+}
+
 /* Maintenance thread */
 static void*
 jbpf_maintenance_thread_start(void* arg)
@@ -1669,14 +2027,30 @@ jbpf_maintenance_thread_start(void* arg)
 
         if (jbpf_get_time_diff_ns(start, end) / 1000 > MAINTENANCE_CHECK_INTERVAL) {
             start = jbpf_measure_start_time();
-            jbpf_report_perf_stats();
+            jbpf_report_perf_stats_periodic();
+            jbpf_update_metrics();
         }
 
         hook_periodic_call(MAINTENANCE_MEM_CHECK_INTERVAL);
 
+        jbpf_maintenance();
+
+        jbpf_refine_tick_calibration();
+
+        jbpf_trace_maintenance();
+
+        jbpf_stream_map_snapshots();
+
+#ifdef JBPF_RUNTIME_BUDGETS
+        jbpf_enforce_runtime_budgets();
+#endif
+
         for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
             ck_epoch_poll(&epoch_record_list[i]);
         }
+#ifdef JBPF_QSBR
+        jbpf_qsbr_reclaim();
+#endif
         usleep(MAINTENANCE_MEM_CHECK_INTERVAL);
     }
     jbpf_cleanup_thread();
@@ -1796,6 +2170,12 @@ jbpf_get_ctx()
     return &jbpf_ctx;
 }
 
+int
+jbpf_get_num_thread_slots(void)
+{
+    return ck_pr_load_int(&jbpf_ctx.threads_info.num_thread_slots);
+}
+
 void
 jbpf_init_ebr(void)
 {
@@ -1804,12 +2184,17 @@ jbpf_init_ebr(void)
     for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
         ck_epoch_register(&ctx->epoch, &epoch_record_list[i], NULL);
     }
+    jbpf_qsbr_init();
 }
 
 void
 jbpf_cleanup_ebr(void)
 {
+#ifdef JBPF_QSBR
+    jbpf_qsbr_stop();
+#else
     jbpf_call_barrier();
+#endif
 }
 
 void
@@ -1841,22 +2226,26 @@ jbpf_generate_hook_list(void)
     iter = __start___jbpf_agent_hook_list;
 
     if (iter) {
-        for (; iter < __stop___jbpf_agent_hook_list; iter++)
+        for (; iter < __stop___jbpf_agent_hook_list; iter++) {
+            iter->id = index;
             jbpf_hook_list.jbpf_hook_p[index++] = iter;
+        }
     }
 
     iter = __start___hook_list;
 
     if (iter) {
-        for (; iter < __stop___hook_list; iter++)
+        for (; iter < __stop___hook_list; iter++) {
+            iter->id = index;
             jbpf_hook_list.jbpf_hook_p[index++] = iter;
+        }
     }
 }
 
 void
 jbpf_call_barrier()
 {
-    ck_epoch_barrier(e_record);
+    jbpf_ebr_barrier();
 }
 
 int
@@ -1942,6 +2331,7 @@ jbpf_init_threads_info(void)
 {
     struct jbpf_threads_info* thinfo = &jbpf_ctx.threads_info;
     jbpf_init_bitmap(&thinfo->registered_threads, JBPF_MAX_NUM_REG_THREADS);
+    thinfo->num_thread_slots = 0;
 }
 
 static void
@@ -1956,10 +2346,21 @@ register_jbpf_hook_thread(void)
 {
     struct jbpf_ctx_t* ctx = jbpf_get_ctx();
     struct jbpf_threads_info* thinfo = &ctx->threads_info;
+    int num_slots;
     __thread_id = jbpf_allocate_bit(&thinfo->registered_threads);
     if (__thread_id == -1)
         return false;
+    /* The copies of the per-thread maps that the aggregated reads go through */
+    do {
+        num_slots = ck_pr_load_int(&thinfo->num_thread_slots);
+    } while (num_slots <= __thread_id && !ck_pr_cas_int(&thinfo->num_thread_slots, num_slots, __thread_id + 1));
     e_record = &epoch_record_list[__thread_id];
+#ifdef JBPF_QSBR
+    jbpf_qsbr_thread_online(__thread_id);
+#endif
+    jbpf_deferred_register_thread(__thread_id);
+    jbpf_trace_register_thread(__thread_id);
+    jbpf_perf_counters_register_thread(__thread_id);
     return true;
 }
 
@@ -2149,6 +2550,46 @@ jbpf_init(struct jbpf_config* config)
 #else
     jbpf_logger(JBPF_INFO, "JBPF_EXPERIMENTAL_FEATURES = OFF\n");
 #endif
+#ifdef JBPF_HOOK_TRAMPOLINE
+    jbpf_logger(JBPF_INFO, "USE_JBPF_HOOK_TRAMPOLINE = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_HOOK_TRAMPOLINE = OFF\n");
+#endif
+#ifdef JBPF_QSBR
+    jbpf_logger(JBPF_INFO, "USE_JBPF_QSBR = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_QSBR = OFF\n");
+#endif
+#ifdef JBPF_CODELET_PERF_STATS
+    jbpf_logger(JBPF_INFO, "USE_JBPF_CODELET_PERF_STATS = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_CODELET_PERF_STATS = OFF\n");
+#endif
+#ifdef JBPF_RUNTIME_BUDGETS
+    jbpf_logger(JBPF_INFO, "USE_JBPF_RUNTIME_BUDGETS = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_RUNTIME_BUDGETS = OFF\n");
+#endif
+#ifdef JBPF_STATIC_KEYS
+    jbpf_logger(JBPF_INFO, "USE_JBPF_STATIC_KEYS = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_STATIC_KEYS = OFF\n");
+#endif
+#ifdef JBPF_DEFERRED_HOOKS
+    jbpf_logger(JBPF_INFO, "USE_JBPF_DEFERRED_HOOKS = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_DEFERRED_HOOKS = OFF\n");
+#endif
+#ifdef JBPF_PERF_COUNTERS
+    jbpf_logger(JBPF_INFO, "USE_JBPF_PERF_COUNTERS = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_PERF_COUNTERS = OFF\n");
+#endif
+#ifdef JBPF_TRACE
+    jbpf_logger(JBPF_INFO, "USE_JBPF_TRACE = ON\n");
+#else
+    jbpf_logger(JBPF_INFO, "USE_JBPF_TRACE = OFF\n");
+#endif
 
     struct jbpf_ctx_t* ctx = jbpf_get_ctx();
 
@@ -2156,6 +2597,9 @@ jbpf_init(struct jbpf_config* config)
     snprintf(jbpf_path_namespace, JBPF_PATH_NAMESPACE_LEN - 1, "%s/%s", config->jbpf_run_path, config->jbpf_namespace);
     jbpf_path_namespace[JBPF_PATH_NAMESPACE_LEN - 1] = '\0';
 
+    strncpy(ctx->jbpf_namespace, config->jbpf_namespace, JBPF_NAMESPACE_LEN - 1);
+    ctx->jbpf_namespace[JBPF_NAMESPACE_LEN - 1] = '\0';
+
     if (_jbpf_create_run_dir(ctx, jbpf_path_namespace) < 0) {
         jbpf_logger(JBPF_ERROR, "Failed to create run path for jbpf. Exiting...\n");
         return -1;
@@ -2167,6 +2611,8 @@ jbpf_init(struct jbpf_config* config)
 
     jbpf_generate_hook_list();
 
+    jbpf_static_key_init(jbpf_hook_list.jbpf_hook_p, jbpf_hook_list.num_hooks);
+
     if (jbpf_hook_list.num_hooks > MAX_NUM_HOOKS) {
         jbpf_logger(
             JBPF_ERROR,
@@ -2189,13 +2635,44 @@ jbpf_init(struct jbpf_config* config)
 
     /* Initialize perf structs of hooks */
     jbpf_init_perf();
+    jbpf_init_runtime_budgets(&config->runtime_budget_config);
 
     jbpf_init_threads_info();
 
+    if (jbpf_deferred_init(&config->deferred_config) != 0) {
+        ret = -1;
+        goto init_interfaces_error;
+    }
+
+    if (jbpf_perf_map_init(&config->perf_map_config) != 0) {
+        ret = -1;
+        jbpf_deferred_stop();
+        goto init_interfaces_error;
+    }
+
+    if (jbpf_trace_init(&config->trace_config) != 0) {
+        ret = -1;
+        jbpf_perf_map_stop();
+        jbpf_deferred_stop();
+        goto init_interfaces_error;
+    }
+
+    if (jbpf_metrics_init(config) != 0) {
+        ret = -1;
+        jbpf_trace_stop();
+        jbpf_perf_map_stop();
+        jbpf_deferred_stop();
+        goto init_interfaces_error;
+    }
+
     ret = start_jbpf_interfaces(config);
 
     if (ret) {
         ret = -3;
+        jbpf_metrics_stop();
+        jbpf_trace_stop();
+        jbpf_perf_map_stop();
+        jbpf_deferred_stop();
         goto init_interfaces_error;
     }
 
@@ -2212,13 +2689,41 @@ out_chan_error:
 void
 jbpf_maintenance()
 {
-    return;
+    jbpf_quiescent();
+}
+
+void
+jbpf_quiescent(void)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_quiescent(__thread_id);
+#endif
+}
+
+void
+jbpf_thread_offline(void)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_thread_offline(__thread_id);
+#endif
+}
+
+void
+jbpf_thread_online(void)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_thread_online(__thread_id);
+#endif
 }
 
 void
 jbpf_remove_hook_thread(void)
 {
     struct jbpf_threads_info* thinfo = &jbpf_ctx.threads_info;
+#ifdef JBPF_QSBR
+    jbpf_qsbr_thread_offline(__thread_id);
+#endif
+    jbpf_perf_counters_remove_thread(__thread_id);
     jbpf_free_bit(&thinfo->registered_threads, __thread_id);
 }
 
@@ -2241,10 +2746,18 @@ clear_all_jbpf_hooks(void)
 
     for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
         hook = jbpf_hook_list.jbpf_hook_p[i];
+        if (hook->trampoline != NULL) {
+            jbpf_hook_trampoline_destroy(hook->trampoline);
+            hook->trampoline = NULL;
+        }
         if (hook->codelets != NULL) {
+            for (int j = 0; hook->codelets[j].jbpf_codelet; j++) {
+                jbpf_codelet_perf_destroy(hook->codelets[j].perf);
+            }
             jbpf_free_mem(hook->codelets);
             hook->codelets = NULL;
         }
+        jbpf_hook_disable_call_sites(hook);
     }
 }
 
@@ -2285,8 +2798,23 @@ jbpf_stop()
     /* Remove all codelets from hooks */
     jbpf_remove_all_codeletsets(ctx);
 
+    /* No hook queues calls anymore, so the deferred hook workers can be stopped */
+    jbpf_deferred_stop();
+
+    /* All codelets are unloaded, so the perf map is empty */
+    jbpf_perf_map_stop();
+
     jbpf_stop_interfaces();
 
+    /* The maintenance and LCM threads, which dump the flight recorder, are stopped */
+    jbpf_trace_stop();
+
+    /* The maintenance thread, which publishes the metrics, is stopped */
+    jbpf_metrics_stop();
+
+    /* The maintenance thread, which streams the map snapshots, is stopped */
+    jbpf_map_snapshot_cleanup(ctx->io_ctx);
+
     jbpf_cleanup_thread();
 
     jbpf_stop_threads_info();
@@ -2328,11 +2856,100 @@ jbpf_send_input_msg(jbpf_io_stream_id_t* stream_id, void* data, size_t size)
     return jbpf_io_channel_send_msg(__jbpf_ctx->io_ctx, stream_id, data, size);
 }
 
+int
+jbpf_map_iterate_entries(
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    uint64_t* cursor,
+    void* data,
+    uint32_t max_size)
+{
+    struct jbpf_map* map;
+    int res;
+
+    /* The lock is only held for the call, so that the map is not destroyed while it is read */
+    pthread_mutex_lock(&lcm_mutex);
+    map = jbpf_find_codelet_map(codeletset_name, codelet_name, map_name);
+    if (!map) {
+        res = JBPF_MAP_ERROR;
+    } else if (
+        map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY || map->type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP ||
+        map->type == JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP) {
+        res = jbpf_bpf_map_iterate_per_thread(map, jbpf_get_num_thread_slots(), cursor, data, max_size);
+    } else {
+        res = jbpf_bpf_map_iterate(map, cursor, data, max_size);
+    }
+    pthread_mutex_unlock(&lcm_mutex);
+
+    return res;
+}
+
+int
+jbpf_map_snapshot_start(
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    const struct jbpf_map_snapshot_config* config)
+{
+    struct jbpf_map* map;
+    int res;
+
+    pthread_mutex_lock(&lcm_mutex);
+    map = jbpf_find_codelet_map(codeletset_name, codelet_name, map_name);
+    if (!map) {
+        jbpf_logger(JBPF_ERROR, "Map %s of codelet %s was not found\n", map_name, codelet_name);
+        res = -1;
+    } else {
+        res = jbpf_map_snapshot_add(
+            jbpf_get_io_ctx(), codeletset_name, codelet_name, map_name, map, config, jbpf_monotonic_time_ns());
+    }
+    pthread_mutex_unlock(&lcm_mutex);
+
+    return res;
+}
+
+int
+jbpf_map_snapshot_stop(const jbpf_io_stream_id_t* stream_id)
+{
+    return jbpf_map_snapshot_remove(jbpf_get_io_ctx(), stream_id);
+}
+
+int
+jbpf_map_get_mmap_name(
+    const char* codeletset_name, const char* codelet_name, const char* map_name, char* mem_name, size_t len)
+{
+    struct jbpf_map* map;
+    int res = -1;
+
+    if (!mem_name || len == 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&lcm_mutex);
+    map = jbpf_find_codelet_map(codeletset_name, codelet_name, map_name);
+    if (map && map->mmap && strlen(map->mmap->mmap_info.mem_name) < len) {
+        strcpy(mem_name, map->mmap->mmap_info.mem_name);
+        res = 0;
+    }
+    pthread_mutex_unlock(&lcm_mutex);
+
+    return res;
+}
+
+const struct jbpf_map_mmap_hdr*
+jbpf_map_mmap_attach(const char* mem_name, struct jbpf_mmap_info* mmap_info)
+{
+    struct jbpf_ctx_t* __jbpf_ctx = jbpf_get_ctx();
+
+    return jbpf_map_mmap_attach_path(__jbpf_ctx->jbpf_run_path, mem_name, mmap_info);
+}
+
 // test wrapper function
 struct jbpf_map*
 __jbpf_create_map(const char* name, const struct jbpf_load_map_def* map_def, const struct jbpf_map_io_def* io_def)
 {
-    return jbpf_create_map(name, map_def, io_def);
+    return jbpf_create_map(name, map_def, io_def, NULL);
 }
 
 // test wrapper function
@@ -48,6 +48,105 @@ extern _Thread_local ck_epoch_record_t* e_record;
         jbpf_helper_func_t function_cb;
     } jbpf_helper_func_def_t;
 
+#define JBPF_MAP_SNAPSHOT_DEFAULT_NUM_CHUNKS (64)
+
+/* Flags of the header of a snapshot chunk */
+#define JBPF_MAP_SNAPSHOT_LAST (1U << 0)
+#define JBPF_MAP_SNAPSHOT_ABORTED (1U << 1)
+
+    /**
+     * @brief Configuration of a streamed map snapshot
+     * @param stream_id The stream id of the output channel created for the snapshot
+     * @param chunk_size The maximum size of the entries of a chunk, of at least one entry (key_size + value_size)
+     * @param max_chunks_per_sec The maximum number of chunks sent per second, or 0 for no limit other than the space
+     * in the output channel
+     * @param num_chunks The number of chunks that the output channel holds. JBPF_MAP_SNAPSHOT_DEFAULT_NUM_CHUNKS if 0
+     * @ingroup jbpf_agent
+     */
+    struct jbpf_map_snapshot_config
+    {
+        jbpf_io_stream_id_t stream_id;
+        uint32_t chunk_size;
+        uint32_t max_chunks_per_sec;
+        uint32_t num_chunks;
+    };
+
+    /**
+     * @brief Header of a chunk of a streamed map snapshot. It is followed by num_entries entries, each the key
+     * followed by the value. The keys of the arrays are their uint32_t indexes. The entries of a per-thread map are
+     * sent once for each thread copy that holds them
+     * @param seq The sequence number of the chunk, from 0
+     * @param num_entries The number of entries of the chunk
+     * @param key_size The key size of the map
+     * @param value_size The value size of the map
+     * @param flags JBPF_MAP_SNAPSHOT_LAST for the last chunk of the snapshot, and JBPF_MAP_SNAPSHOT_ABORTED if the
+     * snapshot was aborted because the map was unloaded or could not be read
+     * @ingroup jbpf_agent
+     */
+    struct jbpf_map_snapshot_hdr
+    {
+        uint32_t seq;
+        uint32_t num_entries;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+#define JBPF_MAP_MMAP_MAGIC (0x4a424d4dU)
+#define JBPF_MAP_MMAP_VERSION (1U)
+
+/* Maximum length of the shared memory name of a JBPF_MAP_F_MMAPABLE map, "<namespace>_map_<id>" */
+#define JBPF_MAP_MMAP_NAME_LEN (64U)
+
+    /**
+     * @brief Header of the shared memory region of a JBPF_MAP_F_MMAPABLE map, in its first page. The values of the
+     * array of copy c (0 for a JBPF_MAP_TYPE_ARRAY, the thread id for a JBPF_MAP_TYPE_PER_THREAD_ARRAY) start at
+     * data_offset + c * copy_stride from the header, and are value_size bytes each
+     * @param magic JBPF_MAP_MMAP_MAGIC
+     * @param version JBPF_MAP_MMAP_VERSION
+     * @param map_type The type of the map
+     * @param value_size The value size of the map
+     * @param max_entries The number of values of each copy
+     * @param num_copies The number of copies of the array
+     * @param data_offset The offset of the first copy, a multiple of the page size
+     * @param copy_stride The distance between two copies, a multiple of the page size
+     * @param codeletset_name The name of the codeletset that created the map
+     * @param codelet_name The name of the codelet that created the map
+     * @param map_name The name of the map
+     * @ingroup jbpf_agent
+     */
+    struct jbpf_map_mmap_hdr
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t map_type;
+        uint32_t value_size;
+        uint32_t max_entries;
+        uint32_t num_copies;
+        uint64_t data_offset;
+        uint64_t copy_stride;
+        char codeletset_name[JBPF_CODELETSET_NAME_LEN];
+        char codelet_name[JBPF_CODELET_NAME_LEN];
+        char map_name[JBPF_MAP_NAME_LEN];
+    };
+
+    /**
+     * @brief Get the address of a value in the mapped region of a JBPF_MAP_F_MMAPABLE map
+     * @param hdr The header of the region
+     * @param copy The copy of the array, which is 0 unless the map is a JBPF_MAP_TYPE_PER_THREAD_ARRAY
+     * @param index The index of the value
+     * @return The address of the value, or NULL if the copy or the index is out of range
+     * @ingroup jbpf_agent
+     */
+    static inline const void*
+    jbpf_map_mmap_value(const struct jbpf_map_mmap_hdr* hdr, uint32_t copy, uint32_t index)
+    {
+        if (copy >= hdr->num_copies || index >= hdr->max_entries)
+            return NULL;
+        return (const uint8_t*)hdr + hdr->data_offset + copy * hdr->copy_stride + (uint64_t)index * hdr->value_size;
+    }
+
     /**
      * @brief Initializes jbpf using default config parameters.
      *
@@ -97,6 +196,42 @@ extern _Thread_local ck_epoch_record_t* e_record;
     void
     jbpf_maintenance(void);
 
+    /**
+     * @brief Announce that the calling thread is in a quiescent state
+     *
+     * A thread is in a quiescent state when it is not executing any jbpf hook. When jbpf is built with
+     * USE_JBPF_QSBR, hooks do not use any synchronization primitive, and loading or unloading codelets
+     * waits until every online registered thread has called this function (or jbpf_maintenance()).
+     * It should be called periodically from each thread that is calling jbpf hooks, e.g. once per processing loop.
+     * Without USE_JBPF_QSBR, this function does nothing.
+     *
+     * @ingroup jbpf_agent
+     */
+    void
+    jbpf_quiescent(void);
+
+    /**
+     * @brief Mark the calling thread as offline
+     *
+     * An offline thread is not waited for when codelets are loaded or unloaded and must not call any jbpf hook
+     * until jbpf_thread_online() is called. This should be used before a registered thread blocks for a long time.
+     * Without USE_JBPF_QSBR, this function does nothing.
+     *
+     * @ingroup jbpf_agent
+     */
+    void
+    jbpf_thread_offline(void);
+
+    /**
+     * @brief Mark the calling thread as online again, after a call to jbpf_thread_offline()
+     *
+     * Without USE_JBPF_QSBR, this function does nothing.
+     *
+     * @ingroup jbpf_agent
+     */
+    void
+    jbpf_thread_online(void);
+
     /**
      * @brief Initializes threads that will be used to call jbpf hooks.
      *
@@ -197,6 +332,155 @@ extern _Thread_local ck_epoch_record_t* e_record;
     int
     jbpf_send_input_msg(jbpf_io_stream_id_t* stream_id, void* data, size_t size);
 
+    /**
+     * @brief Dump the flight recorder of the registered threads to a file
+     *
+     * The file holds the latest codelet invocations of each thread, with the names of the hooks and the codelets.
+     * It can be decoded with jbpf_trace_decoder. Only available when jbpf is built with USE_JBPF_TRACE.
+     *
+     * @param path The path of the dump file
+     * @return int 0 if the dump was written, -1 otherwise
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_trace_dump(const char* path);
+
+    /**
+     * @brief Copy the next entries of a map of a loaded codelet, a bounded number per call, without holding any
+     * lock between two calls. The entries are copied as by jbpf_map_dump(), the key followed by the value, and the
+     * keys of the arrays are their uint32_t indexes. The entries of a per-thread map are returned once for each
+     * thread copy that holds them. The iteration is weakly consistent: the entries added or deleted during the
+     * iteration may or may not be returned, and an entry that is in the map for the whole iteration is returned once,
+     * unless its bucket chain was returned in part by a call and updated before the next one, in which case it may be
+     * returned twice or missed
+     * @param codeletset_name The name of the codeletset
+     * @param codelet_name The name of a codelet of the codeletset that is linked to the map
+     * @param map_name The name of the map
+     * @param cursor The position of the iteration, set to 0 to start. It is updated with the position to resume
+     * from, or set back to 0 once all the entries have been returned
+     * @param data The buffer of the entries
+     * @param max_size The size of the buffer, of at least one entry
+     * @return int The number of entries copied, -1 if the map is not found, does not hold entries or the buffer is
+     * too small, and -2 if the map is busy, in which case the cursor is left unchanged and the call can be retried
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_iterate_entries(
+        const char* codeletset_name,
+        const char* codelet_name,
+        const char* map_name,
+        uint64_t* cursor,
+        void* data,
+        uint32_t max_size);
+
+    /**
+     * @brief Stream a snapshot of a map of a loaded codelet to a new output channel. The entries are sent by the
+     * maintenance thread in chunks of a struct jbpf_map_snapshot_hdr followed by the entries, at the rate set in the
+     * configuration. A full channel holds the snapshot back until it has space again. The snapshot is weakly
+     * consistent, as jbpf_map_iterate_entries(), and is aborted if the map is unloaded before it completes
+     * @param codeletset_name The name of the codeletset
+     * @param codelet_name The name of a codelet of the codeletset that is linked to the map
+     * @param map_name The name of the map
+     * @param config The configuration of the snapshot
+     * @return int 0 if the snapshot was started, -1 otherwise
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_snapshot_start(
+        const char* codeletset_name,
+        const char* codelet_name,
+        const char* map_name,
+        const struct jbpf_map_snapshot_config* config);
+
+    /**
+     * @brief Stop a streamed map snapshot, complete or not, and destroy its output channel
+     * @param stream_id The stream id of the snapshot
+     * @return int 0 if the snapshot was stopped, -1 if there is no snapshot with this stream id
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_snapshot_stop(const jbpf_io_stream_id_t* stream_id);
+
+    /**
+     * @brief Get the name of the shared memory region of a JBPF_MAP_F_MMAPABLE map of a loaded codelet, to be
+     * passed to jbpf_map_mmap_attach()
+     * @param codeletset_name The name of the codeletset
+     * @param codelet_name The name of a codelet of the codeletset that is linked to the map
+     * @param map_name The name of the map
+     * @param mem_name The buffer of the name, of JBPF_MAP_MMAP_NAME_LEN bytes
+     * @param len The size of the buffer
+     * @return int 0 on success, -1 if the map is not found or was not created with JBPF_MAP_F_MMAPABLE
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_get_mmap_name(
+        const char* codeletset_name, const char* codelet_name, const char* map_name, char* mem_name, size_t len);
+
+    /**
+     * @brief Get the name of the shared memory region of a JBPF_MAP_F_MMAPABLE map of a loaded codelet from the run
+     * path of an agent, to be passed to jbpf_map_mmap_attach_path(). Unlike jbpf_map_get_mmap_name(), it does not
+     * need an initialized agent, so it can be called by an IPC secondary
+     * @param run_path The "<run_path>/<namespace>" directory of the agent
+     * @param codeletset_name The name of the codeletset
+     * @param codelet_name The name of a codelet of the codeletset that is linked to the map
+     * @param map_name The name of the map
+     * @param mem_name The buffer of the name, of JBPF_MAP_MMAP_NAME_LEN bytes
+     * @param len The size of the buffer
+     * @return int 0 on success, -1 if the map is not found or was not created with JBPF_MAP_F_MMAPABLE
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_mmap_find(
+        const char* run_path,
+        const char* codeletset_name,
+        const char* codelet_name,
+        const char* map_name,
+        char* mem_name,
+        size_t len);
+
+    /**
+     * @brief Map read-only the shared memory region of a JBPF_MAP_F_MMAPABLE map. The values are read without any
+     * synchronization with the codelets that update them, and the mapping stays valid after the map is unloaded,
+     * until it is detached
+     * @param mem_name The name of the region, as returned by jbpf_map_get_mmap_name()
+     * @param mmap_info The descriptor of the mapping, to be passed to jbpf_map_mmap_detach()
+     * @return The header of the region, or NULL if the region does not exist or is not the region of a map
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    const struct jbpf_map_mmap_hdr*
+    jbpf_map_mmap_attach(const char* mem_name, struct jbpf_mmap_info* mmap_info);
+
+    /**
+     * @brief Map read-only the shared memory region of a JBPF_MAP_F_MMAPABLE map of the agent with a given run path,
+     * as jbpf_map_mmap_attach() does for the agent of the process. It does not need an initialized agent, so it can
+     * be called by an IPC secondary
+     * @param run_path The "<run_path>/<namespace>" directory of the agent
+     * @param mem_name The name of the region, as returned by jbpf_map_mmap_find()
+     * @param mmap_info The descriptor of the mapping, to be passed to jbpf_map_mmap_detach()
+     * @return The header of the region, or NULL if the region does not exist or is not the region of a map
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    const struct jbpf_map_mmap_hdr*
+    jbpf_map_mmap_attach_path(const char* run_path, const char* mem_name, struct jbpf_mmap_info* mmap_info);
+
+    /**
+     * @brief Unmap a region mapped with jbpf_map_mmap_attach() or jbpf_map_mmap_attach_path()
+     * @param mmap_info The descriptor of the mapping
+     * @return int 0 on success, -1 otherwise
+     * @ingroup jbpf_agent
+     * @ingroup core
+     */
+    int
+    jbpf_map_mmap_detach(struct jbpf_mmap_info* mmap_info);
+
     /**
      * @defgroup jbpf_agent   jbpf Agent API
      * API to interact with a jbpf agent
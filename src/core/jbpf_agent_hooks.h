@@ -9,6 +9,8 @@
 /**
  * @brief Declare a jbpf hook: report_stats
  * @note This is called internally by the jbpf library to collect stats about the loaded codelets and their runtime.
+ * @note The context points to a struct jbpf_perf_hook_list of about 270KB with the default JBPF_MAX_NUM_HOOKS and
+ * JBPF_MAX_NUM_PERF_CODELETS build options, which bound its size.
  * @ingroup hooks
  * @ingroup core
  */
@@ -35,4 +37,18 @@ DECLARE_JBPF_HOOK(
     HOOK_PROTO(uint32_t meas_period),
     HOOK_ASSIGN(ctx.meas_period = meas_period; ctx.data = (uint64_t)(void*)NULL; ctx.data_end = (uint64_t)(void*)NULL;))
 
+/**
+ * @brief Declare a jbpf hook: codelet_quarantined
+ * @note This is called by the maintenance thread when a codelet is removed from its hook because it exceeded its
+ * runtime threshold too many times within a budget window (see USE_JBPF_RUNTIME_BUDGETS).
+ * @ingroup hooks
+ * @ingroup core
+ */
+DECLARE_JBPF_HOOK(
+    codelet_quarantined,
+    struct jbpf_generic_ctx ctx,
+    ctx,
+    HOOK_PROTO(struct jbpf_codelet_quarantine_event* event),
+    HOOK_ASSIGN(ctx.data = (uint64_t)(void*)event; ctx.data_end = (uint64_t)(void*)(event + 1);))
+
 #endif
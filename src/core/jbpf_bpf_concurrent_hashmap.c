@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "jbpf_bpf_concurrent_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap_int.h"
+#include "jbpf_memory.h"
+#include "jbpf_int.h"
+#include "jbpf_utils.h"
+
+void*
+jbpf_bpf_concurrent_hashmap_create(const struct jbpf_load_map_def* map_def)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+    unsigned int num_buckets;
+    unsigned int value_offset;
+
+    if (!map_def || map_def->max_entries == 0 || map_def->key_size == 0 || map_def->value_size == 0)
+        return NULL;
+
+    hmap = jbpf_calloc_mem(1, sizeof(jbpf_concurrent_hashmap_t));
+
+    if (!hmap)
+        return NULL;
+
+    /* The values are aligned, so that codelets can access them with atomic operations */
+    value_offset = round_up(map_def->key_size, (uint32_t)sizeof(uint64_t));
+
+    hmap->key_size = map_def->key_size;
+    hmap->value_size = map_def->value_size;
+    hmap->max_entries = map_def->max_entries;
+    hmap->value_offset = value_offset;
+
+    /* At least one bucket per entry, so that most of the writers do not contend for the same bucket */
+    num_buckets = round_up_pow_of_two(map_def->max_entries);
+    hmap->bucket_mask = num_buckets - 1;
+    hmap->buckets = jbpf_calloc_mem(num_buckets, sizeof(struct jbpf_concurrent_hbucket));
+    if (!hmap->buckets) {
+        jbpf_free_mem(hmap);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < num_buckets; i++) {
+        ck_spinlock_init(&hmap->buckets[i].lock);
+    }
+
+    /* The nodes are preallocated. Updates of existing keys reuse their node, but the nodes of deleted keys are only
+     * reclaimed after a grace period, so twice the entries are kept for keys that are deleted and added again */
+    hmap->mempool = jbpf_init_data_mempool(
+        map_def->max_entries * 2, sizeof(struct jbpf_concurrent_hnode) + value_offset + map_def->value_size);
+    if (!hmap->mempool) {
+        jbpf_free_mem(hmap->buckets);
+        jbpf_free_mem(hmap);
+        return NULL;
+    }
+
+    return hmap;
+}
+
+void
+jbpf_bpf_concurrent_hashmap_destroy(struct jbpf_map* map)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+
+    if (!map)
+        return;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+
+    /* Wait for the nodes waiting for a grace period to be returned to the mempool */
+    jbpf_call_barrier();
+
+    jbpf_destroy_data_mempool(hmap->mempool);
+    jbpf_free_mem(hmap->buckets);
+    jbpf_free_mem(hmap);
+}
@@ -0,0 +1,396 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_CONCURRENT_HASHMAP_H
+#define JBPF_BPF_CONCURRENT_HASHMAP_H
+
+#include <string.h>
+
+#include "ck_pr.h"
+
+#include "jbpf_bpf_concurrent_hashmap_int.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_defs.h"
+#include "jbpf_memory.h"
+#include "jbpf_int.h"
+#include "jbpf_qsbr.h"
+
+#include "jbpf_lookup3.h"
+
+typedef struct jbpf_bpf_concurrent_hashmap jbpf_concurrent_hashmap_t;
+
+/**
+ * @brief Create a new concurrent bpf hashmap
+ * @param map_def The map definition
+ * @return The hashmap
+ * @ingroup core
+ */
+void*
+jbpf_bpf_concurrent_hashmap_create(const struct jbpf_load_map_def* map_def);
+
+/**
+ * @brief Destroy a concurrent bpf hashmap
+ * @param map The map to destroy
+ * @ingroup core
+ */
+void
+jbpf_bpf_concurrent_hashmap_destroy(struct jbpf_map* map);
+
+/**
+ * @brief Free a node of a concurrent hashmap, once no reader can access it
+ * @param e The epoch entry of the node
+ * @ingroup core
+ */
+static inline void
+jbpf_bpf_concurrent_hnode_free(ck_epoch_entry_t* e)
+{
+    jbpf_free_data_mem(e);
+}
+
+static inline __attribute__((always_inline)) uint32_t
+jbpf_bpf_concurrent_hashmap_hash(const void* key, size_t key_size)
+{
+    return hashlittle(key, key_size, 6602834);
+}
+
+static inline __attribute__((always_inline)) uint8_t*
+jbpf_bpf_concurrent_hnode_key(struct jbpf_concurrent_hnode* node)
+{
+    return (uint8_t*)(node + 1);
+}
+
+static inline __attribute__((always_inline)) uint8_t*
+jbpf_bpf_concurrent_hnode_value(const jbpf_concurrent_hashmap_t* hmap, struct jbpf_concurrent_hnode* node)
+{
+    return (uint8_t*)(node + 1) + hmap->value_offset;
+}
+
+/* Copy the value of a node, retrying if a writer overwrites it during the copy */
+static inline __attribute__((always_inline)) void
+jbpf_bpf_concurrent_hnode_read_value(
+    const jbpf_concurrent_hashmap_t* hmap, struct jbpf_concurrent_hnode* node, void* value)
+{
+    unsigned int version;
+
+    do {
+        version = ck_sequence_read_begin(&node->seq);
+        memcpy(value, jbpf_bpf_concurrent_hnode_value(hmap, node), hmap->value_size);
+    } while (ck_sequence_read_retry(&node->seq, version));
+}
+
+/* Find the node of a key in a bucket. Safe without the lock of the bucket: the nodes are published after they are
+ * initialized, and unlinked nodes keep pointing to the rest of the chain until they are reclaimed */
+static inline __attribute__((always_inline)) struct jbpf_concurrent_hnode*
+jbpf_bpf_concurrent_hashmap_find(
+    const jbpf_concurrent_hashmap_t* hmap, struct jbpf_concurrent_hbucket* bucket, uint32_t hash, const void* key)
+{
+    struct jbpf_concurrent_hnode* node;
+
+    node = ck_pr_load_ptr(&bucket->head);
+    while (node) {
+        ck_pr_fence_load_depends();
+        if (node->hash == hash && memcmp(jbpf_bpf_concurrent_hnode_key(node), key, hmap->key_size) == 0) {
+            return node;
+        }
+        node = ck_pr_load_ptr(&node->next);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Get the number of elements of the concurrent hashmap
+ * @param map The map
+ * @return The number of elements. Unlike JBPF_MAP_TYPE_HASHMAP, the map is never busy
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_concurrent_hashmap_size(const struct jbpf_map* map)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+
+    if (!map)
+        return 0;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    return ck_pr_load_uint(&hmap->count);
+}
+
+/**
+ * @brief Lookup an element in the concurrent bpf hashmap
+ * @param map The map
+ * @param key The key
+ * @note thread-safe: yes, wait-free
+ * @return The value of the element
+ * Possible return values:
+ * - NULL: Element not found or the map is NULL
+ * - void*: The element
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_concurrent_hashmap_lookup_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+    struct jbpf_concurrent_hnode* node;
+    uint32_t hash;
+
+    if (!map || !key)
+        return NULL;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    hash = jbpf_bpf_concurrent_hashmap_hash(key, hmap->key_size);
+
+    node = jbpf_bpf_concurrent_hashmap_find(hmap, &hmap->buckets[hash & hmap->bucket_mask], hash, key);
+    if (!node)
+        return NULL;
+
+    return jbpf_bpf_concurrent_hnode_value(hmap, node);
+}
+
+/**
+ * @brief Reset an element in the concurrent bpf hashmap
+ * @param map The map
+ * @param key The key
+ * @return The value of the element
+ * Possible return values:
+ * - NULL: Element not found or the map is NULL
+ * - void*: The element
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_concurrent_hashmap_reset_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+    void* value;
+
+    value = jbpf_bpf_concurrent_hashmap_lookup_elem(map, key);
+    if (!value)
+        return NULL;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    memset(value, 0, hmap->value_size);
+    return value;
+}
+
+/* Update an element of the concurrent hashmap, with the hash of the key computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_concurrent_hashmap_update_hashed(
+    jbpf_concurrent_hashmap_t* hmap, const void* key, const void* value, uint32_t hash)
+{
+    struct jbpf_concurrent_hbucket* bucket;
+    struct jbpf_concurrent_hnode* node;
+
+    bucket = &hmap->buckets[hash & hmap->bucket_mask];
+
+    ck_spinlock_lock(&bucket->lock);
+
+    for (node = bucket->head; node; node = node->next) {
+        if (node->hash == hash && memcmp(jbpf_bpf_concurrent_hnode_key(node), key, hmap->key_size) == 0)
+            break;
+    }
+
+    /* The value of an existing key is overwritten in place, so updating it never needs a node from the mempool */
+    if (node) {
+        ck_sequence_write_begin(&node->seq);
+        memcpy(jbpf_bpf_concurrent_hnode_value(hmap, node), value, hmap->value_size);
+        ck_sequence_write_end(&node->seq);
+        ck_spinlock_unlock(&bucket->lock);
+        return JBPF_MAP_SUCCESS;
+    }
+
+    if (ck_pr_faa_uint(&hmap->count, 1) >= hmap->max_entries) {
+        ck_pr_dec_uint(&hmap->count);
+        ck_spinlock_unlock(&bucket->lock);
+        return JBPF_MAP_FULL;
+    }
+
+    node = jbpf_alloc_data_mem(hmap->mempool);
+    if (!node) {
+        ck_pr_dec_uint(&hmap->count);
+        ck_spinlock_unlock(&bucket->lock);
+        return JBPF_MAP_ERROR;
+    }
+
+    node->hash = hash;
+    ck_sequence_init(&node->seq);
+    memcpy(jbpf_bpf_concurrent_hnode_key(node), key, hmap->key_size);
+    memcpy(jbpf_bpf_concurrent_hnode_value(hmap, node), value, hmap->value_size);
+    node->next = bucket->head;
+
+    ck_pr_fence_store();
+    ck_pr_store_ptr(&bucket->head, node);
+
+    ck_spinlock_unlock(&bucket->lock);
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Update an element in the concurrent bpf hashmap
+ * @param map The map
+ * @param key The key
+ * @param value The value
+ * @param flags The flags (currently not used)
+ * @return The status of the operation
+ * Possible return values:
+ * - JBPF_MAP_SUCCESS: Success
+ * - JBPF_MAP_FULL: The map is full
+ * - JBPF_MAP_ERROR: Error
+ * @note thread-safe: yes. Writers only serialize with the writers of the same bucket. The value of an existing key is
+ * overwritten in place: codelets that read it through a pointer returned by a lookup may see a partially written
+ * value, while the copies made by the host application never do
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_concurrent_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+
+    if (!map || !key || !value)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    return jbpf_bpf_concurrent_hashmap_update_hashed(
+        hmap, key, value, jbpf_bpf_concurrent_hashmap_hash(key, hmap->key_size));
+}
+
+/* Delete an element of the concurrent hashmap, with the hash of the key computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_concurrent_hashmap_delete_hashed(jbpf_concurrent_hashmap_t* hmap, const void* key, uint32_t hash)
+{
+    struct jbpf_concurrent_hbucket* bucket;
+    struct jbpf_concurrent_hnode *node, **prev;
+
+    bucket = &hmap->buckets[hash & hmap->bucket_mask];
+
+    ck_spinlock_lock(&bucket->lock);
+
+    for (prev = &bucket->head; (node = *prev) != NULL; prev = &node->next) {
+        if (node->hash == hash && memcmp(jbpf_bpf_concurrent_hnode_key(node), key, hmap->key_size) == 0)
+            break;
+    }
+
+    if (node) {
+        /* The node keeps pointing to the rest of the chain for the readers that are still on it */
+        ck_pr_store_ptr(prev, node->next);
+        ck_pr_dec_uint(&hmap->count);
+    }
+
+    ck_spinlock_unlock(&bucket->lock);
+
+    if (!node)
+        return JBPF_MAP_ERROR;
+
+    jbpf_ebr_call(&node->epoch_entry, jbpf_bpf_concurrent_hnode_free);
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Delete an element in the concurrent bpf hashmap
+ * @param map The map
+ * @param key The key
+ * @note thread-safe: yes
+ * @return The status of the operation
+ * Possible return values:
+ * - JBPF_MAP_SUCCESS: Success
+ * - JBPF_MAP_ERROR: Element not found or error
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_concurrent_hashmap_delete_elem(struct jbpf_map* map, const void* key)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+
+    if (!map || !key)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    return jbpf_bpf_concurrent_hashmap_delete_hashed(hmap, key, jbpf_bpf_concurrent_hashmap_hash(key, hmap->key_size));
+}
+
+/**
+ * @brief Clear the concurrent bpf hashmap
+ * @param map The map
+ * @return JBPF_MAP_SUCCESS on success.
+ * Possible return values:
+ * - JBPF_MAP_SUCCESS: Success
+ * - JBPF_MAP_ERROR: Error
+ * @note The buckets are cleared one at a time, so elements added to other buckets during the clear are kept
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_concurrent_hashmap_clear(const struct jbpf_map* map)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+    struct jbpf_concurrent_hbucket* bucket;
+    struct jbpf_concurrent_hnode *node, *next;
+
+    if (!map)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+
+    for (unsigned int i = 0; i <= hmap->bucket_mask; i++) {
+        bucket = &hmap->buckets[i];
+        if (!ck_pr_load_ptr(&bucket->head))
+            continue;
+
+        ck_spinlock_lock(&bucket->lock);
+        node = bucket->head;
+        ck_pr_store_ptr(&bucket->head, NULL);
+        ck_spinlock_unlock(&bucket->lock);
+
+        for (; node; node = next) {
+            next = node->next;
+            ck_pr_dec_uint(&hmap->count);
+            jbpf_ebr_call(&node->epoch_entry, jbpf_bpf_concurrent_hnode_free);
+        }
+    }
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Dump the concurrent bpf hashmap
+ * @param map The map
+ * @param data The data buffer
+ * @param max_size The maximum size of the buffer
+ * @param flags The flags (currently not used)
+ * @return The number of elements copied to the buffer, or 0 if the elements of the map do not fit in the buffer
+ * @note The elements are read without locking, so elements that are updated during the dump may be missed
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_concurrent_hashmap_dump(const struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flags)
+{
+    jbpf_concurrent_hashmap_t* hmap;
+    struct jbpf_concurrent_hnode* node;
+    uint8_t* dataptr = data;
+    uint32_t elem_size;
+    unsigned int count = 0;
+
+    if (!map || !data)
+        return 0;
+
+    hmap = (jbpf_concurrent_hashmap_t*)map->data;
+    elem_size = hmap->key_size + hmap->value_size;
+
+    if ((uint64_t)ck_pr_load_uint(&hmap->count) * elem_size > max_size)
+        return 0;
+
+    for (unsigned int i = 0; i <= hmap->bucket_mask; i++) {
+        for (node = ck_pr_load_ptr(&hmap->buckets[i].head); node; node = ck_pr_load_ptr(&node->next)) {
+            ck_pr_fence_load_depends();
+            /* Elements may have been added since the size was checked */
+            if ((count + 1) * elem_size > max_size)
+                return count;
+            memcpy(dataptr, jbpf_bpf_concurrent_hnode_key(node), hmap->key_size);
+            dataptr += hmap->key_size;
+            jbpf_bpf_concurrent_hnode_read_value(hmap, node, dataptr);
+            dataptr += hmap->value_size;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_CONCURRENT_HASHMAP_INT_H
+#define JBPF_BPF_CONCURRENT_HASHMAP_INT_H
+
+#include <stdint.h>
+
+#include "ck_epoch.h"
+#include "ck_sequence.h"
+#include "ck_spinlock.h"
+
+#include "jbpf_memory.h"
+
+/* An entry of the map. The key and the value are stored after the node, the value at offset value_offset. The value
+ * of an existing key is overwritten in place, with the lock of the bucket held. seq lets the copies of the value made
+ * by the host application retry if the value was overwritten meanwhile */
+struct jbpf_concurrent_hnode
+{
+    ck_epoch_entry_t epoch_entry;
+    struct jbpf_concurrent_hnode* next;
+    uint32_t hash;
+    ck_sequence_t seq;
+};
+
+/* The lock of a bucket is only taken by the writers of the bucket. Readers walk the chain without locking */
+struct jbpf_concurrent_hbucket
+{
+    struct jbpf_concurrent_hnode* head;
+    ck_spinlock_t lock;
+};
+
+struct jbpf_bpf_concurrent_hashmap
+{
+    unsigned int key_size;
+    unsigned int value_size;
+    unsigned int max_entries;
+    unsigned int value_offset;
+    unsigned int bucket_mask;
+    unsigned int count;
+    struct jbpf_concurrent_hbucket* buckets;
+    jbpf_mempool_ctx_t* mempool;
+};
+
+#endif
@@ -11,6 +11,7 @@
 
 #include "jbpf.h"
 #include "jbpf_int.h"
+#include "jbpf_qsbr.h"
 
 typedef struct jbpf_bpf_hashmap jbpf_hashmap_t;
 
@@ -52,6 +53,7 @@ jbpf_bpf_hashmap_destroy(struct jbpf_map* map);
 /**
  * @brief Get the size of the hashmap
  * @param map The map
+ * @note thread-safe: yes. The lock of the map is not taken, so the size may be stale while the map is updated
  * @return The size of the hashmap
  * @ingroup core
  */
@@ -64,13 +66,7 @@ jbpf_bpf_hashmap_size(const struct jbpf_map* map)
         return 0;
 
     hmap = (jbpf_hashmap_t*)map->data;
-
-    if (ck_spinlock_trylock(&hmap->lock)) {
-        unsigned int count = ck_ht_count(&hmap->ht);
-        ck_spinlock_unlock(&hmap->lock);
-        return count;
-    }
-    return JBPF_MAP_BUSY;
+    return ck_pr_load_uint(&hmap->count);
 }
 
 /**
@@ -106,9 +102,10 @@ jbpf_bpf_hashmap_clear(const struct jbpf_map* map)
             key = ck_ht_entry_key(cursor);
             value = ck_ht_entry_value(cursor);
             ck_ht_hash(&h, &hmap->ht, key, hmap->key_size);
-            ck_epoch_call_strict(e_record, (ck_epoch_entry_t*)value, free_hnode);
+            jbpf_ebr_call((ck_epoch_entry_t*)value, free_hnode);
             ck_ht_remove_spmc(&hmap->ht, h, cursor);
         }
+        ck_pr_store_uint(&hmap->count, ck_ht_count(&hmap->ht));
 
         ck_spinlock_unlock(&hmap->lock);
     } else {
@@ -240,58 +237,29 @@ jbpf_bpf_hashmap_reset_elem(const struct jbpf_map* map, const void* key)
     }
 }
 
-/**
- * @brief Update an element in the bpf hashmap
- * @param map The map
- * @param key The key
- * @param value The value
- * @param flags The flags
- * @return The status of the operation
- * Possible return values:
- * - JBPF_MAP_SUCCESS: Success
- * - JBPF_MAP_BUSY: The map is busy
- * - JBPF_MAP_FULL: The map is full
- * - JBPF_MAP_ERROR: Error
- * @ingroup core
- */
-#pragma message("WARNING: Hashmap update functionality using flags is not implemented yet")
+/* Update an element of the bpf hashmap, with the lock of the map held and the hash of the key computed */
 static inline __attribute__((always_inline)) int
-jbpf_bpf_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+jbpf_bpf_hashmap_update_locked(jbpf_hashmap_t* hmap, const void* key, void* value, ck_ht_hash_t h)
 {
-
-    jbpf_hashmap_t* hmap;
     ck_ht_entry_t entry;
-    ck_ht_hash_t h;
     uint8_t* val;
     bool found = false;
     void *key_e, *val_e;
     void* ret_val;
-    int res = 0;
-
-    if (!map || !key || !value)
-        return JBPF_MAP_ERROR;
-
-    hmap = (jbpf_hashmap_t*)map->data;
-
-    if (!ck_spinlock_trylock(&hmap->lock)) {
-        return -JBPF_MAP_BUSY;
-    }
 
     val = jbpf_alloc_data_mem(hmap->mempool);
 
     if (!val) {
-        res = JBPF_MAP_ERROR;
-        goto out;
+        return JBPF_MAP_ERROR;
     }
 
-    ck_ht_hash(&h, &hmap->ht, key, hmap->key_size);
     ck_ht_entry_key_set(&entry, key, hmap->key_size);
 
     found = ck_ht_get_spmc(&hmap->ht, h, &entry);
 
     if (!found && ck_ht_count(&hmap->ht) == hmap->max_entries) {
-        res = JBPF_MAP_FULL;
-        goto out;
+        jbpf_free_data_mem(val);
+        return JBPF_MAP_FULL;
     }
 
     key_e = val + sizeof(ck_epoch_entry_t);
@@ -300,7 +268,6 @@ jbpf_bpf_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value,
     memcpy(key_e, key, hmap->key_size);
     memcpy(val_e, value, hmap->value_size);
 
-    ck_ht_hash(&h, &hmap->ht, key_e, hmap->key_size);
     ck_ht_entry_set(&entry, h, key_e, hmap->key_size, val);
 
     ck_ht_set_spmc(&hmap->ht, h, &entry);
@@ -308,16 +275,73 @@ jbpf_bpf_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value,
     ret_val = ck_ht_entry_value(&entry);
 
     if (ret_val && ret_val != val) {
-        ck_epoch_call_strict(e_record, (ck_epoch_entry_t*)ret_val, free_hnode);
+        jbpf_ebr_call((ck_epoch_entry_t*)ret_val, free_hnode);
     } else if (ret_val == val) {
         jbpf_free_data_mem(val);
     }
+    ck_pr_store_uint(&hmap->count, ck_ht_count(&hmap->ht));
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Update an element in the bpf hashmap
+ * @param map The map
+ * @param key The key
+ * @param value The value
+ * @param flags The flags
+ * @return The status of the operation
+ * Possible return values:
+ * - JBPF_MAP_SUCCESS: Success
+ * - JBPF_MAP_BUSY: The map is busy
+ * - JBPF_MAP_FULL: The map is full
+ * - JBPF_MAP_ERROR: Error
+ * @ingroup core
+ */
+#pragma message("WARNING: Hashmap update functionality using flags is not implemented yet")
+static inline __attribute__((always_inline)) int
+jbpf_bpf_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+{
+
+    jbpf_hashmap_t* hmap;
+    ck_ht_hash_t h;
+    int res;
+
+    if (!map || !key || !value)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_hashmap_t*)map->data;
+
+    if (!ck_spinlock_trylock(&hmap->lock)) {
+        return -JBPF_MAP_BUSY;
+    }
+
+    ck_ht_hash(&h, &hmap->ht, key, hmap->key_size);
+    res = jbpf_bpf_hashmap_update_locked(hmap, key, value, h);
 
-out:
     ck_spinlock_unlock(&hmap->lock);
     return res;
 }
 
+/* Delete an element of the bpf hashmap, with the lock of the map held and the hash of the key computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_hashmap_delete_locked(jbpf_hashmap_t* hmap, const void* key, ck_ht_hash_t h)
+{
+    ck_ht_entry_t entry;
+    void* ret_val;
+
+    ck_ht_entry_key_set(&entry, key, hmap->key_size);
+
+    if (!ck_ht_remove_spmc(&hmap->ht, h, &entry)) {
+        return JBPF_MAP_ERROR;
+    }
+
+    ret_val = ck_ht_entry_value(&entry);
+    jbpf_ebr_call((ck_epoch_entry_t*)ret_val, free_hnode);
+    ck_pr_store_uint(&hmap->count, ck_ht_count(&hmap->ht));
+    return JBPF_MAP_SUCCESS;
+}
+
 /**
  * @brief Delete an element in the bpf hashmap
  * @param map The map
@@ -335,10 +359,8 @@ jbpf_bpf_hashmap_delete_elem(struct jbpf_map* map, const void* key)
 {
 
     jbpf_hashmap_t* hmap;
-    ck_ht_entry_t entry;
     ck_ht_hash_t h;
-    void* ret_val;
-    int res = JBPF_MAP_ERROR;
+    int res;
 
     if (!map || !key)
         return JBPF_MAP_ERROR;
@@ -350,14 +372,7 @@ jbpf_bpf_hashmap_delete_elem(struct jbpf_map* map, const void* key)
     }
 
     ck_ht_hash(&h, &hmap->ht, key, hmap->key_size);
-    ck_ht_entry_key_set(&entry, key, hmap->key_size);
-
-    if (ck_ht_remove_spmc(&hmap->ht, h, &entry)) {
-
-        ret_val = ck_ht_entry_value(&entry);
-        ck_epoch_call_strict(e_record, (ck_epoch_entry_t*)ret_val, free_hnode);
-        res = JBPF_MAP_SUCCESS;
-    }
+    res = jbpf_bpf_hashmap_delete_locked(hmap, key, h);
 
     ck_spinlock_unlock(&hmap->lock);
     return res;
@@ -17,6 +17,8 @@ struct jbpf_bpf_hashmap
     ck_ht_t ht;
     jbpf_mempool_ctx_t* mempool;
     ck_spinlock_t lock;
+    /* Number of entries, updated with the lock held so that it can be read without taking the lock */
+    unsigned int count;
 };
 
 #endif
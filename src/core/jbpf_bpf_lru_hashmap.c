@@ -0,0 +1,70 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_memory.h"
+#include "jbpf_utils.h"
+
+void*
+jbpf_bpf_lru_hashmap_create(const struct jbpf_load_map_def* map_def)
+{
+    jbpf_lru_hashmap_t* hmap;
+    unsigned int num_buckets;
+
+    if (!map_def || map_def->max_entries == 0 || map_def->key_size == 0 || map_def->value_size == 0)
+        return NULL;
+
+    hmap = jbpf_calloc_mem(1, sizeof(jbpf_lru_hashmap_t));
+
+    if (!hmap)
+        return NULL;
+
+    hmap->key_size = map_def->key_size;
+    hmap->value_size = map_def->value_size;
+    hmap->max_entries = map_def->max_entries;
+
+    // The key and the value are 8-byte aligned
+    hmap->value_offset = sizeof(struct jbpf_lru_hnode) + round_up(hmap->key_size, (uint32_t)sizeof(uint64_t));
+    hmap->node_size = round_up(hmap->value_offset + hmap->value_size, (uint32_t)sizeof(uint64_t));
+
+    num_buckets = round_up_pow_of_two(hmap->max_entries);
+    hmap->bucket_mask = num_buckets - 1;
+
+    hmap->buckets = jbpf_alloc_mem((size_t)num_buckets * sizeof(uint32_t));
+    hmap->nodes = jbpf_calloc_mem(hmap->max_entries, hmap->node_size);
+
+    if (!hmap->buckets || !hmap->nodes) {
+        jbpf_free_mem(hmap->buckets);
+        jbpf_free_mem(hmap->nodes);
+        jbpf_free_mem(hmap);
+        return NULL;
+    }
+
+    memset(hmap->buckets, 0xFF, (size_t)num_buckets * sizeof(uint32_t));
+
+    // All the nodes start in the free list
+    for (uint32_t idx = 0; idx < hmap->max_entries; idx++) {
+        jbpf_bpf_lru_hnode(hmap, idx)->next = idx + 1 < hmap->max_entries ? idx + 1 : JBPF_LRU_HNODE_NIL;
+    }
+    hmap->free_list = 0;
+    hmap->head = JBPF_LRU_HNODE_NIL;
+    hmap->tail = JBPF_LRU_HNODE_NIL;
+
+    ck_spinlock_init(&hmap->lock);
+
+    return hmap;
+}
+
+void
+jbpf_bpf_lru_hashmap_destroy(struct jbpf_map* map)
+{
+    jbpf_lru_hashmap_t* hmap;
+
+    if (!map || !map->data)
+        return;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+
+    jbpf_free_mem(hmap->buckets);
+    jbpf_free_mem(hmap->nodes);
+    jbpf_free_mem(hmap);
+}
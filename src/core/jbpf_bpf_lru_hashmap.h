@@ -0,0 +1,497 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_LRU_HASHMAP_H
+#define JBPF_BPF_LRU_HASHMAP_H
+
+#include <string.h>
+
+#include "jbpf_bpf_lru_hashmap_int.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_defs.h"
+#include "jbpf_memory.h"
+#include "jbpf_int.h"
+
+#include "jbpf_lookup3.h"
+
+typedef struct jbpf_bpf_lru_hashmap jbpf_lru_hashmap_t;
+
+/* JBPF_MAP_TYPE_LRU_HASHMAP and JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP share the same table. The jbpf_bpf_spsc_lru_*
+ * functions are used by the per-thread maps, where the table is only accessed by its thread. The jbpf_bpf_lru_*
+ * functions take the lock of the table around them.
+ *
+ * All the nodes are allocated when the map is created. When the map is full, inserting a new key evicts the least
+ * recently used key, and reuses its node. Lookups and updates move the key to the head of the recency list */
+
+/**
+ * @brief Create a new LRU hashmap
+ * @param map_def The map definition
+ * @return The hashmap
+ * @ingroup core
+ */
+void*
+jbpf_bpf_lru_hashmap_create(const struct jbpf_load_map_def* map_def);
+
+/**
+ * @brief Destroy an LRU hashmap
+ * @param map The map to destroy
+ * @ingroup core
+ */
+void
+jbpf_bpf_lru_hashmap_destroy(struct jbpf_map* map);
+
+static inline __attribute__((always_inline)) uint32_t
+jbpf_bpf_lru_hashmap_hash(const void* key, size_t key_size)
+{
+    return hashlittle(key, key_size, 6602834);
+}
+
+static inline __attribute__((always_inline)) struct jbpf_lru_hnode*
+jbpf_bpf_lru_hnode(const jbpf_lru_hashmap_t* hmap, uint32_t idx)
+{
+    return (struct jbpf_lru_hnode*)(hmap->nodes + (size_t)idx * hmap->node_size);
+}
+
+static inline __attribute__((always_inline)) uint8_t*
+jbpf_bpf_lru_hnode_key(struct jbpf_lru_hnode* node)
+{
+    return (uint8_t*)(node + 1);
+}
+
+static inline __attribute__((always_inline)) uint8_t*
+jbpf_bpf_lru_hnode_value(const jbpf_lru_hashmap_t* hmap, struct jbpf_lru_hnode* node)
+{
+    return (uint8_t*)node + hmap->value_offset;
+}
+
+/* Find the node of a key. If prev is not NULL, it is set to the link of the bucket chain that points to the node */
+static inline __attribute__((always_inline)) uint32_t
+jbpf_bpf_lru_hashmap_find(const jbpf_lru_hashmap_t* hmap, const void* key, uint32_t hash, uint32_t** prev)
+{
+    uint32_t* link = &hmap->buckets[hash & hmap->bucket_mask];
+    struct jbpf_lru_hnode* node;
+
+    while (*link != JBPF_LRU_HNODE_NIL) {
+        node = jbpf_bpf_lru_hnode(hmap, *link);
+        if (node->hash == hash && memcmp(jbpf_bpf_lru_hnode_key(node), key, hmap->key_size) == 0) {
+            if (prev)
+                *prev = link;
+            return *link;
+        }
+        link = &node->hash_next;
+    }
+    return JBPF_LRU_HNODE_NIL;
+}
+
+static inline __attribute__((always_inline)) void
+jbpf_bpf_lru_hashmap_list_unlink(jbpf_lru_hashmap_t* hmap, uint32_t idx)
+{
+    struct jbpf_lru_hnode* node = jbpf_bpf_lru_hnode(hmap, idx);
+
+    if (node->prev != JBPF_LRU_HNODE_NIL)
+        jbpf_bpf_lru_hnode(hmap, node->prev)->next = node->next;
+    else
+        hmap->head = node->next;
+
+    if (node->next != JBPF_LRU_HNODE_NIL)
+        jbpf_bpf_lru_hnode(hmap, node->next)->prev = node->prev;
+    else
+        hmap->tail = node->prev;
+}
+
+static inline __attribute__((always_inline)) void
+jbpf_bpf_lru_hashmap_list_push(jbpf_lru_hashmap_t* hmap, uint32_t idx)
+{
+    struct jbpf_lru_hnode* node = jbpf_bpf_lru_hnode(hmap, idx);
+
+    node->prev = JBPF_LRU_HNODE_NIL;
+    node->next = hmap->head;
+    if (hmap->head != JBPF_LRU_HNODE_NIL)
+        jbpf_bpf_lru_hnode(hmap, hmap->head)->prev = idx;
+    else
+        hmap->tail = idx;
+    hmap->head = idx;
+}
+
+/* Mark a node as the most recently used */
+static inline __attribute__((always_inline)) void
+jbpf_bpf_lru_hashmap_touch(jbpf_lru_hashmap_t* hmap, uint32_t idx)
+{
+    if (hmap->head == idx)
+        return;
+    jbpf_bpf_lru_hashmap_list_unlink(hmap, idx);
+    jbpf_bpf_lru_hashmap_list_push(hmap, idx);
+}
+
+/* Remove the least recently used node from the map and return it */
+static inline __attribute__((always_inline)) uint32_t
+jbpf_bpf_lru_hashmap_evict(jbpf_lru_hashmap_t* hmap)
+{
+    uint32_t idx = hmap->tail;
+    struct jbpf_lru_hnode* node = jbpf_bpf_lru_hnode(hmap, idx);
+    uint32_t* link = &hmap->buckets[node->hash & hmap->bucket_mask];
+
+    while (*link != idx)
+        link = &jbpf_bpf_lru_hnode(hmap, *link)->hash_next;
+    *link = node->hash_next;
+
+    jbpf_bpf_lru_hashmap_list_unlink(hmap, idx);
+    hmap->count--;
+    hmap->evictions++;
+    return idx;
+}
+
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_spsc_lru_hashmap_size(const struct jbpf_map* map)
+{
+    if (!map || !map->data)
+        return 0;
+
+    return ((jbpf_lru_hashmap_t*)map->data)->count;
+}
+
+/**
+ * @brief Get the number of keys evicted from the LRU hashmap since it was created
+ * @param map The map
+ * @return The number of evicted keys
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) uint64_t
+jbpf_bpf_spsc_lru_hashmap_evictions(const struct jbpf_map* map)
+{
+    if (!map || !map->data)
+        return 0;
+
+    return ((jbpf_lru_hashmap_t*)map->data)->evictions;
+}
+
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_spsc_lru_hashmap_lookup_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+    uint32_t idx;
+
+    if (!map || !key)
+        return NULL;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+
+    idx = jbpf_bpf_lru_hashmap_find(hmap, key, jbpf_bpf_lru_hashmap_hash(key, hmap->key_size), NULL);
+    if (idx == JBPF_LRU_HNODE_NIL)
+        return NULL;
+
+    jbpf_bpf_lru_hashmap_touch(hmap, idx);
+    return jbpf_bpf_lru_hnode_value(hmap, jbpf_bpf_lru_hnode(hmap, idx));
+}
+
+/**
+ * @brief Look up an element of a per-thread LRU hashmap from another thread, without moving it in the recency list
+ * @param map The map
+ * @param key The key
+ * @return The value, or NULL if the key is not found. As the owner thread may update the map concurrently, the
+ * walk of the bucket chain is bounded and the value is a best-effort snapshot
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_spsc_lru_hashmap_peek_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+    struct jbpf_lru_hnode* node;
+    uint32_t hash;
+    uint32_t idx;
+
+    if (!map || !map->data || !key)
+        return NULL;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    hash = jbpf_bpf_lru_hashmap_hash(key, hmap->key_size);
+    idx = hmap->buckets[hash & hmap->bucket_mask];
+
+    for (unsigned int steps = 0; idx != JBPF_LRU_HNODE_NIL && steps < hmap->max_entries; steps++) {
+        node = jbpf_bpf_lru_hnode(hmap, idx);
+        if (node->hash == hash && memcmp(jbpf_bpf_lru_hnode_key(node), key, hmap->key_size) == 0)
+            return jbpf_bpf_lru_hnode_value(hmap, node);
+        idx = node->hash_next;
+    }
+    return NULL;
+}
+
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_spsc_lru_hashmap_reset_elem(const struct jbpf_map* map, const void* key)
+{
+    void* value;
+
+    value = jbpf_bpf_spsc_lru_hashmap_lookup_elem(map, key);
+    if (value)
+        memset(value, 0, ((jbpf_lru_hashmap_t*)map->data)->value_size);
+
+    return value;
+}
+
+/* Update an element, evicting the least recently used element if the map is full, with the hash of the key
+ * computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_lru_hashmap_update_hashed(jbpf_lru_hashmap_t* hmap, const void* key, const void* value, uint32_t hash)
+{
+    struct jbpf_lru_hnode* node;
+    uint32_t idx, *bucket;
+
+    idx = jbpf_bpf_lru_hashmap_find(hmap, key, hash, NULL);
+    if (idx != JBPF_LRU_HNODE_NIL) {
+        memcpy(jbpf_bpf_lru_hnode_value(hmap, jbpf_bpf_lru_hnode(hmap, idx)), value, hmap->value_size);
+        jbpf_bpf_lru_hashmap_touch(hmap, idx);
+        return JBPF_MAP_SUCCESS;
+    }
+
+    if (hmap->free_list != JBPF_LRU_HNODE_NIL) {
+        idx = hmap->free_list;
+        hmap->free_list = jbpf_bpf_lru_hnode(hmap, idx)->next;
+    } else {
+        idx = jbpf_bpf_lru_hashmap_evict(hmap);
+    }
+
+    node = jbpf_bpf_lru_hnode(hmap, idx);
+    node->hash = hash;
+    memcpy(jbpf_bpf_lru_hnode_key(node), key, hmap->key_size);
+    memcpy(jbpf_bpf_lru_hnode_value(hmap, node), value, hmap->value_size);
+
+    bucket = &hmap->buckets[hash & hmap->bucket_mask];
+    node->hash_next = *bucket;
+    *bucket = idx;
+
+    jbpf_bpf_lru_hashmap_list_push(hmap, idx);
+    hmap->count++;
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/* Delete an element, with the hash of the key computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_lru_hashmap_delete_hashed(jbpf_lru_hashmap_t* hmap, const void* key, uint32_t hash)
+{
+    struct jbpf_lru_hnode* node;
+    uint32_t idx, *prev;
+
+    idx = jbpf_bpf_lru_hashmap_find(hmap, key, hash, &prev);
+    if (idx == JBPF_LRU_HNODE_NIL)
+        return JBPF_MAP_ERROR;
+
+    node = jbpf_bpf_lru_hnode(hmap, idx);
+    *prev = node->hash_next;
+    jbpf_bpf_lru_hashmap_list_unlink(hmap, idx);
+
+    node->next = hmap->free_list;
+    hmap->free_list = idx;
+    hmap->count--;
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Update an element of the LRU hashmap, evicting the least recently used element if the map is full
+ * @param map The map
+ * @param key The key
+ * @param value The value
+ * @param flags The flags (currently not used)
+ * @return The status of the operation
+ * Possible return values:
+ * - JBPF_MAP_SUCCESS: Success
+ * - JBPF_MAP_ERROR: Error
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_spsc_lru_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+{
+    jbpf_lru_hashmap_t* hmap;
+
+    if (!map || !key || !value)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    return jbpf_bpf_lru_hashmap_update_hashed(hmap, key, value, jbpf_bpf_lru_hashmap_hash(key, hmap->key_size));
+}
+
+static inline __attribute__((always_inline)) int
+jbpf_bpf_spsc_lru_hashmap_delete_elem(struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+
+    if (!map || !key)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    return jbpf_bpf_lru_hashmap_delete_hashed(hmap, key, jbpf_bpf_lru_hashmap_hash(key, hmap->key_size));
+}
+
+static inline __attribute__((always_inline)) int
+jbpf_bpf_spsc_lru_hashmap_clear(const struct jbpf_map* map)
+{
+    jbpf_lru_hashmap_t* hmap;
+
+    if (!map)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+
+    // Return the used nodes to the free list
+    if (hmap->tail != JBPF_LRU_HNODE_NIL) {
+        jbpf_bpf_lru_hnode(hmap, hmap->tail)->next = hmap->free_list;
+        hmap->free_list = hmap->head;
+    }
+    hmap->head = JBPF_LRU_HNODE_NIL;
+    hmap->tail = JBPF_LRU_HNODE_NIL;
+    hmap->count = 0;
+    memset(hmap->buckets, 0xFF, (size_t)(hmap->bucket_mask + 1) * sizeof(uint32_t));
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/**
+ * @brief Dump the LRU hashmap, from the most to the least recently used element
+ * @param map The map
+ * @param data The data buffer
+ * @param max_size The maximum size of the buffer
+ * @param flags The flags (currently not used)
+ * @return The number of elements copied to the buffer. The least recently used elements that do not fit in the
+ * buffer are not copied
+ * @ingroup core
+ */
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_spsc_lru_hashmap_dump(const struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flags)
+{
+    jbpf_lru_hashmap_t* hmap;
+    struct jbpf_lru_hnode* node;
+    uint8_t* data_ptr = data;
+    unsigned int count = 0;
+
+    if (!map || !data)
+        return 0;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+
+    for (uint32_t idx = hmap->head; idx != JBPF_LRU_HNODE_NIL; idx = node->next) {
+        node = jbpf_bpf_lru_hnode(hmap, idx);
+        if ((count + 1) * (hmap->key_size + hmap->value_size) > max_size)
+            break;
+        memcpy(data_ptr, jbpf_bpf_lru_hnode_key(node), hmap->key_size);
+        data_ptr += hmap->key_size;
+        memcpy(data_ptr, jbpf_bpf_lru_hnode_value(hmap, node), hmap->value_size);
+        data_ptr += hmap->value_size;
+        count++;
+    }
+
+    return count;
+}
+
+/* JBPF_MAP_TYPE_LRU_HASHMAP. The recency list is updated by the lookups too, so all the operations take the lock.
+ * The critical sections are O(1). As with JBPF_MAP_TYPE_HASHMAP, a value returned by a lookup can be overwritten
+ * by another thread, including when its key is evicted */
+
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_lru_hashmap_size(const struct jbpf_map* map)
+{
+    return jbpf_bpf_spsc_lru_hashmap_size(map);
+}
+
+static inline __attribute__((always_inline)) uint64_t
+jbpf_bpf_lru_hashmap_evictions(const struct jbpf_map* map)
+{
+    return jbpf_bpf_spsc_lru_hashmap_evictions(map);
+}
+
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_lru_hashmap_lookup_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+    void* res;
+
+    if (!map || !key)
+        return NULL;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_lookup_elem(map, key);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+static inline __attribute__((always_inline)) void*
+jbpf_bpf_lru_hashmap_reset_elem(const struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+    void* res;
+
+    if (!map || !key)
+        return NULL;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_reset_elem(map, key);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+static inline __attribute__((always_inline)) int
+jbpf_bpf_lru_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+{
+    jbpf_lru_hashmap_t* hmap;
+    int res;
+
+    if (!map || !key || !value)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_update_elem(map, key, value, flags);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+static inline __attribute__((always_inline)) int
+jbpf_bpf_lru_hashmap_delete_elem(struct jbpf_map* map, const void* key)
+{
+    jbpf_lru_hashmap_t* hmap;
+    int res;
+
+    if (!map || !key)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_delete_elem(map, key);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+static inline __attribute__((always_inline)) int
+jbpf_bpf_lru_hashmap_clear(const struct jbpf_map* map)
+{
+    jbpf_lru_hashmap_t* hmap;
+    int res;
+
+    if (!map)
+        return JBPF_MAP_ERROR;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_clear(map);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_lru_hashmap_dump(const struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flags)
+{
+    jbpf_lru_hashmap_t* hmap;
+    unsigned int res;
+
+    if (!map || !data)
+        return 0;
+
+    hmap = (jbpf_lru_hashmap_t*)map->data;
+    ck_spinlock_lock(&hmap->lock);
+    res = jbpf_bpf_spsc_lru_hashmap_dump(map, data, max_size, flags);
+    ck_spinlock_unlock(&hmap->lock);
+    return res;
+}
+
+#endif
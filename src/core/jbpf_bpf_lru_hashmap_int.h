@@ -0,0 +1,43 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_LRU_HASHMAP_INT_H
+#define JBPF_BPF_LRU_HASHMAP_INT_H
+
+#include <stdint.h>
+
+#include "ck_spinlock.h"
+
+/* Nodes are referenced by their index, JBPF_LRU_HNODE_NIL marks the end of a list */
+#define JBPF_LRU_HNODE_NIL (UINT32_MAX)
+
+/* An entry of the map. The key is stored after the node, and the value at offset value_offset of the node. A node is
+ * linked to a bucket chain and to the recency list while used, and to the free list otherwise */
+struct jbpf_lru_hnode
+{
+    uint32_t prev;
+    uint32_t next;
+    uint32_t hash_next;
+    uint32_t hash;
+};
+
+struct jbpf_bpf_lru_hashmap
+{
+    unsigned int key_size;
+    unsigned int value_size;
+    unsigned int max_entries;
+    unsigned int value_offset;
+    unsigned int node_size;
+    unsigned int bucket_mask;
+    unsigned int count;
+    // Recency list, from the most (head) to the least (tail) recently used node
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free_list;
+    uint64_t evictions;
+    uint32_t* buckets;
+    uint8_t* nodes;
+    // Only taken for JBPF_MAP_TYPE_LRU_HASHMAP
+    ck_spinlock_t lock;
+};
+
+#endif
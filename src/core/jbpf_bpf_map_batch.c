@@ -0,0 +1,465 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <string.h>
+
+#include "jbpf_bpf_map_batch.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_spsc_hashmap.h"
+
+#define JBPF_BATCH_KEY(map, keys, i) ((const uint8_t*)(keys) + (size_t)(i) * (map)->key_size)
+#define JBPF_BATCH_VALUE(map, values, i) ((uint8_t*)(values) + (size_t)(i) * (map)->value_size)
+
+/* A batch that stops at a failed key returns the number of keys done before it, or the error of the first key */
+static inline int
+jbpf_bpf_map_batch_result(uint32_t done, int res)
+{
+    return done > 0 ? (int)done : res;
+}
+
+/* JBPF_MAP_TYPE_ARRAY and JBPF_MAP_TYPE_PER_THREAD_ARRAY. The keys are uint32_t indexes. A lookup sets found_mask, an
+ * update passes NULL */
+
+static int
+jbpf_bpf_array_batch(struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    uint32_t index[JBPF_MAP_BATCH_MAX_KEYS];
+    bool update = !found_mask;
+    uint8_t* elem;
+    uint32_t done = 0;
+    uint64_t mask = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(&index[i], JBPF_BATCH_KEY(map, keys, i), sizeof(uint32_t));
+        if (index[i] < map->max_entries)
+            __builtin_prefetch((uint8_t*)map->data + (size_t)index[i] * map->value_size);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (index[i] >= map->max_entries) {
+            if (update)
+                return jbpf_bpf_map_batch_result(done, JBPF_MAP_ERROR);
+            continue;
+        }
+        elem = (uint8_t*)map->data + (size_t)index[i] * map->value_size;
+        if (update)
+            memcpy(elem, JBPF_BATCH_VALUE(map, values, i), map->value_size);
+        else
+            memcpy(JBPF_BATCH_VALUE(map, values, i), elem, map->value_size);
+        mask |= 1ULL << i;
+        done++;
+    }
+
+    if (found_mask)
+        *found_mask = mask;
+    return done;
+}
+
+/* JBPF_MAP_TYPE_HASHMAP. The buckets of ck_ht are not exposed, so only the hashing is batched, as well as the lock
+ * of the map for the updates and the deletes */
+
+static int
+jbpf_bpf_hashmap_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    jbpf_hashmap_t* hmap = map->data;
+    ck_ht_hash_t h[JBPF_MAP_BATCH_MAX_KEYS];
+    ck_ht_entry_t entry;
+    uint8_t* v;
+    uint32_t found = 0;
+    uint64_t mask = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        ck_ht_hash(&h[i], &hmap->ht, JBPF_BATCH_KEY(map, keys, i), hmap->key_size);
+
+    for (uint32_t i = 0; i < count; i++) {
+        ck_ht_entry_key_set(&entry, JBPF_BATCH_KEY(map, keys, i), hmap->key_size);
+        if (ck_ht_get_spmc(&hmap->ht, h[i], &entry)) {
+            v = ck_ht_entry_value(&entry);
+            memcpy(JBPF_BATCH_VALUE(map, values, i), v + sizeof(ck_epoch_entry_t) + hmap->key_size, hmap->value_size);
+            mask |= 1ULL << i;
+            found++;
+        }
+    }
+
+    *found_mask = mask;
+    return found;
+}
+
+static int
+jbpf_bpf_hashmap_update_batch(struct jbpf_map* map, const void* keys, const void* values, uint32_t count)
+{
+    jbpf_hashmap_t* hmap = map->data;
+    ck_ht_hash_t h[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t done = 0;
+    int res = JBPF_MAP_SUCCESS;
+
+    for (uint32_t i = 0; i < count; i++)
+        ck_ht_hash(&h[i], &hmap->ht, JBPF_BATCH_KEY(map, keys, i), hmap->key_size);
+
+    if (!ck_spinlock_trylock(&hmap->lock))
+        return JBPF_MAP_BUSY;
+
+    for (; done < count; done++) {
+        res = jbpf_bpf_hashmap_update_locked(
+            hmap, JBPF_BATCH_KEY(map, keys, done), JBPF_BATCH_VALUE(map, values, done), h[done]);
+        if (res != JBPF_MAP_SUCCESS)
+            break;
+    }
+
+    ck_spinlock_unlock(&hmap->lock);
+    return jbpf_bpf_map_batch_result(done, res);
+}
+
+static int
+jbpf_bpf_hashmap_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    jbpf_hashmap_t* hmap = map->data;
+    ck_ht_hash_t h[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t deleted = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        ck_ht_hash(&h[i], &hmap->ht, JBPF_BATCH_KEY(map, keys, i), hmap->key_size);
+
+    if (!ck_spinlock_trylock(&hmap->lock))
+        return JBPF_MAP_BUSY;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (jbpf_bpf_hashmap_delete_locked(hmap, JBPF_BATCH_KEY(map, keys, i), h[i]) == JBPF_MAP_SUCCESS)
+            deleted++;
+    }
+
+    ck_spinlock_unlock(&hmap->lock);
+    return deleted;
+}
+
+/* JBPF_MAP_TYPE_CONCURRENT_HASHMAP. Each key still takes the lock of its own bucket for updates and deletes */
+
+static void
+jbpf_bpf_concurrent_hashmap_batch_prefetch(
+    const jbpf_concurrent_hashmap_t* hmap, const void* keys, uint32_t* hash, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        hash[i] = jbpf_bpf_concurrent_hashmap_hash((const uint8_t*)keys + (size_t)i * hmap->key_size, hmap->key_size);
+        __builtin_prefetch(&hmap->buckets[hash[i] & hmap->bucket_mask]);
+    }
+}
+
+static int
+jbpf_bpf_concurrent_hashmap_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    jbpf_concurrent_hashmap_t* hmap = map->data;
+    struct jbpf_concurrent_hnode* node;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t found = 0;
+    uint64_t mask = 0;
+
+    jbpf_bpf_concurrent_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        node = jbpf_bpf_concurrent_hashmap_find(
+            hmap, &hmap->buckets[hash[i] & hmap->bucket_mask], hash[i], JBPF_BATCH_KEY(map, keys, i));
+        if (node) {
+            jbpf_bpf_concurrent_hnode_read_value(hmap, node, JBPF_BATCH_VALUE(map, values, i));
+            mask |= 1ULL << i;
+            found++;
+        }
+    }
+
+    *found_mask = mask;
+    return found;
+}
+
+static int
+jbpf_bpf_concurrent_hashmap_update_batch(
+    struct jbpf_map* map, const void* keys, const void* values, uint32_t count)
+{
+    jbpf_concurrent_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t done;
+    int res = JBPF_MAP_SUCCESS;
+
+    jbpf_bpf_concurrent_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (done = 0; done < count; done++) {
+        res = jbpf_bpf_concurrent_hashmap_update_hashed(
+            hmap, JBPF_BATCH_KEY(map, keys, done), JBPF_BATCH_VALUE(map, values, done), hash[done]);
+        if (res != JBPF_MAP_SUCCESS)
+            break;
+    }
+
+    return jbpf_bpf_map_batch_result(done, res);
+}
+
+static int
+jbpf_bpf_concurrent_hashmap_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    jbpf_concurrent_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t deleted = 0;
+
+    jbpf_bpf_concurrent_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (jbpf_bpf_concurrent_hashmap_delete_hashed(hmap, JBPF_BATCH_KEY(map, keys, i), hash[i]) ==
+            JBPF_MAP_SUCCESS)
+            deleted++;
+    }
+
+    return deleted;
+}
+
+/* JBPF_MAP_TYPE_LRU_HASHMAP and JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP. The buckets are prefetched before the lock of a
+ * JBPF_MAP_TYPE_LRU_HASHMAP is taken, which keeps the cache misses out of the critical section */
+
+static void
+jbpf_bpf_lru_hashmap_batch_prefetch(
+    const jbpf_lru_hashmap_t* hmap, const void* keys, uint32_t* hash, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        hash[i] = jbpf_bpf_lru_hashmap_hash((const uint8_t*)keys + (size_t)i * hmap->key_size, hmap->key_size);
+        __builtin_prefetch(&hmap->buckets[hash[i] & hmap->bucket_mask]);
+    }
+}
+
+static int
+jbpf_bpf_lru_hashmap_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    jbpf_lru_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t idx, found = 0;
+    uint64_t mask = 0;
+
+    jbpf_bpf_lru_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_lock(&hmap->lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        idx = jbpf_bpf_lru_hashmap_find(hmap, JBPF_BATCH_KEY(map, keys, i), hash[i], NULL);
+        if (idx == JBPF_LRU_HNODE_NIL)
+            continue;
+        // As with single lookups, the keys found become the most recently used
+        jbpf_bpf_lru_hashmap_touch(hmap, idx);
+        memcpy(
+            JBPF_BATCH_VALUE(map, values, i),
+            jbpf_bpf_lru_hnode_value(hmap, jbpf_bpf_lru_hnode(hmap, idx)),
+            hmap->value_size);
+        mask |= 1ULL << i;
+        found++;
+    }
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_unlock(&hmap->lock);
+
+    *found_mask = mask;
+    return found;
+}
+
+static int
+jbpf_bpf_lru_hashmap_update_batch(struct jbpf_map* map, const void* keys, const void* values, uint32_t count)
+{
+    jbpf_lru_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t done;
+    int res = JBPF_MAP_SUCCESS;
+
+    jbpf_bpf_lru_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_lock(&hmap->lock);
+
+    for (done = 0; done < count; done++) {
+        res = jbpf_bpf_lru_hashmap_update_hashed(
+            hmap, JBPF_BATCH_KEY(map, keys, done), JBPF_BATCH_VALUE(map, values, done), hash[done]);
+        if (res != JBPF_MAP_SUCCESS)
+            break;
+    }
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_unlock(&hmap->lock);
+
+    return jbpf_bpf_map_batch_result(done, res);
+}
+
+static int
+jbpf_bpf_lru_hashmap_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    jbpf_lru_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t deleted = 0;
+
+    jbpf_bpf_lru_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_lock(&hmap->lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (jbpf_bpf_lru_hashmap_delete_hashed(hmap, JBPF_BATCH_KEY(map, keys, i), hash[i]) == JBPF_MAP_SUCCESS)
+            deleted++;
+    }
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_unlock(&hmap->lock);
+
+    return deleted;
+}
+
+/* JBPF_MAP_TYPE_PER_THREAD_HASHMAP. The control bytes of the first group probed by each key are prefetched */
+
+static void
+jbpf_bpf_spsc_hashmap_batch_prefetch(const jbpf_spsc_hashmap_t* hmap, const void* keys, uint32_t* hash, uint32_t count)
+{
+    uint32_t group_idx;
+
+    for (uint32_t i = 0; i < count; i++) {
+        hash[i] = jbpf_bpf_spsc_hashmap_hash((const uint8_t*)keys + (size_t)i * hmap->key_size, hmap->key_size);
+        group_idx = jbpf_bpf_spsc_hashmap_h1(hash[i]) & hmap->group_mask;
+        __builtin_prefetch(hmap->ctrl + group_idx * JBPF_SPSC_HASHMAP_GROUP_SIZE);
+    }
+}
+
+static int
+jbpf_bpf_spsc_hashmap_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    jbpf_spsc_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t found = 0;
+    uint64_t mask = 0;
+    int64_t idx;
+
+    jbpf_bpf_spsc_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        idx = jbpf_bpf_spsc_hashmap_find(hmap, JBPF_BATCH_KEY(map, keys, i), hash[i]);
+        if (idx < 0)
+            continue;
+        memcpy(
+            JBPF_BATCH_VALUE(map, values, i),
+            jbpf_bpf_spsc_hashmap_slot(hmap, idx) + hmap->value_offset,
+            hmap->value_size);
+        mask |= 1ULL << i;
+        found++;
+    }
+
+    *found_mask = mask;
+    return found;
+}
+
+static int
+jbpf_bpf_spsc_hashmap_update_batch(struct jbpf_map* map, const void* keys, const void* values, uint32_t count)
+{
+    jbpf_spsc_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t done;
+    int res = JBPF_MAP_SUCCESS;
+
+    jbpf_bpf_spsc_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (done = 0; done < count; done++) {
+        res = jbpf_bpf_spsc_hashmap_update_hashed(
+            hmap, JBPF_BATCH_KEY(map, keys, done), JBPF_BATCH_VALUE(map, values, done), hash[done]);
+        if (res != JBPF_MAP_SUCCESS)
+            break;
+    }
+
+    return jbpf_bpf_map_batch_result(done, res);
+}
+
+static int
+jbpf_bpf_spsc_hashmap_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    jbpf_spsc_hashmap_t* hmap = map->data;
+    uint32_t hash[JBPF_MAP_BATCH_MAX_KEYS];
+    uint32_t deleted = 0;
+
+    jbpf_bpf_spsc_hashmap_batch_prefetch(hmap, keys, hash, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (jbpf_bpf_spsc_hashmap_delete_hashed(hmap, JBPF_BATCH_KEY(map, keys, i), hash[i]) == JBPF_MAP_SUCCESS)
+            deleted++;
+    }
+
+    return deleted;
+}
+
+static bool
+jbpf_bpf_map_batch_is_valid(const struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    return map && map->data && keys && count > 0 && count <= JBPF_MAP_BATCH_MAX_KEYS;
+}
+
+int
+jbpf_bpf_map_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask)
+{
+    if (!jbpf_bpf_map_batch_is_valid(map, keys, count) || !values || !found_mask)
+        return JBPF_MAP_ERROR;
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_ARRAY:
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        return jbpf_bpf_array_batch((struct jbpf_map*)map, keys, values, count, found_mask);
+    case JBPF_MAP_TYPE_HASHMAP:
+        return jbpf_bpf_hashmap_lookup_batch(map, keys, values, count, found_mask);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_lookup_batch(map, keys, values, count, found_mask);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_lookup_batch(map, keys, values, count, found_mask);
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        return jbpf_bpf_spsc_hashmap_lookup_batch(map, keys, values, count, found_mask);
+    default:
+        return JBPF_MAP_ERROR;
+    }
+}
+
+int
+jbpf_bpf_map_update_batch(struct jbpf_map* map, const void* keys, const void* values, uint32_t count)
+{
+    if (!jbpf_bpf_map_batch_is_valid(map, keys, count) || !values)
+        return JBPF_MAP_ERROR;
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_ARRAY:
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        return jbpf_bpf_array_batch(map, keys, (void*)values, count, NULL);
+    case JBPF_MAP_TYPE_HASHMAP:
+        return jbpf_bpf_hashmap_update_batch(map, keys, values, count);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_update_batch(map, keys, values, count);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_update_batch(map, keys, values, count);
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        return jbpf_bpf_spsc_hashmap_update_batch(map, keys, values, count);
+    default:
+        return JBPF_MAP_ERROR;
+    }
+}
+
+int
+jbpf_bpf_map_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count)
+{
+    if (!jbpf_bpf_map_batch_is_valid(map, keys, count))
+        return JBPF_MAP_ERROR;
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_HASHMAP:
+        return jbpf_bpf_hashmap_delete_batch(map, keys, count);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_delete_batch(map, keys, count);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_delete_batch(map, keys, count);
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        return jbpf_bpf_spsc_hashmap_delete_batch(map, keys, count);
+    default:
+        return JBPF_MAP_ERROR;
+    }
+}
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_MAP_BATCH_H
+#define JBPF_BPF_MAP_BATCH_H
+
+#include <stdint.h>
+
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_int.h"
+
+/* Operations on up to JBPF_MAP_BATCH_MAX_KEYS keys at once. The keys and the values are packed one after the other,
+ * with key_size and value_size bytes each, and need not be aligned.
+ *
+ * Each map type runs a batch in two passes: the first one hashes all the keys and prefetches the buckets they fall
+ * in, and the second one does the operations, by which time the buckets are in the cache. The maps with a lock for
+ * the whole map (JBPF_MAP_TYPE_HASHMAP and JBPF_MAP_TYPE_LRU_HASHMAP) take it once for the batch.
+ *
+ * For the per-thread map types, map is the copy of the calling thread */
+
+/**
+ * @brief Copy the values of a batch of keys
+ * @param map The map, or the copy of the thread for a per-thread map
+ * @param keys The keys
+ * @param values The buffer of the values, of count * value_size bytes. The values of the keys that are not in the
+ * map are left unchanged
+ * @param count The number of keys
+ * @param found_mask Set to the mask of the keys found, where bit i is set if the i-th key is found
+ * @return The number of keys found, or a negative value on failure:
+ * - JBPF_MAP_ERROR: Invalid map or count, or map type without lookups
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_lookup_batch(
+    const struct jbpf_map* map, const void* keys, void* values, uint32_t count, uint64_t* found_mask);
+
+/**
+ * @brief Update the values of a batch of keys, in order
+ * @param map The map, or the copy of the thread for a per-thread map
+ * @param keys The keys
+ * @param values The values, count * value_size bytes
+ * @param count The number of keys
+ * @return The number of keys updated. The batch stops at the first key that cannot be updated, and the error of that
+ * key is returned if it is the first one:
+ * - JBPF_MAP_ERROR: Invalid map or count, map type without updates, or the key cannot be updated
+ * - JBPF_MAP_BUSY: The map is busy (JBPF_MAP_TYPE_HASHMAP)
+ * - JBPF_MAP_FULL: The map is full
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_update_batch(struct jbpf_map* map, const void* keys, const void* values, uint32_t count);
+
+/**
+ * @brief Delete a batch of keys
+ * @param map The map, or the copy of the thread for a per-thread map
+ * @param keys The keys
+ * @param count The number of keys
+ * @return The number of keys deleted. The keys that are not in the map are skipped. On failure:
+ * - JBPF_MAP_ERROR: Invalid map or count, or map type without deletes
+ * - JBPF_MAP_BUSY: The map is busy (JBPF_MAP_TYPE_HASHMAP)
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_delete_batch(struct jbpf_map* map, const void* keys, uint32_t count);
+
+#endif
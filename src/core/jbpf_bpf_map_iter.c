@@ -0,0 +1,324 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <string.h>
+
+#include "jbpf_bpf_map_iter.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_spsc_hashmap.h"
+
+/* The position of an iteration in a single map: the slot or bucket to resume from, and the number of entries of
+ * that bucket already returned */
+struct jbpf_bpf_map_iter_pos
+{
+    uint32_t idx;
+    uint32_t skip;
+};
+
+static inline uint8_t*
+jbpf_bpf_map_iter_copy(uint8_t* data, const void* key, uint32_t key_size, const void* value, uint32_t value_size)
+{
+    memcpy(data, key, key_size);
+    memcpy(data + key_size, value, value_size);
+    return data + key_size + value_size;
+}
+
+/* JBPF_MAP_TYPE_ARRAY and JBPF_MAP_TYPE_PER_THREAD_ARRAY. The keys are the uint32_t indexes, zero-padded to key_size */
+static int
+jbpf_bpf_array_iterate(
+    const struct jbpf_map* map, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    uint8_t key[sizeof(uint64_t)] = {0};
+    uint32_t count = 0;
+
+    if (map->key_size > sizeof(key))
+        return JBPF_MAP_ERROR;
+
+    for (; pos->idx < map->max_entries && count < max_count; pos->idx++, count++) {
+        memcpy(key, &pos->idx, sizeof(uint32_t));
+        data = jbpf_bpf_map_iter_copy(
+            data, key, map->key_size, (uint8_t*)map->data + (size_t)pos->idx * map->value_size, map->value_size);
+    }
+
+    *done = pos->idx >= map->max_entries;
+    return count;
+}
+
+/* JBPF_MAP_TYPE_HASHMAP. The position is the offset of the ck_ht iterator, which is a slot of the table */
+static int
+jbpf_bpf_hashmap_iterate(
+    const struct jbpf_map* map, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    jbpf_hashmap_t* hmap = map->data;
+    ck_ht_iterator_t iterator = CK_HT_ITERATOR_INITIALIZER;
+    ck_ht_entry_t* cursor;
+    uint8_t* value;
+    uint32_t count = 0;
+
+    if (!ck_spinlock_trylock(&hmap->lock))
+        return JBPF_MAP_BUSY;
+
+    iterator.offset = pos->idx;
+    *done = false;
+    while (count < max_count) {
+        if (!ck_ht_next(&hmap->ht, &iterator, &cursor)) {
+            *done = true;
+            break;
+        }
+        value = ck_ht_entry_value(cursor);
+        data = jbpf_bpf_map_iter_copy(
+            data,
+            value + sizeof(ck_epoch_entry_t),
+            hmap->key_size,
+            value + sizeof(ck_epoch_entry_t) + hmap->key_size,
+            hmap->value_size);
+        count++;
+    }
+    pos->idx = (uint32_t)iterator.offset;
+
+    ck_spinlock_unlock(&hmap->lock);
+    return count;
+}
+
+/* JBPF_MAP_TYPE_CONCURRENT_HASHMAP. Each chain is walked and copied under the lock of its bucket, as the host thread
+ * that iterates may not be in an epoch or QSBR read-side section, and a node deleted by a hook could otherwise be
+ * freed while it is read. A writer to the bucket waits for at most one chain to be copied */
+static int
+jbpf_bpf_concurrent_hashmap_iterate(
+    const struct jbpf_map* map, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    jbpf_concurrent_hashmap_t* hmap = map->data;
+    struct jbpf_concurrent_hbucket* bucket;
+    struct jbpf_concurrent_hnode* node;
+    uint32_t count = 0, chain_len, i;
+
+    *done = false;
+    for (; pos->idx <= hmap->bucket_mask; pos->idx++, pos->skip = 0) {
+        bucket = &hmap->buckets[pos->idx];
+        if (!ck_pr_load_ptr(&bucket->head))
+            continue;
+
+        ck_spinlock_lock(&bucket->lock);
+
+        // Stop before a chain that does not fit, unless it is the first one, which is then returned in part
+        chain_len = 0;
+        for (node = bucket->head; node; node = node->next)
+            chain_len++;
+        if (count > 0 && chain_len > pos->skip && count + chain_len - pos->skip > max_count) {
+            ck_spinlock_unlock(&bucket->lock);
+            return count;
+        }
+
+        for (node = bucket->head, i = 0; node; node = node->next, i++) {
+            if (i < pos->skip)
+                continue;
+            if (count == max_count || i == JBPF_MAP_CURSOR_SKIP_MAX) {
+                pos->skip = i;
+                ck_spinlock_unlock(&bucket->lock);
+                return count;
+            }
+            // The value is only written under the lock of the bucket, so it can be copied as is
+            data = jbpf_bpf_map_iter_copy(
+                data,
+                jbpf_bpf_concurrent_hnode_key(node),
+                hmap->key_size,
+                jbpf_bpf_concurrent_hnode_value(hmap, node),
+                hmap->value_size);
+            count++;
+        }
+
+        ck_spinlock_unlock(&bucket->lock);
+    }
+
+    *done = true;
+    return count;
+}
+
+/* JBPF_MAP_TYPE_LRU_HASHMAP and JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP. The bucket chains are walked rather than the
+ * recency list, whose order changes with every lookup. Reading the entries does not change their recency. The copy
+ * of a per-thread map is read without a lock while its thread may relink its nodes, so the walk of a chain is bounded
+ * by max_entries, as by jbpf_bpf_spsc_lru_hashmap_peek_elem() */
+static int
+jbpf_bpf_lru_hashmap_iterate_chains(
+    jbpf_lru_hashmap_t* hmap, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    struct jbpf_lru_hnode* node;
+    uint32_t count = 0, chain_len, i, idx;
+
+    *done = false;
+    for (; pos->idx <= hmap->bucket_mask; pos->idx++, pos->skip = 0) {
+        chain_len = 0;
+        for (idx = hmap->buckets[pos->idx]; idx != JBPF_LRU_HNODE_NIL && chain_len < hmap->max_entries;
+             idx = jbpf_bpf_lru_hnode(hmap, idx)->hash_next)
+            chain_len++;
+        if (count > 0 && chain_len > pos->skip && count + chain_len - pos->skip > max_count)
+            return count;
+
+        for (idx = hmap->buckets[pos->idx], i = 0; idx != JBPF_LRU_HNODE_NIL && i < hmap->max_entries;
+             idx = node->hash_next, i++) {
+            node = jbpf_bpf_lru_hnode(hmap, idx);
+            if (i < pos->skip)
+                continue;
+            if (count == max_count || i == JBPF_MAP_CURSOR_SKIP_MAX) {
+                pos->skip = i;
+                return count;
+            }
+            data = jbpf_bpf_map_iter_copy(
+                data,
+                jbpf_bpf_lru_hnode_key(node),
+                hmap->key_size,
+                jbpf_bpf_lru_hnode_value(hmap, node),
+                hmap->value_size);
+            count++;
+        }
+    }
+
+    *done = true;
+    return count;
+}
+
+static int
+jbpf_bpf_lru_hashmap_iterate(
+    const struct jbpf_map* map, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    jbpf_lru_hashmap_t* hmap = map->data;
+    int res;
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_lock(&hmap->lock);
+
+    res = jbpf_bpf_lru_hashmap_iterate_chains(hmap, pos, data, max_count, done);
+
+    if (map->type == JBPF_MAP_TYPE_LRU_HASHMAP)
+        ck_spinlock_unlock(&hmap->lock);
+
+    return res;
+}
+
+/* JBPF_MAP_TYPE_PER_THREAD_HASHMAP. The position is a slot of the table */
+static int
+jbpf_bpf_spsc_hashmap_iterate(
+    const struct jbpf_map* map, struct jbpf_bpf_map_iter_pos* pos, uint8_t* data, uint32_t max_count, bool* done)
+{
+    jbpf_spsc_hashmap_t* hmap = map->data;
+    uint32_t count = 0;
+    uint8_t* slot;
+
+    for (; pos->idx < hmap->ht_size && count < max_count; pos->idx++) {
+        if (hmap->ctrl[pos->idx] & JBPF_SPSC_HASHMAP_CTRL_EMPTY)
+            continue;
+        slot = jbpf_bpf_spsc_hashmap_slot(hmap, pos->idx);
+        data = jbpf_bpf_map_iter_copy(data, slot, hmap->key_size, slot + hmap->value_offset, hmap->value_size);
+        count++;
+    }
+
+    *done = pos->idx >= hmap->ht_size;
+    return count;
+}
+
+bool
+jbpf_bpf_map_iterable(int map_type)
+{
+    switch (map_type) {
+    case JBPF_MAP_TYPE_ARRAY:
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+    case JBPF_MAP_TYPE_HASHMAP:
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int
+jbpf_bpf_map_iterate(const struct jbpf_map* map, uint64_t* cursor, void* data, uint32_t max_size)
+{
+    struct jbpf_bpf_map_iter_pos pos;
+    uint32_t max_count;
+    bool done = false;
+    int res;
+
+    if (!map || !map->data || !cursor || !data)
+        return JBPF_MAP_ERROR;
+
+    max_count = max_size / (map->key_size + map->value_size);
+    if (max_count == 0 || *cursor > JBPF_MAP_CURSOR_POS_MASK)
+        return JBPF_MAP_ERROR;
+
+    pos.idx = (uint32_t)*cursor;
+    pos.skip = (uint32_t)(*cursor >> 32);
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_ARRAY:
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        res = jbpf_bpf_array_iterate(map, &pos, data, max_count, &done);
+        break;
+    case JBPF_MAP_TYPE_HASHMAP:
+        res = jbpf_bpf_hashmap_iterate(map, &pos, data, max_count, &done);
+        break;
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        res = jbpf_bpf_concurrent_hashmap_iterate(map, &pos, data, max_count, &done);
+        break;
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        res = jbpf_bpf_lru_hashmap_iterate(map, &pos, data, max_count, &done);
+        break;
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        res = jbpf_bpf_spsc_hashmap_iterate(map, &pos, data, max_count, &done);
+        break;
+    default:
+        return JBPF_MAP_ERROR;
+    }
+
+    if (res < 0)
+        return res;
+
+    *cursor = done ? 0 : ((uint64_t)pos.skip << 32) | pos.idx;
+    return res;
+}
+
+int
+jbpf_bpf_map_iterate_per_thread(
+    const struct jbpf_map* map, int num_slots, uint64_t* cursor, void* data, uint32_t max_size)
+{
+    const struct jbpf_map* copies;
+    uint32_t elem_size, count = 0;
+    uint64_t pos;
+    int copy, res;
+
+    if (!map || !map->data || !cursor || !data)
+        return JBPF_MAP_ERROR;
+
+    if (map->type != JBPF_MAP_TYPE_PER_THREAD_ARRAY && map->type != JBPF_MAP_TYPE_PER_THREAD_HASHMAP &&
+        map->type != JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP)
+        return JBPF_MAP_ERROR;
+
+    elem_size = map->key_size + map->value_size;
+    if (max_size < elem_size)
+        return JBPF_MAP_ERROR;
+
+    copies = map->data;
+    copy = (int)(*cursor >> JBPF_MAP_CURSOR_POS_BITS);
+    pos = *cursor & JBPF_MAP_CURSOR_POS_MASK;
+
+    for (; copy < num_slots; copy++, pos = 0) {
+        // The rest of the buffer is too small, resume from the start of this copy
+        if (max_size - count * elem_size < elem_size)
+            break;
+        res = jbpf_bpf_map_iterate(
+            &copies[copy], &pos, (uint8_t*)data + (size_t)count * elem_size, max_size - count * elem_size);
+        if (res < 0)
+            return res;
+        count += res;
+        if (pos != 0)
+            break;
+    }
+
+    *cursor = copy < num_slots ? ((uint64_t)copy << JBPF_MAP_CURSOR_POS_BITS) | pos : 0;
+    return count;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_MAP_ITER_H
+#define JBPF_BPF_MAP_ITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_int.h"
+
+/* Incremental iteration over the entries of a map, a bounded number of entries per call. The position of the
+ * iteration is kept in a cursor owned by the caller, so no lock is held between two calls. A cursor of 0 starts an
+ * iteration, and the cursor is set back to 0 once all the entries have been returned. The entries are copied as by
+ * jbpf_map_dump(): the key followed by the value, key_size + value_size bytes each. The keys of the arrays are their
+ * uint32_t indexes.
+ *
+ * The cursor is a position in the table of the map rather than in its entries, so the iteration is weakly
+ * consistent: an entry added or deleted during the iteration may or may not be returned, and an entry that is in the
+ * map for the whole iteration is returned once, with the following exceptions. For the maps with bucket chains
+ * (JBPF_MAP_TYPE_CONCURRENT_HASHMAP and the LRU hashmaps), a chain that does not fit in the buffer is resumed by
+ * skipping the number of its entries already returned, so an insert in that chain between two calls may return one of
+ * its entries twice, and a delete in it may miss one. A call returns whole chains when it can, which keeps this to the
+ * chains longer than the free space of the buffer. The entries of a JBPF_MAP_TYPE_HASHMAP or a
+ * JBPF_MAP_TYPE_PER_THREAD_HASHMAP may be returned twice or missed if its table is resized or rehashed during the
+ * iteration.
+ *
+ * Layout of the cursor: bits 0-31 hold the slot or the bucket of the map to resume from, bits 32-55 the number of
+ * entries of that bucket already returned, and bits 56-63 the thread copy of a per-thread map */
+
+#define JBPF_MAP_CURSOR_POS_BITS (56)
+#define JBPF_MAP_CURSOR_POS_MASK ((1ULL << JBPF_MAP_CURSOR_POS_BITS) - 1)
+#define JBPF_MAP_CURSOR_SKIP_MAX ((1U << (JBPF_MAP_CURSOR_POS_BITS - 32)) - 1)
+
+/**
+ * @brief Whether the entries of a map type can be iterated over
+ * @param map_type The map type
+ * @ingroup core
+ */
+bool
+jbpf_bpf_map_iterable(int map_type);
+
+/**
+ * @brief Copy the next entries of a map
+ * @param map The map, or the copy of a thread for a per-thread map
+ * @param cursor The position of the iteration, 0 to start. Set to the position to resume from, or to 0 if all the
+ * entries have been returned
+ * @param data The buffer of the entries
+ * @param max_size The size of the buffer. At least one entry must fit
+ * @return The number of entries copied, which may be 0 when the iteration completes, or a negative value on failure:
+ * - JBPF_MAP_ERROR: Invalid map, map type without entries, or buffer smaller than an entry
+ * - JBPF_MAP_BUSY: The map is busy (JBPF_MAP_TYPE_HASHMAP). The cursor is left unchanged
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_iterate(const struct jbpf_map* map, uint64_t* cursor, void* data, uint32_t max_size);
+
+/**
+ * @brief Copy the next entries of a per-thread map, over the copies of the first num_slots threads in turn. A key
+ * is returned once for each copy that holds it. The copies are read without any lock while their threads may update
+ * them, as by jbpf_bpf_map_dump_aggregated()
+ * @param map The per-thread map
+ * @param num_slots The number of thread copies to iterate over
+ * @param cursor The position of the iteration, as for jbpf_bpf_map_iterate()
+ * @param data The buffer of the entries
+ * @param max_size The size of the buffer
+ * @return The number of entries copied, or a negative value on failure, as for jbpf_bpf_map_iterate()
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_iterate_per_thread(
+    const struct jbpf_map* map, int num_slots, uint64_t* cursor, void* data, uint32_t max_size);
+
+#endif
@@ -0,0 +1,292 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <string.h>
+
+#include "jbpf_bpf_map_reduce.h"
+#include "jbpf_bpf_array.h"
+#include "jbpf_bpf_spsc_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+
+/* The values are not necessarily aligned to the size of their elements, e.g. in the buffers of the codelets */
+typedef uint64_t jbpf_reduce_u64_t __attribute__((aligned(1), __may_alias__));
+typedef uint32_t jbpf_reduce_u32_t __attribute__((aligned(1), __may_alias__));
+typedef int64_t jbpf_reduce_s64_t __attribute__((aligned(1), __may_alias__));
+typedef int32_t jbpf_reduce_s32_t __attribute__((aligned(1), __may_alias__));
+
+#define JBPF_REDUCE_ADD(a, b) ((a) + (b))
+#define JBPF_REDUCE_OR(a, b) ((a) | (b))
+#define JBPF_REDUCE_MIN(a, b) ((b) < (a) ? (b) : (a))
+#define JBPF_REDUCE_MAX(a, b) ((b) > (a) ? (b) : (a))
+
+/* Plain element-wise loops without dependencies between the iterations, that the compiler turns into SIMD code */
+#define JBPF_REDUCE_LOOP(elem_t, dst, src, n, reduce_op)         \
+    do {                                                         \
+        elem_t* __restrict d = (elem_t*)(dst);                   \
+        const elem_t* __restrict s = (const elem_t*)(src);       \
+        for (uint32_t i = 0; i < (n); i++) {                     \
+            d[i] = reduce_op(d[i], s[i]);                        \
+        }                                                        \
+    } while (0)
+
+/* Returns the size of the elements of the values, or 0 if the flags or the size of the values are invalid */
+static uint32_t
+jbpf_bpf_map_reduce_elem_size(uint32_t size, uint64_t flags)
+{
+    uint32_t elem_size;
+
+    switch (flags & JBPF_MAP_REDUCE_TYPE_MASK) {
+    case JBPF_MAP_REDUCE_U64:
+    case JBPF_MAP_REDUCE_S64:
+        elem_size = sizeof(uint64_t);
+        break;
+    case JBPF_MAP_REDUCE_U32:
+    case JBPF_MAP_REDUCE_S32:
+        elem_size = sizeof(uint32_t);
+        break;
+    default:
+        return 0;
+    }
+
+    if ((flags & JBPF_MAP_REDUCE_OP_MASK) > JBPF_MAP_REDUCE_OR || size == 0 || size % elem_size != 0)
+        return 0;
+
+    return elem_size;
+}
+
+int
+jbpf_bpf_map_reduce_values(void* dst, const void* src, uint32_t size, uint64_t flags)
+{
+    uint32_t elem_size;
+    uint32_t n;
+    uint64_t type = flags & JBPF_MAP_REDUCE_TYPE_MASK;
+
+    if (!dst || !src)
+        return JBPF_MAP_ERROR;
+
+    elem_size = jbpf_bpf_map_reduce_elem_size(size, flags);
+    if (elem_size == 0)
+        return JBPF_MAP_ERROR;
+
+    n = size / elem_size;
+
+    switch (flags & JBPF_MAP_REDUCE_OP_MASK) {
+    case JBPF_MAP_REDUCE_SUM:
+        // The sums wrap around, so the signed and the unsigned elements are added alike
+        if (elem_size == sizeof(uint64_t))
+            JBPF_REDUCE_LOOP(jbpf_reduce_u64_t, dst, src, n, JBPF_REDUCE_ADD);
+        else
+            JBPF_REDUCE_LOOP(jbpf_reduce_u32_t, dst, src, n, JBPF_REDUCE_ADD);
+        break;
+    case JBPF_MAP_REDUCE_OR:
+        if (elem_size == sizeof(uint64_t))
+            JBPF_REDUCE_LOOP(jbpf_reduce_u64_t, dst, src, n, JBPF_REDUCE_OR);
+        else
+            JBPF_REDUCE_LOOP(jbpf_reduce_u32_t, dst, src, n, JBPF_REDUCE_OR);
+        break;
+    case JBPF_MAP_REDUCE_MIN:
+        if (type == JBPF_MAP_REDUCE_U64)
+            JBPF_REDUCE_LOOP(jbpf_reduce_u64_t, dst, src, n, JBPF_REDUCE_MIN);
+        else if (type == JBPF_MAP_REDUCE_U32)
+            JBPF_REDUCE_LOOP(jbpf_reduce_u32_t, dst, src, n, JBPF_REDUCE_MIN);
+        else if (type == JBPF_MAP_REDUCE_S64)
+            JBPF_REDUCE_LOOP(jbpf_reduce_s64_t, dst, src, n, JBPF_REDUCE_MIN);
+        else
+            JBPF_REDUCE_LOOP(jbpf_reduce_s32_t, dst, src, n, JBPF_REDUCE_MIN);
+        break;
+    case JBPF_MAP_REDUCE_MAX:
+        if (type == JBPF_MAP_REDUCE_U64)
+            JBPF_REDUCE_LOOP(jbpf_reduce_u64_t, dst, src, n, JBPF_REDUCE_MAX);
+        else if (type == JBPF_MAP_REDUCE_U32)
+            JBPF_REDUCE_LOOP(jbpf_reduce_u32_t, dst, src, n, JBPF_REDUCE_MAX);
+        else if (type == JBPF_MAP_REDUCE_S64)
+            JBPF_REDUCE_LOOP(jbpf_reduce_s64_t, dst, src, n, JBPF_REDUCE_MAX);
+        else
+            JBPF_REDUCE_LOOP(jbpf_reduce_s32_t, dst, src, n, JBPF_REDUCE_MAX);
+        break;
+    }
+
+    return JBPF_MAP_SUCCESS;
+}
+
+/* Look up a key in the copy of a thread, without modifying the copy */
+static void*
+jbpf_bpf_map_reduce_peek(const struct jbpf_map* copy, const void* key)
+{
+    switch (copy->type) {
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        return jbpf_bpf_array_lookup_elem(copy, key);
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        return jbpf_bpf_spsc_hashmap_lookup_elem(copy, key);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        return jbpf_bpf_spsc_lru_hashmap_peek_elem(copy, key);
+    default:
+        return NULL;
+    }
+}
+
+static bool
+jbpf_bpf_map_reduce_is_per_thread(const struct jbpf_map* map)
+{
+    return map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY || map->type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP ||
+           map->type == JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP;
+}
+
+int
+jbpf_bpf_map_reduce(
+    const struct jbpf_map* map, int num_slots, const void* key, void* out, uint32_t out_size, uint64_t flags)
+{
+    const struct jbpf_map* copies;
+    uint32_t size;
+    void* value;
+    int reduced = 0;
+
+    if (!map || !map->data || !out || num_slots < 0 || !jbpf_bpf_map_reduce_is_per_thread(map))
+        return JBPF_MAP_ERROR;
+
+    copies = map->data;
+    if (num_slots > JBPF_MAX_NUM_REG_THREADS)
+        num_slots = JBPF_MAX_NUM_REG_THREADS;
+
+    if (flags & JBPF_MAP_REDUCE_ALL_KEYS) {
+        // The values of an array are contiguous, so the whole array is reduced at once
+        if (map->type != JBPF_MAP_TYPE_PER_THREAD_ARRAY)
+            return JBPF_MAP_ERROR;
+        size = map->max_entries * map->value_size;
+        if (out_size < size || jbpf_bpf_map_reduce_elem_size(size, flags) == 0)
+            return JBPF_MAP_ERROR;
+        for (int slot = 0; slot < num_slots; slot++) {
+            if (slot == 0)
+                memcpy(out, copies[slot].data, size);
+            else
+                jbpf_bpf_map_reduce_values(out, copies[slot].data, size, flags);
+        }
+        return num_slots;
+    }
+
+    if (!key || out_size < map->value_size || jbpf_bpf_map_reduce_elem_size(map->value_size, flags) == 0)
+        return JBPF_MAP_ERROR;
+
+    for (int slot = 0; slot < num_slots; slot++) {
+        value = jbpf_bpf_map_reduce_peek(&copies[slot], key);
+        if (!value)
+            continue;
+        if (reduced == 0)
+            memcpy(out, value, map->value_size);
+        else
+            jbpf_bpf_map_reduce_values(out, value, map->value_size, flags);
+        reduced++;
+    }
+
+    return reduced;
+}
+
+/* Write the pair of a key found in the copy of a thread, unless the key was already written from the copy of a
+ * previous thread. The key is copied first, and then looked up from the buffer, as the copy of the thread may be
+ * updated concurrently. Returns whether the pair was written */
+static bool
+jbpf_bpf_map_reduce_emit(
+    const struct jbpf_map* map, int slot, int num_slots, const void* key, const void* value, uint8_t* out,
+    uint64_t flags)
+{
+    const struct jbpf_map* copies = map->data;
+    uint8_t* out_value = out + map->key_size;
+    void* other;
+
+    memcpy(out, key, map->key_size);
+    for (int prev = 0; prev < slot; prev++) {
+        if (jbpf_bpf_map_reduce_peek(&copies[prev], out))
+            return false;
+    }
+
+    memcpy(out_value, value, map->value_size);
+    for (int next = slot + 1; next < num_slots; next++) {
+        other = jbpf_bpf_map_reduce_peek(&copies[next], out);
+        if (other)
+            jbpf_bpf_map_reduce_values(out_value, other, map->value_size, flags);
+    }
+    return true;
+}
+
+int
+jbpf_bpf_map_dump_aggregated(const struct jbpf_map* map, int num_slots, void* data, uint32_t max_size, uint64_t flags)
+{
+    const struct jbpf_map* copies;
+    jbpf_spsc_hashmap_t* hmap;
+    jbpf_lru_hashmap_t* lru;
+    struct jbpf_lru_hnode* node;
+    uint8_t* data_ptr = data;
+    uint32_t pair_size;
+    int count = 0;
+
+    if (!map || !map->data || !data || num_slots < 0 || !jbpf_bpf_map_reduce_is_per_thread(map))
+        return JBPF_MAP_ERROR;
+
+    if (jbpf_bpf_map_reduce_elem_size(map->value_size, flags) == 0)
+        return JBPF_MAP_ERROR;
+
+    copies = map->data;
+    if (num_slots > JBPF_MAX_NUM_REG_THREADS)
+        num_slots = JBPF_MAX_NUM_REG_THREADS;
+
+    if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY) {
+        pair_size = sizeof(uint32_t) + map->value_size;
+        for (uint32_t idx = 0; num_slots > 0 && idx < map->max_entries; idx++) {
+            if ((count + 1) * pair_size > max_size)
+                break;
+            memcpy(data_ptr, &idx, sizeof(uint32_t));
+            jbpf_bpf_map_reduce(
+                map, num_slots, &idx, data_ptr + sizeof(uint32_t), map->value_size, flags & ~JBPF_MAP_REDUCE_ALL_KEYS);
+            data_ptr += pair_size;
+            count++;
+        }
+        return count;
+    }
+
+    pair_size = map->key_size + map->value_size;
+
+    for (int slot = 0; slot < num_slots; slot++) {
+        if (map->type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP) {
+            hmap = copies[slot].data;
+            for (uint32_t idx = 0; idx < hmap->ht_size; idx++) {
+                if (hmap->ctrl[idx] & JBPF_SPSC_HASHMAP_CTRL_EMPTY)
+                    continue;
+                if ((count + 1) * pair_size > max_size)
+                    return count;
+                if (jbpf_bpf_map_reduce_emit(
+                        map,
+                        slot,
+                        num_slots,
+                        jbpf_bpf_spsc_hashmap_slot(hmap, idx),
+                        jbpf_bpf_spsc_hashmap_slot(hmap, idx) + hmap->value_offset,
+                        data_ptr,
+                        flags)) {
+                    data_ptr += pair_size;
+                    count++;
+                }
+            }
+        } else {
+            // The walk is bounded, as the recency list may be relinked by the owner thread meanwhile
+            lru = copies[slot].data;
+            uint32_t idx = lru->head;
+            for (unsigned int steps = 0; idx != JBPF_LRU_HNODE_NIL && steps < lru->max_entries; steps++) {
+                node = jbpf_bpf_lru_hnode(lru, idx);
+                if ((count + 1) * pair_size > max_size)
+                    return count;
+                if (jbpf_bpf_map_reduce_emit(
+                        map,
+                        slot,
+                        num_slots,
+                        jbpf_bpf_lru_hnode_key(node),
+                        jbpf_bpf_lru_hnode_value(lru, node),
+                        data_ptr,
+                        flags)) {
+                    data_ptr += pair_size;
+                    count++;
+                }
+                idx = node->next;
+            }
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_BPF_MAP_REDUCE_H
+#define JBPF_BPF_MAP_REDUCE_H
+
+#include <stdint.h>
+
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_int.h"
+
+/* Aggregated read path of the per-thread maps (JBPF_MAP_TYPE_PER_THREAD_ARRAY, JBPF_MAP_TYPE_PER_THREAD_HASHMAP and
+ * JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP). The values of the copies of the first num_slots threads are combined element
+ * by element, with the operation and the element type of the JBPF_MAP_REDUCE_* flags.
+ *
+ * The copies are read without any lock while their threads may update them, so the results are best-effort
+ * snapshots: an update that happens during the read may be missed or seen partially. Copies of threads that were
+ * registered but never wrote to an array hold zeros, which take part in JBPF_MAP_REDUCE_MIN and
+ * JBPF_MAP_REDUCE_MAX */
+
+/**
+ * @brief Combine a value into another one, element by element
+ * @param dst The value to update
+ * @param src The value to combine into dst
+ * @param size The size of the values, a multiple of the size of the elements
+ * @param flags The operation and the element type
+ * @return JBPF_MAP_SUCCESS on success, JBPF_MAP_ERROR if the flags or the size are invalid
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_reduce_values(void* dst, const void* src, uint32_t size, uint64_t flags);
+
+/**
+ * @brief Reduce the value of a key over the thread copies of a per-thread map
+ * @param map The per-thread map
+ * @param num_slots The number of thread copies to reduce
+ * @param key The key. Ignored for a JBPF_MAP_TYPE_PER_THREAD_ARRAY with JBPF_MAP_REDUCE_ALL_KEYS
+ * @param out The buffer of the result, of at least value_size bytes, or max_entries * value_size bytes with
+ * JBPF_MAP_REDUCE_ALL_KEYS
+ * @param out_size The size of the buffer
+ * @param flags The operation, the element type and JBPF_MAP_REDUCE_ALL_KEYS
+ * @return The number of copies reduced, 0 if the key is in none of them, or JBPF_MAP_ERROR on failure
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_reduce(
+    const struct jbpf_map* map, int num_slots, const void* key, void* out, uint32_t out_size, uint64_t flags);
+
+/**
+ * @brief Dump a per-thread map with the values of each key reduced over the thread copies
+ * @param map The per-thread map
+ * @param num_slots The number of thread copies to reduce
+ * @param data The data buffer, filled with | key | value | pairs. The keys of a JBPF_MAP_TYPE_PER_THREAD_ARRAY are
+ * their uint32_t index
+ * @param max_size The size of the buffer
+ * @param flags The operation and the element type
+ * @return The number of pairs copied to the buffer, or JBPF_MAP_ERROR on failure. The pairs that do not fit in the
+ * buffer are not copied
+ * @ingroup core
+ */
+int
+jbpf_bpf_map_dump_aggregated(
+    const struct jbpf_map* map, int num_slots, void* data, uint32_t max_size, uint64_t flags);
+
+#endif
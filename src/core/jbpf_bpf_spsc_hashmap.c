@@ -6,6 +6,7 @@ jbpf_bpf_spsc_hashmap_create(const struct jbpf_load_map_def* map_def)
 {
 
     struct jbpf_bpf_spsc_hashmap* hmap;
+    uint32_t num_slots;
 
     if (!map_def)
         return NULL;
@@ -19,19 +20,33 @@ jbpf_bpf_spsc_hashmap_create(const struct jbpf_load_map_def* map_def)
     hmap->value_size = map_def->value_size;
     hmap->max_entries = map_def->max_entries;
     hmap->count = 0;
+    hmap->tombstones = 0;
 
-    // Make hashtable to be power of 2 for faster lookups
-    hmap->ht_size = round_up_pow_of_two(hmap->max_entries);
+    // Make hashtable to be power of 2 for faster lookups, with enough slots to keep max_entries under the max load
+    num_slots = hmap->max_entries + hmap->max_entries / 7 + 1;
+    if (num_slots < JBPF_SPSC_HASHMAP_GROUP_SIZE)
+        num_slots = JBPF_SPSC_HASHMAP_GROUP_SIZE;
+    hmap->ht_size = round_up_pow_of_two(num_slots);
+    hmap->group_mask = hmap->ht_size / JBPF_SPSC_HASHMAP_GROUP_SIZE - 1;
 
-    // Each entry of the table has the following structure | used | key | value |
-    // The "used" value designates whether an entry is empty (0) or used (1)
-    hmap->ht = jbpf_calloc_mem(hmap->ht_size, hmap->key_size + hmap->value_size + 1);
+    // Keys and values are 8-byte aligned, so that codelets can access the values with atomic operations
+    hmap->value_offset = round_up(hmap->key_size, (uint32_t)sizeof(uint64_t));
+    hmap->slot_size = round_up(hmap->value_offset + hmap->value_size, (uint32_t)sizeof(uint64_t));
 
-    if (!hmap->ht) {
+    hmap->ctrl = jbpf_alloc_mem(hmap->ht_size);
+    hmap->ht = jbpf_calloc_mem(hmap->ht_size, hmap->slot_size);
+    hmap->scratch = jbpf_calloc_mem(1, hmap->slot_size);
+
+    if (!hmap->ctrl || !hmap->ht || !hmap->scratch) {
+        jbpf_free_mem(hmap->ctrl);
+        jbpf_free_mem(hmap->ht);
+        jbpf_free_mem(hmap->scratch);
         jbpf_free_mem(hmap);
         return NULL;
     }
 
+    memset(hmap->ctrl, JBPF_SPSC_HASHMAP_CTRL_EMPTY, hmap->ht_size);
+
     return hmap;
 }
 
@@ -46,6 +61,53 @@ jbpf_bpf_spsc_hashmap_destroy(struct jbpf_map* map)
 
     hmap = (jbpf_spsc_hashmap_t*)map->data;
 
+    jbpf_free_mem(hmap->ctrl);
     jbpf_free_mem(hmap->ht);
+    jbpf_free_mem(hmap->scratch);
     jbpf_free_mem(hmap);
 }
+
+void
+jbpf_bpf_spsc_hashmap_drop_deleted(jbpf_spsc_hashmap_t* hmap)
+{
+    uint32_t hash, group_idx;
+    int64_t target;
+    uint8_t *slot, *target_slot;
+
+    // Mark the used slots as deleted, to tell the slots that still have to be placed, and the deleted slots as empty
+    for (uint32_t idx = 0; idx < hmap->ht_size; idx++) {
+        hmap->ctrl[idx] = (hmap->ctrl[idx] & JBPF_SPSC_HASHMAP_CTRL_EMPTY) ? JBPF_SPSC_HASHMAP_CTRL_EMPTY
+                                                                           : JBPF_SPSC_HASHMAP_CTRL_DELETED;
+    }
+
+    for (uint32_t idx = 0; idx < hmap->ht_size; idx++) {
+        if (hmap->ctrl[idx] != JBPF_SPSC_HASHMAP_CTRL_DELETED)
+            continue;
+
+        slot = jbpf_bpf_spsc_hashmap_slot(hmap, idx);
+        hash = jbpf_bpf_spsc_hashmap_hash(slot, hmap->key_size);
+        target = jbpf_bpf_spsc_hashmap_find_free(hmap, hash);
+        group_idx = idx / JBPF_SPSC_HASHMAP_GROUP_SIZE;
+
+        // The slot is already in the first group of its probe sequence with a free slot
+        if (target / JBPF_SPSC_HASHMAP_GROUP_SIZE == group_idx) {
+            hmap->ctrl[idx] = jbpf_bpf_spsc_hashmap_h2(hash);
+            continue;
+        }
+
+        target_slot = jbpf_bpf_spsc_hashmap_slot(hmap, target);
+        if (hmap->ctrl[target] == JBPF_SPSC_HASHMAP_CTRL_EMPTY) {
+            memcpy(target_slot, slot, hmap->slot_size);
+            hmap->ctrl[idx] = JBPF_SPSC_HASHMAP_CTRL_EMPTY;
+        } else {
+            // The target slot has yet to be placed. Swap the slots and place the swapped slot next
+            memcpy(hmap->scratch, target_slot, hmap->slot_size);
+            memcpy(target_slot, slot, hmap->slot_size);
+            memcpy(slot, hmap->scratch, hmap->slot_size);
+            idx--;
+        }
+        hmap->ctrl[target] = jbpf_bpf_spsc_hashmap_h2(hash);
+    }
+
+    hmap->tombstones = 0;
+}
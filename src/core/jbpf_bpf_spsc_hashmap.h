@@ -11,19 +11,162 @@
 
 #include "jbpf_lookup3.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 typedef struct jbpf_bpf_spsc_hashmap jbpf_spsc_hashmap_t;
 
+/* The table is an open addressing table, with the control bytes of the slots in a separate array (Swiss table).
+ * The hash of a key selects the first group of slots to probe (h1) and the tag stored in the control byte (h2).
+ * The control bytes of a group are compared to the tag at once, so that the key is only compared for the slots with
+ * a matching tag. The probing stops at the first group with an empty slot, and visits each group at most once.
+ *
+ * The matches of a group are returned as a bitmask with JBPF_SPSC_HASHMAP_MASK_STRIDE bits per slot */
+#if defined(__ARM_NEON)
+#define JBPF_SPSC_HASHMAP_MASK_STRIDE (4)
+#else
+#define JBPF_SPSC_HASHMAP_MASK_STRIDE (1)
+#endif
+
 static inline __attribute__((always_inline)) uint32_t
 jbpf_bpf_spsc_hashmap_hash(const void* key, size_t key_size)
 {
     return hashlittle(key, key_size, 6602834);
 }
 
+static inline __attribute__((always_inline)) uint32_t
+jbpf_bpf_spsc_hashmap_h1(uint32_t hash)
+{
+    return hash >> 7;
+}
+
+static inline __attribute__((always_inline)) uint8_t
+jbpf_bpf_spsc_hashmap_h2(uint32_t hash)
+{
+    return hash & 0x7F;
+}
+
+/* Slots of the group with the control byte c */
+static inline __attribute__((always_inline)) uint64_t
+jbpf_bpf_spsc_hashmap_group_match(const uint8_t* group, uint8_t c)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+#elif defined(__ARM_NEON)
+    uint8x16_t eq = vceqq_u8(vld1q_u8(group), vdupq_n_u8(c));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ULL;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < JBPF_SPSC_HASHMAP_GROUP_SIZE; i++) {
+        mask |= (uint64_t)(group[i] == c) << i;
+    }
+    return mask;
+#endif
+}
+
+/* Slots of the group that are empty or deleted, i.e. whose control byte has the high bit set */
+static inline __attribute__((always_inline)) uint64_t
+jbpf_bpf_spsc_hashmap_group_match_free(const uint8_t* group)
+{
+#if defined(__SSE2__)
+    return (uint16_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#elif defined(__ARM_NEON)
+    uint8x16_t match = vtstq_u8(vld1q_u8(group), vdupq_n_u8(0x80));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x8888888888888888ULL;
+#else
+    uint64_t mask = 0;
+    for (int i = 0; i < JBPF_SPSC_HASHMAP_GROUP_SIZE; i++) {
+        mask |= (uint64_t)(group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+/* Index in the group of the first slot of a non-zero mask */
+static inline __attribute__((always_inline)) unsigned int
+jbpf_bpf_spsc_hashmap_mask_first(uint64_t mask)
+{
+    return __builtin_ctzll(mask) / JBPF_SPSC_HASHMAP_MASK_STRIDE;
+}
+
+static inline __attribute__((always_inline)) uint8_t*
+jbpf_bpf_spsc_hashmap_slot(const jbpf_spsc_hashmap_t* hmap, uint32_t idx)
+{
+    return (uint8_t*)hmap->ht + (size_t)idx * hmap->slot_size;
+}
+
 void*
 jbpf_bpf_spsc_hashmap_create(const struct jbpf_load_map_def* map_def);
 void
 jbpf_bpf_spsc_hashmap_destroy(struct jbpf_map* map);
 
+/**
+ * @brief Rehash a per-thread hashmap in place, to turn the deleted slots into empty slots
+ * @param hmap The hashmap
+ * @ingroup core
+ */
+void
+jbpf_bpf_spsc_hashmap_drop_deleted(jbpf_spsc_hashmap_t* hmap);
+
+/* Find the slot of a key. Returns the index of the slot, or -1 if the key is not in the map */
+static inline __attribute__((always_inline)) int64_t
+jbpf_bpf_spsc_hashmap_find(const jbpf_spsc_hashmap_t* hmap, const void* key, uint32_t hash)
+{
+    uint32_t group_idx, idx;
+    uint8_t h2;
+    uint64_t mask;
+    const uint8_t* group;
+
+    group_idx = jbpf_bpf_spsc_hashmap_h1(hash) & hmap->group_mask;
+    h2 = jbpf_bpf_spsc_hashmap_h2(hash);
+
+    for (uint32_t probe = 0; probe <= hmap->group_mask; probe++) {
+        group = hmap->ctrl + group_idx * JBPF_SPSC_HASHMAP_GROUP_SIZE;
+
+        for (mask = jbpf_bpf_spsc_hashmap_group_match(group, h2); mask; mask &= mask - 1) {
+            idx = group_idx * JBPF_SPSC_HASHMAP_GROUP_SIZE + jbpf_bpf_spsc_hashmap_mask_first(mask);
+            if (memcmp(jbpf_bpf_spsc_hashmap_slot(hmap, idx), key, hmap->key_size) == 0) {
+                return idx;
+            }
+        }
+
+        if (jbpf_bpf_spsc_hashmap_group_match(group, JBPF_SPSC_HASHMAP_CTRL_EMPTY)) {
+            return -1;
+        }
+
+        // Triangular probing, which visits all the groups since their number is a power of 2
+        group_idx = (group_idx + probe + 1) & hmap->group_mask;
+    }
+
+    return -1;
+}
+
+/* Find the first empty or deleted slot in the probe sequence of a hash */
+static inline __attribute__((always_inline)) int64_t
+jbpf_bpf_spsc_hashmap_find_free(const jbpf_spsc_hashmap_t* hmap, uint32_t hash)
+{
+    uint32_t group_idx;
+    uint64_t mask;
+
+    group_idx = jbpf_bpf_spsc_hashmap_h1(hash) & hmap->group_mask;
+
+    for (uint32_t probe = 0; probe <= hmap->group_mask; probe++) {
+        mask = jbpf_bpf_spsc_hashmap_group_match_free(hmap->ctrl + group_idx * JBPF_SPSC_HASHMAP_GROUP_SIZE);
+        if (mask) {
+            return group_idx * JBPF_SPSC_HASHMAP_GROUP_SIZE + jbpf_bpf_spsc_hashmap_mask_first(mask);
+        }
+        group_idx = (group_idx + probe + 1) & hmap->group_mask;
+    }
+
+    return -1;
+}
+
 static inline __attribute__((always_inline)) unsigned int
 jbpf_bpf_spsc_hashmap_size(const struct jbpf_map* map)
 {
@@ -47,7 +190,8 @@ jbpf_bpf_spsc_hashmap_clear(const struct jbpf_map* map)
     hmap = (jbpf_spsc_hashmap_t*)map->data;
 
     hmap->count = 0;
-    memset(hmap->ht, 0, (hmap->key_size + hmap->value_size + 1) * hmap->ht_size);
+    hmap->tombstones = 0;
+    memset(hmap->ctrl, JBPF_SPSC_HASHMAP_CTRL_EMPTY, hmap->ht_size);
 
     return JBPF_MAP_SUCCESS;
 }
@@ -57,69 +201,51 @@ jbpf_bpf_spsc_hashmap_dump(const struct jbpf_map* map, void* data, uint32_t max_
 {
 
     jbpf_spsc_hashmap_t* hmap;
-    uint32_t hash_idx;
-    uint8_t* entry_ptr;
     uint32_t count = 0;
     uint8_t* data_ptr;
+    uint8_t* slot;
 
     if (!map || !data)
         return JBPF_MAP_ERROR;
 
     hmap = (jbpf_spsc_hashmap_t*)map->data;
 
-    hash_idx = 0;
-    entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
     data_ptr = data;
 
-    while ((count < hmap->count) && hash_idx < hmap->ht_size) {
-        if (*(uint8_t*)entry_ptr == 1) {
-            memcpy(data_ptr, entry_ptr + 1, hmap->key_size);
-            memcpy(data_ptr + hmap->key_size, entry_ptr + 1 + hmap->key_size, hmap->value_size);
-            data_ptr += (hmap->key_size + hmap->value_size);
-            count++;
+    for (uint32_t idx = 0; (count < hmap->count) && idx < hmap->ht_size; idx++) {
+        if (hmap->ctrl[idx] & JBPF_SPSC_HASHMAP_CTRL_EMPTY) {
+            continue;
         }
-
-        hash_idx++;
+        if ((count + 1) * (hmap->key_size + hmap->value_size) > max_size) {
+            break;
+        }
+        slot = jbpf_bpf_spsc_hashmap_slot(hmap, idx);
+        memcpy(data_ptr, slot, hmap->key_size);
+        memcpy(data_ptr + hmap->key_size, slot + hmap->value_offset, hmap->value_size);
+        data_ptr += (hmap->key_size + hmap->value_size);
+        count++;
     }
 
-    return hmap->count;
+    return count;
 }
 
 static inline __attribute__((always_inline)) void*
 jbpf_bpf_spsc_hashmap_lookup_elem(const struct jbpf_map* map, const void* key)
 {
     jbpf_spsc_hashmap_t* hmap;
-    uint32_t hash_idx, orig_idx;
-    uint8_t* entry_ptr;
+    int64_t idx;
 
     if (!map || !key)
         return NULL;
 
     hmap = (jbpf_spsc_hashmap_t*)map->data;
 
-    hash_idx = jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size) & (hmap->ht_size - 1);
-    orig_idx = hash_idx;
-
-    entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
-
-    do {
-        // Check if entry is used or not
-        if (*(uint8_t*)entry_ptr == 0) {
-            return NULL;
-        }
-
-        // Check the key
-        if (memcmp(entry_ptr + 1, key, hmap->key_size) == 0) {
-            return entry_ptr + hmap->key_size + 1;
-        }
-
-        // Go to the next entry
-        hash_idx = (hash_idx + 1) & (hmap->ht_size - 1);
-        entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
-
-    } while (orig_idx != hash_idx);
+    idx = jbpf_bpf_spsc_hashmap_find(hmap, key, jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size));
+    if (idx < 0) {
+        return NULL;
+    }
 
-    return NULL;
+    return jbpf_bpf_spsc_hashmap_slot(hmap, idx) + hmap->value_offset;
 }
 
 static inline __attribute__((always_inline)) void*
@@ -142,130 +268,100 @@ jbpf_bpf_spsc_hashmap_reset_elem(const struct jbpf_map* map, const void* key)
     return elem;
 }
 
-#pragma message("WARNING: Hashmap update functionality using flags is not implemented yet")
+/* Update an element, with the hash of the key computed */
 static inline __attribute__((always_inline)) int
-jbpf_bpf_spsc_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
+jbpf_bpf_spsc_hashmap_update_hashed(jbpf_spsc_hashmap_t* hmap, const void* key, const void* value, uint32_t hash)
 {
-    jbpf_spsc_hashmap_t* hmap;
-    uint32_t hash_idx, orig_idx;
-    uint8_t* entry_ptr;
-
-    if (!map || !key || !value)
-        return JBPF_MAP_ERROR;
+    int64_t idx;
+    uint8_t* slot;
 
-    hmap = (jbpf_spsc_hashmap_t*)map->data;
+    idx = jbpf_bpf_spsc_hashmap_find(hmap, key, hash);
+    if (idx >= 0) {
+        memcpy(jbpf_bpf_spsc_hashmap_slot(hmap, idx) + hmap->value_offset, value, hmap->value_size);
+        return JBPF_MAP_SUCCESS;
+    }
 
-    hash_idx = jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size) & (hmap->ht_size - 1);
-    orig_idx = hash_idx;
-    entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
+    if (hmap->count == hmap->max_entries) {
+        return JBPF_MAP_FULL;
+    }
 
-    do {
-        // Check if the entry is free and we have space
-        if (*(uint8_t*)entry_ptr == 0) {
+    idx = jbpf_bpf_spsc_hashmap_find_free(hmap, hash);
 
-            if (hmap->count == hmap->max_entries) {
-                return JBPF_MAP_FULL;
-            }
+    // Taking an empty slot would leave too few empty slots to stop the probing early
+    if (idx >= 0 && hmap->ctrl[idx] == JBPF_SPSC_HASHMAP_CTRL_EMPTY &&
+        hmap->count + hmap->tombstones + 1 > JBPF_SPSC_HASHMAP_MAX_LOAD(hmap->ht_size)) {
+        jbpf_bpf_spsc_hashmap_drop_deleted(hmap);
+        idx = jbpf_bpf_spsc_hashmap_find_free(hmap, hash);
+    }
 
-            *(uint8_t*)entry_ptr = 1;
-            memcpy(entry_ptr + 1, key, hmap->key_size);
-            memcpy(entry_ptr + hmap->key_size + 1, value, hmap->value_size);
-            hmap->count++;
-            return JBPF_MAP_SUCCESS;
-        } else if (memcmp(entry_ptr + 1, key, hmap->key_size) == 0) {
-            memcpy(entry_ptr + 1, key, hmap->key_size);
-            memcpy(entry_ptr + hmap->key_size + 1, value, hmap->value_size);
-            return JBPF_MAP_SUCCESS;
-        }
+    if (idx < 0) {
+        return JBPF_MAP_FULL;
+    }
 
-        // Go to the next entry
-        hash_idx = (hash_idx + 1) & (hmap->ht_size - 1);
-        entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
+    if (hmap->ctrl[idx] == JBPF_SPSC_HASHMAP_CTRL_DELETED) {
+        hmap->tombstones--;
+    }
 
-    } while (orig_idx != hash_idx);
+    slot = jbpf_bpf_spsc_hashmap_slot(hmap, idx);
+    memcpy(slot, key, hmap->key_size);
+    memcpy(slot + hmap->value_offset, value, hmap->value_size);
+    hmap->ctrl[idx] = jbpf_bpf_spsc_hashmap_h2(hash);
+    hmap->count++;
 
-    return JBPF_MAP_FULL;
+    return JBPF_MAP_SUCCESS;
 }
 
-static inline __attribute__((always_inline)) long int
-jbpf_bpf_spsc_hashmap_restructure(jbpf_spsc_hashmap_t* hmap, uint32_t root_idx)
+#pragma message("WARNING: Hashmap update functionality using flags is not implemented yet")
+static inline __attribute__((always_inline)) int
+jbpf_bpf_spsc_hashmap_update_elem(struct jbpf_map* map, const void* key, void* value, uint64_t flags)
 {
-    uint8_t* entry_ptr;
-    uint8_t* root_entry_ptr;
-    uint32_t hash_idx, new_idx;
+    jbpf_spsc_hashmap_t* hmap;
 
-    hash_idx = root_idx;
-    hash_idx = (hash_idx + 1) & (hmap->ht_size - 1);
-    entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
-    root_entry_ptr = (uint8_t*)hmap->ht + (root_idx * (hmap->key_size + hmap->value_size + 1));
+    if (!map || !key || !value)
+        return JBPF_MAP_ERROR;
 
-    while (hash_idx != root_idx) {
+    hmap = (jbpf_spsc_hashmap_t*)map->data;
 
-        if (*(uint8_t*)entry_ptr == 0) {
-            return -1;
-        }
+    return jbpf_bpf_spsc_hashmap_update_hashed(hmap, key, value, jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size));
+}
 
-        new_idx = jbpf_bpf_spsc_hashmap_hash(entry_ptr + 1, hmap->key_size);
+/* Delete an element, with the hash of the key computed */
+static inline __attribute__((always_inline)) int
+jbpf_bpf_spsc_hashmap_delete_hashed(jbpf_spsc_hashmap_t* hmap, const void* key, uint32_t hash)
+{
+    int64_t idx;
+    const uint8_t* group;
 
-        if (new_idx <= root_idx) {
-            memcpy(root_entry_ptr, entry_ptr, hmap->key_size + hmap->value_size + 1);
-            memset(entry_ptr, 0, hmap->key_size + hmap->value_size + 1);
-            return new_idx;
-        }
+    idx = jbpf_bpf_spsc_hashmap_find(hmap, key, hash);
+    if (idx < 0) {
+        return JBPF_MAP_ERROR;
+    }
 
-        // Go to the next entry
-        hash_idx = (hash_idx + 1) & (hmap->ht_size - 1);
-        entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
+    // If the group has an empty slot, no probing went past it, so the slot can be emptied. Otherwise, a tombstone
+    // keeps the probing going to the next groups
+    group = hmap->ctrl + (idx & ~(JBPF_SPSC_HASHMAP_GROUP_SIZE - 1));
+    if (jbpf_bpf_spsc_hashmap_group_match(group, JBPF_SPSC_HASHMAP_CTRL_EMPTY)) {
+        hmap->ctrl[idx] = JBPF_SPSC_HASHMAP_CTRL_EMPTY;
+    } else {
+        hmap->ctrl[idx] = JBPF_SPSC_HASHMAP_CTRL_DELETED;
+        hmap->tombstones++;
     }
-    return -1;
+    hmap->count--;
+
+    return JBPF_MAP_SUCCESS;
 }
 
 static inline __attribute__((always_inline)) int
 jbpf_bpf_spsc_hashmap_delete_elem(struct jbpf_map* map, const void* key)
 {
     jbpf_spsc_hashmap_t* hmap;
-    uint32_t hash_idx, orig_idx, new_idx;
-    uint8_t* entry_ptr;
-    bool entry_deleted = false;
 
     if (!map || !key)
         return JBPF_MAP_ERROR;
 
     hmap = (jbpf_spsc_hashmap_t*)map->data;
 
-    hash_idx = jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size) & (hmap->ht_size - 1);
-    orig_idx = hash_idx;
-    entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
-
-    // Entry was empty
-    if (*(uint8_t*)entry_ptr == 0) {
-        return JBPF_MAP_ERROR;
-    }
-
-    do {
-        // Check if the entry is free or contains the key
-        if (memcmp(entry_ptr + 1, key, hmap->key_size) == 0) {
-            entry_deleted = true;
-            hmap->count--;
-            memset(entry_ptr, 0, map->key_size + map->value_size + 1);
-            break;
-        }
-
-        // Go to the next entry
-        hash_idx = (hash_idx + 1) & (hmap->ht_size - 1);
-        entry_ptr = (uint8_t*)hmap->ht + (hash_idx * (hmap->key_size + hmap->value_size + 1));
-
-    } while (orig_idx != hash_idx);
-
-    if (!entry_deleted) {
-        return JBPF_MAP_ERROR;
-    }
-
-    do {
-        new_idx = jbpf_bpf_spsc_hashmap_restructure(hmap, hash_idx);
-    } while (new_idx != -1);
-
-    return JBPF_MAP_SUCCESS;
+    return jbpf_bpf_spsc_hashmap_delete_hashed(hmap, key, jbpf_bpf_spsc_hashmap_hash(key, hmap->key_size));
 }
 
-#endif
\ No newline at end of file
+#endif
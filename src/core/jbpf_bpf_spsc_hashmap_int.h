@@ -1,14 +1,36 @@
 #ifndef JBPF_BPF_SPSC_HASHMAP_INT_H
 #define JBPF_BPF_SPSC_HASHMAP_INT_H
 
+#include <stdint.h>
+
+/* The slots of the table are split in groups of JBPF_SPSC_HASHMAP_GROUP_SIZE slots, that are probed at once */
+#define JBPF_SPSC_HASHMAP_GROUP_SIZE (16)
+
+/* Control bytes. A used slot holds the 7 lower bits of the hash of its key */
+#define JBPF_SPSC_HASHMAP_CTRL_EMPTY (0x80)
+#define JBPF_SPSC_HASHMAP_CTRL_DELETED (0xFE)
+
+/* The table is rehashed in place to drop the tombstones once the used and deleted slots exceed 7/8 of the slots */
+#define JBPF_SPSC_HASHMAP_MAX_LOAD(slots) ((slots) - (slots) / 8)
+
 struct jbpf_bpf_spsc_hashmap
 {
     unsigned int key_size;
     unsigned int value_size;
     unsigned int max_entries;
+    // Number of slots. A power of 2, multiple of JBPF_SPSC_HASHMAP_GROUP_SIZE
     unsigned int ht_size;
+    unsigned int group_mask;
+    // Each slot has the structure | key | padding | value | padding |, with the key and the value 8-byte aligned
+    unsigned int value_offset;
+    unsigned int slot_size;
+    unsigned int tombstones;
+    // One control byte per slot
+    uint8_t* ctrl;
     void* ht;
+    // Space for one slot, used to swap slots when the table is rehashed
+    void* scratch;
     int count;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -32,6 +32,54 @@
  */
 #define DEFAULT_SCHED_PRIORITY 1
 
+/**
+ * @brief Default number of runtime threshold overruns of a codelet within a window before it is quarantined
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_MAX_RUNTIME_OVERRUNS 10
+
+/**
+ * @brief Default length in ms of the window used to count the runtime threshold overruns of a codelet
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_RUNTIME_BUDGET_WINDOW_MS 1000
+
+/**
+ * @brief Default number of worker threads running the codelets of deferred hooks
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_DEFERRED_WORKERS 1
+
+/**
+ * @brief Default number of pending hook calls in the deferred ring of each registered thread
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_DEFERRED_RING_SIZE 256
+
+/**
+ * @brief Default directory of the jitdump file of the JIT-compiled codelets
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_JITDUMP_DIR "/tmp"
+
+/**
+ * @brief Default number of codelet invocations kept in the flight recorder ring of each registered thread
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_TRACE_RING_SIZE 4096
+
+/**
+ * @brief Default directory of the flight recorder dumps requested with the dump signal
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_TRACE_DUMP_DIR "/tmp"
+
+/**
+ * @brief Default name of the socket serving the metrics
+ * @ingroup core
+ */
+#define JBPF_DEFAULT_METRICS_SOCKET "jbpf_metrics"
+
 /**
  * @brief JBPF agent lcm IPC configuration
  * @param has_lcm_ipc_thread Whether to use LCM IPC thread
@@ -172,6 +220,76 @@ struct jbpf_agent_mem_config
     size_t mem_size;
 };
 
+/**
+ * @brief JBPF agent runtime budget configuration
+ * @param max_overruns Number of times a codelet can exceed its runtime threshold within a window before it is
+ * quarantined
+ * @param window_ms Length of the window in ms
+ * @note Only used when jbpf is built with USE_JBPF_RUNTIME_BUDGETS
+ * @ingroup core
+ */
+struct jbpf_agent_runtime_budget_config
+{
+    uint32_t max_overruns;
+    uint32_t window_ms;
+};
+
+/**
+ * @brief JBPF agent deferred hook configuration
+ * @param num_workers Number of worker threads running the codelets of deferred hooks
+ * @param ring_size Number of pending hook calls per registered thread. Rounded up to a power of 2
+ * @note Only used when jbpf is built with USE_JBPF_DEFERRED_HOOKS
+ * @ingroup core
+ */
+struct jbpf_agent_deferred_config
+{
+    uint32_t num_workers;
+    uint32_t ring_size;
+};
+
+/**
+ * @brief JBPF agent perf map configuration, to let Linux perf attribute samples to the JIT-compiled codelets
+ * @param enable_perf_map Write the address range of each loaded codelet to /tmp/perf-<pid>.map
+ * @param enable_jitdump Also write a load record with the code of each codelet to jit-<pid>.dump in jitdump_dir,
+ * to be merged in a profile with perf inject --jit
+ * @param jitdump_dir The directory of the jitdump file
+ * @ingroup core
+ */
+struct jbpf_agent_perf_map_config
+{
+    bool enable_perf_map;
+    bool enable_jitdump;
+    char jitdump_dir[JBPF_RUN_PATH_LEN];
+};
+
+/**
+ * @brief JBPF agent flight recorder configuration
+ * @param ring_size Number of codelet invocations kept per registered thread. Rounded up to a power of 2
+ * @param dump_signal Signal that dumps the rings to jbpf_trace-<pid>-<n>.bin in dump_dir, or 0 for none
+ * @param dump_dir The directory of the dumps requested with dump_signal
+ * @note Only used when jbpf is built with USE_JBPF_TRACE
+ * @ingroup core
+ */
+struct jbpf_agent_trace_config
+{
+    uint32_t ring_size;
+    int dump_signal;
+    char dump_dir[JBPF_RUN_PATH_LEN];
+};
+
+/**
+ * @brief JBPF agent metrics configuration
+ * @param enable_metrics Whether to serve the hook, codelet, map, IO channel and memory metrics in OpenMetrics text
+ * format. The snapshot is updated by the maintenance thread
+ * @param metrics_ipc_name The name of the metrics socket, created next to the LCM IPC socket
+ * @ingroup core
+ */
+struct jbpf_agent_metrics_config
+{
+    bool enable_metrics;
+    char metrics_ipc_name[JBPF_LCM_IPC_NAME_LEN];
+};
+
 /**
  * @brief JBPF agent configuration
  * @param jbpf_run_path The path to the JBPF run directory
@@ -180,6 +298,11 @@ struct jbpf_agent_mem_config
  * @param lcm_ipc_config LCM IPC parameters
  * @param io_config The IO configuration
  * @param thread_config Thread affinity and scheduling configuration parameters
+ * @param runtime_budget_config Enforcement of the runtime thresholds of the codelets
+ * @param deferred_config Worker threads and rings of the deferred hooks
+ * @param perf_map_config Symbols of the JIT-compiled codelets for Linux perf
+ * @param trace_config Flight recorder of the codelet invocations
+ * @param metrics_config Metrics served on a local socket
  * @ingroup core
  */
 struct jbpf_config
@@ -197,6 +320,21 @@ struct jbpf_config
 
     /* Thread affinity and scheduling configuration parameters */
     struct jbpf_agent_thread_config thread_config;
+
+    /* Enforcement of the runtime thresholds of the codelets */
+    struct jbpf_agent_runtime_budget_config runtime_budget_config;
+
+    /* Worker threads and rings of the deferred hooks */
+    struct jbpf_agent_deferred_config deferred_config;
+
+    /* Symbols of the JIT-compiled codelets for Linux perf */
+    struct jbpf_agent_perf_map_config perf_map_config;
+
+    /* Flight recorder of the codelet invocations */
+    struct jbpf_agent_trace_config trace_config;
+
+    /* Metrics served on a local socket */
+    struct jbpf_agent_metrics_config metrics_config;
 };
 
 /**
@@ -231,6 +369,26 @@ jbpf_set_default_config_options(struct jbpf_config* config)
     config->thread_config.has_affinity_maintenance_thread = false;
     config->thread_config.has_sched_policy_maintenance_thread = false;
     config->thread_config.has_sched_priority_maintenance_thread = false;
+
+    config->runtime_budget_config.max_overruns = JBPF_DEFAULT_MAX_RUNTIME_OVERRUNS;
+    config->runtime_budget_config.window_ms = JBPF_DEFAULT_RUNTIME_BUDGET_WINDOW_MS;
+
+    config->deferred_config.num_workers = JBPF_DEFAULT_DEFERRED_WORKERS;
+    config->deferred_config.ring_size = JBPF_DEFAULT_DEFERRED_RING_SIZE;
+
+    config->perf_map_config.enable_perf_map = false;
+    config->perf_map_config.enable_jitdump = false;
+    strncpy(config->perf_map_config.jitdump_dir, JBPF_DEFAULT_JITDUMP_DIR, JBPF_RUN_PATH_LEN - 1);
+    config->perf_map_config.jitdump_dir[JBPF_RUN_PATH_LEN - 1] = '\0';
+
+    config->trace_config.ring_size = JBPF_DEFAULT_TRACE_RING_SIZE;
+    config->trace_config.dump_signal = 0;
+    strncpy(config->trace_config.dump_dir, JBPF_DEFAULT_TRACE_DUMP_DIR, JBPF_RUN_PATH_LEN - 1);
+    config->trace_config.dump_dir[JBPF_RUN_PATH_LEN - 1] = '\0';
+
+    config->metrics_config.enable_metrics = false;
+    strncpy(config->metrics_config.metrics_ipc_name, JBPF_DEFAULT_METRICS_SOCKET, JBPF_LCM_IPC_NAME_LEN - 1);
+    config->metrics_config.metrics_ipc_name[JBPF_LCM_IPC_NAME_LEN - 1] = '\0';
 }
 
 #endif /* JBPF_CONFIG_H */
@@ -0,0 +1,384 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jbpf_deferred.h"
+#include "jbpf_hook.h"
+#include "jbpf_perf.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+#ifdef JBPF_DEFERRED_HOOKS
+
+#define JBPF_MAX_DEFERRED_WORKERS (16)
+/* Time a worker sleeps when none of its rings has pending calls */
+#define DEFERRED_IDLE_WAIT_US (50)
+
+/* A queued hook call: the codelets selected for the call, and the context, followed by the data it points to */
+struct jbpf_deferred_slot
+{
+    struct jbpf_hook* hook;
+    uint32_t ctx_size;
+    uint32_t data_offset;
+    uint32_t data_size;
+    uint32_t num_selected;
+    jbpf_jit_fn selected[JBPF_DEFERRED_MAX_CODELETS];
+    uint8_t buf[JBPF_DEFERRED_SLOT_SIZE] __attribute__((aligned(8)));
+};
+
+/* Single producer (the registered thread) and single consumer (the worker the thread is assigned to) ring.
+ * The indices of the producer and the consumer are kept in different cache lines. */
+struct jbpf_deferred_ring
+{
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    /* Last value of head seen by the producer */
+    uint64_t cached_head;
+    uint64_t mask __attribute__((aligned(64)));
+    struct jbpf_deferred_slot* slots;
+};
+
+static struct jbpf_deferred_ring deferred_rings[JBPF_MAX_NUM_REG_THREADS];
+static pthread_t deferred_workers[JBPF_MAX_DEFERRED_WORKERS];
+static int num_deferred_workers = 0;
+/* Number of configured workers. Each worker serves the rings of every deferred_worker_stride-th thread */
+static int deferred_worker_stride = 1;
+static uint32_t deferred_ring_size = 0;
+static bool deferred_run = false;
+
+/* The filters and samplers of the codelets are evaluated on the calling thread, before a slot is reserved, so that
+ * the calls that no codelet is selected for are not queued. Returns the number of selected codelets, or -1 if there
+ * are more than fit in a slot */
+static int
+select_deferred_codelets(struct jbpf_hook* hook, const void* ctx, size_t ctx_size, jbpf_jit_fn* selected)
+{
+    struct jbpf_hook_codelet* hook_codelet_ptr = ck_pr_load_ptr(&hook->codelets);
+    int num_selected = 0;
+
+    if (!hook_codelet_ptr) {
+        return 0;
+    }
+
+    do {
+#ifdef JBPF_MEASURE_CODELETS
+        if (JBPF_UNLIKELY(jbpf_codelet_quarantined(hook_codelet_ptr))) {
+            continue;
+        }
+#endif
+        if (JBPF_CODELET_SELECTED(ctx, ctx_size)) {
+            if (JBPF_UNLIKELY(num_selected == JBPF_DEFERRED_MAX_CODELETS)) {
+                return -1;
+            }
+            selected[num_selected++] = hook_codelet_ptr->jbpf_codelet;
+        }
+    } while ((++hook_codelet_ptr)->jbpf_codelet);
+
+    return num_selected;
+}
+
+void
+jbpf_defer_hook(struct jbpf_hook* hook, const void* ctx, size_t ctx_size)
+{
+    /* All the jbpf contexts start with data and data_end */
+    const struct jbpf_generic_ctx* generic_ctx = ctx;
+    struct jbpf_deferred_ring* ring;
+    struct jbpf_deferred_slot* slot;
+    jbpf_jit_fn selected[JBPF_DEFERRED_MAX_CODELETS];
+    size_t data_offset, data_size;
+    int num_selected;
+    uint64_t tail;
+
+    if (JBPF_UNLIKELY(__thread_id < 0 || __thread_id >= JBPF_MAX_NUM_REG_THREADS)) {
+        goto drop;
+    }
+
+    ring = &deferred_rings[__thread_id];
+    if (JBPF_UNLIKELY(!ring->slots)) {
+        goto drop;
+    }
+
+    num_selected = select_deferred_codelets(hook, ctx, ctx_size, selected);
+    if (num_selected == 0) {
+        return;
+    }
+    if (JBPF_UNLIKELY(num_selected < 0)) {
+        goto drop;
+    }
+
+    data_size = generic_ctx->data_end > generic_ctx->data ? generic_ctx->data_end - generic_ctx->data : 0;
+    data_offset = (ctx_size + 7) & ~(size_t)7;
+    if (JBPF_UNLIKELY(data_offset + data_size > JBPF_DEFERRED_SLOT_SIZE)) {
+        goto drop;
+    }
+
+    tail = ring->tail;
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = ck_pr_load_64(&ring->head);
+        ck_pr_fence_acquire();
+        if (tail - ring->cached_head > ring->mask) {
+            goto drop;
+        }
+    }
+
+    slot = &ring->slots[tail & ring->mask];
+    slot->hook = hook;
+    slot->ctx_size = ctx_size;
+    slot->data_offset = data_offset;
+    slot->data_size = data_size;
+    slot->num_selected = num_selected;
+    memcpy(slot->selected, selected, num_selected * sizeof(jbpf_jit_fn));
+    memcpy(slot->buf, ctx, ctx_size);
+    if (data_size > 0) {
+        memcpy(slot->buf + data_offset, (const void*)(uintptr_t)generic_ctx->data, data_size);
+    }
+
+    ck_pr_fence_release();
+    ck_pr_store_64(&ring->tail, tail + 1);
+    return;
+
+drop:
+    ck_pr_inc_64(&hook->deferred_drops);
+}
+
+static bool
+deferred_codelet_selected(const struct jbpf_deferred_slot* slot, jbpf_jit_fn codelet)
+{
+    for (uint32_t i = 0; i < slot->num_selected; i++) {
+        if (slot->selected[i] == codelet) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Run the codelets of the hook that were selected for the call on the copied context, as the hook would have done.
+ * A codelet removed since the call was queued is not run */
+static void
+run_deferred_call(struct jbpf_deferred_slot* slot)
+{
+    struct jbpf_hook* hook = slot->hook;
+    struct jbpf_hook_codelet* hook_codelet_ptr;
+    struct jbpf_generic_ctx* generic_ctx = (struct jbpf_generic_ctx*)slot->buf;
+
+    generic_ctx->data = (uint64_t)(uintptr_t)(slot->buf + slot->data_offset);
+    generic_ctx->data_end = generic_ctx->data + slot->data_size;
+
+    JBPF_HOOK_READ_BEGIN()
+    hook_codelet_ptr = ck_pr_load_ptr(&hook->codelets);
+    if (hook_codelet_ptr) {
+        do {
+            e_runtime_threshold = hook_codelet_ptr->time_thresh;
+#ifdef JBPF_MEASURE_CODELETS
+            if (JBPF_LIKELY(!jbpf_codelet_quarantined(hook_codelet_ptr)) &&
+                deferred_codelet_selected(slot, hook_codelet_ptr->jbpf_codelet)) {
+                JBPF_CODELET_COUNTERS_START(codelet_start_counters)
+                uint64_t codelet_start_time = jbpf_measure_start_time();
+                uint64_t codelet_res __attribute__((unused)) =
+                    hook_codelet_ptr->jbpf_codelet(slot->buf, slot->ctx_size);
+                uint64_t codelet_end_time = jbpf_measure_stop_time();
+                _jbpf_codelet_account(hook, hook_codelet_ptr, codelet_start_time, codelet_end_time);
+                JBPF_CODELET_COUNTERS_STOP(codelet_start_counters, hook, hook_codelet_ptr)
+                JBPF_TRACE_CODELET(hook, codelet_start_time, codelet_end_time, codelet_res)
+            }
+#else
+            if (deferred_codelet_selected(slot, hook_codelet_ptr->jbpf_codelet)) {
+                hook_codelet_ptr->jbpf_codelet(slot->buf, slot->ctx_size);
+            }
+#endif
+        } while ((++hook_codelet_ptr)->jbpf_codelet);
+        JBPF_RINGBUF_RELEASE()
+    }
+    JBPF_HOOK_READ_END()
+}
+
+static int
+drain_ring(struct jbpf_deferred_ring* ring)
+{
+    struct jbpf_deferred_slot* slots = ck_pr_load_ptr(&ring->slots);
+    uint64_t head, tail;
+    int num_calls = 0;
+
+    if (!slots) {
+        return 0;
+    }
+    /* Pairs with the release store of the slots, so that the mask is seen */
+    ck_pr_fence_acquire();
+
+    head = ring->head;
+    tail = ck_pr_load_64(&ring->tail);
+    ck_pr_fence_acquire();
+
+    for (; head != tail; head++) {
+        run_deferred_call(&slots[head & ring->mask]);
+        num_calls++;
+    }
+
+    ck_pr_fence_release();
+    ck_pr_store_64(&ring->head, head);
+    return num_calls;
+}
+
+static void*
+deferred_worker_start(void* arg)
+{
+    int worker_id = (int)(intptr_t)arg;
+    int num_calls;
+
+    jbpf_register_thread();
+
+    while (__atomic_load_n(&deferred_run, __ATOMIC_ACQUIRE)) {
+        num_calls = 0;
+        for (int i = worker_id; i < JBPF_MAX_NUM_REG_THREADS; i += deferred_worker_stride) {
+            num_calls += drain_ring(&deferred_rings[i]);
+        }
+        jbpf_quiescent();
+        if (num_calls == 0) {
+            usleep(DEFERRED_IDLE_WAIT_US);
+        }
+    }
+
+    jbpf_cleanup_thread();
+    return NULL;
+}
+
+int
+jbpf_deferred_init(const struct jbpf_agent_deferred_config* config)
+{
+    char thread_name[16];
+    uint32_t ring_size = 1;
+
+    if (config->num_workers == 0 || config->ring_size == 0) {
+        jbpf_logger(JBPF_INFO, "No deferred hook workers configured\n");
+        return 0;
+    }
+
+    if (config->num_workers > JBPF_MAX_DEFERRED_WORKERS) {
+        jbpf_logger(
+            JBPF_ERROR,
+            "Too many deferred hook workers: %u, maximum %d allowed\n",
+            config->num_workers,
+            JBPF_MAX_DEFERRED_WORKERS);
+        return -1;
+    }
+
+    while (ring_size < config->ring_size) {
+        ring_size <<= 1;
+    }
+    deferred_ring_size = ring_size;
+    num_deferred_workers = config->num_workers;
+    deferred_worker_stride = config->num_workers;
+    __atomic_store_n(&deferred_run, true, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < num_deferred_workers; i++) {
+        if (pthread_create(&deferred_workers[i], NULL, deferred_worker_start, (void*)(intptr_t)i) != 0) {
+            jbpf_logger(JBPF_ERROR, "Unable to create deferred hook worker %d\n", i);
+            num_deferred_workers = i;
+            jbpf_deferred_stop();
+            return -1;
+        }
+        snprintf(thread_name, sizeof(thread_name), "jbpf_defer_%d", i % JBPF_MAX_DEFERRED_WORKERS);
+        if (pthread_setname_np(deferred_workers[i], thread_name) != 0) {
+            jbpf_logger(JBPF_WARN, "Could not set the name of deferred hook worker %d\n", i);
+        }
+    }
+
+    jbpf_logger(
+        JBPF_INFO, "Started %d deferred hook workers with rings of %u calls\n", num_deferred_workers, ring_size);
+    return 0;
+}
+
+void
+jbpf_deferred_stop(void)
+{
+    __atomic_store_n(&deferred_run, false, __ATOMIC_RELEASE);
+    for (int i = 0; i < num_deferred_workers; i++) {
+        pthread_join(deferred_workers[i], NULL);
+    }
+    num_deferred_workers = 0;
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        jbpf_free_mem(deferred_rings[i].slots);
+        memset(&deferred_rings[i], 0, sizeof(deferred_rings[i]));
+    }
+}
+
+void
+jbpf_deferred_register_thread(int thread_id)
+{
+    struct jbpf_deferred_ring* ring;
+    struct jbpf_deferred_slot* slots;
+
+    if (num_deferred_workers == 0 || thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+
+    /* The ring of a thread id is kept when the thread is cleaned up, and reused by the next thread with this id */
+    ring = &deferred_rings[thread_id];
+    if (ring->slots) {
+        return;
+    }
+
+    slots = jbpf_calloc_mem(deferred_ring_size, sizeof(struct jbpf_deferred_slot));
+    if (!slots) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate the deferred ring of thread %d\n", thread_id);
+        return;
+    }
+    ring->mask = deferred_ring_size - 1;
+    /* The workers read the mask once they see the slots */
+    ck_pr_fence_release();
+    ck_pr_store_ptr(&ring->slots, slots);
+}
+
+int
+jbpf_hook_set_deferred(struct jbpf_hook* hook, bool deferred)
+{
+    if (!hook || hook->hook_type != JBPF_HOOK_TYPE_MON) {
+        jbpf_logger(JBPF_ERROR, "Only monitoring hooks can be deferred\n");
+        return -1;
+    }
+    if (deferred && num_deferred_workers == 0) {
+        jbpf_logger(JBPF_ERROR, "Hook %s cannot be deferred, no deferred hook workers are running\n", hook->name);
+        return -1;
+    }
+    __atomic_store_n(&hook->deferred, deferred, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#else
+
+int
+jbpf_deferred_init(const struct jbpf_agent_deferred_config* config)
+{
+    return 0;
+}
+
+void
+jbpf_deferred_stop(void)
+{
+}
+
+void
+jbpf_deferred_register_thread(int thread_id)
+{
+}
+
+void
+jbpf_defer_hook(struct jbpf_hook* hook, const void* ctx, size_t ctx_size)
+{
+}
+
+int
+jbpf_hook_set_deferred(struct jbpf_hook* hook, bool deferred)
+{
+    if (deferred) {
+        jbpf_logger(JBPF_ERROR, "jbpf is built without USE_JBPF_DEFERRED_HOOKS\n");
+        return -1;
+    }
+    return 0;
+}
+
+#endif
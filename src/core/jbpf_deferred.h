@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_DEFERRED_H
+#define JBPF_DEFERRED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jbpf_config.h"
+#include "jbpf_hook_defs.h"
+
+/**
+ * @brief Maximum size of the context of a deferred hook call, plus the data it points to
+ * @ingroup core
+ */
+#define JBPF_DEFERRED_SLOT_SIZE (512)
+
+/**
+ * @brief Maximum number of codelets of a hook selected by their filters and samplers for a deferred hook call. A call
+ * that selects more codelets is dropped
+ * @ingroup core
+ */
+#define JBPF_DEFERRED_MAX_CODELETS (16)
+
+/**
+ * @brief Start the worker threads of the deferred hooks
+ * @param config The deferred hook configuration
+ * @return 0 on success, -1 otherwise
+ * @note Nothing is done if jbpf is built without USE_JBPF_DEFERRED_HOOKS
+ * @ingroup core
+ */
+int
+jbpf_deferred_init(const struct jbpf_agent_deferred_config* config);
+
+/**
+ * @brief Stop the worker threads and release the rings. Pending hook calls are discarded
+ * @ingroup core
+ */
+void
+jbpf_deferred_stop(void);
+
+/**
+ * @brief Allocate the deferred ring of the calling thread, if it does not have one yet
+ * @param thread_id The id of the calling registered thread
+ * @ingroup core
+ */
+void
+jbpf_deferred_register_thread(int thread_id);
+
+#endif
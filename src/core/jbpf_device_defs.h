@@ -71,9 +71,11 @@
 #ifdef __cplusplus
 extern thread_local jbpf_runtime_threshold_t e_runtime_threshold;
 extern thread_local unsigned int seed;
+extern thread_local uint32_t jbpf_ringbuf_num_reserved;
 #else
 extern _Thread_local jbpf_runtime_threshold_t e_runtime_threshold;
 extern _Thread_local unsigned int seed;
+extern _Thread_local uint32_t jbpf_ringbuf_num_reserved;
 #endif
 
 #endif // JBPF_DEVICE_DEFS
\ No newline at end of file
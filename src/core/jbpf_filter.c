@@ -0,0 +1,100 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "jbpf_filter.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+int
+jbpf_codelet_filter_create(
+    const jbpf_codelet_filter_t* filter, struct jbpf_codelet_filter_check** codelet_filter)
+{
+    struct jbpf_codelet_filter_check* new_filter;
+
+    *codelet_filter = NULL;
+
+    if (!filter || filter->num_conditions == 0) {
+        return 0;
+    }
+
+    if (filter->num_conditions > JBPF_MAX_FILTER_CONDITIONS || filter->combine > JBPF_FILTER_ANY) {
+        jbpf_logger(
+            JBPF_ERROR,
+            "Invalid codelet filter: %u conditions, maximum %u allowed, combine %u\n",
+            filter->num_conditions,
+            JBPF_MAX_FILTER_CONDITIONS,
+            filter->combine);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < filter->num_conditions; i++) {
+        const jbpf_codelet_filter_cond_t* cond = &filter->conditions[i];
+        if (cond->base > JBPF_FILTER_BASE_DATA || cond->op > JBPF_FILTER_OP_MASK ||
+            (cond->size != 1 && cond->size != 2 && cond->size != 4 && cond->size != 8)) {
+            jbpf_logger(
+                JBPF_ERROR,
+                "Invalid codelet filter condition %u: base %u, op %u, size %u\n",
+                i,
+                cond->base,
+                cond->op,
+                cond->size);
+            return -1;
+        }
+    }
+
+    new_filter = jbpf_calloc_mem(1, sizeof(struct jbpf_codelet_filter_check));
+    if (!new_filter) {
+        goto alloc_error;
+    }
+
+    new_filter->state = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_codelet_filter_state));
+    if (!new_filter->state) {
+        jbpf_free_mem(new_filter);
+        goto alloc_error;
+    }
+
+    new_filter->match_any = filter->combine == JBPF_FILTER_ANY;
+    new_filter->num_conditions = filter->num_conditions;
+    memcpy(new_filter->conditions, filter->conditions, filter->num_conditions * sizeof(jbpf_codelet_filter_cond_t));
+
+    *codelet_filter = new_filter;
+    return 0;
+
+alloc_error:
+    jbpf_logger(JBPF_ERROR, "Failed to allocate memory for codelet filter\n");
+    return -1;
+}
+
+void
+jbpf_codelet_filter_destroy(struct jbpf_codelet_filter_check* codelet_filter)
+{
+    if (!codelet_filter) {
+        return;
+    }
+    jbpf_free_mem(codelet_filter->state);
+    jbpf_free_mem(codelet_filter);
+}
+
+uint64_t
+jbpf_codelet_filter_collect(struct jbpf_codelet_filter_check* codelet_filter)
+{
+    uint64_t num_filtered = 0;
+    uint64_t num_reported;
+
+    if (!codelet_filter) {
+        return 0;
+    }
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        num_filtered += __atomic_load_n(&codelet_filter->state[i].num_filtered, __ATOMIC_RELAXED);
+    }
+
+    /* Concurrent reports split the filtered calls between them, without counting any call twice */
+    num_reported = __atomic_load_n(&codelet_filter->num_reported, __ATOMIC_RELAXED);
+    do {
+        if (num_filtered <= num_reported) {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(
+        &codelet_filter->num_reported, &num_reported, num_filtered, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return num_filtered - num_reported;
+}
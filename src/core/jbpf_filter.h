@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_FILTER_H
+#define JBPF_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "jbpf_hook_defs.h"
+#include "jbpf_device_defs.h"
+#include "jbpf_defs.h"
+#include "jbpf_utils.h"
+#include "jbpf.h"
+
+/**
+ * @brief Create the pre-filter of a codelet
+ * @param filter The filter of the codelet
+ * @param codelet_filter Set to the new filter, or to NULL if the filter has no conditions
+ * @return 0 on success, -1 if a condition is invalid or the filter cannot be allocated
+ * @ingroup core
+ */
+int
+jbpf_codelet_filter_create(
+    const jbpf_codelet_filter_t* filter, struct jbpf_codelet_filter_check** codelet_filter);
+
+/**
+ * @brief Release a filter created with jbpf_codelet_filter_create()
+ * @param codelet_filter The filter to release
+ * @note The caller must make sure that no hook can still use the filter
+ * @ingroup core
+ */
+void
+jbpf_codelet_filter_destroy(struct jbpf_codelet_filter_check* codelet_filter);
+
+/**
+ * @brief Get the number of calls filtered out since the last call of this function
+ * @param codelet_filter The filter, can be NULL
+ * @return The number of calls that did not run the codelet because the filter did not match
+ * @note Can be called by multiple threads at the same time, each call gets a different part of the filtered calls
+ * @ingroup core
+ */
+uint64_t
+jbpf_codelet_filter_collect(struct jbpf_codelet_filter_check* codelet_filter);
+
+#pragma once
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    __attribute__((always_inline)) static bool inline _jbpf_codelet_filter_cond(
+        const jbpf_codelet_filter_cond_t* cond, const void* ctx, size_t ctx_size)
+    {
+        const uint8_t* start = ctx;
+        const uint8_t* end = start + ctx_size;
+        uint64_t field;
+
+        if (cond->base == JBPF_FILTER_BASE_DATA) {
+            const struct jbpf_generic_ctx* generic_ctx = ctx;
+            start = (const uint8_t*)(uintptr_t)generic_ctx->data;
+            end = (const uint8_t*)(uintptr_t)generic_ctx->data_end;
+        }
+
+        if (JBPF_UNLIKELY(end < start || (size_t)(end - start) < (size_t)cond->offset + cond->size))
+            return false;
+        start += cond->offset;
+
+        switch (cond->size) {
+        case 1:
+            field = *start;
+            break;
+        case 2: {
+            uint16_t v;
+            memcpy(&v, start, sizeof(v));
+            field = v;
+            break;
+        }
+        case 4: {
+            uint32_t v;
+            memcpy(&v, start, sizeof(v));
+            field = v;
+            break;
+        }
+        default:
+            memcpy(&field, start, sizeof(field));
+            break;
+        }
+
+        switch (cond->op) {
+        case JBPF_FILTER_OP_EQ:
+            return field == cond->value;
+        case JBPF_FILTER_OP_NE:
+            return field != cond->value;
+        case JBPF_FILTER_OP_LT:
+            return field < cond->value;
+        case JBPF_FILTER_OP_LE:
+            return field <= cond->value;
+        case JBPF_FILTER_OP_GT:
+            return field > cond->value;
+        case JBPF_FILTER_OP_GE:
+            return field >= cond->value;
+        default:
+            return (field & cond->value) != 0;
+        }
+    }
+
+    __attribute__((always_inline)) static bool inline _jbpf_codelet_filter_match(
+        const struct jbpf_codelet_filter_check* filter, const void* ctx, size_t ctx_size)
+    {
+        for (uint32_t i = 0; i < filter->num_conditions; i++) {
+            if (_jbpf_codelet_filter_cond(&filter->conditions[i], ctx, ctx_size) == filter->match_any)
+                return filter->match_any;
+        }
+        return !filter->match_any;
+    }
+
+    /* Check whether the context of the current call matches the filter of the codelet.
+     * Codelets without a filter run on every call */
+    __attribute__((always_inline)) static bool inline jbpf_codelet_filter_pass(
+        const struct jbpf_hook_codelet* codelet, const void* ctx, size_t ctx_size)
+    {
+        struct jbpf_codelet_filter_check* filter = codelet->filter;
+        int thread_id;
+
+        if (JBPF_LIKELY(!filter) || _jbpf_codelet_filter_match(filter, ctx, ctx_size))
+            return true;
+
+        /* The counter of each thread is only updated by that thread, so no need to lock */
+        thread_id = get_jbpf_hook_thread_id();
+        if (JBPF_LIKELY(thread_id >= 0 && thread_id < JBPF_MAX_NUM_REG_THREADS)) {
+            uint64_t* num_filtered = &filter->state[thread_id].num_filtered;
+            __atomic_store_n(num_filtered, *num_filtered + 1, __ATOMIC_RELAXED);
+        }
+        return false;
+    }
+
+#pragma once
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JBPF_FILTER_H */
@@ -69,7 +69,8 @@ static int (*jbpf_map_clear)(const void*) = (int (*)(const void*))JBPF_MAP_CLEAR
  * @param map The map to dump.
  * @param data The buffer to dump the data into.
  * @param max_size The maximum size of the buffer.
- * @param flags Flags (currently unused, set to 0).
+ * @param flags Flags. For a per-thread map, JBPF_MAP_DUMP_AGGREGATED with a JBPF_MAP_REDUCE_* operation and element
+ * type dumps the values reduced over all the threads. Set to 0 otherwise.
  * @return 0 if the map was dumped successfully or a negative value otherwise.
  * @ingroup jbpf_agent
  * @ingroup helper_function
@@ -131,6 +132,7 @@ static void (*jbpf_printf)(const void*, uint32_t, ...) = (void (*)(const void*,
  * JBPF will output garbage that will not be decodable. This function performs two operations; it reserves size memory
  * in the ringbuffer and then does a memcpy() of the data to the reserved memory. If a program requires minimum overhead
  * with zero-copy for outputs, it should use jbpf_ringbuf_reserve and jbpf_ringbuf_submit instead.
+ * The record only takes size bytes of the ringbuf, so small outputs are packed densely.
  * @return 0 if the data is placed in the ringbuf succesfully or -1 otherwise.
  * @ingroup jbpf_agent
  * @ingroup helper_function
@@ -138,6 +140,35 @@ static void (*jbpf_printf)(const void*, uint32_t, ...) = (void (*)(const void*,
 static int (*jbpf_ringbuf_output)(const void*, void*, uint64_t) = (int (*)(const void*, void*, uint64_t))
     JBPF_RINGBUF_OUTPUT;
 
+/**
+ * @brief Reserves a record of value_size bytes in a map of type JBPF_MAP_TYPE_RINGBUF, to be filled in place.
+ * This call will keep returning the same record if called multiple times in a row, until jbpf_ringbuf_submit() or
+ * jbpf_ringbuf_discard() is called. The records reserved after it are not output until it is submitted or discarded.
+ * A record that is still reserved when the hook returns is discarded.
+ * @return Pointer to the record if request was successful or NULL if the ringbuf is full, or if the codelets of the
+ * hook call already hold records in 8 other ringbufs.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static void* (*jbpf_ringbuf_reserve)(void*) = (void* (*)(void*))JBPF_RINGBUF_RESERVE;
+
+/**
+ * @brief Outputs the first size bytes of the record reserved with jbpf_ringbuf_reserve(). The rest of the record is
+ * given back to the ringbuf.
+ * @return 0 if the record was submitted successfully or a negative value otherwise.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_ringbuf_submit)(void*, uint64_t) = (int (*)(void*, uint64_t))JBPF_RINGBUF_SUBMIT;
+
+/**
+ * @brief Gives back the record reserved with jbpf_ringbuf_reserve() without outputting it.
+ * @return 0 if the record was discarded or a negative value otherwise.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_ringbuf_discard)(void*) = (int (*)(void*))JBPF_RINGBUF_DISCARD;
+
 /**
  * @brief Receives control input data and copies them in some memory region.
  * @return 0 if control input was received successfully and non-zero otherwise.
@@ -168,6 +199,83 @@ static void* (*jbpf_get_output_buf)(void*) = (void* (*)(void*))JBPF_GET_OUTPUT_B
  */
 static int (*jbpf_send_output)(void*) = (int (*)(void*))JBPF_SEND_OUTPUT;
 
+/**
+ * @brief Reduces the value of a key of a per-thread map over the copies of all the threads, e.g. to read a counter
+ * that each thread increments in its own copy.
+ * @param map The per-thread map.
+ * @param key The key. Ignored with JBPF_MAP_REDUCE_ALL_KEYS.
+ * @param out The buffer of the result, of at least the size of a value, or of the whole array with
+ * JBPF_MAP_REDUCE_ALL_KEYS.
+ * @param out_size The size of the buffer.
+ * @param flags A JBPF_MAP_REDUCE_* operation and element type, and JBPF_MAP_REDUCE_ALL_KEYS to reduce all the values
+ * of a per-thread array.
+ * @return The number of thread copies reduced, 0 if no thread has the key, or a negative value on failure.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_map_reduce)(void*, void*, void*, uint32_t, uint64_t) =
+    (int (*)(void*, void*, void*, uint32_t, uint64_t))JBPF_MAP_REDUCE;
+
+/**
+ * @brief Copies the values of a batch of keys of a map, which costs less per key than separate lookups.
+ * @param map The map. For the per-thread maps, the copy of the calling thread is used.
+ * @param keys The keys, one after the other.
+ * @param keys_size The size of the keys, a multiple of the key size of the map, of up to JBPF_MAP_BATCH_MAX_KEYS keys.
+ * @param values The buffer of the values, laid out as a struct jbpf_map_batch_values: the found mask, where bit i is
+ * set if the i-th key is found, followed by the values, where the value of the i-th key is copied to the i-th slot.
+ * The slots of the keys that are not found are left unchanged.
+ * @param values_size The size of the buffer, of at least the mask and one value per key.
+ * @return The number of keys found, or a negative value on failure.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_map_lookup_batch)(void*, void*, uint32_t, void*, uint32_t) =
+    (int (*)(void*, void*, uint32_t, void*, uint32_t))JBPF_MAP_LOOKUP_BATCH;
+
+/**
+ * @brief Updates a batch of keys of a map, in order, with the values of the same index.
+ * @param map The map. For the per-thread maps, the copy of the calling thread is used.
+ * @param keys The keys, one after the other.
+ * @param keys_size The size of the keys, a multiple of the key size of the map, of up to JBPF_MAP_BATCH_MAX_KEYS keys.
+ * @param values The values, one per key.
+ * @param values_size The size of the values.
+ * @return The number of keys updated, which is less than the number of keys if an update failed (e.g., the map is
+ * full), or a negative value if the first update failed.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_map_update_batch)(void*, void*, uint32_t, void*, uint32_t) =
+    (int (*)(void*, void*, uint32_t, void*, uint32_t))JBPF_MAP_UPDATE_BATCH;
+
+/**
+ * @brief Deletes a batch of keys of a map. The keys that are not found are skipped.
+ * @param map The map. For the per-thread maps, the copy of the calling thread is used.
+ * @param keys The keys, one after the other.
+ * @param keys_size The size of the keys, a multiple of the key size of the map, of up to JBPF_MAP_BATCH_MAX_KEYS keys.
+ * @return The number of keys deleted, or a negative value on failure.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_map_delete_batch)(void*, void*, uint32_t) = (int (*)(void*, void*, uint32_t))JBPF_MAP_DELETE_BATCH;
+
+/**
+ * @brief Copies the next entries of a map, a bounded number per call, so that a large map can be walked over several
+ * calls. The entries are copied as by jbpf_map_dump(), the key followed by the value. The iteration is weakly
+ * consistent: the entries added or deleted during the iteration may or may not be returned.
+ * @param map The map. For the per-thread maps, the copy of the calling thread is used.
+ * @param cursor A uint64_t that holds the position of the iteration, set to 0 to start. It is updated with the
+ * position to resume from, or set back to 0 once all the entries have been returned.
+ * @param cursor_size The size of the cursor, sizeof(uint64_t).
+ * @param data The buffer of the entries.
+ * @param max_size The size of the buffer, of at least one entry.
+ * @return The number of entries copied, or a negative value on failure. -2 if the map is busy, in which case the
+ * cursor is left unchanged and the call can be retried.
+ * @ingroup jbpf_agent
+ * @ingroup helper_function
+ */
+static int (*jbpf_map_iterate)(void*, void*, uint32_t, void*, uint32_t) =
+    (int (*)(void*, void*, uint32_t, void*, uint32_t))JBPF_MAP_ITERATE;
+
 /**
  * @brief Adds a checkpoint for measuring elapsed runtime.
  * This is a stateful call and is intended to be used along with jbpf_check_runtime_limit to check if a codelet has
@@ -36,4 +36,61 @@
  */
 #define JBPF_MAP_RETRY_ATTEMPTS (100)
 
+/**
+ * @brief Operations of jbpf_map_reduce() and of the aggregated jbpf_map_dump(), in the lowest 4 bits of the flags
+ * @note JBPF_MAP_REDUCE_SUM: Sum of the thread copies
+ * @note JBPF_MAP_REDUCE_MIN: Minimum of the thread copies
+ * @note JBPF_MAP_REDUCE_MAX: Maximum of the thread copies
+ * @note JBPF_MAP_REDUCE_OR: Bitwise or of the thread copies
+ * @ingroup core
+ */
+#define JBPF_MAP_REDUCE_SUM (0x0ULL)
+#define JBPF_MAP_REDUCE_MIN (0x1ULL)
+#define JBPF_MAP_REDUCE_MAX (0x2ULL)
+#define JBPF_MAP_REDUCE_OR (0x3ULL)
+#define JBPF_MAP_REDUCE_OP_MASK (0xFULL)
+
+/**
+ * @brief Type of the elements the values are made of, in bits 4-7 of the flags. The size of the values must be a
+ * multiple of the size of the elements
+ * @ingroup core
+ */
+#define JBPF_MAP_REDUCE_U64 (0x00ULL)
+#define JBPF_MAP_REDUCE_U32 (0x10ULL)
+#define JBPF_MAP_REDUCE_S64 (0x20ULL)
+#define JBPF_MAP_REDUCE_S32 (0x30ULL)
+#define JBPF_MAP_REDUCE_TYPE_MASK (0xF0ULL)
+
+/**
+ * @brief Flag of jbpf_map_reduce() to reduce all the values of a JBPF_MAP_TYPE_PER_THREAD_ARRAY instead of the value
+ * of the key
+ * @ingroup core
+ */
+#define JBPF_MAP_REDUCE_ALL_KEYS (0x100ULL)
+
+/**
+ * @brief Flag of jbpf_map_dump() to dump the values of a per-thread map reduced over all the threads, with the
+ * operation and the type of the JBPF_MAP_REDUCE_* flags
+ * @ingroup core
+ */
+#define JBPF_MAP_DUMP_AGGREGATED (0x10000ULL)
+
+/**
+ * @brief Maximum number of keys of a call to jbpf_map_lookup_batch(), jbpf_map_update_batch() or
+ * jbpf_map_delete_batch()
+ * @ingroup core
+ */
+#define JBPF_MAP_BATCH_MAX_KEYS (64)
+
+/**
+ * @brief Layout of the buffer of jbpf_map_lookup_batch(): the mask of the keys found, where bit i is set if the i-th
+ * key is found, followed by the values, where the value of the i-th key is copied to the i-th slot
+ * @ingroup core
+ */
+struct jbpf_map_batch_values
+{
+    uint64_t found;
+    uint8_t values[];
+};
+
 #endif /* JBPF_HELPER_API_DEFS_ */
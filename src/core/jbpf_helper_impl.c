@@ -15,7 +15,12 @@
 #include "jbpf_utils.h"
 #include "jbpf_bpf_hashmap.h"
 #include "jbpf_bpf_spsc_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap.h"
 #include "jbpf_bpf_array.h"
+#include "jbpf_bpf_map_reduce.h"
+#include "jbpf_bpf_map_batch.h"
+#include "jbpf_bpf_map_iter.h"
 #include "jbpf_helper_impl.h"
 #include "jbpf_common_types.h"
 
@@ -45,6 +50,14 @@
              (jbpf_helper_func_t)jbpf_control_input_receive},                                                        \
             {"jbpf_get_output_buf", JBPF_GET_OUTPUT_BUF, (jbpf_helper_func_t)jbpf_get_output_buf},                   \
             {"jbpf_send_output", JBPF_SEND_OUTPUT, (jbpf_helper_func_t)jbpf_send_output},                            \
+            {"jbpf_map_reduce", JBPF_MAP_REDUCE, (jbpf_helper_func_t)jbpf_map_reduce},                               \
+            {"jbpf_ringbuf_reserve", JBPF_RINGBUF_RESERVE, (jbpf_helper_func_t)jbpf_ringbuf_reserve},                \
+            {"jbpf_ringbuf_submit", JBPF_RINGBUF_SUBMIT, (jbpf_helper_func_t)jbpf_ringbuf_submit},                   \
+            {"jbpf_ringbuf_discard", JBPF_RINGBUF_DISCARD, (jbpf_helper_func_t)jbpf_ringbuf_discard},                \
+            {"jbpf_map_lookup_batch", JBPF_MAP_LOOKUP_BATCH, (jbpf_helper_func_t)jbpf_map_lookup_batch},             \
+            {"jbpf_map_update_batch", JBPF_MAP_UPDATE_BATCH, (jbpf_helper_func_t)jbpf_map_update_batch},             \
+            {"jbpf_map_delete_batch", JBPF_MAP_DELETE_BATCH, (jbpf_helper_func_t)jbpf_map_delete_batch},             \
+            {"jbpf_map_iterate", JBPF_MAP_ITERATE, (jbpf_helper_func_t)jbpf_map_iterate},                            \
     }
 
 struct __control_input_ctx
@@ -54,14 +67,22 @@ struct __control_input_ctx
     uint32_t size_read;
 };
 
+/* Maximum number of ring buffers in which the codelets of a single hook call can hold a reserved record. The ring
+ * buffers are kept in ringbuf_reserved, and their records are discarded when the hook returns */
+#define JBPF_RINGBUF_MAX_RESERVED (8)
+
 #ifdef __cplusplus
 thread_local uint64_t codelet_mark_runtime;
 thread_local jbpf_runtime_threshold_t e_runtime_threshold;
 thread_local unsigned int seed;
+thread_local uint32_t jbpf_ringbuf_num_reserved;
+static thread_local jbpf_io_channel_t* ringbuf_reserved[JBPF_RINGBUF_MAX_RESERVED];
 #else
 _Thread_local uint64_t codelet_mark_runtime;
 _Thread_local jbpf_runtime_threshold_t e_runtime_threshold;
 _Thread_local unsigned int seed;
+_Thread_local uint32_t jbpf_ringbuf_num_reserved;
+static _Thread_local jbpf_io_channel_t* ringbuf_reserved[JBPF_RINGBUF_MAX_RESERVED];
 #endif
 
 static void*
@@ -85,6 +106,10 @@ jbpf_map_lookup_elem(const struct jbpf_map* map, const void* key)
         return jbpf_bpf_array_lookup_elem(map, key);
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_lookup_elem(map, key);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_lookup_elem(map, key);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_lookup_elem(map, key);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         perthread_map = map->data;
         index = get_jbpf_hook_thread_id();
@@ -99,6 +124,13 @@ jbpf_map_lookup_elem(const struct jbpf_map* map, const void* key)
             return NULL;
         else
             return jbpf_bpf_spsc_hashmap_lookup_elem(&perthread_map[index], key);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return NULL;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_lookup_elem(&perthread_map[index], key);
     default:
         return NULL;
     }
@@ -124,6 +156,10 @@ jbpf_map_lookup_reset_elem(const struct jbpf_map* map, const void* key)
         return jbpf_bpf_array_reset_elem(map, key);
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_reset_elem(map, key);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_reset_elem(map, key);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_reset_elem(map, key);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         perthread_map = map->data;
         index = get_jbpf_hook_thread_id();
@@ -138,6 +174,13 @@ jbpf_map_lookup_reset_elem(const struct jbpf_map* map, const void* key)
             return NULL;
         else
             return jbpf_bpf_spsc_hashmap_reset_elem(&perthread_map[index], key);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return NULL;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_reset_elem(&perthread_map[index], key);
     default:
         return NULL;
     }
@@ -163,6 +206,10 @@ jbpf_map_update_elem(struct jbpf_map* map, const void* key, void* item, uint64_t
         return jbpf_bpf_array_update_elem(map, key, item, flags);
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_update_elem(map, key, item, flags);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_update_elem(map, key, item, flags);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_update_elem(map, key, item, flags);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         perthread_map = map->data;
         index = get_jbpf_hook_thread_id();
@@ -177,6 +224,13 @@ jbpf_map_update_elem(struct jbpf_map* map, const void* key, void* item, uint64_t
             return -5;
         else
             return jbpf_bpf_spsc_hashmap_update_elem(&perthread_map[index], key, item, flags);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return -5;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_update_elem(&perthread_map[index], key, item, flags);
     default:
         return -2;
     }
@@ -197,6 +251,10 @@ jbpf_map_clear(struct jbpf_map* map)
         return jbpf_bpf_array_clear(map);
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_clear(map);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_clear(map);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_clear(map);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         perthread_map = map->data;
         index = get_jbpf_hook_thread_id();
@@ -211,6 +269,13 @@ jbpf_map_clear(struct jbpf_map* map)
             return -3;
         else
             return jbpf_bpf_spsc_hashmap_clear(&perthread_map[index]);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return -3;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_clear(&perthread_map[index]);
     default:
         return -2;
     }
@@ -231,20 +296,185 @@ jbpf_map_dump(struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flag
         return -2;
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_dump(map, data, max_size, flags);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_dump(map, data, max_size, flags);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_dump(map, data, max_size, flags);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        if (flags & JBPF_MAP_DUMP_AGGREGATED)
+            return jbpf_bpf_map_dump_aggregated(map, jbpf_get_num_thread_slots(), data, max_size, flags);
         return -2;
     case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        if (flags & JBPF_MAP_DUMP_AGGREGATED)
+            return jbpf_bpf_map_dump_aggregated(map, jbpf_get_num_thread_slots(), data, max_size, flags);
         perthread_map = map->data;
         index = get_jbpf_hook_thread_id();
         if (index == -1)
             return -3;
         else
             return jbpf_bpf_spsc_hashmap_dump(&perthread_map[index], data, max_size, flags);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        if (flags & JBPF_MAP_DUMP_AGGREGATED)
+            return jbpf_bpf_map_dump_aggregated(map, jbpf_get_num_thread_slots(), data, max_size, flags);
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return -3;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_dump(&perthread_map[index], data, max_size, flags);
     default:
         return -2;
     }
 }
 
+static int
+jbpf_map_reduce(const struct jbpf_map* map, const void* key, void* out, uint32_t out_size, uint64_t flags)
+{
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+
+    return jbpf_bpf_map_reduce(map, jbpf_get_num_thread_slots(), key, out, out_size, flags);
+}
+
+/* The map that a batch or an iteration operates on: the map itself, or the copy of the calling thread of a per-thread
+ * map */
+static struct jbpf_map*
+jbpf_map_thread_target(const struct jbpf_map* map)
+{
+    int index;
+    struct jbpf_map* perthread_map;
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return NULL;
+        return &perthread_map[index];
+    default:
+        return (struct jbpf_map*)map;
+    }
+}
+
+/* The number of keys of a batch, or 0 if the sizes of the keys and of the values do not match. The values of a lookup
+ * follow the found mask */
+static uint32_t
+jbpf_map_batch_count(const struct jbpf_map* map, uint32_t keys_size, uint32_t values_size, bool has_values)
+{
+    uint32_t count;
+
+    if (map->key_size == 0 || keys_size % map->key_size != 0)
+        return 0;
+
+    count = keys_size / map->key_size;
+    if (count > JBPF_MAP_BATCH_MAX_KEYS)
+        return 0;
+    if (has_values && values_size < (uint64_t)count * map->value_size)
+        return 0;
+
+    return count;
+}
+
+static int
+jbpf_map_lookup_batch(
+    const struct jbpf_map* map, const void* keys, uint32_t keys_size, void* values, uint32_t values_size)
+{
+    struct jbpf_map_batch_values* batch_values;
+    struct jbpf_map* target;
+    uint32_t count;
+
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+    if (JBPF_UNLIKELY(!keys || !values)) {
+        return -3;
+    }
+
+    if (values_size < sizeof(struct jbpf_map_batch_values))
+        return -1;
+
+    count = jbpf_map_batch_count(map, keys_size, values_size - sizeof(struct jbpf_map_batch_values), true);
+    target = jbpf_map_thread_target(map);
+    if (count == 0 || !target)
+        return -1;
+
+    batch_values = values;
+    return jbpf_bpf_map_lookup_batch(target, keys, batch_values->values, count, &batch_values->found);
+}
+
+static int
+jbpf_map_update_batch(
+    struct jbpf_map* map, const void* keys, uint32_t keys_size, const void* values, uint32_t values_size)
+{
+    struct jbpf_map* target;
+    uint32_t count;
+
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+    if (JBPF_UNLIKELY(!keys || !values)) {
+        return -3;
+    }
+
+    count = jbpf_map_batch_count(map, keys_size, values_size, true);
+    target = jbpf_map_thread_target(map);
+    if (count == 0 || !target)
+        return -1;
+
+    return jbpf_bpf_map_update_batch(target, keys, values, count);
+}
+
+static int
+jbpf_map_delete_batch(struct jbpf_map* map, const void* keys, uint32_t keys_size)
+{
+    struct jbpf_map* target;
+    uint32_t count;
+
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+    if (JBPF_UNLIKELY(!keys)) {
+        return -3;
+    }
+
+    count = jbpf_map_batch_count(map, keys_size, 0, false);
+    target = jbpf_map_thread_target(map);
+    if (count == 0 || !target)
+        return -1;
+
+    return jbpf_bpf_map_delete_batch(target, keys, count);
+}
+
+static int
+jbpf_map_iterate(const struct jbpf_map* map, void* cursor, uint32_t cursor_size, void* data, uint32_t max_size)
+{
+    struct jbpf_map* target;
+    uint64_t pos;
+    int res;
+
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+    if (JBPF_UNLIKELY(!cursor || !data)) {
+        return -3;
+    }
+    if (cursor_size != sizeof(uint64_t))
+        return -1;
+
+    target = jbpf_map_thread_target(map);
+    if (!target)
+        return -1;
+
+    // The cursor is on the stack of the codelet, which may not align it
+    memcpy(&pos, cursor, sizeof(pos));
+    res = jbpf_bpf_map_iterate(target, &pos, data, max_size);
+    memcpy(cursor, &pos, sizeof(pos));
+    return res;
+}
+
 static int
 jbpf_map_delete_elem(struct jbpf_map* map, const void* key)
 {
@@ -263,6 +493,10 @@ jbpf_map_delete_elem(struct jbpf_map* map, const void* key)
         return -2;
     case JBPF_MAP_TYPE_HASHMAP:
         return jbpf_bpf_hashmap_delete_elem(map, key);
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        return jbpf_bpf_concurrent_hashmap_delete_elem(map, key);
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        return jbpf_bpf_lru_hashmap_delete_elem(map, key);
     case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
         return -2;
     case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
@@ -272,6 +506,13 @@ jbpf_map_delete_elem(struct jbpf_map* map, const void* key)
             return -4;
         else
             return jbpf_bpf_spsc_hashmap_delete_elem(&perthread_map[index], key);
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_map = map->data;
+        index = get_jbpf_hook_thread_id();
+        if (index == -1)
+            return -4;
+        else
+            return jbpf_bpf_spsc_lru_hashmap_delete_elem(&perthread_map[index], key);
     default:
         return -2;
     }
@@ -416,6 +657,86 @@ jbpf_ringbuf_output(struct jbpf_map* map, void* data, uint64_t size)
     }
 }
 
+static void
+jbpf_ringbuf_forget_reserved(const jbpf_io_channel_t* channel)
+{
+    for (uint32_t i = 0; i < jbpf_ringbuf_num_reserved; i++) {
+        if (ringbuf_reserved[i] == channel) {
+            ringbuf_reserved[i] = ringbuf_reserved[--jbpf_ringbuf_num_reserved];
+            return;
+        }
+    }
+}
+
+void
+jbpf_ringbuf_release_reserved(void)
+{
+    for (uint32_t i = 0; i < jbpf_ringbuf_num_reserved; i++) {
+        jbpf_io_channel_discard_buf(ringbuf_reserved[i]);
+    }
+    jbpf_ringbuf_num_reserved = 0;
+}
+
+static void*
+jbpf_ringbuf_reserve(struct jbpf_map* map)
+{
+    jbpf_io_channel_t* channel;
+    void* record;
+
+    if (JBPF_UNLIKELY(!map)) {
+        return NULL;
+    }
+
+    if (map->type != JBPF_MAP_TYPE_RINGBUF)
+        return NULL;
+
+    channel = (jbpf_io_channel_t*)map->data;
+    record = jbpf_io_channel_reserve_buf(channel);
+    if (!record)
+        return NULL;
+
+    /* The reservation is recorded, so that it is discarded when the hook returns if the codelet forgets it */
+    for (uint32_t i = 0; i < jbpf_ringbuf_num_reserved; i++) {
+        if (ringbuf_reserved[i] == channel)
+            return record;
+    }
+    if (jbpf_ringbuf_num_reserved == JBPF_RINGBUF_MAX_RESERVED) {
+        jbpf_io_channel_discard_buf(channel);
+        return NULL;
+    }
+    ringbuf_reserved[jbpf_ringbuf_num_reserved++] = channel;
+    return record;
+}
+
+static int
+jbpf_ringbuf_submit(struct jbpf_map* map, uint64_t size)
+{
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+
+    if (map->type != JBPF_MAP_TYPE_RINGBUF || size == 0 || size > map->value_size)
+        return -1;
+
+    jbpf_ringbuf_forget_reserved((jbpf_io_channel_t*)map->data);
+    return jbpf_io_channel_submit_buf_size((jbpf_io_channel_t*)map->data, size);
+}
+
+static int
+jbpf_ringbuf_discard(struct jbpf_map* map)
+{
+    if (JBPF_UNLIKELY(!map)) {
+        return -1;
+    }
+
+    if (map->type != JBPF_MAP_TYPE_RINGBUF)
+        return -1;
+
+    jbpf_ringbuf_forget_reserved((jbpf_io_channel_t*)map->data);
+    jbpf_io_channel_discard_buf((jbpf_io_channel_t*)map->data);
+    return 0;
+}
+
 int
 jbpf_control_input_receive(struct jbpf_map* map, void* buf, uint32_t size)
 {
@@ -580,6 +901,50 @@ __jbpf_map_delete_elem(struct jbpf_map* map, const void* key)
     return jbpf_map_delete_elem(map, key);
 }
 
+// wrapper function
+int
+__jbpf_map_reduce(const struct jbpf_map* map, const void* key, void* out, uint32_t out_size, uint64_t flags)
+{
+    return jbpf_map_reduce(map, key, out, out_size, flags);
+}
+
+// wrapper function
+int
+__jbpf_map_lookup_batch(
+    const struct jbpf_map* map, const void* keys, uint32_t keys_size, void* values, uint32_t values_size)
+{
+    return jbpf_map_lookup_batch(map, keys, keys_size, values, values_size);
+}
+
+// wrapper function
+int
+__jbpf_map_update_batch(
+    struct jbpf_map* map, const void* keys, uint32_t keys_size, const void* values, uint32_t values_size)
+{
+    return jbpf_map_update_batch(map, keys, keys_size, values, values_size);
+}
+
+// wrapper function
+int
+__jbpf_map_delete_batch(struct jbpf_map* map, const void* keys, uint32_t keys_size)
+{
+    return jbpf_map_delete_batch(map, keys, keys_size);
+}
+
+// wrapper function
+int
+__jbpf_map_iterate(const struct jbpf_map* map, void* cursor, uint32_t cursor_size, void* data, uint32_t max_size)
+{
+    return jbpf_map_iterate(map, cursor, cursor_size, data, max_size);
+}
+
+// wrapper function
+int
+__jbpf_map_dump(struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flags)
+{
+    return jbpf_map_dump(map, data, max_size, flags);
+}
+
 void
 __jbpf_set_e_runtime_threshold(uint64_t threshold)
 {
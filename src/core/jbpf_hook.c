@@ -5,6 +5,11 @@
 #include "jbpf_hook_defs.h"
 #include "jbpf_int.h"
 #include "jbpf_hook.h"
+#include "jbpf_hook_trampoline.h"
+#include "jbpf_static_key.h"
+#include "jbpf_sampling.h"
+#include "jbpf_filter.h"
+#include "jbpf_qsbr.h"
 #include "jbpf_memory.h"
 #include "jbpf_logging.h"
 #include "jbpf_common_types.h"
@@ -20,161 +25,564 @@ free_codelet_list(ck_epoch_entry_t* e)
     jbpf_free_mem(node);
 }
 
+CK_EPOCH_CONTAINER(struct jbpf_hook_trampoline, epoch_entry, trampoline_container)
+
+static void
+free_trampoline(ck_epoch_entry_t* e)
+{
+    jbpf_hook_trampoline_destroy(trampoline_container(e));
+}
+
+/* Control hooks run a single codelet and need its return value, so only
+ * monitoring hooks get a fused trampoline. The trampoline does not measure
+ * codelets separately, so it is not used when codelets are measured.
+ * It does not sample or filter codelets either, so it is not used when a codelet is sampled or filtered */
+static struct jbpf_hook_trampoline*
+build_hook_trampoline(const struct jbpf_hook* hook, const struct jbpf_hook_codelet* codelets)
+{
+#ifdef JBPF_MEASURE_CODELETS
+    return NULL;
+#else
+    if (hook->hook_type != JBPF_HOOK_TYPE_MON) {
+        return NULL;
+    }
+    for (int i = 0; codelets[i].jbpf_codelet; i++) {
+        if (codelets[i].sampler || codelets[i].filter) {
+            return NULL;
+        }
+    }
+    return jbpf_hook_trampoline_create(codelets);
+#endif
+}
+
+/* Staged update of the codelets of a single hook */
+struct jbpf_hook_staged
+{
+    struct jbpf_hook* hook;
+    struct jbpf_hook_codelet* old_codelets;
+    struct jbpf_hook_codelet* new_codelets;
+    struct jbpf_hook_trampoline* old_trampoline;
+    struct jbpf_hook_trampoline* new_trampoline;
+    /* Perf data, samplers and filters of the removed codelets, released after the grace period */
+    int num_removed;
+    struct jbpf_codelet_perf* removed_perf[JBPF_HOOK_TXN_MAX_OPS];
+    int num_removed_samplers;
+    struct jbpf_codelet_sampler* removed_samplers[JBPF_HOOK_TXN_MAX_OPS];
+    int num_removed_filters;
+    struct jbpf_codelet_filter_check* removed_filters[JBPF_HOOK_TXN_MAX_OPS];
+    /* Flight recorder ids of the removed codelets, released once the transaction is committed */
+    int num_removed_trace_ids;
+    uint16_t removed_trace_ids[JBPF_HOOK_TXN_MAX_OPS];
+    /* Samplers and filters of the added codelets, released if the transaction is aborted */
+    int num_added_samplers;
+    struct jbpf_codelet_sampler* added_samplers[JBPF_HOOK_TXN_MAX_OPS];
+    int num_added_filters;
+    struct jbpf_codelet_filter_check* added_filters[JBPF_HOOK_TXN_MAX_OPS];
+};
+
+void
+jbpf_hook_txn_init(struct jbpf_hook_txn* txn)
+{
+    txn->num_ops = 0;
+}
+
+static int
+jbpf_hook_txn_add_op(
+    struct jbpf_hook_txn* txn,
+    enum jbpf_hook_txn_op_type type,
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    const char* codelet_name,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio,
+    const jbpf_codelet_sampling_t* sampling)
+{
+    struct jbpf_hook_txn_op* op;
+
+    if (!txn || !hook || !codelet) {
+        return -1;
+    }
+
+    if (txn->num_ops >= JBPF_HOOK_TXN_MAX_OPS) {
+        jbpf_logger(JBPF_ERROR, "Too many codelets staged for hook %s\n", hook->name);
+        return -1;
+    }
+
+    op = &txn->ops[txn->num_ops++];
+    op->type = type;
+    op->hook = hook;
+    op->codelet = codelet;
+    op->codelet_name = codelet_name;
+    op->runtime_threshold = runtime_threshold;
+    op->prio = prio;
+    if (sampling) {
+        op->sampling = *sampling;
+    } else {
+        memset(&op->sampling, 0, sizeof(op->sampling));
+    }
+    memset(&op->filter, 0, sizeof(op->filter));
+    return 0;
+}
+
 int
-jbpf_register_codelet_hook(
+jbpf_hook_txn_add_codelet(
+    struct jbpf_hook_txn* txn,
     struct jbpf_hook* hook,
     jbpf_jit_fn codelet,
+    const char* codelet_name,
     jbpf_runtime_threshold_t runtime_threshold,
     jbpf_codelet_priority_t prio)
 {
-    struct jbpf_hook_codelet hook_codelet;
-    struct jbpf_hook_codelet *old_codelets, *new_codelets;
+    return jbpf_hook_txn_add_op(txn, JBPF_HOOK_TXN_ADD, hook, codelet, codelet_name, runtime_threshold, prio, NULL);
+}
 
-    int ret = -1;
-    int nr_codelets = 0;
+int
+jbpf_hook_txn_add_sampled_codelet(
+    struct jbpf_hook_txn* txn,
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    const char* codelet_name,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio,
+    const jbpf_codelet_sampling_t* sampling)
+{
+    return jbpf_hook_txn_add_op(
+        txn, JBPF_HOOK_TXN_ADD, hook, codelet, codelet_name, runtime_threshold, prio, sampling);
+}
+
+int
+jbpf_hook_txn_filter_codelet(
+    struct jbpf_hook_txn* txn, struct jbpf_hook* hook, jbpf_jit_fn codelet, const jbpf_codelet_filter_t* filter)
+{
+    if (!txn || !filter) {
+        return -1;
+    }
+
+    /* The filter applies to the last registration of the codelet staged so far */
+    for (int i = txn->num_ops - 1; i >= 0; i--) {
+        struct jbpf_hook_txn_op* op = &txn->ops[i];
+        if (op->type == JBPF_HOOK_TXN_ADD && op->hook == hook && op->codelet == codelet) {
+            op->filter = *filter;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int
+jbpf_hook_txn_remove_codelet(struct jbpf_hook_txn* txn, struct jbpf_hook* hook, jbpf_jit_fn codelet)
+{
+    return jbpf_hook_txn_add_op(txn, JBPF_HOOK_TXN_REMOVE, hook, codelet, NULL, 0, 0, NULL);
+}
+
+/* Insert a codelet after all the codelets with the same or a higher priority */
+static int
+stage_add_codelet(
+    struct jbpf_hook* hook, struct jbpf_hook_codelet* codelets, int nr_codelets, struct jbpf_hook_txn_op* op)
+{
     int pos = -1;
 
-    if (!codelet) {
+    for (int i = 0; i < nr_codelets; i++) {
+        if (pos < 0 && codelets[i].prio < op->prio) {
+            pos = i;
+        }
+        /* The program already exists. Abort */
+        if (codelets[i].jbpf_codelet == op->codelet) {
+            return -1;
+        }
+    }
+
+    /* If this is a control hook, only one program is allowed to be loaded */
+    if (hook->hook_type == JBPF_HOOK_TYPE_CTRL && nr_codelets > 0) {
+        jbpf_logger(JBPF_ERROR, "This is a control hook. Only one codelet can be loaded\n");
         return -1;
     }
 
-    /* Only one thread can update programs */
-    pthread_mutex_lock(&hook_mutex);
+    if (pos < 0) {
+        pos = nr_codelets;
+    }
 
-    hook_codelet.jbpf_codelet = codelet;
-    hook_codelet.prio = prio;
-    hook_codelet.time_thresh = runtime_threshold;
+    memmove(codelets + pos + 1, codelets + pos, (nr_codelets - pos) * sizeof(struct jbpf_hook_codelet));
+    memset(&codelets[pos], 0, sizeof(struct jbpf_hook_codelet));
+    codelets[pos].jbpf_codelet = op->codelet;
+    codelets[pos].prio = op->prio;
+    codelets[pos].time_thresh = op->runtime_threshold;
 
-    ck_epoch_begin(e_record, NULL);
-    old_codelets = hook->codelets;
+    return nr_codelets + 1;
+}
+
+static int
+stage_remove_codelet(
+    struct jbpf_hook_staged* staged, struct jbpf_hook_codelet* codelets, int nr_codelets, struct jbpf_hook_txn_op* op)
+{
+    int pos = 0;
+
+    for (int i = 0; i < nr_codelets; i++) {
+        if (codelets[i].jbpf_codelet != op->codelet) {
+            codelets[pos++] = codelets[i];
+            continue;
+        }
+        /* The objects of the removed codelet must be released after the grace period, so the removal fails if they
+         * cannot all be recorded */
+        if ((codelets[i].perf && staged->num_removed >= JBPF_HOOK_TXN_MAX_OPS) ||
+            (codelets[i].sampler && staged->num_removed_samplers >= JBPF_HOOK_TXN_MAX_OPS) ||
+            (codelets[i].filter && staged->num_removed_filters >= JBPF_HOOK_TXN_MAX_OPS) ||
+            (codelets[i].trace_id != JBPF_TRACE_UNKNOWN_CODELET &&
+             staged->num_removed_trace_ids >= JBPF_HOOK_TXN_MAX_OPS)) {
+            jbpf_logger(JBPF_ERROR, "Too many codelets removed from hook %s\n", staged->hook->name);
+            return -1;
+        }
+        if (codelets[i].perf) {
+            staged->removed_perf[staged->num_removed++] = codelets[i].perf;
+        }
+        if (codelets[i].sampler) {
+            staged->removed_samplers[staged->num_removed_samplers++] = codelets[i].sampler;
+        }
+        if (codelets[i].filter) {
+            staged->removed_filters[staged->num_removed_filters++] = codelets[i].filter;
+        }
+        if (codelets[i].trace_id != JBPF_TRACE_UNKNOWN_CODELET) {
+            staged->removed_trace_ids[staged->num_removed_trace_ids++] = codelets[i].trace_id;
+        }
+    }
+
+    /* If we did not find the program */
+    if (pos == nr_codelets) {
+        return -1;
+    }
+    return pos;
+}
 
-    /* Check where we should place the new program based on its priority and
-     * make sure that program has not been registered already */
-    if (old_codelets) {
+static void
+release_added_checks(struct jbpf_hook_staged* staged)
+{
+    for (int i = 0; i < staged->num_added_samplers; i++) {
+        jbpf_codelet_sampler_destroy(staged->added_samplers[i]);
+    }
+    staged->num_added_samplers = 0;
+    for (int i = 0; i < staged->num_added_filters; i++) {
+        jbpf_codelet_filter_destroy(staged->added_filters[i]);
+    }
+    staged->num_added_filters = 0;
+}
 
-        for (nr_codelets = 0; old_codelets[nr_codelets].jbpf_codelet; nr_codelets++) {
-            if (pos < 0 && old_codelets[nr_codelets].prio < prio) {
-                pos = nr_codelets;
+/* Create the samplers and filters of the codelets added by the transaction.
+ * The codelets that were already loaded keep theirs */
+static int
+stage_codelets_checks(struct jbpf_hook_staged* staged, struct jbpf_hook_codelet* codelets, struct jbpf_hook_txn* txn)
+{
+    for (int i = 0; codelets[i].jbpf_codelet; i++) {
+        if (codelets[i].perf || codelets[i].sampler || codelets[i].filter) {
+            continue;
+        }
+        for (int j = 0; j < txn->num_ops; j++) {
+            struct jbpf_hook_txn_op* op = &txn->ops[j];
+            if (op->type != JBPF_HOOK_TXN_ADD || op->hook != staged->hook || op->codelet != codelets[i].jbpf_codelet) {
+                continue;
+            }
+            if (jbpf_codelet_sampler_create(&op->sampling, &codelets[i].sampler) != 0) {
+                jbpf_logger(JBPF_ERROR, "Failed to set the sampling of a codelet of hook %s\n", staged->hook->name);
+                return -1;
             }
-            /* The program already exists. Abort */
-            if (old_codelets[nr_codelets].jbpf_codelet == codelet) {
-                ck_epoch_end(e_record, NULL);
-                goto out;
+            if (codelets[i].sampler) {
+                staged->added_samplers[staged->num_added_samplers++] = codelets[i].sampler;
             }
+            if (jbpf_codelet_filter_create(&op->filter, &codelets[i].filter) != 0) {
+                jbpf_logger(JBPF_ERROR, "Failed to set the filter of a codelet of hook %s\n", staged->hook->name);
+                return -1;
+            }
+            if (codelets[i].filter) {
+                staged->added_filters[staged->num_added_filters++] = codelets[i].filter;
+            }
+            break;
         }
+    }
+    return 0;
+}
 
-        /* If this is a control hook, only one program is allowed to be loaded */
-        if (hook->hook_type == JBPF_HOOK_TYPE_CTRL && nr_codelets > 0) {
-            jbpf_logger(JBPF_ERROR, "This is a control hook. Only one codelet can be loaded\n");
-            ck_epoch_end(e_record, NULL);
-            goto out;
+/* Build the new codelet array of a hook, applying all the operations of the transaction to that hook in order.
+ * Nothing is published here. */
+static int
+stage_hook(struct jbpf_hook_staged* staged, struct jbpf_hook_txn* txn)
+{
+    struct jbpf_hook* hook = staged->hook;
+    struct jbpf_hook_codelet* new_codelets;
+    int nr_codelets = 0;
+    int nr_adds = 0;
+
+    staged->old_codelets = hook->codelets;
+    staged->old_trampoline = hook->trampoline;
+    staged->new_codelets = NULL;
+    staged->new_trampoline = NULL;
+    staged->num_removed = 0;
+    staged->num_removed_samplers = 0;
+    staged->num_removed_filters = 0;
+    staged->num_removed_trace_ids = 0;
+    staged->num_added_samplers = 0;
+    staged->num_added_filters = 0;
+
+    if (staged->old_codelets) {
+        while (staged->old_codelets[nr_codelets].jbpf_codelet) {
+            nr_codelets++;
         }
     }
 
-    // +2 to add the new codelet and the NULL terminator
-    new_codelets = (struct jbpf_hook_codelet*)jbpf_calloc_mem(nr_codelets + 2, sizeof(struct jbpf_hook_codelet));
+    for (int i = 0; i < txn->num_ops; i++) {
+        if (txn->ops[i].hook == hook && txn->ops[i].type == JBPF_HOOK_TXN_ADD) {
+            nr_adds++;
+        }
+    }
+
+    // +1 for the NULL terminator
+    new_codelets =
+        (struct jbpf_hook_codelet*)jbpf_calloc_mem(nr_codelets + nr_adds + 1, sizeof(struct jbpf_hook_codelet));
 
     if (!new_codelets) {
-        ck_epoch_end(e_record, NULL);
         jbpf_logger(JBPF_ERROR, "Failed to allocate memory for new codelets\n");
-        goto out;
+        return -1;
     }
 
-    /* If programs were already registered */
-    if (old_codelets) {
-        if (pos < 0) {
-            pos = nr_codelets;
-            memcpy(new_codelets, old_codelets, nr_codelets * sizeof(struct jbpf_hook_codelet));
+    if (nr_codelets > 0) {
+        memcpy(new_codelets, staged->old_codelets, nr_codelets * sizeof(struct jbpf_hook_codelet));
+    }
+
+    for (int i = 0; i < txn->num_ops; i++) {
+        struct jbpf_hook_txn_op* op = &txn->ops[i];
+
+        if (op->hook != hook) {
+            continue;
+        }
+        if (op->type == JBPF_HOOK_TXN_ADD) {
+            nr_codelets = stage_add_codelet(hook, new_codelets, nr_codelets, op);
         } else {
-            /* Copy the data before and after the new position */
-            memcpy(new_codelets, old_codelets, pos * sizeof(struct jbpf_hook_codelet));
-            memcpy(new_codelets + pos + 1, old_codelets + pos, (nr_codelets - pos) * sizeof(struct jbpf_hook_codelet));
+            nr_codelets = stage_remove_codelet(staged, new_codelets, nr_codelets, op);
+        }
+        if (nr_codelets < 0) {
+            jbpf_free_mem(new_codelets);
+            return -1;
         }
-    } else {
-        pos = 0;
     }
 
-    // cppcheck-suppress uninitStructMember
-    new_codelets[pos] = hook_codelet;
-    new_codelets[nr_codelets + 1].jbpf_codelet = NULL;
+    new_codelets[nr_codelets].jbpf_codelet = NULL;
 
-    ck_pr_store_ptr(&hook->codelets, new_codelets);
-    ck_epoch_end(e_record, NULL);
-    if (old_codelets) {
-        ck_epoch_call_strict(e_record, &old_codelets->epoch_entry, free_codelet_list);
-        ck_epoch_barrier(e_record);
+    /* All programs are removed. Need to disable the hook */
+    if (nr_codelets == 0) {
+        jbpf_free_mem(new_codelets);
+        return 0;
     }
 
-    ret = 0;
-out:
-    pthread_mutex_unlock(&hook_mutex);
-    return ret;
+    /* The samplers and filters are needed before the trampoline is built */
+    if (stage_codelets_checks(staged, new_codelets, txn) != 0) {
+        release_added_checks(staged);
+        jbpf_free_mem(new_codelets);
+        return -1;
+    }
+
+    staged->new_codelets = new_codelets;
+    /* If the trampoline cannot be built, the hook walks the codelet array instead */
+    staged->new_trampoline = build_hook_trampoline(hook, new_codelets);
+    return 0;
 }
 
-int
-jbpf_remove_codelet_hook(struct jbpf_hook* hook, jbpf_jit_fn codelet)
+/* Allocate the perf data and the flight recorder ids of the codelets added by the transaction. Done once the
+ * transaction cannot fail anymore, so that an aborted transaction does not take any id */
+static void
+stage_codelets_perf(struct jbpf_hook_staged* staged, struct jbpf_hook_txn* txn)
 {
+    struct jbpf_hook_codelet* codelets = staged->new_codelets;
 
-    struct jbpf_hook_codelet *old_codelets, *new_codelets;
-    int nr_codelets = 0;
-    int nr_rem = 0;
-    int i, pos;
+    if (!codelets) {
+        return;
+    }
+
+    for (int i = 0; codelets[i].jbpf_codelet; i++) {
+        if (codelets[i].perf || codelets[i].trace_id != JBPF_TRACE_UNKNOWN_CODELET) {
+            continue;
+        }
+        for (int j = 0; j < txn->num_ops; j++) {
+            struct jbpf_hook_txn_op* op = &txn->ops[j];
+            if (op->type == JBPF_HOOK_TXN_ADD && op->hook == staged->hook && op->codelet == codelets[i].jbpf_codelet) {
+                codelets[i].perf = jbpf_codelet_perf_create(op->codelet_name);
+                codelets[i].trace_id = jbpf_trace_codelet_id(staged->hook, op->codelet_name);
+                break;
+            }
+        }
+    }
+}
+
+int
+jbpf_hook_txn_commit(struct jbpf_hook_txn* txn)
+{
+    struct jbpf_hook_staged* staged;
+    int num_staged = 0;
+    bool need_barrier = false;
     int ret = -1;
 
+    if (!txn) {
+        return -1;
+    }
+
+    /* At most one staged update per operation. The staging is too large for the stack of the caller */
+    staged = jbpf_calloc_mem(txn->num_ops > 0 ? txn->num_ops : 1, sizeof(struct jbpf_hook_staged));
+    if (!staged) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate memory for the hook transaction\n");
+        return -1;
+    }
+
     /* Only one thread can update programs */
     pthread_mutex_lock(&hook_mutex);
 
     ck_epoch_begin(e_record, NULL);
-    old_codelets = hook->codelets;
 
-    /* Find the position of the program to remove */
-    if (old_codelets) {
-        for (nr_codelets = 0; old_codelets[nr_codelets].jbpf_codelet; nr_codelets++) {
-            if (old_codelets[nr_codelets].jbpf_codelet == codelet) {
-                nr_rem++;
+    /* Stage the new codelets of every hook of the transaction */
+    for (int i = 0; i < txn->num_ops; i++) {
+        bool found = false;
+        for (int j = 0; j < num_staged; j++) {
+            if (staged[j].hook == txn->ops[i].hook) {
+                found = true;
+                break;
             }
         }
-    } else { /* No program is registered */
-        ck_epoch_end(e_record, NULL);
-        goto out;
+        if (found) {
+            continue;
+        }
+        staged[num_staged].hook = txn->ops[i].hook;
+        if (stage_hook(&staged[num_staged], txn) != 0) {
+            ck_epoch_end(e_record, NULL);
+            goto abort;
+        }
+        num_staged++;
     }
 
-    /* If we did not find the program */
-    if (nr_rem == 0) {
-        ck_epoch_end(e_record, NULL);
-        goto out;
+    /* Hooks that get their first codelet start jumping into the hook body before the codelets are published */
+    for (int i = 0; i < num_staged; i++) {
+        if (!staged[i].old_codelets && staged[i].new_codelets && jbpf_static_key_enable(staged[i].hook) != 0) {
+            jbpf_logger(JBPF_ERROR, "Failed to enable the call sites of hook %s\n", staged[i].hook->name);
+            for (int j = 0; j <= i; j++) {
+                if (!staged[j].old_codelets && staged[j].new_codelets) {
+                    jbpf_static_key_disable(staged[j].hook);
+                }
+            }
+            ck_epoch_end(e_record, NULL);
+            goto abort;
+        }
     }
 
-    /* All programs are removed */
-    if (nr_codelets - nr_rem == 0) {
-        /* Need to disable the hook */
-        ck_pr_store_ptr(&hook->codelets, NULL);
-    } else {
-        new_codelets =
-            (struct jbpf_hook_codelet*)jbpf_calloc_mem(nr_codelets - nr_rem + 1, sizeof(struct jbpf_hook_codelet));
+    for (int i = 0; i < num_staged; i++) {
+        stage_codelets_perf(&staged[i], txn);
+    }
 
-        if (!new_codelets) {
-            ck_epoch_end(e_record, NULL);
-            goto out;
+    /* Publish all hooks back to back, without any grace period in between */
+    for (int i = 0; i < num_staged; i++) {
+        ck_pr_store_ptr(&staged[i].hook->trampoline, staged[i].new_trampoline);
+        ck_pr_store_ptr(&staged[i].hook->codelets, staged[i].new_codelets);
+    }
+    ck_epoch_end(e_record, NULL);
+
+    /* Hooks left without codelets are skipped again at their call sites. The hook body still checks for
+     * codelets, so a call site that cannot be patched back only costs the check */
+    for (int i = 0; i < num_staged; i++) {
+        if (staged[i].old_codelets && !staged[i].new_codelets && jbpf_static_key_disable(staged[i].hook) != 0) {
+            jbpf_logger(JBPF_WARN, "Failed to disable the call sites of hook %s\n", staged[i].hook->name);
         }
+    }
 
-        /* Need to copy old programs to new structure */
-        pos = 0;
-        for (i = 0; old_codelets[i].jbpf_codelet; i++) {
-            if (old_codelets[i].jbpf_codelet != codelet) {
-                new_codelets[pos++] = old_codelets[i];
-            }
+    /* A single grace period for the whole transaction */
+    for (int i = 0; i < num_staged; i++) {
+        if (staged[i].old_trampoline) {
+            jbpf_ebr_call(&staged[i].old_trampoline->epoch_entry, free_trampoline);
+            need_barrier = true;
+        }
+        if (staged[i].old_codelets) {
+            jbpf_ebr_call(&staged[i].old_codelets->epoch_entry, free_codelet_list);
+            need_barrier = true;
+        }
+    }
+    if (need_barrier) {
+        jbpf_ebr_barrier();
+    }
+
+    /* The removed codelets are no longer reachable by the hooks */
+    for (int i = 0; i < num_staged; i++) {
+        for (int j = 0; j < staged[i].num_removed; j++) {
+            jbpf_codelet_perf_destroy(staged[i].removed_perf[j]);
+        }
+        for (int j = 0; j < staged[i].num_removed_samplers; j++) {
+            jbpf_codelet_sampler_destroy(staged[i].removed_samplers[j]);
+        }
+        for (int j = 0; j < staged[i].num_removed_filters; j++) {
+            jbpf_codelet_filter_destroy(staged[i].removed_filters[j]);
+        }
+        for (int j = 0; j < staged[i].num_removed_trace_ids; j++) {
+            jbpf_trace_codelet_release(staged[i].removed_trace_ids[j]);
         }
-        new_codelets[nr_codelets - nr_rem].jbpf_codelet = NULL;
-        ck_pr_store_ptr(&hook->codelets, new_codelets);
     }
-    ck_epoch_end(e_record, NULL);
-    ck_epoch_synchronize(e_record);
-    jbpf_free_mem(old_codelets);
 
     ret = 0;
+    goto out;
+
+abort:
+    /* Nothing was published, so the staged codelets can be released immediately */
+    for (int i = 0; i < num_staged; i++) {
+        jbpf_hook_trampoline_destroy(staged[i].new_trampoline);
+        release_added_checks(&staged[i]);
+        jbpf_free_mem(staged[i].new_codelets);
+    }
 
 out:
     pthread_mutex_unlock(&hook_mutex);
+    jbpf_free_mem(staged);
+    return ret;
+}
+
+/* Commit a transaction of a single operation. The transaction is allocated on the heap, as it is too large for the
+ * stack of the caller */
+static int
+jbpf_hook_single_op_commit(
+    enum jbpf_hook_txn_op_type type,
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio)
+{
+    struct jbpf_hook_txn* txn;
+    int ret = -1;
+
+    txn = jbpf_calloc_mem(1, sizeof(struct jbpf_hook_txn));
+    if (!txn) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate memory for the hook transaction\n");
+        return -1;
+    }
+
+    jbpf_hook_txn_init(txn);
+    if (jbpf_hook_txn_add_op(txn, type, hook, codelet, NULL, runtime_threshold, prio, NULL) == 0) {
+        ret = jbpf_hook_txn_commit(txn);
+    }
+    jbpf_free_mem(txn);
     return ret;
 }
+
+int
+jbpf_register_codelet_hook(
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio)
+{
+    return jbpf_hook_single_op_commit(JBPF_HOOK_TXN_ADD, hook, codelet, runtime_threshold, prio);
+}
+
+int
+jbpf_remove_codelet_hook(struct jbpf_hook* hook, jbpf_jit_fn codelet)
+{
+    return jbpf_hook_single_op_commit(JBPF_HOOK_TXN_REMOVE, hook, codelet, 0, 0);
+}
+
+void
+jbpf_hook_disable_call_sites(struct jbpf_hook* hook)
+{
+    /* Serialized with the transactions, which enable the call sites of the hooks that get their first codelet */
+    pthread_mutex_lock(&hook_mutex);
+    jbpf_static_key_disable(hook);
+    pthread_mutex_unlock(&hook_mutex);
+}
@@ -8,40 +8,150 @@
 #include <stdio.h>
 
 #include "jbpf_common_types.h"
+#include "jbpf_defs.h"
 #include "jbpf_hook_defs.h"
 #include "jbpf_hook_defs_ext.h"
 #include "jbpf_device_defs.h"
 #include "jbpf_perf.h"
+#include "jbpf_perf_counters.h"
+#include "jbpf_sampling.h"
+#include "jbpf_filter.h"
+#include "jbpf_trace.h"
 
 #include "jbpf.h"
 
 #ifndef DISABLE_JBPF_PERF_STATS
-#define JBPF_START_MEASURE_TIME(name)      \
-    uint64_t start_time = 0, end_time = 0; \
+/* The perf counters are read outside of the timed section, so that reading them does not add to the runtime */
+#define JBPF_START_MEASURE_TIME(name)        \
+    JBPF_PERF_COUNTERS_START(start_counters) \
+    uint64_t start_time = 0, end_time = 0;   \
     start_time = jbpf_measure_start_time();
-#define JBPF_STOP_MEASURE_TIME(name)                                         \
-    end_time = jbpf_measure_stop_time();                                     \
-    if (JBPF_LIKELY(__jbpf_hook_##name.jbpf_perf_active)) {                  \
-        struct jbpf_perf_data* perf_data = (&__jbpf_hook_##name)->perf_data; \
-        _jbpf_perf_log(perf_data, start_time, end_time);                     \
+#define JBPF_STOP_MEASURE_TIME(name)                                                                        \
+    end_time = jbpf_measure_stop_time();                                                                    \
+    if (JBPF_LIKELY(__jbpf_hook_##name.jbpf_perf_active)) {                                                 \
+        struct jbpf_perf_thread_data* perf_data = ck_pr_load_ptr(&(&__jbpf_hook_##name)->perf_data.active); \
+        _jbpf_perf_log(perf_data, start_time, end_time);                                                    \
+        JBPF_PERF_COUNTERS_STOP(start_counters, perf_data)                                                  \
     }
 #else
 #define JBPF_START_MEASURE_TIME(name)
 #define JBPF_STOP_MEASURE_TIME(name)
 #endif
 
+/* The codelet pointed to by hook_codelet_ptr runs on the current call if the context matches the filter of the
+ * codelet and the call is part of the sample of the codelet */
+#define JBPF_CODELET_SELECTED(args...) \
+    (jbpf_codelet_filter_pass(hook_codelet_ptr, args) && jbpf_codelet_sampled(hook_codelet_ptr))
+
+/* Runs the codelet pointed to by hook_codelet_ptr, if it is selected for the current call.
+ * With USE_JBPF_CODELET_PERF_STATS, the runtime of each codelet is also logged in its own perf data.
+ * With USE_JBPF_RUNTIME_BUDGETS, it is checked against the runtime threshold of the codelet, and quarantined codelets
+ * are skipped. With USE_JBPF_TRACE, the invocation is recorded in the flight recorder of the calling thread */
+#if (defined(JBPF_CODELET_PERF_STATS) && !defined(DISABLE_JBPF_PERF_STATS)) || defined(JBPF_RUNTIME_BUDGETS) || \
+    defined(JBPF_TRACE)
+#define JBPF_MEASURE_CODELETS
+#define JBPF_RUN_CODELET(name, args...)                                                                     \
+    if (JBPF_LIKELY(!jbpf_codelet_quarantined(hook_codelet_ptr)) && JBPF_CODELET_SELECTED(args)) {          \
+        JBPF_CODELET_COUNTERS_START(codelet_start_counters)                                                 \
+        uint64_t codelet_start_time = jbpf_measure_start_time();                                            \
+        uint64_t codelet_res __attribute__((unused)) = hook_codelet_ptr->jbpf_codelet(args);                \
+        uint64_t codelet_end_time = jbpf_measure_stop_time();                                               \
+        _jbpf_codelet_account(&__jbpf_hook_##name, hook_codelet_ptr, codelet_start_time, codelet_end_time); \
+        JBPF_CODELET_COUNTERS_STOP(codelet_start_counters, &__jbpf_hook_##name, hook_codelet_ptr)           \
+        JBPF_TRACE_CODELET(&__jbpf_hook_##name, codelet_start_time, codelet_end_time, codelet_res)          \
+    }
+#define JBPF_RUN_CTRL_CODELET(name, res, args...)                                                           \
+    if (JBPF_LIKELY(!jbpf_codelet_quarantined(hook_codelet_ptr)) && JBPF_CODELET_SELECTED(args)) {          \
+        JBPF_CODELET_COUNTERS_START(codelet_start_counters)                                                 \
+        uint64_t codelet_start_time = jbpf_measure_start_time();                                            \
+        res = hook_codelet_ptr->jbpf_codelet(args);                                                         \
+        uint64_t codelet_end_time = jbpf_measure_stop_time();                                               \
+        _jbpf_codelet_account(&__jbpf_hook_##name, hook_codelet_ptr, codelet_start_time, codelet_end_time); \
+        JBPF_CODELET_COUNTERS_STOP(codelet_start_counters, &__jbpf_hook_##name, hook_codelet_ptr)           \
+        JBPF_TRACE_CODELET(&__jbpf_hook_##name, codelet_start_time, codelet_end_time, res)                  \
+    }
+#else
+#define JBPF_RUN_CODELET(name, args...)       \
+    if (JBPF_CODELET_SELECTED(args)) {        \
+        hook_codelet_ptr->jbpf_codelet(args); \
+    }
+#define JBPF_RUN_CTRL_CODELET(name, res, args...)   \
+    if (JBPF_CODELET_SELECTED(args)) {              \
+        res = hook_codelet_ptr->jbpf_codelet(args); \
+    }
+#endif
+
 #ifdef JBPF_AUTOREGISTER_THREAD
 #define JBPF_REGISTER_THREAD() jbpf_register_thread();
 #else
 #define JBPF_REGISTER_THREAD()
 #endif
 
+/* With QSBR, threads announce quiescent states with jbpf_quiescent() instead of
+ * entering an epoch section on every hook call */
+#ifdef JBPF_QSBR
+#define JBPF_HOOK_READ_BEGIN()
+#define JBPF_HOOK_READ_END()
+#else
+#define JBPF_HOOK_READ_BEGIN() ck_epoch_begin(e_record, NULL);
+#define JBPF_HOOK_READ_END() ck_epoch_end(e_record, NULL);
+#endif
+
+/* A record left reserved by a codelet would stall the consumer of its ring buffer, so the records that the codelets
+ * of a hook call did not submit or discard are discarded before the hook returns */
+#define JBPF_RINGBUF_RELEASE()                          \
+    if (JBPF_UNLIKELY(jbpf_ringbuf_num_reserved > 0)) { \
+        jbpf_ringbuf_release_reserved();                \
+    }
+
 extern struct jbpf_hook __start___hook_list[];
 extern struct jbpf_hook __stop___hook_list[];
 
 extern struct jbpf_hook __start___jbpf_agent_hook_list[];
 extern struct jbpf_hook __stop___jbpf_agent_hook_list[];
 
+/* With USE_JBPF_STATIC_KEYS, each hook call site starts with a NOP that skips the whole hook, without loading its
+ * codelets. The NOP is patched into a jump to the hook body when the first codelet is attached to the hook, and back
+ * into a NOP when the last one is removed. The patch sites are recorded in the __jbpf_static_keys section of the
+ * binary that calls the hook, which must be the binary that defines it. If the call sites cannot be patched (e.g.
+ * the code pages cannot be made writable), jbpf_static_keys_active stays false and the NOP falls through to the hook
+ * body, which checks the codelets of the hook as without USE_JBPF_STATIC_KEYS. */
+#if defined(JBPF_STATIC_KEYS) && defined(__x86_64__)
+#define JBPF_HOOK_STATIC_KEYS
+
+extern struct jbpf_static_key_entry __start___jbpf_static_keys[] __attribute__((weak));
+extern struct jbpf_static_key_entry __stop___jbpf_static_keys[] __attribute__((weak));
+
+extern bool jbpf_static_keys_active;
+
+#define JBPF_STATIC_KEYS_START __start___jbpf_static_keys
+#define JBPF_STATIC_KEYS_STOP __stop___jbpf_static_keys
+
+#define JBPF_HOOK_KEY_FUNC(name)                                                   \
+    __attribute__((always_inline)) static inline bool __jbpf_hook_key_##name(void) \
+    {                                                                              \
+        __asm__ goto(".balign 8\n\t"                                               \
+                     "1: .byte 0x0f, 0x1f, 0x44, 0x00, 0x00\n\t"                   \
+                     ".pushsection __jbpf_static_keys, \"aw\"\n\t"                 \
+                     ".balign 8\n\t"                                               \
+                     ".quad 1b, %l[l_enabled], __jbpf_hook_" #name "\n\t"          \
+                     ".popsection\n\t"                                             \
+                     :                                                             \
+                     :                                                             \
+                     :                                                             \
+                     : l_enabled);                                                 \
+        return !__atomic_load_n(&jbpf_static_keys_active, __ATOMIC_RELAXED);       \
+    l_enabled:                                                                     \
+        return true;                                                               \
+    }
+#define JBPF_HOOK_KEY_ENABLED(name) __jbpf_hook_key_##name()
+#else
+#define JBPF_STATIC_KEYS_START NULL
+#define JBPF_STATIC_KEYS_STOP NULL
+#define JBPF_HOOK_KEY_FUNC(name)
+#define JBPF_HOOK_KEY_ENABLED(name) true
+#endif
+
 enum hook_enabled
 {
     JBPF_HOOK_DISABLED = 0,
@@ -56,6 +166,47 @@ jbpf_register_codelet_hook(
     jbpf_codelet_priority_t prio);
 int
 jbpf_remove_codelet_hook(struct jbpf_hook* hook, jbpf_jit_fn codelet);
+void
+jbpf_hook_disable_call_sites(struct jbpf_hook* hook);
+
+/* Staging API to update the codelets of multiple hooks at once */
+void
+jbpf_hook_txn_init(struct jbpf_hook_txn* txn);
+int
+jbpf_hook_txn_add_codelet(
+    struct jbpf_hook_txn* txn,
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    const char* codelet_name,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio);
+int
+jbpf_hook_txn_add_sampled_codelet(
+    struct jbpf_hook_txn* txn,
+    struct jbpf_hook* hook,
+    jbpf_jit_fn codelet,
+    const char* codelet_name,
+    jbpf_runtime_threshold_t runtime_threshold,
+    jbpf_codelet_priority_t prio,
+    const jbpf_codelet_sampling_t* sampling);
+int
+jbpf_hook_txn_filter_codelet(
+    struct jbpf_hook_txn* txn, struct jbpf_hook* hook, jbpf_jit_fn codelet, const jbpf_codelet_filter_t* filter);
+int
+jbpf_hook_txn_remove_codelet(struct jbpf_hook_txn* txn, struct jbpf_hook* hook, jbpf_jit_fn codelet);
+int
+jbpf_hook_txn_commit(struct jbpf_hook_txn* txn);
+
+/* Deferred hooks. Only available with USE_JBPF_DEFERRED_HOOKS */
+int
+jbpf_hook_set_deferred(struct jbpf_hook* hook, bool deferred);
+void
+jbpf_defer_hook(struct jbpf_hook* hook, const void* ctx, size_t ctx_size);
+
+/* Discard the records reserved with jbpf_ringbuf_reserve() by the codelets that ran on the calling thread, and that
+ * were neither submitted nor discarded */
+void
+jbpf_ringbuf_release_reserved(void);
 
 #pragma once
 #ifdef __cplusplus
@@ -69,14 +220,45 @@ extern "C"
 #define PARAMS(args...) args
 #endif
 
-#define __RUN_JBPF_HOOK(name, args)                              \
+#define __RUN_JBPF_HOOK_CODELETS(name, args...)                  \
     {                                                            \
         do {                                                     \
             e_runtime_threshold = hook_codelet_ptr->time_thresh; \
-            hook_codelet_ptr->jbpf_codelet(args);                \
+            JBPF_RUN_CODELET(name, args)                         \
         } while ((++hook_codelet_ptr)->jbpf_codelet);            \
     }
 
+#if defined(JBPF_HOOK_TRAMPOLINE) && !defined(JBPF_MEASURE_CODELETS)
+/* A single call into the fused trampoline of the hook, if one was built */
+#define __RUN_JBPF_HOOK(name, args...)                                            \
+    {                                                                             \
+        struct jbpf_hook_trampoline* hook_trampoline_ptr;                         \
+        hook_trampoline_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->trampoline); \
+        if (JBPF_LIKELY(hook_trampoline_ptr)) {                                   \
+            hook_trampoline_ptr->fn(args, &e_runtime_threshold);                  \
+        } else {                                                                  \
+            __RUN_JBPF_HOOK_CODELETS(name, args)                                  \
+        }                                                                         \
+    }
+#else
+#define __RUN_JBPF_HOOK(name, args...) __RUN_JBPF_HOOK_CODELETS(name, args)
+#endif
+
+/* A deferred hook copies its context to the ring of the calling thread, and the codelets run later on a jbpf worker
+ * thread. Only monitoring hooks can be deferred */
+#ifdef JBPF_DEFERRED_HOOKS
+#define __RUN_OR_DEFER_JBPF_HOOK(name, ctx_ptr, ctx_size)                                         \
+    {                                                                                             \
+        if (JBPF_UNLIKELY(__atomic_load_n(&(&__jbpf_hook_##name)->deferred, __ATOMIC_RELAXED))) { \
+            jbpf_defer_hook(&__jbpf_hook_##name, ctx_ptr, ctx_size);                              \
+        } else {                                                                                  \
+            __RUN_JBPF_HOOK(name, ctx_ptr, ctx_size)                                              \
+        }                                                                                         \
+    }
+#else
+#define __RUN_OR_DEFER_JBPF_HOOK(name, ctx_ptr, ctx_size) __RUN_JBPF_HOOK(name, ctx_ptr, ctx_size)
+#endif
+
 #define HOOK_PROTO(arg...) arg
 #define HOOK_ARGS(args...) args
 #define HOOK_ASSIGN(args...) args
@@ -97,22 +279,27 @@ extern "C"
 #define DECLARE_JBPF_CTRL_HOOK(name, ctx_proto, ctx_arg, fields_proto, assign)                            \
     static inline uint64_t ctrl_hook_##name(fields_proto);                                                \
     extern struct jbpf_hook __jbpf_hook_##name;                                                           \
+    JBPF_HOOK_KEY_FUNC(name)                                                                              \
     static inline uint64_t ctrl_hook_##name(fields_proto)                                                 \
     {                                                                                                     \
         struct jbpf_hook_codelet* hook_codelet_ptr;                                                       \
         uint64_t res = JBPF_DEFAULT_CTRL_OP;                                                              \
+        if (!JBPF_HOOK_KEY_ENABLED(name)) {                                                               \
+            return res;                                                                                   \
+        }                                                                                                 \
         hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);                              \
         if (hook_codelet_ptr) {                                                                           \
             JBPF_REGISTER_THREAD()                                                                        \
-            ck_epoch_begin(e_record, NULL);                                                               \
+            JBPF_HOOK_READ_BEGIN()                                                                        \
             hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);                          \
             if (hook_codelet_ptr) {                                                                       \
                 ctx_proto;                                                                                \
                 assign JBPF_START_MEASURE_TIME(name) e_runtime_threshold = hook_codelet_ptr->time_thresh; \
-                res = hook_codelet_ptr->jbpf_codelet(HOOK_ARGS((void*)&ctx_arg, sizeof(ctx_arg)));        \
+                JBPF_RUN_CTRL_CODELET(name, res, HOOK_ARGS((void*)&ctx_arg, sizeof(ctx_arg)))             \
                 JBPF_STOP_MEASURE_TIME(name)                                                              \
+                JBPF_RINGBUF_RELEASE()                                                                    \
             }                                                                                             \
-            ck_epoch_end(e_record, NULL);                                                                 \
+            JBPF_HOOK_READ_END()                                                                          \
         }                                                                                                 \
         return res;                                                                                       \
     }                                                                                                     \
@@ -121,24 +308,64 @@ extern "C"
 #define DECLARE_JBPF_HOOK(name, ctx_proto, ctx_arg, fields_proto, assign)                                           \
     static inline void hook_##name(fields_proto);                                                                   \
     extern struct jbpf_hook __jbpf_hook_##name;                                                                     \
+    JBPF_HOOK_KEY_FUNC(name)                                                                                        \
     static inline void hook_##name(fields_proto)                                                                    \
     {                                                                                                               \
         struct jbpf_hook_codelet* hook_codelet_ptr;                                                                 \
+        if (!JBPF_HOOK_KEY_ENABLED(name)) {                                                                         \
+            return;                                                                                                 \
+        }                                                                                                           \
         hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);                                        \
         if (hook_codelet_ptr) {                                                                                     \
             JBPF_REGISTER_THREAD()                                                                                  \
-            ck_epoch_begin(e_record, NULL);                                                                         \
+            JBPF_HOOK_READ_BEGIN()                                                                                  \
             hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);                                    \
             if (hook_codelet_ptr) {                                                                                 \
                 ctx_proto;                                                                                          \
                 assign JBPF_START_MEASURE_TIME(name)                                                                \
-                    __RUN_JBPF_HOOK(name, HOOK_ARGS((void*)&ctx_arg, sizeof(ctx_arg))) JBPF_STOP_MEASURE_TIME(name) \
+                    __RUN_OR_DEFER_JBPF_HOOK(name, (void*)&ctx_arg, sizeof(ctx_arg))                                \
+                        JBPF_STOP_MEASURE_TIME(name) JBPF_RINGBUF_RELEASE()                                         \
             }                                                                                                       \
-            ck_epoch_end(e_record, NULL);                                                                           \
+            JBPF_HOOK_READ_END()                                                                                    \
         }                                                                                                           \
     }                                                                                                               \
     JBPF_CODELET_MGMT_FUNCS(name)
 
+/* A batch hook passes num_elems contiguous elements to its codelets in a single struct jbpf_batch_ctx.
+ * The codelet list load, the read-side section and the perf measurement are done once per batch
+ * instead of once per element. Empty batches do not run the codelets. */
+#define DECLARE_JBPF_BATCH_HOOK(name, elem_type)                                           \
+    static inline void hook_##name(elem_type* elems, uint32_t num_elems, uint32_t ctx_id); \
+    extern struct jbpf_hook __jbpf_hook_##name;                                            \
+    JBPF_HOOK_KEY_FUNC(name)                                                               \
+    static inline void hook_##name(elem_type* elems, uint32_t num_elems, uint32_t ctx_id)  \
+    {                                                                                      \
+        struct jbpf_hook_codelet* hook_codelet_ptr;                                        \
+        if (!JBPF_HOOK_KEY_ENABLED(name) || JBPF_UNLIKELY(num_elems == 0)) {               \
+            return;                                                                        \
+        }                                                                                  \
+        hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);               \
+        if (hook_codelet_ptr) {                                                            \
+            JBPF_REGISTER_THREAD()                                                         \
+            JBPF_HOOK_READ_BEGIN()                                                         \
+            hook_codelet_ptr = ck_pr_load_ptr(&(&__jbpf_hook_##name)->codelets);           \
+            if (hook_codelet_ptr) {                                                        \
+                struct jbpf_batch_ctx ctx;                                                 \
+                ctx.data = (uint64_t)(uintptr_t)elems;                                     \
+                ctx.data_end = (uint64_t)(uintptr_t)(elems + num_elems);                   \
+                ctx.meta_data = 0;                                                         \
+                ctx.ctx_id = ctx_id;                                                       \
+                ctx.num_elems = num_elems;                                                 \
+                JBPF_START_MEASURE_TIME(name)                                              \
+                __RUN_OR_DEFER_JBPF_HOOK(name, (void*)&ctx, sizeof(ctx))                  \
+                JBPF_STOP_MEASURE_TIME(name)                                               \
+                JBPF_RINGBUF_RELEASE()                                                     \
+            }                                                                              \
+            JBPF_HOOK_READ_END()                                                           \
+        }                                                                                  \
+    }                                                                                      \
+    JBPF_CODELET_MGMT_FUNCS(name)
+
 /* Here we assing the various information about the hook
  * in corresponding ELF sections so that we can later parse them
  * and identify the location of the functions */
@@ -151,6 +378,8 @@ extern "C"
         .codelets = NULL,                                                                                       \
         .hook_type = type,                                                                                      \
         .jbpf_perf_active = JBPF_HOOK_PERF_DEFAULT_STATE,                                                       \
+        .static_keys_start = JBPF_STATIC_KEYS_START,                                                            \
+        .static_keys_stop = JBPF_STATIC_KEYS_STOP,                                                              \
     };                                                                                                          \
     struct jbpf_hook* jh_start_##_name = __start___hook_list;                                                   \
     struct jbpf_hook* jh_stop_##_name = __stop___hook_list;
@@ -163,6 +392,8 @@ extern "C"
 #define DEFINE_JBPF_AGENT_HOOK(_name) \
     DEFINE_JBPF_HOOK_SECTIONS(_name, "__jbpf_agent_hook_list", "__jbpf_agent_hook_names", JBPF_HOOK_TYPE_MON)
 
+#define DEFINE_JBPF_BATCH_HOOK(_name) DEFINE_JBPF_HOOK(_name)
+
 #else /* jbpf hooks are not enabled */
 
 #define JBPF_CODELET_MGMT_FUNCS(name)                                                                            \
@@ -177,6 +408,10 @@ extern "C"
     static inline void hook_##name(fields_proto) { return; }              \
     JBPF_CODELET_MGMT_FUNCS(name)
 
+#define DECLARE_JBPF_BATCH_HOOK(name, elem_type)                                                       \
+    static inline void hook_##name(elem_type* elems, uint32_t num_elems, uint32_t ctx_id) { return; } \
+    JBPF_CODELET_MGMT_FUNCS(name)
+
 #define DEFINE_JBPF_HOOK_SECTIONS(_name, hook_list_section, hook_names_section)
 
 /* Here we assing the various information about the hook
@@ -188,6 +423,8 @@ extern "C"
 
 #define DEFINE_JBPF_AGENT_HOOK(_name)
 
+#define DEFINE_JBPF_BATCH_HOOK(_name)
+
 #endif /* JBPF_ENABLED */
 
 #pragma once
@@ -9,6 +9,7 @@
 
 #include "jbpf_hook_defs_ext.h"
 #include "jbpf_common_types.h"
+#include "jbpf_perf_ext.h"
 
 #include "ck_epoch.h"
 
@@ -30,22 +31,164 @@ enum jbpf_hook_type
     JBPF_HOOK_TYPE_CTRL
 };
 
+/* Runtime stats of a hook or a codelet for a single thread, padded so that threads do not share cache lines */
+struct jbpf_perf_thread_data
+{
+    uint64_t num;
+    uint64_t min;
+    uint64_t max;
+    uint64_t counters[JBPF_PERF_NUM_COUNTERS];
+    uint32_t hist[JBPF_NUM_HIST_BINS];
+} __attribute__((aligned(64)));
+
+/* Double buffer of per-thread runtime stats. The hooks log to the active buffer, while the perf report collects the
+ * retired one and then swaps the two, so that the stats are collected without allocating or waiting for the hooks */
+struct jbpf_perf_buf
+{
+    struct jbpf_perf_thread_data* active;
+    struct jbpf_perf_thread_data* retired;
+};
+
+/* Runtime accounting of a codelet, kept while the codelet is loaded to a hook */
+struct jbpf_codelet_perf
+{
+    char codelet_name[JBPF_PERF_CODELET_NAME_LEN];
+    /* Per-thread runtime stats */
+    struct jbpf_perf_buf perf_data;
+    /* Runtime threshold overruns, counted by the hook threads */
+    uint64_t num_overruns;
+    /* Value of num_overruns at the start of the current window */
+    uint64_t window_overruns;
+    uint64_t window_start;
+    /* Set once the codelet exceeded its budget. The hooks skip it until it is removed */
+    bool quarantined;
+};
+
+/* Sampling state of a codelet for a single thread */
+struct jbpf_codelet_sampler_state
+{
+    /* Calls since the codelet last ran, for ratio sampling */
+    uint64_t count;
+    /* Theoretical arrival time of the next call, for rate and interval sampling */
+    uint64_t next_time;
+} __attribute__((aligned(64)));
+
+/* Sampling of a codelet, kept while the codelet is loaded to a hook.
+ * Rate and interval sampling are both done with a generic cell rate algorithm: a call is allowed if it does not
+ * arrive more than tolerance_ns before its theoretical arrival time. */
+struct jbpf_codelet_sampler
+{
+    uint32_t type;
+    uint64_t ratio;
+    uint64_t period_ns;
+    uint64_t tolerance_ns;
+    /* Time origin of next_time */
+    uint64_t start_time;
+    struct jbpf_codelet_sampler_state* state;
+};
+
+/* Filter counters of a codelet for a single thread */
+struct jbpf_codelet_filter_state
+{
+    /* Calls that did not run the codelet because the filter did not match */
+    uint64_t num_filtered;
+} __attribute__((aligned(64)));
+
+/* Pre-filter of a codelet, kept while the codelet is loaded to a hook.
+ * The conditions are checked when the filter is created, so the hooks evaluate them without any validation. */
+struct jbpf_codelet_filter_check
+{
+    bool match_any;
+    uint32_t num_conditions;
+    jbpf_codelet_filter_cond_t conditions[JBPF_MAX_FILTER_CONDITIONS];
+    struct jbpf_codelet_filter_state* state;
+    /* Sum of num_filtered already reported in the perf stats */
+    uint64_t num_reported;
+};
+
 struct jbpf_hook_codelet
 {
     jbpf_jit_fn jbpf_codelet;
     jbpf_codelet_priority_t prio;
     jbpf_runtime_threshold_t time_thresh;
+    struct jbpf_codelet_perf* perf;
+    /* NULL if the codelet runs on every call of the hook */
+    struct jbpf_codelet_sampler* sampler;
+    struct jbpf_codelet_filter_check* filter;
+    /* Id of the codelet in the flight recorder */
+    uint16_t trace_id;
     ck_epoch_entry_t epoch_entry;
 };
 
+/* Native function fusing all the codelets of a hook into a single call.
+ * The last argument is the location of the runtime threshold of the calling thread. */
+typedef uint64_t (*jbpf_hook_trampoline_fn)(void* mem, size_t mem_len, jbpf_runtime_threshold_t* runtime_threshold);
+
+struct jbpf_hook_trampoline
+{
+    jbpf_hook_trampoline_fn fn;
+    void* code;
+    size_t code_size;
+    ck_epoch_entry_t epoch_entry;
+};
+
+/* Patch site of a hook call, emitted in the __jbpf_static_keys section when USE_JBPF_STATIC_KEYS is enabled.
+ * The site is a 5-byte NOP, 8-byte aligned, that is turned into a jump to target while the hook has codelets. */
+struct jbpf_static_key_entry
+{
+    uint64_t code;
+    uint64_t target;
+    struct jbpf_hook* hook;
+};
+
+/* Maximum number of codelet registrations and removals staged in a single hook transaction */
+#define JBPF_HOOK_TXN_MAX_OPS (64)
+
+enum jbpf_hook_txn_op_type
+{
+    JBPF_HOOK_TXN_ADD = 0,
+    JBPF_HOOK_TXN_REMOVE
+};
+
+struct jbpf_hook_txn_op
+{
+    enum jbpf_hook_txn_op_type type;
+    struct jbpf_hook* hook;
+    jbpf_jit_fn codelet;
+    const char* codelet_name;
+    jbpf_runtime_threshold_t runtime_threshold;
+    jbpf_codelet_priority_t prio;
+    jbpf_codelet_sampling_t sampling;
+    jbpf_codelet_filter_t filter;
+};
+
+/* Codelet registrations and removals that are applied to their hooks together,
+ * with a single grace period for the whole transaction */
+struct jbpf_hook_txn
+{
+    int num_ops;
+    struct jbpf_hook_txn_op ops[JBPF_HOOK_TXN_MAX_OPS];
+};
+
 struct jbpf_hook
 {
     const char* name;
+    /* Index of the hook in the hook list, set by jbpf_init */
+    uint16_t id;
     struct jbpf_hook_codelet* codelets;
+    struct jbpf_hook_trampoline* trampoline;
 
     enum jbpf_hook_type hook_type;
     bool jbpf_perf_active;
-    struct jbpf_perf_data* perf_data;
+    struct jbpf_perf_buf perf_data;
+
+    /* Patch sites of the binary that defines the hook */
+    struct jbpf_static_key_entry* static_keys_start;
+    struct jbpf_static_key_entry* static_keys_stop;
+
+    /* Deferred hooks queue their calls to the jbpf workers instead of running the codelets */
+    bool deferred;
+    uint64_t deferred_drops;
 };
 
 #endif
@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jbpf_hook_trampoline.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+#if defined(JBPF_HOOK_TRAMPOLINE) && defined(__x86_64__)
+
+/* Prologue: push rbx, r12, r13 and keep the arguments in them.
+ * Three pushes also realign the stack to 16 bytes for the codelet calls */
+#define TRAMPOLINE_PROLOGUE_SIZE 14
+/* Per codelet: movabs rax, thresh (10), mov [r13], rax (4), mov rdi, rbx (3), mov rsi, r12 (3),
+ * and either call rel32 (5) or movabs rax, fn + call rax (12) */
+#define TRAMPOLINE_CODELET_MAX_SIZE 32
+/* Epilogue: pop r13, r12, rbx and ret */
+#define TRAMPOLINE_EPILOGUE_SIZE 6
+
+static inline uint8_t*
+emit_bytes(uint8_t* p, const uint8_t* bytes, size_t len)
+{
+    memcpy(p, bytes, len);
+    return p + len;
+}
+
+static inline uint8_t*
+emit_imm64(uint8_t* p, uint64_t imm)
+{
+    memcpy(p, &imm, sizeof(imm));
+    return p + sizeof(imm);
+}
+
+static size_t
+emit_trampoline(uint8_t* code, const struct jbpf_hook_codelet* codelets)
+{
+    static const uint8_t prologue[TRAMPOLINE_PROLOGUE_SIZE] = {
+        0x53,             /* push rbx */
+        0x41, 0x54,       /* push r12 */
+        0x41, 0x55,       /* push r13 */
+        0x48, 0x89, 0xfb, /* mov rbx, rdi */
+        0x49, 0x89, 0xf4, /* mov r12, rsi */
+        0x49, 0x89, 0xd5, /* mov r13, rdx */
+    };
+    static const uint8_t set_args[] = {
+        0x49, 0x89, 0x45, 0x00, /* mov [r13], rax */
+        0x48, 0x89, 0xdf,       /* mov rdi, rbx */
+        0x4c, 0x89, 0xe6,       /* mov rsi, r12 */
+    };
+    static const uint8_t epilogue[TRAMPOLINE_EPILOGUE_SIZE] = {
+        0x41, 0x5d, /* pop r13 */
+        0x41, 0x5c, /* pop r12 */
+        0x5b,       /* pop rbx */
+        0xc3,       /* ret */
+    };
+    static const uint8_t movabs_rax[] = {0x48, 0xb8};
+    static const uint8_t call_rax[] = {0xff, 0xd0};
+
+    uint8_t* p = code;
+
+    p = emit_bytes(p, prologue, sizeof(prologue));
+
+    for (int i = 0; codelets[i].jbpf_codelet; i++) {
+        int64_t rel;
+
+        p = emit_bytes(p, movabs_rax, sizeof(movabs_rax));
+        p = emit_imm64(p, (uint64_t)codelets[i].time_thresh);
+        p = emit_bytes(p, set_args, sizeof(set_args));
+
+        /* Use a direct call if the codelet is within reach, otherwise go through rax */
+        rel = (int64_t)(uintptr_t)codelets[i].jbpf_codelet - (int64_t)(uintptr_t)(p + 5);
+        if (rel >= INT32_MIN && rel <= INT32_MAX) {
+            int32_t rel32 = (int32_t)rel;
+            *p++ = 0xe8; /* call rel32 */
+            memcpy(p, &rel32, sizeof(rel32));
+            p += sizeof(rel32);
+        } else {
+            p = emit_bytes(p, movabs_rax, sizeof(movabs_rax));
+            p = emit_imm64(p, (uint64_t)(uintptr_t)codelets[i].jbpf_codelet);
+            p = emit_bytes(p, call_rax, sizeof(call_rax));
+        }
+    }
+
+    p = emit_bytes(p, epilogue, sizeof(epilogue));
+
+    return p - code;
+}
+
+struct jbpf_hook_trampoline*
+jbpf_hook_trampoline_create(const struct jbpf_hook_codelet* codelets)
+{
+    struct jbpf_hook_trampoline* trampoline;
+    size_t nr_codelets = 0;
+    size_t max_size;
+    void* code;
+
+    if (!codelets) {
+        return NULL;
+    }
+
+    while (codelets[nr_codelets].jbpf_codelet) {
+        nr_codelets++;
+    }
+
+    if (nr_codelets == 0) {
+        return NULL;
+    }
+
+    max_size = TRAMPOLINE_PROLOGUE_SIZE + nr_codelets * TRAMPOLINE_CODELET_MAX_SIZE + TRAMPOLINE_EPILOGUE_SIZE;
+
+    trampoline = jbpf_calloc_mem(1, sizeof(struct jbpf_hook_trampoline));
+    if (!trampoline) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate memory for hook trampoline\n");
+        return NULL;
+    }
+
+    code = mmap(NULL, max_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        jbpf_logger(JBPF_ERROR, "Failed to map memory for hook trampoline\n");
+        jbpf_free_mem(trampoline);
+        return NULL;
+    }
+
+    emit_trampoline(code, codelets);
+
+    if (mprotect(code, max_size, PROT_READ | PROT_EXEC) < 0) {
+        jbpf_logger(JBPF_ERROR, "Failed to make hook trampoline executable\n");
+        munmap(code, max_size);
+        jbpf_free_mem(trampoline);
+        return NULL;
+    }
+
+    trampoline->code = code;
+    trampoline->code_size = max_size;
+    trampoline->fn = (jbpf_hook_trampoline_fn)code;
+
+    return trampoline;
+}
+
+void
+jbpf_hook_trampoline_destroy(struct jbpf_hook_trampoline* trampoline)
+{
+    if (!trampoline) {
+        return;
+    }
+    munmap(trampoline->code, trampoline->code_size);
+    jbpf_free_mem(trampoline);
+}
+
+#else
+
+/* Hooks fall back to walking the codelet array */
+struct jbpf_hook_trampoline*
+jbpf_hook_trampoline_create(const struct jbpf_hook_codelet* codelets)
+{
+    return NULL;
+}
+
+void
+jbpf_hook_trampoline_destroy(struct jbpf_hook_trampoline* trampoline)
+{
+}
+
+#endif
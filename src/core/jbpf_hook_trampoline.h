@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_HOOK_TRAMPOLINE_H
+#define JBPF_HOOK_TRAMPOLINE_H
+
+#include "jbpf_hook_defs.h"
+
+/**
+ * @brief Build a native trampoline that runs a chain of codelets
+ * @param codelets The NULL-terminated codelet array of the hook, sorted by priority
+ * @return The trampoline on success, NULL if the chain cannot be fused (e.g. unsupported architecture)
+ * @note The trampoline calls the JIT'd codelets directly, in the order they appear in the array,
+ * and stores the runtime threshold of each codelet before calling it.
+ * @ingroup core
+ */
+struct jbpf_hook_trampoline*
+jbpf_hook_trampoline_create(const struct jbpf_hook_codelet* codelets);
+
+/**
+ * @brief Release a trampoline created with jbpf_hook_trampoline_create()
+ * @param trampoline The trampoline to release
+ * @note The caller must make sure that no thread can still execute the trampoline
+ * @ingroup core
+ */
+void
+jbpf_hook_trampoline_destroy(struct jbpf_hook_trampoline* trampoline);
+
+#endif
@@ -27,8 +27,11 @@ struct jbpf_map
     unsigned int key_size;
     unsigned int value_size;
     unsigned int max_entries;
+    unsigned int map_flags;
     jbpf_map_name_t name;
     void* data;
+    /* Shared memory region of the data of a JBPF_MAP_F_MMAPABLE map, NULL otherwise */
+    struct jbpf_map_mmap* mmap;
 };
 
 struct jbpf_codelet_io_serde_obj_files
@@ -93,6 +96,8 @@ struct jbpf_codelet
     jbpf_hook_name_t hook_name;
     jbpf_codelet_priority_t priority;
     jbpf_runtime_threshold_t e_runtime_threshold;
+    jbpf_codelet_sampling_t sampling;
+    jbpf_codelet_filter_t filter;
     struct jbpf_codeletset* codeletset;
     bool loaded;
     bool relocation_error;
@@ -109,12 +114,15 @@ extern struct jbpf_hook_list jbpf_hook_list;
 struct jbpf_threads_info
 {
     struct jbpf_bitmap registered_threads;
+    /* Number of thread ids that have been used, i.e. of per-thread map copies that may hold data */
+    int num_thread_slots;
 };
 
 struct jbpf_ctx_t
 {
     /* Run path*/
     char jbpf_run_path[JBPF_RUN_PATH_LEN];
+    char jbpf_namespace[JBPF_NAMESPACE_LEN];
 
     jbpf_lcm_ipc_server_ctx_t lcm_ipc_server_ctx;
 
@@ -137,9 +145,30 @@ struct jbpf_ctx_t
 struct jbpf_ctx_t*
 jbpf_get_ctx(void);
 
+/**
+ * @brief Get the number of thread ids used since the start of jbpf, i.e. of the copies of a per-thread map that may
+ * hold data
+ * @return The number of thread ids
+ * @ingroup core
+ */
+int
+jbpf_get_num_thread_slots(void);
+
 void
 jbpf_call_barrier(void);
 
+/**
+ * @brief Remove a codelet that exceeded its runtime budget from its hook. A codelet of a loaded codeletset is marked
+ * as no longer loaded, so that the unload of its codeletset does not remove it from the hook again
+ * @param hook The hook of the codelet
+ * @param codelet_fn The codelet
+ * @return 0 if the codelet was removed, -1 if it could not be removed or a codeletset is being loaded or unloaded,
+ * in which case the removal can be retried
+ * @ingroup core
+ */
+int
+jbpf_quarantine_codelet(struct jbpf_hook* hook, jbpf_jit_fn codelet_fn);
+
 int
 validate_string_param(char* param_name, char* param, uint32_t param_maxlen, jbpf_codeletset_load_error_s* err);
 
@@ -158,6 +187,20 @@ int
 __jbpf_map_update_elem(struct jbpf_map* map, const void* key, void* item, uint64_t flags);
 int
 __jbpf_map_delete_elem(struct jbpf_map* map, const void* key);
+int
+__jbpf_map_reduce(const struct jbpf_map* map, const void* key, void* out, uint32_t out_size, uint64_t flags);
+int
+__jbpf_map_lookup_batch(
+    const struct jbpf_map* map, const void* keys, uint32_t keys_size, void* values, uint32_t values_size);
+int
+__jbpf_map_update_batch(
+    struct jbpf_map* map, const void* keys, uint32_t keys_size, const void* values, uint32_t values_size);
+int
+__jbpf_map_delete_batch(struct jbpf_map* map, const void* keys, uint32_t keys_size);
+int
+__jbpf_map_iterate(const struct jbpf_map* map, void* cursor, uint32_t cursor_size, void* data, uint32_t max_size);
+int
+__jbpf_map_dump(struct jbpf_map* map, void* data, uint32_t max_size, uint64_t flags);
 void
 __test_setup(void);
 
@@ -0,0 +1,296 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ck_pr.h"
+
+#include "jbpf_map_mmap.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+#include "jbpf_lookup3.h"
+
+static unsigned int jbpf_map_mmap_id;
+
+/* Entry of the name index, in "<run_path>/<namespace>/map_<hash>.mmap" */
+struct jbpf_map_mmap_index
+{
+    uint32_t magic;
+    char codeletset_name[JBPF_CODELETSET_NAME_LEN];
+    char codelet_name[JBPF_CODELET_NAME_LEN];
+    char map_name[JBPF_MAP_NAME_LEN];
+    char mem_name[JBPF_MAP_MMAP_NAME_LEN];
+};
+
+static void
+jbpf_map_mmap_index_init(
+    struct jbpf_map_mmap_index* entry, const char* codeletset_name, const char* codelet_name, const char* map_name)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->magic = JBPF_MAP_MMAP_MAGIC;
+    strncpy(entry->codeletset_name, codeletset_name, JBPF_CODELETSET_NAME_LEN - 1);
+    strncpy(entry->codelet_name, codelet_name, JBPF_CODELET_NAME_LEN - 1);
+    strncpy(entry->map_name, map_name, JBPF_MAP_NAME_LEN - 1);
+}
+
+// The file of an entry is named after a hash of the names, which are checked on lookup in case of a collision
+static int
+jbpf_map_mmap_index_path(const char* run_path, const struct jbpf_map_mmap_index* entry, char* path, size_t len)
+{
+    uint32_t hash1 = 0, hash2 = 0;
+    int res;
+
+    hashlittle2(entry, offsetof(struct jbpf_map_mmap_index, mem_name), &hash1, &hash2);
+    res = snprintf(path, len, "%s/map_%08x%08x.mmap", run_path, hash1, hash2);
+    return (res < 0 || (size_t)res >= len) ? -1 : 0;
+}
+
+static size_t
+jbpf_map_mmap_round_up(size_t size, size_t page_size)
+{
+    return (size + page_size - 1) / page_size * page_size;
+}
+
+bool
+jbpf_map_mmap_supported(int map_type)
+{
+    return map_type == JBPF_MAP_TYPE_ARRAY || map_type == JBPF_MAP_TYPE_PER_THREAD_ARRAY;
+}
+
+int
+jbpf_map_mmap_create(
+    struct jbpf_map* map,
+    const struct jbpf_load_map_def* map_def,
+    char* meta_path_name,
+    const char* jbpf_namespace,
+    const char* codeletset_name,
+    const char* codelet_name)
+{
+    struct jbpf_map_mmap* map_mmap;
+    struct jbpf_map_mmap_hdr* hdr;
+    struct jbpf_map* perthread_maps = NULL;
+    char mem_name[JBPF_MAP_MMAP_NAME_LEN];
+    size_t page_size, data_offset, copy_stride;
+    uint32_t num_copies;
+    uint8_t* base;
+
+    if (!jbpf_map_mmap_supported(map->type) || map->value_size == 0 || map->max_entries == 0) {
+        jbpf_logger(JBPF_ERROR, "Map %s of type %d cannot be memory-mapped\n", map->name, map->type);
+        return -1;
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    num_copies = map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY ? JBPF_MAX_NUM_REG_THREADS : 1;
+    data_offset = jbpf_map_mmap_round_up(sizeof(struct jbpf_map_mmap_hdr), page_size);
+    copy_stride = jbpf_map_mmap_round_up((size_t)map->value_size * map->max_entries, page_size);
+
+    map_mmap = jbpf_calloc_mem(1, sizeof(struct jbpf_map_mmap));
+    if (!map_mmap) {
+        return -1;
+    }
+
+    snprintf(mem_name, sizeof(mem_name), "%s_map_%u", jbpf_namespace, ck_pr_faa_uint(&jbpf_map_mmap_id, 1));
+
+    base = jbpf_allocate_shared_region(
+        data_offset + num_copies * copy_stride,
+        meta_path_name,
+        mem_name,
+        &map_mmap->mmap_info,
+        map_def->map_flags & JBPF_MAP_F_MMAP_HUGEPAGES);
+    if (!base) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate the shared memory of map %s\n", map->name);
+        goto error;
+    }
+
+    if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY) {
+        perthread_maps = jbpf_calloc_mem(sizeof(struct jbpf_map), JBPF_MAX_NUM_REG_THREADS);
+        if (!perthread_maps) {
+            jbpf_free_memory(&map_mmap->mmap_info, meta_path_name, true);
+            goto error;
+        }
+        for (int map_id = 0; map_id < JBPF_MAX_NUM_REG_THREADS; map_id++) {
+            memcpy(&perthread_maps[map_id], map, sizeof(struct jbpf_map));
+            perthread_maps[map_id].data = base + data_offset + map_id * copy_stride;
+        }
+        map->data = perthread_maps;
+    } else {
+        map->data = base + data_offset;
+    }
+
+    hdr = (struct jbpf_map_mmap_hdr*)base;
+    hdr->version = JBPF_MAP_MMAP_VERSION;
+    hdr->map_type = map->type;
+    hdr->value_size = map->value_size;
+    hdr->max_entries = map->max_entries;
+    hdr->num_copies = num_copies;
+    hdr->data_offset = data_offset;
+    hdr->copy_stride = copy_stride;
+    strncpy(hdr->codeletset_name, codeletset_name, JBPF_CODELETSET_NAME_LEN - 1);
+    strncpy(hdr->codelet_name, codelet_name, JBPF_CODELET_NAME_LEN - 1);
+    strncpy(hdr->map_name, map->name, JBPF_MAP_NAME_LEN - 1);
+    // The magic is written last, so that a reader that sees it sees the whole header
+    ck_pr_fence_store();
+    hdr->magic = JBPF_MAP_MMAP_MAGIC;
+
+    map_mmap->hdr = hdr;
+    map->mmap = map_mmap;
+    jbpf_logger(JBPF_INFO, "Map %s is memory-mapped in %s\n", map->name, mem_name);
+    return 0;
+
+error:
+    jbpf_free_mem(map_mmap);
+    return -1;
+}
+
+void
+jbpf_map_mmap_destroy(struct jbpf_map* map, char* meta_path_name)
+{
+    struct jbpf_map_mmap* map_mmap = map->mmap;
+
+    if (!map_mmap) {
+        return;
+    }
+
+    if (map->type == JBPF_MAP_TYPE_PER_THREAD_ARRAY) {
+        jbpf_free_mem(map->data);
+    }
+    map->data = NULL;
+
+    if (jbpf_free_memory(&map_mmap->mmap_info, meta_path_name, true) != 0) {
+        jbpf_logger(JBPF_ERROR, "Failed to release the shared memory of map %s\n", map->name);
+    }
+    jbpf_free_mem(map_mmap);
+    map->mmap = NULL;
+}
+
+int
+jbpf_map_mmap_publish(
+    const char* run_path,
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    const char* mem_name)
+{
+    struct jbpf_map_mmap_index entry;
+    char path[PATH_MAX], tmp_path[PATH_MAX + 8];
+    FILE* f;
+    size_t written;
+
+    jbpf_map_mmap_index_init(&entry, codeletset_name, codelet_name, map_name);
+    strncpy(entry.mem_name, mem_name, JBPF_MAP_MMAP_NAME_LEN - 1);
+    if (jbpf_map_mmap_index_path(run_path, &entry, path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    // The entry is written to a temporary file and renamed, so that a reader never sees a partial entry
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    f = fopen(tmp_path, "w");
+    if (!f) {
+        jbpf_logger(JBPF_ERROR, "Failed to create %s: %s\n", tmp_path, strerror(errno));
+        return -1;
+    }
+    written = fwrite(&entry, sizeof(entry), 1, f);
+    if (fclose(f) != 0 || written != 1 || rename(tmp_path, path) != 0) {
+        jbpf_logger(JBPF_ERROR, "Failed to write %s\n", path);
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+void
+jbpf_map_mmap_unpublish(
+    const char* run_path, const char* codeletset_name, const char* codelet_name, const char* map_name)
+{
+    struct jbpf_map_mmap_index entry;
+    char path[PATH_MAX];
+
+    jbpf_map_mmap_index_init(&entry, codeletset_name, codelet_name, map_name);
+    if (jbpf_map_mmap_index_path(run_path, &entry, path, sizeof(path)) == 0) {
+        unlink(path);
+    }
+}
+
+int
+jbpf_map_mmap_find(
+    const char* run_path,
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    char* mem_name,
+    size_t len)
+{
+    struct jbpf_map_mmap_index entry, stored;
+    char path[PATH_MAX];
+    FILE* f;
+    size_t nread;
+
+    if (!run_path || !codeletset_name || !codelet_name || !map_name || !mem_name || len == 0) {
+        return -1;
+    }
+
+    jbpf_map_mmap_index_init(&entry, codeletset_name, codelet_name, map_name);
+    if (jbpf_map_mmap_index_path(run_path, &entry, path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    nread = fread(&stored, sizeof(stored), 1, f);
+    fclose(f);
+
+    if (nread != 1 || memcmp(&stored, &entry, offsetof(struct jbpf_map_mmap_index, mem_name)) != 0) {
+        return -1;
+    }
+    stored.mem_name[JBPF_MAP_MMAP_NAME_LEN - 1] = '\0';
+    if (strlen(stored.mem_name) >= len) {
+        return -1;
+    }
+    strcpy(mem_name, stored.mem_name);
+    return 0;
+}
+
+const struct jbpf_map_mmap_hdr*
+jbpf_map_mmap_attach_path(const char* run_path, const char* mem_name, struct jbpf_mmap_info* mmap_info)
+{
+    char meta_path[JBPF_RUN_PATH_LEN] = {0};
+    char name[JBPF_MAP_MMAP_NAME_LEN] = {0};
+    const struct jbpf_map_mmap_hdr* hdr;
+
+    if (!run_path || !mem_name || !mmap_info) {
+        return NULL;
+    }
+
+    strncpy(meta_path, run_path, JBPF_RUN_PATH_LEN - 1);
+    strncpy(name, mem_name, JBPF_MAP_MMAP_NAME_LEN - 1);
+    hdr = jbpf_attach_memory_readonly(meta_path, name, mmap_info);
+    if (!hdr) {
+        jbpf_logger(JBPF_ERROR, "Failed to map the shared memory %s\n", mem_name);
+        return NULL;
+    }
+
+    if (mmap_info->len < sizeof(*hdr) || hdr->magic != JBPF_MAP_MMAP_MAGIC ||
+        hdr->data_offset + hdr->num_copies * hdr->copy_stride > mmap_info->len) {
+        jbpf_logger(JBPF_ERROR, "The shared memory %s does not hold a map\n", mem_name);
+        jbpf_map_mmap_detach(mmap_info);
+        return NULL;
+    }
+
+    return hdr;
+}
+
+int
+jbpf_map_mmap_detach(struct jbpf_mmap_info* mmap_info)
+{
+    if (!mmap_info || !mmap_info->addr) {
+        return -1;
+    }
+    // A read-only mapping has no name, so no metadata is removed
+    return jbpf_free_memory(mmap_info, NULL, false);
+}
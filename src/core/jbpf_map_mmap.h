@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_MAP_MMAP_H
+#define JBPF_MAP_MMAP_H
+
+#include <stdbool.h>
+
+#include "jbpf.h"
+#include "jbpf_int.h"
+#include "jbpf_mem_mgmt.h"
+
+/* Maps created with JBPF_MAP_F_MMAPABLE keep their data in a shared memory region named "<namespace>_map_<id>",
+ * instead of the heap. The first page of the region holds a struct jbpf_map_mmap_hdr that describes the layout of the
+ * data, and each array copy starts on a page of its own, so that the region can be mapped read-only by the host
+ * application and the IPC secondaries. The name of the region is published for each codelet linked to the map in a
+ * file of the run path, named after a hash of the codeletset, codelet and map names, where the secondaries find it
+ * with jbpf_map_mmap_find() */
+
+struct jbpf_map_mmap
+{
+    struct jbpf_mmap_info mmap_info;
+    struct jbpf_map_mmap_hdr* hdr;
+};
+
+/**
+ * @brief Whether the maps of a type can be created with JBPF_MAP_F_MMAPABLE
+ * @param map_type The map type
+ * @ingroup core
+ */
+bool
+jbpf_map_mmap_supported(int map_type);
+
+/**
+ * @brief Allocate the shared memory region of a map and point the data of the map, or of its thread copies, to it
+ * @param map The map, with its type and sizes set
+ * @param map_def The definition of the map
+ * @param meta_path_name The directory of the memory metadata of the agent
+ * @param jbpf_namespace The namespace of the agent
+ * @param codeletset_name The name of the codeletset that creates the map, stored in the header
+ * @param codelet_name The name of the codelet that creates the map, stored in the header
+ * @return 0 on success, or -1 if the map is invalid or the region cannot be allocated
+ * @ingroup core
+ */
+int
+jbpf_map_mmap_create(
+    struct jbpf_map* map,
+    const struct jbpf_load_map_def* map_def,
+    char* meta_path_name,
+    const char* jbpf_namespace,
+    const char* codeletset_name,
+    const char* codelet_name);
+
+/**
+ * @brief Release the shared memory region of a map. The processes that mapped it keep their mapping
+ * @param map The map
+ * @param meta_path_name The directory of the memory metadata of the agent
+ * @ingroup core
+ */
+void
+jbpf_map_mmap_destroy(struct jbpf_map* map, char* meta_path_name);
+
+/**
+ * @brief Publish the name of the region of a map for a codelet linked to it, in the run path of the agent
+ * @param run_path The "<run_path>/<namespace>" directory of the agent
+ * @param codeletset_name The name of the codeletset
+ * @param codelet_name The name of the codelet
+ * @param map_name The name of the map in the codelet
+ * @param mem_name The name of the region
+ * @return 0 on success, -1 if the entry cannot be written
+ * @ingroup core
+ */
+int
+jbpf_map_mmap_publish(
+    const char* run_path,
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    const char* mem_name);
+
+/**
+ * @brief Remove the entry published by jbpf_map_mmap_publish()
+ * @param run_path The "<run_path>/<namespace>" directory of the agent
+ * @param codeletset_name The name of the codeletset
+ * @param codelet_name The name of the codelet
+ * @param map_name The name of the map in the codelet
+ * @ingroup core
+ */
+void
+jbpf_map_mmap_unpublish(
+    const char* run_path, const char* codeletset_name, const char* codelet_name, const char* map_name);
+
+#endif
@@ -0,0 +1,287 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <pthread.h>
+#include <string.h>
+
+#include "ck_pr.h"
+
+#include "jbpf_map_snapshot.h"
+#include "jbpf_bpf_map_iter.h"
+#include "jbpf_int.h"
+#include "jbpf_io.h"
+#include "jbpf_io_channel.h"
+#include "jbpf_logging.h"
+
+#define JBPF_MAP_SNAPSHOT_NSEC_PER_SEC (1000000000ULL)
+
+struct jbpf_map_snapshot
+{
+    bool active;
+    bool done;
+    char codeletset_name[JBPF_CODELETSET_NAME_LEN];
+    char codelet_name[JBPF_CODELET_NAME_LEN];
+    char map_name[JBPF_MAP_NAME_LEN];
+    int map_type;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t chunk_size;
+    uint32_t num_chunks;
+    jbpf_io_stream_id_t stream_id;
+    struct jbpf_io_channel* channel;
+    uint64_t cursor;
+    uint32_t seq;
+    uint64_t interval_ns;
+    uint64_t next_send_ns;
+};
+
+/* Protects the snapshots. Taken by the maintenance thread with the LCM lock held, so it must never be held while
+ * taking the LCM lock */
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct jbpf_map_snapshot snapshots[JBPF_MAP_SNAPSHOT_MAX];
+static int num_pending;
+
+static bool
+jbpf_map_snapshot_per_thread(int map_type)
+{
+    return map_type == JBPF_MAP_TYPE_PER_THREAD_ARRAY || map_type == JBPF_MAP_TYPE_PER_THREAD_HASHMAP ||
+           map_type == JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP;
+}
+
+static struct jbpf_map_snapshot*
+jbpf_map_snapshot_find(const jbpf_io_stream_id_t* stream_id)
+{
+    for (int i = 0; i < JBPF_MAP_SNAPSHOT_MAX; i++) {
+        if (snapshots[i].active && memcmp(&snapshots[i].stream_id, stream_id, sizeof(*stream_id)) == 0)
+            return &snapshots[i];
+    }
+    return NULL;
+}
+
+static void
+jbpf_map_snapshot_release(struct jbpf_io_ctx* io_ctx, struct jbpf_map_snapshot* snap)
+{
+    jbpf_io_destroy_channel(io_ctx, snap->channel);
+    if (!snap->done)
+        ck_pr_dec_int(&num_pending);
+    memset(snap, 0, sizeof(*snap));
+}
+
+int
+jbpf_map_snapshot_add(
+    struct jbpf_io_ctx* io_ctx,
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    const struct jbpf_map* map,
+    const struct jbpf_map_snapshot_config* config,
+    uint64_t now_ns)
+{
+    struct jbpf_map_snapshot* snap = NULL;
+    struct jbpf_io_channel* channel;
+    uint32_t num_chunks;
+    int res = -1;
+
+    if (!codeletset_name || !codelet_name || !map_name || !map || !config)
+        return -1;
+
+    if (!jbpf_bpf_map_iterable(map->type)) {
+        jbpf_logger(JBPF_ERROR, "Snapshots of map %s of type %d are not supported\n", map_name, map->type);
+        return -1;
+    }
+
+    if (config->chunk_size < map->key_size + map->value_size) {
+        jbpf_logger(
+            JBPF_ERROR,
+            "Chunk size %u of the snapshot of map %s is smaller than an entry\n",
+            config->chunk_size,
+            map_name);
+        return -1;
+    }
+
+    num_chunks = config->num_chunks ? config->num_chunks : JBPF_MAP_SNAPSHOT_DEFAULT_NUM_CHUNKS;
+
+    pthread_mutex_lock(&snapshot_mutex);
+
+    if (jbpf_map_snapshot_find(&config->stream_id)) {
+        jbpf_logger(JBPF_ERROR, "A snapshot of map %s already uses this stream id\n", map_name);
+        goto out;
+    }
+
+    for (int i = 0; i < JBPF_MAP_SNAPSHOT_MAX; i++) {
+        if (!snapshots[i].active) {
+            snap = &snapshots[i];
+            break;
+        }
+    }
+    if (!snap) {
+        jbpf_logger(JBPF_ERROR, "Too many active snapshots, the snapshot of map %s was not started\n", map_name);
+        goto out;
+    }
+
+    channel = jbpf_io_create_channel(
+        io_ctx,
+        JBPF_IO_CHANNEL_OUTPUT,
+        JBPF_IO_CHANNEL_RINGBUF,
+        num_chunks,
+        sizeof(struct jbpf_map_snapshot_hdr) + config->chunk_size,
+        config->stream_id,
+        NULL,
+        0);
+    if (!channel) {
+        jbpf_logger(JBPF_ERROR, "Failed to create the output channel of the snapshot of map %s\n", map_name);
+        goto out;
+    }
+
+    memset(snap, 0, sizeof(*snap));
+    strncpy(snap->codeletset_name, codeletset_name, JBPF_CODELETSET_NAME_LEN - 1);
+    strncpy(snap->codelet_name, codelet_name, JBPF_CODELET_NAME_LEN - 1);
+    strncpy(snap->map_name, map_name, JBPF_MAP_NAME_LEN - 1);
+    snap->map_type = map->type;
+    snap->key_size = map->key_size;
+    snap->value_size = map->value_size;
+    snap->chunk_size = config->chunk_size;
+    snap->num_chunks = num_chunks;
+    snap->stream_id = config->stream_id;
+    snap->channel = channel;
+    snap->interval_ns = config->max_chunks_per_sec ? JBPF_MAP_SNAPSHOT_NSEC_PER_SEC / config->max_chunks_per_sec : 0;
+    snap->next_send_ns = now_ns;
+    snap->active = true;
+    ck_pr_inc_int(&num_pending);
+    res = 0;
+
+out:
+    pthread_mutex_unlock(&snapshot_mutex);
+    return res;
+}
+
+int
+jbpf_map_snapshot_remove(struct jbpf_io_ctx* io_ctx, const jbpf_io_stream_id_t* stream_id)
+{
+    struct jbpf_map_snapshot* snap;
+    int res = -1;
+
+    if (!stream_id)
+        return -1;
+
+    pthread_mutex_lock(&snapshot_mutex);
+    snap = jbpf_map_snapshot_find(stream_id);
+    if (snap) {
+        jbpf_map_snapshot_release(io_ctx, snap);
+        res = 0;
+    }
+    pthread_mutex_unlock(&snapshot_mutex);
+    return res;
+}
+
+bool
+jbpf_map_snapshot_pending(void)
+{
+    return ck_pr_load_int(&num_pending) > 0;
+}
+
+/* Copy the next entries of the map to a chunk. The cursor is only advanced once the chunk is sent */
+static int
+jbpf_map_snapshot_fill(
+    struct jbpf_map_snapshot* snap,
+    jbpf_map_snapshot_lookup_cb lookup_cb,
+    int num_slots,
+    uint64_t* cursor,
+    struct jbpf_map_snapshot_hdr* hdr)
+{
+    const struct jbpf_map* map;
+
+    // The map was unloaded, or replaced by a map of the same name that the cursor does not apply to
+    map = lookup_cb(snap->codeletset_name, snap->codelet_name, snap->map_name);
+    if (!map || map->type != snap->map_type || map->key_size != snap->key_size ||
+        map->value_size != snap->value_size)
+        return JBPF_MAP_ERROR;
+
+    if (jbpf_map_snapshot_per_thread(map->type))
+        return jbpf_bpf_map_iterate_per_thread(map, num_slots, cursor, hdr + 1, snap->chunk_size);
+    return jbpf_bpf_map_iterate(map, cursor, hdr + 1, snap->chunk_size);
+}
+
+static void
+jbpf_map_snapshot_send_chunks(
+    struct jbpf_map_snapshot* snap, jbpf_map_snapshot_lookup_cb lookup_cb, int num_slots, uint64_t now_ns)
+{
+    struct jbpf_map_snapshot_hdr* hdr;
+    uint64_t max_credit_ns, cursor;
+    uint32_t num_entries, flags;
+    int res;
+
+    // The chunks held back by a full channel or a busy map are caught up with in a burst of bounded size
+    max_credit_ns = JBPF_MAP_SNAPSHOT_MAX_BURST * snap->interval_ns;
+    if (now_ns > snap->next_send_ns + max_credit_ns)
+        snap->next_send_ns = now_ns - max_credit_ns;
+
+    for (uint32_t sent = 0; sent < snap->num_chunks && !snap->done; sent++) {
+        if (now_ns < snap->next_send_ns)
+            break;
+
+        // The channel is full, the chunk is retried at the next call
+        hdr = jbpf_io_channel_reserve_buf(snap->channel);
+        if (!hdr)
+            break;
+
+        cursor = snap->cursor;
+        res = jbpf_map_snapshot_fill(snap, lookup_cb, num_slots, &cursor, hdr);
+        if (res == JBPF_MAP_BUSY) {
+            jbpf_io_channel_discard_buf(snap->channel);
+            break;
+        }
+
+        if (res < 0) {
+            jbpf_logger(JBPF_WARN, "Snapshot of map %s aborted, the map cannot be read\n", snap->map_name);
+            num_entries = 0;
+            flags = JBPF_MAP_SNAPSHOT_LAST | JBPF_MAP_SNAPSHOT_ABORTED;
+        } else {
+            num_entries = res;
+            flags = cursor == 0 ? JBPF_MAP_SNAPSHOT_LAST : 0;
+        }
+
+        hdr->seq = snap->seq;
+        hdr->num_entries = num_entries;
+        hdr->key_size = snap->key_size;
+        hdr->value_size = snap->value_size;
+        hdr->flags = flags;
+        hdr->reserved = 0;
+
+        if (jbpf_io_channel_submit_buf_size(
+                snap->channel, sizeof(*hdr) + (size_t)num_entries * (snap->key_size + snap->value_size)) != 0)
+            break;
+
+        snap->seq++;
+        snap->cursor = cursor;
+        snap->next_send_ns += snap->interval_ns;
+        if (flags & JBPF_MAP_SNAPSHOT_LAST) {
+            snap->done = true;
+            ck_pr_dec_int(&num_pending);
+        }
+    }
+}
+
+void
+jbpf_map_snapshot_send(jbpf_map_snapshot_lookup_cb lookup_cb, int num_slots, uint64_t now_ns)
+{
+    if (!jbpf_map_snapshot_pending())
+        return;
+
+    pthread_mutex_lock(&snapshot_mutex);
+    for (int i = 0; i < JBPF_MAP_SNAPSHOT_MAX; i++) {
+        if (snapshots[i].active && !snapshots[i].done)
+            jbpf_map_snapshot_send_chunks(&snapshots[i], lookup_cb, num_slots, now_ns);
+    }
+    pthread_mutex_unlock(&snapshot_mutex);
+}
+
+void
+jbpf_map_snapshot_cleanup(struct jbpf_io_ctx* io_ctx)
+{
+    pthread_mutex_lock(&snapshot_mutex);
+    for (int i = 0; i < JBPF_MAP_SNAPSHOT_MAX; i++) {
+        if (snapshots[i].active)
+            jbpf_map_snapshot_release(io_ctx, &snapshots[i]);
+    }
+    pthread_mutex_unlock(&snapshot_mutex);
+}
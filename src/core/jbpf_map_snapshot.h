@@ -0,0 +1,85 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_MAP_SNAPSHOT_H
+#define JBPF_MAP_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jbpf.h"
+
+/* Streamed snapshots of maps. The entries of a map are sent in chunks to an output channel of its own, from the
+ * maintenance thread, at most max_chunks_per_sec chunks per second. The map is looked up by name before each chunk,
+ * so that a snapshot of a map that is unloaded is aborted instead of reading freed memory */
+
+#define JBPF_MAP_SNAPSHOT_MAX (8)
+
+/* The maximum number of chunks that may be sent in a burst, after the snapshot was held back by a full channel */
+#define JBPF_MAP_SNAPSHOT_MAX_BURST (16)
+
+struct jbpf_map;
+struct jbpf_io_ctx;
+
+typedef struct jbpf_map* (*jbpf_map_snapshot_lookup_cb)(
+    const char* codeletset_name, const char* codelet_name, const char* map_name);
+
+/**
+ * @brief Start a snapshot, and create its output channel
+ * @param io_ctx The io context of the output channel
+ * @param codeletset_name The name of the codeletset of the map
+ * @param codelet_name The name of a codelet linked to the map
+ * @param map_name The name of the map
+ * @param map The map, to check that its entries fit in a chunk
+ * @param config The configuration of the snapshot
+ * @param now_ns The current time, in ns
+ * @return 0 on success, or -1 if the configuration is invalid, the map type has no entries, JBPF_MAP_SNAPSHOT_MAX
+ * snapshots are active, or the output channel cannot be created
+ * @ingroup core
+ */
+int
+jbpf_map_snapshot_add(
+    struct jbpf_io_ctx* io_ctx,
+    const char* codeletset_name,
+    const char* codelet_name,
+    const char* map_name,
+    const struct jbpf_map* map,
+    const struct jbpf_map_snapshot_config* config,
+    uint64_t now_ns);
+
+/**
+ * @brief Stop a snapshot, complete or not, and destroy its output channel
+ * @param io_ctx The io context of the output channel
+ * @param stream_id The stream id of the snapshot
+ * @return 0 on success, or -1 if there is no snapshot with this stream id
+ * @ingroup core
+ */
+int
+jbpf_map_snapshot_remove(struct jbpf_io_ctx* io_ctx, const jbpf_io_stream_id_t* stream_id);
+
+/**
+ * @brief Whether a snapshot has chunks left to send
+ * @ingroup core
+ */
+bool
+jbpf_map_snapshot_pending(void);
+
+/**
+ * @brief Send the next chunks of the snapshots, as allowed by their rates and the space in their channels. Called by
+ * the maintenance thread, which must be registered to jbpf_io
+ * @param lookup_cb The function that looks up the maps by name
+ * @param num_slots The number of thread copies of the per-thread maps
+ * @param now_ns The current time, in ns
+ * @ingroup core
+ */
+void
+jbpf_map_snapshot_send(jbpf_map_snapshot_lookup_cb lookup_cb, int num_slots, uint64_t now_ns);
+
+/**
+ * @brief Stop all the snapshots and destroy their output channels
+ * @param io_ctx The io context of the output channels
+ * @ingroup core
+ */
+void
+jbpf_map_snapshot_cleanup(struct jbpf_io_ctx* io_ctx);
+
+#endif
@@ -0,0 +1,772 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "jbpf_metrics.h"
+#include "jbpf_int.h"
+#include "jbpf_defs.h"
+#include "jbpf_helper_api_defs.h"
+#include "jbpf_bpf_hashmap.h"
+#include "jbpf_bpf_spsc_hashmap.h"
+#include "jbpf_bpf_lru_hashmap.h"
+#include "jbpf_bpf_concurrent_hashmap.h"
+#include "jbpf_io_channel.h"
+#include "jbpf_mem_mgmt.h"
+#include "jbpf_perf.h"
+#include "jbpf_logging.h"
+
+/* The runtime histograms are exported with one bucket per power of two of the perf histograms */
+#define JBPF_METRICS_NUM_BUCKETS (JBPF_NUM_HIST_BINS / JBPF_HIST_SUB_BUCKETS)
+#define JBPF_METRICS_BACKLOG (8)
+/* Time given to a client to send an HTTP request, before the snapshot is sent without HTTP headers */
+#define JBPF_METRICS_REQ_TIMEOUT_MS (100)
+#define JBPF_METRICS_SEND_TIMEOUT_S (1)
+#define JBPF_METRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define JBPF_METRICS_EMPTY "# EOF\n"
+
+/* Cumulative runtime histogram of a hook, or of a codelet if codelet_name is not empty */
+struct jbpf_metrics_hist
+{
+    jbpf_hook_name_t hook_name;
+    char codelet_name[JBPF_PERF_CODELET_NAME_LEN];
+    uint64_t buckets[JBPF_METRICS_NUM_BUCKETS];
+    uint64_t deferred_drops;
+    bool reported;
+};
+
+struct jbpf_metrics_map
+{
+    const struct jbpf_map* map;
+    jbpf_codeletset_name_t codeletset_name;
+    jbpf_codelet_name_t codelet_name;
+    jbpf_map_name_t map_name;
+    int type;
+    bool has_entries;
+    uint64_t entries;
+    uint64_t max_entries;
+    bool has_evictions;
+    uint64_t evictions;
+    bool is_channel;
+    struct jbpf_io_channel_stats channel_stats;
+};
+
+struct jbpf_metrics_buf
+{
+    char* data;
+    size_t len;
+    size_t size;
+    bool error;
+};
+
+static bool metrics_enabled = false;
+static volatile bool metrics_run = false;
+static int metrics_sockfd = -1;
+static struct sockaddr_un metrics_addr;
+static pthread_t metrics_thread;
+
+/* Protects the histograms, the maps and the buffer the snapshot is rendered to. Only taken by the maintenance
+ * thread, so that hook threads never wait for the metrics */
+static pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct jbpf_metrics_hist metrics_hooks[MAX_NUM_HOOKS];
+static uint32_t num_metrics_hooks = 0;
+static struct jbpf_metrics_hist metrics_codelets[MAX_NUM_PERF_CODELETS];
+static uint32_t num_metrics_codelets = 0;
+static struct jbpf_metrics_map* metrics_maps = NULL;
+static uint32_t num_metrics_maps = 0;
+static uint32_t max_metrics_maps = 0;
+static struct jbpf_metrics_buf metrics_render_buf;
+
+/* Protects the snapshot served to the clients */
+static pthread_mutex_t metrics_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct jbpf_metrics_buf metrics_snapshot;
+
+static const char* metrics_map_types[JBPF_MAP_TYPE_MAX] = {
+    [JBPF_MAP_TYPE_UNSPEC] = "unspec",
+    [JBPF_MAP_TYPE_ARRAY] = "array",
+    [JBPF_MAP_TYPE_HASHMAP] = "hashmap",
+    [JBPF_MAP_TYPE_RINGBUF] = "ringbuf",
+    [JBPF_MAP_TYPE_CONTROL_INPUT] = "control_input",
+    [JBPF_MAP_TYPE_PER_THREAD_ARRAY] = "per_thread_array",
+    [JBPF_MAP_TYPE_PER_THREAD_HASHMAP] = "per_thread_hashmap",
+    [JBPF_MAP_TYPE_OUTPUT] = "output",
+    [JBPF_MAP_TYPE_CONCURRENT_HASHMAP] = "concurrent_hashmap",
+    [JBPF_MAP_TYPE_LRU_HASHMAP] = "lru_hashmap",
+    [JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP] = "per_thread_lru_hashmap",
+};
+
+static bool
+metrics_buf_reserve(struct jbpf_metrics_buf* buf, size_t len)
+{
+    size_t size;
+    char* data;
+
+    if (buf->len + len + 1 <= buf->size) {
+        return true;
+    }
+    size = buf->size ? buf->size : 4096;
+    while (size < buf->len + len + 1) {
+        size *= 2;
+    }
+    data = realloc(buf->data, size);
+    if (!data) {
+        buf->error = true;
+        return false;
+    }
+    buf->data = data;
+    buf->size = size;
+    return true;
+}
+
+static void
+metrics_printf(struct jbpf_metrics_buf* buf, const char* fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len < 0 || !metrics_buf_reserve(buf, len)) {
+        buf->error = true;
+        return;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, args);
+    va_end(args);
+    buf->len += len;
+}
+
+/* Append a label, escaping its value as required by OpenMetrics */
+static void
+metrics_label(struct jbpf_metrics_buf* buf, const char* sep, const char* name, const char* value)
+{
+    metrics_printf(buf, "%s%s=\"", sep, name);
+    for (const char* c = value; *c; c++) {
+        if (*c == '\\' || *c == '"') {
+            metrics_printf(buf, "\\%c", *c);
+        } else if (*c == '\n') {
+            metrics_printf(buf, "\\n");
+        } else {
+            metrics_printf(buf, "%c", *c);
+        }
+    }
+    metrics_printf(buf, "\"");
+}
+
+static void
+metrics_family(struct jbpf_metrics_buf* buf, const char* name, const char* type, const char* unit, const char* help)
+{
+    metrics_printf(buf, "# TYPE %s %s\n", name, type);
+    if (unit) {
+        metrics_printf(buf, "# UNIT %s %s\n", name, unit);
+    }
+    metrics_printf(buf, "# HELP %s %s\n", name, help);
+}
+
+static void
+metrics_hist_labels(struct jbpf_metrics_buf* buf, const struct jbpf_metrics_hist* hist)
+{
+    metrics_label(buf, "{", "hook", hist->hook_name);
+    if (hist->codelet_name[0]) {
+        metrics_label(buf, ",", "codelet", hist->codelet_name);
+    }
+}
+
+static void
+metrics_render_hist(struct jbpf_metrics_buf* buf, const char* name, const struct jbpf_metrics_hist* hist)
+{
+    uint64_t count = 0, le;
+
+    for (uint32_t i = 0; i < JBPF_METRICS_NUM_BUCKETS; i++) {
+        count += hist->buckets[i];
+        metrics_printf(buf, "%s_bucket", name);
+        metrics_hist_labels(buf, hist);
+        if (i < JBPF_METRICS_NUM_BUCKETS - 1) {
+            /* The runtimes are integers in ns, so the highest runtime of a bucket is its exact upper bound */
+            le = jbpf_perf_hist_bin_max((i + 1) * JBPF_HIST_SUB_BUCKETS - 1);
+            metrics_printf(
+                buf, ",le=\"%" PRIu64 ".%09" PRIu64 "\"} %" PRIu64 "\n", le / 1000000000, le % 1000000000, count);
+        } else {
+            metrics_printf(buf, ",le=\"+Inf\"} %" PRIu64 "\n", count);
+        }
+    }
+    metrics_printf(buf, "%s_count", name);
+    metrics_hist_labels(buf, hist);
+    metrics_printf(buf, "} %" PRIu64 "\n", count);
+}
+
+static void
+metrics_map_labels(struct jbpf_metrics_buf* buf, const struct jbpf_metrics_map* map)
+{
+    metrics_label(buf, "{", "codeletset", map->codeletset_name);
+    metrics_label(buf, ",", "codelet", map->codelet_name);
+    metrics_label(buf, ",", "map", map->map_name);
+    metrics_label(buf, ",", "type", metrics_map_types[map->type]);
+    metrics_printf(buf, "}");
+}
+
+/* Values exported for each map */
+enum jbpf_metrics_map_value
+{
+    JBPF_METRICS_MAP_ENTRIES = 0,
+    JBPF_METRICS_MAP_MAX_ENTRIES,
+    JBPF_METRICS_MAP_EVICTIONS,
+    JBPF_METRICS_CHANNEL_DEPTH,
+    JBPF_METRICS_CHANNEL_CAPACITY,
+    JBPF_METRICS_CHANNEL_DROPS,
+};
+
+static void
+metrics_render_maps(struct jbpf_metrics_buf* buf, const char* name, enum jbpf_metrics_map_value value)
+{
+    bool channels = value >= JBPF_METRICS_CHANNEL_DEPTH;
+    uint64_t res;
+
+    for (uint32_t i = 0; i < num_metrics_maps; i++) {
+        const struct jbpf_metrics_map* map = &metrics_maps[i];
+
+        if (map->is_channel != channels || (value == JBPF_METRICS_MAP_ENTRIES && !map->has_entries) ||
+            (value == JBPF_METRICS_MAP_MAX_ENTRIES && map->max_entries == 0) ||
+            (value == JBPF_METRICS_MAP_EVICTIONS && !map->has_evictions)) {
+            continue;
+        }
+        switch (value) {
+        case JBPF_METRICS_MAP_ENTRIES:
+            res = map->entries;
+            break;
+        case JBPF_METRICS_MAP_MAX_ENTRIES:
+            res = map->max_entries;
+            break;
+        case JBPF_METRICS_MAP_EVICTIONS:
+            res = map->evictions;
+            break;
+        case JBPF_METRICS_CHANNEL_DEPTH:
+            res = map->channel_stats.depth;
+            break;
+        case JBPF_METRICS_CHANNEL_CAPACITY:
+            res = map->channel_stats.capacity;
+            break;
+        default:
+            res = map->channel_stats.num_drops;
+            break;
+        }
+        metrics_printf(buf, "%s", name);
+        metrics_map_labels(buf, map);
+        metrics_printf(buf, " %" PRIu64 "\n", res);
+    }
+}
+
+static void
+metrics_render(struct jbpf_metrics_buf* buf)
+{
+    struct jbpf_mem_stats mem_stats = {0};
+
+    buf->len = 0;
+    buf->error = false;
+
+    metrics_family(
+        buf, "jbpf_hook_runtime_seconds", "histogram", "seconds", "Runtime of the hook calls with codelets.");
+    for (uint32_t i = 0; i < num_metrics_hooks; i++) {
+        metrics_render_hist(buf, "jbpf_hook_runtime_seconds", &metrics_hooks[i]);
+    }
+
+#ifdef JBPF_DEFERRED_HOOKS
+    metrics_family(
+        buf,
+        "jbpf_hook_deferred_drops",
+        "counter",
+        NULL,
+        "Deferred hook calls dropped because the deferred ring was full.");
+    for (uint32_t i = 0; i < num_metrics_hooks; i++) {
+        metrics_printf(buf, "jbpf_hook_deferred_drops_total");
+        metrics_hist_labels(buf, &metrics_hooks[i]);
+        metrics_printf(buf, "} %" PRIu64 "\n", metrics_hooks[i].deferred_drops);
+    }
+#endif
+
+#ifdef JBPF_CODELET_PERF_STATS
+    metrics_family(buf, "jbpf_codelet_runtime_seconds", "histogram", "seconds", "Runtime of the codelet calls.");
+    for (uint32_t i = 0; i < num_metrics_codelets; i++) {
+        metrics_render_hist(buf, "jbpf_codelet_runtime_seconds", &metrics_codelets[i]);
+    }
+#endif
+
+    metrics_family(buf, "jbpf_map_entries", "gauge", NULL, "Number of entries of the maps.");
+    metrics_render_maps(buf, "jbpf_map_entries", JBPF_METRICS_MAP_ENTRIES);
+    metrics_family(buf, "jbpf_map_max_entries", "gauge", NULL, "Maximum number of entries of the maps.");
+    metrics_render_maps(buf, "jbpf_map_max_entries", JBPF_METRICS_MAP_MAX_ENTRIES);
+    metrics_family(buf, "jbpf_map_evictions", "counter", NULL, "Entries evicted from the LRU maps when full.");
+    metrics_render_maps(buf, "jbpf_map_evictions_total", JBPF_METRICS_MAP_EVICTIONS);
+
+    metrics_family(
+        buf,
+        "jbpf_io_channel_depth",
+        "gauge",
+        NULL,
+        "Number of buffers of the IO channels waiting to be received (bytes for ringbuf maps).");
+    metrics_render_maps(buf, "jbpf_io_channel_depth", JBPF_METRICS_CHANNEL_DEPTH);
+    metrics_family(
+        buf,
+        "jbpf_io_channel_capacity",
+        "gauge",
+        NULL,
+        "Maximum number of buffers of the IO channels (bytes for ringbuf maps).");
+    metrics_render_maps(buf, "jbpf_io_channel_capacity", JBPF_METRICS_CHANNEL_CAPACITY);
+    metrics_family(
+        buf, "jbpf_io_channel_drops", "counter", NULL, "Buffers dropped because the IO channels were full.");
+    metrics_render_maps(buf, "jbpf_io_channel_drops_total", JBPF_METRICS_CHANNEL_DROPS);
+
+    jbpf_get_mem_stats(&mem_stats);
+    metrics_family(buf, "jbpf_memory_reserved_bytes", "gauge", "bytes", "Memory reserved for jbpf.");
+    metrics_printf(buf, "jbpf_memory_reserved_bytes %zu\n", mem_stats.reserved_size);
+    metrics_family(buf, "jbpf_memory_committed_bytes", "gauge", "bytes", "Memory committed by the allocator.");
+    metrics_printf(buf, "jbpf_memory_committed_bytes %zu\n", mem_stats.committed_size);
+    metrics_family(
+        buf, "jbpf_memory_peak_committed_bytes", "gauge", "bytes", "Highest memory committed by the allocator.");
+    metrics_printf(buf, "jbpf_memory_peak_committed_bytes %zu\n", mem_stats.peak_committed_size);
+    metrics_family(buf, "jbpf_memory_resident_bytes", "gauge", "bytes", "Resident set size of the process.");
+    metrics_printf(buf, "jbpf_memory_resident_bytes %zu\n", mem_stats.rss);
+
+    metrics_printf(buf, JBPF_METRICS_EMPTY);
+}
+
+static struct jbpf_metrics_hist*
+metrics_find_hist(
+    struct jbpf_metrics_hist* hists,
+    uint32_t* num_hists,
+    uint32_t max_hists,
+    const char* hook_name,
+    const char* codelet_name)
+{
+    struct jbpf_metrics_hist* hist;
+
+    for (uint32_t i = 0; i < *num_hists; i++) {
+        if (strcmp(hists[i].hook_name, hook_name) == 0 && strcmp(hists[i].codelet_name, codelet_name) == 0) {
+            return &hists[i];
+        }
+    }
+    if (*num_hists == max_hists) {
+        return NULL;
+    }
+
+    hist = &hists[(*num_hists)++];
+    memset(hist, 0, sizeof(*hist));
+    strncpy(hist->hook_name, hook_name, JBPF_HOOK_NAME_LEN - 1);
+    strncpy(hist->codelet_name, codelet_name, JBPF_PERF_CODELET_NAME_LEN - 1);
+    return hist;
+}
+
+static void
+metrics_add_perf_data(struct jbpf_metrics_hist* hist, const struct jbpf_perf_data* perf_data)
+{
+    for (uint32_t bin = 0; bin < JBPF_NUM_HIST_BINS; bin++) {
+        hist->buckets[bin / JBPF_HIST_SUB_BUCKETS] += perf_data->hist[bin];
+    }
+    hist->reported = true;
+}
+
+void
+jbpf_metrics_update_perf(const struct jbpf_perf_hook_list* perf)
+{
+    struct jbpf_metrics_hist* hist;
+    uint32_t num_codelets = 0;
+
+    if (!metrics_enabled || !perf) {
+        return;
+    }
+
+    pthread_mutex_lock(&metrics_mutex);
+
+    for (int i = 0; i < perf->num_reported_hooks; i++) {
+        hist = metrics_find_hist(metrics_hooks, &num_metrics_hooks, MAX_NUM_HOOKS, perf->perf_data[i].hook_name, "");
+        if (!hist) {
+            continue;
+        }
+        metrics_add_perf_data(hist, &perf->perf_data[i]);
+#ifdef JBPF_DEFERRED_HOOKS
+        hist->deferred_drops += perf->deferred_drops[i];
+#endif
+    }
+
+    for (uint32_t i = 0; i < num_metrics_codelets; i++) {
+        metrics_codelets[i].reported = false;
+    }
+    for (int i = 0; i < perf->num_reported_codelets; i++) {
+        hist = metrics_find_hist(
+            metrics_codelets,
+            &num_metrics_codelets,
+            MAX_NUM_PERF_CODELETS,
+            perf->codelet_perf_data[i].perf_data.hook_name,
+            perf->codelet_perf_data[i].codelet_name);
+        if (hist) {
+            metrics_add_perf_data(hist, &perf->codelet_perf_data[i].perf_data);
+        }
+    }
+    /* The codelets that are not reported anymore were unloaded */
+    for (uint32_t i = 0; i < num_metrics_codelets; i++) {
+        if (metrics_codelets[i].reported) {
+            if (num_codelets != i) {
+                metrics_codelets[num_codelets] = metrics_codelets[i];
+            }
+            num_codelets++;
+        }
+    }
+    num_metrics_codelets = num_codelets;
+
+    pthread_mutex_unlock(&metrics_mutex);
+}
+
+static void
+metrics_map_occupancy(const struct jbpf_map* map, struct jbpf_metrics_map* res)
+{
+    const struct jbpf_map* perthread_maps;
+
+    res->has_entries = true;
+
+    switch (map->type) {
+    case JBPF_MAP_TYPE_ARRAY:
+        res->entries = map->max_entries;
+        res->max_entries = map->max_entries;
+        break;
+    case JBPF_MAP_TYPE_PER_THREAD_ARRAY:
+        res->entries = (uint64_t)map->max_entries * JBPF_MAX_NUM_REG_THREADS;
+        res->max_entries = res->entries;
+        break;
+    case JBPF_MAP_TYPE_HASHMAP:
+        /* The size is read without the lock of the map, so that hooks updating the map are not made to fail */
+        res->entries = jbpf_bpf_hashmap_size(map);
+        res->max_entries = map->max_entries;
+        break;
+    case JBPF_MAP_TYPE_CONCURRENT_HASHMAP:
+        res->entries = jbpf_bpf_concurrent_hashmap_size(map);
+        res->max_entries = map->max_entries;
+        break;
+    case JBPF_MAP_TYPE_PER_THREAD_HASHMAP:
+        perthread_maps = map->data;
+        res->max_entries = (uint64_t)map->max_entries * JBPF_MAX_NUM_REG_THREADS;
+        for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+            res->entries += jbpf_bpf_spsc_hashmap_size(&perthread_maps[i]);
+        }
+        break;
+    case JBPF_MAP_TYPE_LRU_HASHMAP:
+        res->entries = jbpf_bpf_lru_hashmap_size(map);
+        res->max_entries = map->max_entries;
+        res->has_evictions = true;
+        res->evictions = jbpf_bpf_lru_hashmap_evictions(map);
+        break;
+    case JBPF_MAP_TYPE_PER_THREAD_LRU_HASHMAP:
+        perthread_maps = map->data;
+        res->max_entries = (uint64_t)map->max_entries * JBPF_MAX_NUM_REG_THREADS;
+        res->has_evictions = true;
+        for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+            res->entries += jbpf_bpf_spsc_lru_hashmap_size(&perthread_maps[i]);
+            res->evictions += jbpf_bpf_spsc_lru_hashmap_evictions(&perthread_maps[i]);
+        }
+        break;
+    case JBPF_MAP_TYPE_RINGBUF:
+    case JBPF_MAP_TYPE_OUTPUT:
+    case JBPF_MAP_TYPE_CONTROL_INPUT:
+        res->has_entries = false;
+        res->is_channel = jbpf_io_channel_get_stats(map->data, &res->channel_stats) == 0;
+        break;
+    default:
+        res->has_entries = false;
+        break;
+    }
+}
+
+void
+jbpf_metrics_add_map(const char* codeletset_name, const char* codelet_name, const struct jbpf_map* map)
+{
+    struct jbpf_metrics_map* res;
+
+    if (!metrics_enabled || !map || map->type < 0 || map->type >= JBPF_MAP_TYPE_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&metrics_mutex);
+
+    for (uint32_t i = 0; i < num_metrics_maps; i++) {
+        if (metrics_maps[i].map == map) {
+            goto out;
+        }
+    }
+
+    if (num_metrics_maps == max_metrics_maps) {
+        uint32_t max_maps = max_metrics_maps ? max_metrics_maps * 2 : 64;
+        res = realloc(metrics_maps, max_maps * sizeof(struct jbpf_metrics_map));
+        if (!res) {
+            goto out;
+        }
+        metrics_maps = res;
+        max_metrics_maps = max_maps;
+    }
+
+    res = &metrics_maps[num_metrics_maps++];
+    memset(res, 0, sizeof(*res));
+    res->map = map;
+    res->type = map->type;
+    strncpy(res->codeletset_name, codeletset_name, JBPF_CODELETSET_NAME_LEN - 1);
+    strncpy(res->codelet_name, codelet_name, JBPF_CODELET_NAME_LEN - 1);
+    strncpy(res->map_name, map->name, JBPF_MAP_NAME_LEN - 1);
+    metrics_map_occupancy(map, res);
+
+out:
+    pthread_mutex_unlock(&metrics_mutex);
+}
+
+void
+jbpf_metrics_publish(void)
+{
+    struct jbpf_metrics_buf tmp;
+
+    if (!metrics_enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&metrics_mutex);
+
+    metrics_render(&metrics_render_buf);
+    num_metrics_maps = 0;
+
+    /* The rendered snapshot replaces the served one, whose buffer is reused for the next snapshot */
+    if (!metrics_render_buf.error) {
+        pthread_mutex_lock(&metrics_snapshot_mutex);
+        tmp = metrics_snapshot;
+        metrics_snapshot = metrics_render_buf;
+        metrics_render_buf = tmp;
+        pthread_mutex_unlock(&metrics_snapshot_mutex);
+    } else {
+        jbpf_logger(JBPF_WARN, "Failed to render the metrics snapshot\n");
+    }
+
+    pthread_mutex_unlock(&metrics_mutex);
+}
+
+static int
+metrics_send_all(int fd, const char* data, size_t len)
+{
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+/* Read the HTTP request of the client, if it sends one. Returns true if the snapshot must be sent as an HTTP
+ * response */
+static bool
+metrics_read_request(int client_fd)
+{
+    struct pollfd pfd = {.fd = client_fd, .events = POLLIN};
+    char req[1024];
+    size_t len = 0;
+    ssize_t res;
+
+    while (len < sizeof(req) - 1 && poll(&pfd, 1, JBPF_METRICS_REQ_TIMEOUT_MS) > 0) {
+        res = recv(client_fd, req + len, sizeof(req) - 1 - len, 0);
+        if (res <= 0) {
+            break;
+        }
+        len += res;
+        req[len] = '\0';
+        /* The request is read up to the end of its headers, so that closing the socket does not reset it */
+        if (strstr(req, "\r\n\r\n")) {
+            break;
+        }
+    }
+
+    return len >= 4 && strncmp(req, "GET ", 4) == 0;
+}
+
+static void
+metrics_serve_client(int client_fd, struct jbpf_metrics_buf* buf)
+{
+    struct timeval timeout = {.tv_sec = JBPF_METRICS_SEND_TIMEOUT_S, .tv_usec = 0};
+    char header[256];
+    bool http;
+    int len;
+
+    /* A client that does not read its response does not block the server for longer than the timeout */
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    http = metrics_read_request(client_fd);
+
+    /* The snapshot is copied, so that the maintenance thread does not wait for the client */
+    buf->len = 0;
+    buf->error = false;
+    pthread_mutex_lock(&metrics_snapshot_mutex);
+    if (metrics_buf_reserve(buf, metrics_snapshot.len)) {
+        memcpy(buf->data, metrics_snapshot.data, metrics_snapshot.len);
+        buf->len = metrics_snapshot.len;
+    }
+    pthread_mutex_unlock(&metrics_snapshot_mutex);
+
+    if (buf->error) {
+        return;
+    }
+
+    if (http) {
+        len = snprintf(
+            header,
+            sizeof(header),
+            "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+            JBPF_METRICS_CONTENT_TYPE,
+            buf->len);
+        if (metrics_send_all(client_fd, header, len) != 0) {
+            return;
+        }
+    }
+    if (metrics_send_all(client_fd, buf->data, buf->len) == 0) {
+        shutdown(client_fd, SHUT_WR);
+    }
+}
+
+static void*
+jbpf_metrics_thread_start(void* arg)
+{
+    struct jbpf_metrics_buf buf = {0};
+    int client_fd;
+
+    while (metrics_run) {
+        client_fd = accept(metrics_sockfd, NULL, NULL);
+        if (client_fd < 0) {
+            /* The socket is shut down when the server is stopped */
+            if (!metrics_run) {
+                break;
+            }
+            if (errno != EINTR) {
+                usleep(10000);
+            }
+            continue;
+        }
+        metrics_serve_client(client_fd, &buf);
+        close(client_fd);
+    }
+
+    free(buf.data);
+    return NULL;
+}
+
+int
+jbpf_metrics_init(const struct jbpf_config* config)
+{
+    const struct jbpf_agent_metrics_config* metrics_config = &config->metrics_config;
+
+    if (!metrics_config->enable_metrics) {
+        return 0;
+    }
+
+    memset(&metrics_addr, 0, sizeof(metrics_addr));
+    metrics_addr.sun_family = AF_UNIX;
+    snprintf(
+        metrics_addr.sun_path,
+        sizeof(metrics_addr.sun_path),
+        "%s/%s/%s",
+        config->jbpf_run_path,
+        config->jbpf_namespace,
+        metrics_config->metrics_ipc_name);
+
+    /* Clients get an empty snapshot until the maintenance thread publishes the first one */
+    metrics_printf(&metrics_snapshot, JBPF_METRICS_EMPTY);
+    if (metrics_snapshot.error) {
+        return -1;
+    }
+
+    metrics_sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (metrics_sockfd == -1) {
+        jbpf_logger(JBPF_ERROR, "Failed to create the metrics socket\n");
+        goto error;
+    }
+
+    unlink(metrics_addr.sun_path);
+    if (bind(metrics_sockfd, (struct sockaddr*)&metrics_addr, sizeof(metrics_addr)) == -1 ||
+        listen(metrics_sockfd, JBPF_METRICS_BACKLOG) == -1) {
+        jbpf_logger(JBPF_ERROR, "Failed to bind the metrics socket %s\n", metrics_addr.sun_path);
+        goto error;
+    }
+
+    metrics_run = true;
+    metrics_enabled = true;
+    if (pthread_create(&metrics_thread, NULL, jbpf_metrics_thread_start, NULL) != 0) {
+        jbpf_logger(JBPF_ERROR, "Unable to create the metrics thread\n");
+        metrics_run = false;
+        metrics_enabled = false;
+        unlink(metrics_addr.sun_path);
+        goto error;
+    }
+    if (pthread_setname_np(metrics_thread, "jbpf_metrics_th") != 0) {
+        jbpf_logger(JBPF_WARN, "WARNING: Could not set name of the metrics thread\n");
+    }
+
+    jbpf_logger(JBPF_INFO, "Serving metrics at %s\n", metrics_addr.sun_path);
+    return 0;
+
+error:
+    if (metrics_sockfd != -1) {
+        close(metrics_sockfd);
+        metrics_sockfd = -1;
+    }
+    free(metrics_snapshot.data);
+    memset(&metrics_snapshot, 0, sizeof(metrics_snapshot));
+    return -1;
+}
+
+void
+jbpf_metrics_stop(void)
+{
+    if (!metrics_enabled) {
+        return;
+    }
+
+    metrics_run = false;
+    shutdown(metrics_sockfd, SHUT_RDWR);
+    pthread_join(metrics_thread, NULL);
+    close(metrics_sockfd);
+    metrics_sockfd = -1;
+    unlink(metrics_addr.sun_path);
+
+    pthread_mutex_lock(&metrics_mutex);
+    metrics_enabled = false;
+    num_metrics_hooks = 0;
+    num_metrics_codelets = 0;
+    num_metrics_maps = 0;
+    max_metrics_maps = 0;
+    free(metrics_maps);
+    metrics_maps = NULL;
+    free(metrics_render_buf.data);
+    memset(&metrics_render_buf, 0, sizeof(metrics_render_buf));
+    free(metrics_snapshot.data);
+    memset(&metrics_snapshot, 0, sizeof(metrics_snapshot));
+    pthread_mutex_unlock(&metrics_mutex);
+}
+
+bool
+jbpf_metrics_enabled(void)
+{
+    return metrics_enabled;
+}
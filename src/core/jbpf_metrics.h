@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_METRICS_H
+#define JBPF_METRICS_H
+
+#include <stdbool.h>
+
+#include "jbpf_config.h"
+#include "jbpf_perf_ext.h"
+
+struct jbpf_map;
+
+/**
+ * @brief Start the server of the metrics socket, if enabled
+ * @param config The jbpf configuration. The socket is created in the namespace directory of jbpf_run_path
+ * @return 0 on success, -1 if the socket cannot be created
+ * @ingroup core
+ */
+int
+jbpf_metrics_init(const struct jbpf_config* config);
+
+/**
+ * @brief Stop the server of the metrics socket and remove the socket
+ * @ingroup core
+ */
+void
+jbpf_metrics_stop(void);
+
+/**
+ * @brief Whether the metrics socket is served
+ * @ingroup core
+ */
+bool
+jbpf_metrics_enabled(void);
+
+/**
+ * @brief Add the runtimes of a perf report to the runtime histograms of the hooks and codelets
+ * @param perf The perf report
+ * @ingroup core
+ */
+void
+jbpf_metrics_update_perf(const struct jbpf_perf_hook_list* perf);
+
+/**
+ * @brief Add the occupancy of a map to the next snapshot. IO channel maps are added with their depth and drops
+ * @param codeletset_name The name of the codeletset of the map
+ * @param codelet_name The name of the codelet the map is linked to
+ * @param map The map. Maps linked to several codelets are only added once
+ * @ingroup core
+ */
+void
+jbpf_metrics_add_map(const char* codeletset_name, const char* codelet_name, const struct jbpf_map* map);
+
+/**
+ * @brief Render the metrics added since the previous snapshot in OpenMetrics text format, and serve them on the
+ * metrics socket. Called by the maintenance thread
+ * @ingroup core
+ */
+void
+jbpf_metrics_publish(void);
+
+#endif
@@ -2,43 +2,226 @@
 
 #define _GNU_SOURCE
 
+#include <pthread.h>
 #include <sched.h>
+#include <stdio.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 #include "jbpf_hook.h"
 #include "jbpf_perf.h"
 #include "jbpf_memory.h"
 #include "jbpf_utils.h"
 #include "jbpf_int.h"
+#include "jbpf_qsbr.h"
 #include "jbpf_agent_hooks.h"
 #include "jbpf_logging.h"
+#include "jbpf_metrics.h"
 
 DEFINE_JBPF_AGENT_HOOK(report_stats)
+DEFINE_JBPF_AGENT_HOOK(codelet_quarantined)
 
 double g_jbpf_ticks_per_ns;
 uint64_t g_jbpf_tick_freq;
 
+/* When the tick frequency is not reported by the CPU, it is measured with JBPF_CALIBRATION_NUM_SAMPLES samples over
+ * JBPF_CALIBRATION_PERIOD_NS. Each sample is read up to JBPF_CALIBRATION_SAMPLE_ATTEMPTS times */
+#define JBPF_CALIBRATION_NUM_SAMPLES (8)
+#define JBPF_CALIBRATION_PERIOD_NS (20000000)
+#define JBPF_CALIBRATION_SAMPLE_ATTEMPTS (5)
+/* The measured frequency is then refined by the maintenance thread, from 1 s to 64 s after the calibration */
+#define JBPF_CALIBRATION_REFINE_START_NS (1000000000ULL)
+#define JBPF_CALIBRATION_REFINE_NS (64000000000ULL)
+
+#define JBPF_CPUID_INVARIANT_TSC (1U << 8)
+#define JBPF_TSC_FREQ_SYSFS_PATH "/sys/devices/system/cpu/cpu0/tsc_freq_khz"
+
+/* First calibration sample, and time since that sample of the next refinement. 0 if there is nothing to refine */
+static uint64_t tick_refine_ticks;
+static uint64_t tick_refine_ns;
+static uint64_t tick_refine_next_ns = 0;
+
+/* Number of percentiles in struct jbpf_perf_data */
+#define JBPF_NUM_PERCENTILES (4)
+
+static pthread_mutex_t perf_report_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Grace period started when the last report retired the perf buffers */
+static uint64_t perf_report_gp = 0;
+static bool perf_report_pending = false;
+
+static uint64_t runtime_budget_max_overruns = JBPF_DEFAULT_MAX_RUNTIME_OVERRUNS;
+static uint64_t runtime_budget_window_ns = JBPF_DEFAULT_RUNTIME_BUDGET_WINDOW_MS * 1000000ULL;
+
+/* Read the ticks and the time as close to each other as possible. Of a few attempts, the one with the fewest ticks
+ * around clock_gettime() is kept, as it is the least likely to have been interrupted */
+static void
+jbpf_tick_sample(uint64_t* ticks, uint64_t* ns)
+{
+    struct timespec ts;
+    uint64_t begin, end, best = UINT64_MAX;
+
+    for (int i = 0; i < JBPF_CALIBRATION_SAMPLE_ATTEMPTS; i++) {
+        begin = jbpf_start_time();
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        end = jbpf_end_time();
+        if (end - begin < best) {
+            best = end - begin;
+            *ticks = begin + (end - begin) / 2;
+            *ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        }
+    }
+}
+
+/* Frequency of the tick counter reported by the CPU, or 0 if it is not reported */
+static uint64_t
+jbpf_read_tick_freq(const char** source)
+{
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx, max_leaf, base_mhz;
+    unsigned long long khz = 0;
+    uint64_t crystal_hz;
+    FILE* f;
+
+    /* The TSC frequency is only meaningful if the TSC is invariant */
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+        return 0;
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    if (!(edx & JBPF_CPUID_INVARIANT_TSC))
+        return 0;
+
+    /* Leaf 0x15 gives the ratio of the TSC to the crystal clock, and usually the crystal clock frequency. When the
+     * crystal clock is not reported, it is derived from the base frequency of leaf 0x16 */
+    max_leaf = __get_cpuid_max(0, NULL);
+    if (max_leaf >= 0x15) {
+        __cpuid(0x15, eax, ebx, ecx, edx);
+        if (eax != 0 && ebx != 0) {
+            crystal_hz = ecx;
+            if (crystal_hz == 0 && max_leaf >= 0x16) {
+                __cpuid(0x16, base_mhz, ebx, ecx, edx);
+                __cpuid(0x15, eax, ebx, ecx, edx);
+                crystal_hz = (uint64_t)base_mhz * 1000000ULL * eax / ebx;
+            }
+            if (crystal_hz != 0) {
+                *source = "CPUID";
+                return crystal_hz * ebx / eax;
+            }
+        }
+    }
+
+    f = fopen(JBPF_TSC_FREQ_SYSFS_PATH, "r");
+    if (f) {
+        if (fscanf(f, "%llu", &khz) != 1)
+            khz = 0;
+        fclose(f);
+        if (khz != 0) {
+            *source = JBPF_TSC_FREQ_SYSFS_PATH;
+            return (uint64_t)khz * 1000ULL;
+        }
+    }
+    return 0;
+#elif defined(__aarch64__)
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    *source = "CNTFRQ_EL0";
+    return freq;
+#else
+    /* The ticks are read with clock_gettime() */
+    *source = "clock_gettime";
+    return 1000000000ULL;
+#endif
+}
+
+/* Estimate the frequency of the tick counter with a least squares fit of the ticks against the time of a few samples,
+ * spread over JBPF_CALIBRATION_PERIOD_NS */
+static uint64_t
+jbpf_measure_tick_freq(void)
+{
+    struct timespec sleep_period = {.tv_nsec = JBPF_CALIBRATION_PERIOD_NS / (JBPF_CALIBRATION_NUM_SAMPLES - 1)};
+    uint64_t ticks[JBPF_CALIBRATION_NUM_SAMPLES], ns[JBPF_CALIBRATION_NUM_SAMPLES];
+    double x, y, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0, n = JBPF_CALIBRATION_NUM_SAMPLES;
+
+    for (int i = 0; i < JBPF_CALIBRATION_NUM_SAMPLES; i++) {
+        if (i > 0)
+            nanosleep(&sleep_period, NULL);
+        jbpf_tick_sample(&ticks[i], &ns[i]);
+    }
+
+    /* The samples are taken relative to the first one, to keep the precision of the sums */
+    for (int i = 0; i < JBPF_CALIBRATION_NUM_SAMPLES; i++) {
+        x = (double)(ns[i] - ns[0]);
+        y = (double)(ticks[i] - ticks[0]);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+    }
+
+    tick_refine_ticks = ticks[0];
+    tick_refine_ns = ns[0];
+    return (uint64_t)((n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x) * 1000000000.0);
+}
+
+static void
+jbpf_set_tick_freq(uint64_t freq)
+{
+    double ticks_per_ns = (double)freq / 1000000000.0;
+
+    __atomic_store(&g_jbpf_ticks_per_ns, &ticks_per_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_jbpf_tick_freq, freq, __ATOMIC_RELAXED);
+}
+
 void
 _jbpf_calibrate_ticks()
 {
-    struct timespec sleep_period = {.tv_nsec = 5E8};
-    struct timespec start_ts, end_ts;
-    uint64_t ns_runtime;
-    uint64_t begin = 0, end = 0;
+    const char* source = NULL;
+    uint64_t freq;
+
     jbpf_logger(JBPF_INFO, "Calibrating clock ticks\n");
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start_ts);
-    begin = jbpf_start_time();
-    nanosleep(&sleep_period, NULL);
-    end = jbpf_end_time();
-    clock_gettime(CLOCK_MONOTONIC_RAW, &end_ts);
-    ns_runtime = _jbpf_difftimespec_ns(&end_ts, &start_ts);
 
-    g_jbpf_ticks_per_ns = (double)(end - begin) / (double)ns_runtime;
+    tick_refine_next_ns = 0;
+    freq = jbpf_read_tick_freq(&source);
+    if (freq == 0) {
+        freq = jbpf_measure_tick_freq();
+        source = "measurement";
+        /* The maintenance thread refines the measured frequency over a longer period */
+        tick_refine_next_ns = JBPF_CALIBRATION_REFINE_START_NS;
+    }
 
-    g_jbpf_tick_freq = ((uint64_t)(g_jbpf_ticks_per_ns * 1000000000.0) >> 0);
-    jbpf_logger(JBPF_INFO, "Ticks per ns: %f\n", (double)g_jbpf_ticks_per_ns);
+    jbpf_set_tick_freq(freq);
+    jbpf_logger(JBPF_INFO, "Ticks per ns: %f (%s)\n", (double)g_jbpf_ticks_per_ns, source);
     jbpf_logger(JBPF_INFO, "Tick frequency: %ld\n", g_jbpf_tick_freq);
 }
 
+void
+jbpf_refine_tick_calibration(void)
+{
+    uint64_t ticks, ns, elapsed;
+
+    if (tick_refine_next_ns == 0)
+        return;
+
+    jbpf_tick_sample(&ticks, &ns);
+    elapsed = ns - tick_refine_ns;
+    if (elapsed < tick_refine_next_ns)
+        return;
+
+    jbpf_set_tick_freq((uint64_t)((double)(ticks - tick_refine_ticks) / (double)elapsed * 1000000000.0));
+
+    /* Each refinement doubles the period the frequency is measured over, up to JBPF_CALIBRATION_REFINE_NS */
+    if (elapsed >= JBPF_CALIBRATION_REFINE_NS) {
+        tick_refine_next_ns = 0;
+        jbpf_logger(
+            JBPF_INFO,
+            "Refined ticks per ns: %f, tick frequency: %ld\n",
+            (double)g_jbpf_ticks_per_ns,
+            g_jbpf_tick_freq);
+    } else {
+        tick_refine_next_ns = elapsed * 2;
+    }
+}
+
 int
 jbpf_init_perf()
 {
@@ -47,6 +230,8 @@ jbpf_init_perf()
 
     _jbpf_calibrate_ticks();
 
+    jbpf_perf_counters_init();
+
     for (i = 0; i < jbpf_hook_list.num_hooks; i++) {
         hook = jbpf_hook_list.jbpf_hook_p[i];
         res = jbpf_init_perf_hook(hook);
@@ -64,17 +249,35 @@ error:
     return -1;
 }
 
-int
-jbpf_init_perf_hook(struct jbpf_hook* hook)
+static int
+jbpf_perf_buf_init(struct jbpf_perf_buf* buf)
 {
-    int res = 0;
-
-    hook->perf_data = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_perf_data));
+    buf->active = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_perf_thread_data));
+    buf->retired = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_perf_thread_data));
+
+    if (!buf->active || !buf->retired) {
+        jbpf_free_mem(buf->active);
+        jbpf_free_mem(buf->retired);
+        buf->active = NULL;
+        buf->retired = NULL;
+        return -1;
+    }
+    return 0;
+}
 
-    if (!hook->perf_data)
-        res = -1;
+static void
+jbpf_perf_buf_free(struct jbpf_perf_buf* buf)
+{
+    jbpf_free_mem(buf->active);
+    jbpf_free_mem(buf->retired);
+    buf->active = NULL;
+    buf->retired = NULL;
+}
 
-    return res;
+int
+jbpf_init_perf_hook(struct jbpf_hook* hook)
+{
+    return jbpf_perf_buf_init(&hook->perf_data);
 }
 
 void
@@ -82,6 +285,8 @@ jbpf_free_perf()
 {
     struct jbpf_hook* hook;
 
+    jbpf_perf_counters_stop();
+
     for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
         hook = jbpf_hook_list.jbpf_hook_p[i];
         jbpf_free_perf_hook(hook);
@@ -91,70 +296,335 @@ jbpf_free_perf()
 void
 jbpf_free_perf_hook(struct jbpf_hook* hook)
 {
-    jbpf_free_mem(hook->perf_data);
+    jbpf_perf_buf_free(&hook->perf_data);
 }
 
-struct jbpf_perf_data*
+struct jbpf_perf_thread_data*
 jbpf_get_perf_data(struct jbpf_hook* hook)
 {
+    return ck_pr_load_ptr(&hook->perf_data.active);
+}
 
-    struct jbpf_perf_data* old_data;
-    struct jbpf_perf_data* new_data;
+struct jbpf_codelet_perf*
+jbpf_codelet_perf_create(const char* codelet_name)
+{
+#ifdef JBPF_MEASURE_CODELETS
+    struct jbpf_codelet_perf* perf;
 
-    old_data = hook->perf_data;
-    new_data = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_perf_data));
+    perf = jbpf_calloc_mem(1, sizeof(struct jbpf_codelet_perf));
+    if (!perf) {
+        jbpf_logger(JBPF_WARN, "Failed to allocate perf data for codelet %s\n", codelet_name ? codelet_name : "");
+        return NULL;
+    }
 
-    ck_pr_store_ptr(&hook->perf_data, new_data);
+#ifdef JBPF_CODELET_PERF_STATS
+    if (jbpf_perf_buf_init(&perf->perf_data) != 0) {
+        jbpf_logger(JBPF_WARN, "Failed to allocate perf data for codelet %s\n", codelet_name ? codelet_name : "");
+        jbpf_free_mem(perf);
+        return NULL;
+    }
+#endif
+
+    if (codelet_name) {
+        strncpy(perf->codelet_name, codelet_name, JBPF_PERF_CODELET_NAME_LEN - 1);
+    }
+    return perf;
+#else
+    return NULL;
+#endif
+}
+
+void
+jbpf_codelet_perf_destroy(struct jbpf_codelet_perf* perf)
+{
+    if (!perf) {
+        return;
+    }
+    jbpf_perf_buf_free(&perf->perf_data);
+    jbpf_free_mem(perf);
+}
 
-    return old_data;
+void
+jbpf_init_runtime_budgets(const struct jbpf_agent_runtime_budget_config* config)
+{
+    runtime_budget_max_overruns = config->max_overruns;
+    runtime_budget_window_ns = (uint64_t)config->window_ms * 1000000ULL;
 }
 
 void
-jbpf_report_perf_stats()
+_jbpf_codelet_overrun(struct jbpf_codelet_perf* perf)
 {
+    uint64_t num_overruns = ck_pr_faa_64(&perf->num_overruns, 1) + 1;
+
+    /* Stop running the codelet right away, the maintenance thread will remove it from the hook */
+    if (num_overruns - ck_pr_load_64(&perf->window_overruns) > runtime_budget_max_overruns) {
+        bool quarantined = true;
+        __atomic_store(&perf->quarantined, &quarantined, __ATOMIC_RELAXED);
+    }
+}
 
-    struct jbpf_perf_hook_list jbpf_s;
-    struct jbpf_perf_data* tmp_perf_data;
+#ifdef JBPF_RUNTIME_BUDGETS
+/* Codelet to remove from its hook because it exceeded its runtime budget */
+struct jbpf_quarantined_codelet
+{
     struct jbpf_hook* hook;
-    struct jbpf_perf_data* perf_data[MAX_NUM_HOOKS];
-    jbpf_s.num_reported_hooks = 0;
+    jbpf_jit_fn codelet;
+    struct jbpf_codelet_quarantine_event event;
+};
 
-    memset(&jbpf_s, 0, sizeof(struct jbpf_perf_hook_list));
+static uint64_t
+jbpf_budget_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+void
+jbpf_enforce_runtime_budgets(void)
+{
+#ifdef JBPF_RUNTIME_BUDGETS
+    static struct jbpf_quarantined_codelet quarantined[JBPF_MAX_QUARANTINED_PER_CHECK];
+    int num_quarantined = 0;
+    struct jbpf_hook* hook;
+    struct jbpf_hook_codelet* codelets;
+    uint64_t now = jbpf_budget_time_ns();
 
+    // The codelet lists of the hooks are only read inside a read-side section
+    JBPF_HOOK_READ_BEGIN()
     for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
         hook = jbpf_hook_list.jbpf_hook_p[i];
-        if (strncmp(hook->name, "report_stats", JBPF_HOOK_NAME_LEN) == 0)
+        codelets = ck_pr_load_ptr(&hook->codelets);
+        if (!codelets) {
             continue;
-        perf_data[jbpf_s.num_reported_hooks] = jbpf_get_perf_data(hook);
-        strncpy(jbpf_s.perf_data[jbpf_s.num_reported_hooks].hook_name, hook->name, JBPF_HOOK_NAME_LEN - 1);
-        jbpf_s.perf_data[jbpf_s.num_reported_hooks].hook_name[JBPF_HOOK_NAME_LEN - 1] = '\0';
-        jbpf_s.num_reported_hooks++;
+        }
+        for (int j = 0; codelets[j].jbpf_codelet; j++) {
+            struct jbpf_codelet_perf* perf = codelets[j].perf;
+            if (!perf) {
+                continue;
+            }
+            /* Start a new window. The overruns before the first check count towards the first window */
+            if (perf->window_start == 0) {
+                perf->window_start = now;
+            } else if (now - perf->window_start >= runtime_budget_window_ns) {
+                perf->window_start = now;
+                ck_pr_store_64(&perf->window_overruns, ck_pr_load_64(&perf->num_overruns));
+            }
+            if (!__atomic_load_n(&perf->quarantined, __ATOMIC_RELAXED) ||
+                num_quarantined >= JBPF_MAX_QUARANTINED_PER_CHECK) {
+                continue;
+            }
+            struct jbpf_quarantined_codelet* q = &quarantined[num_quarantined++];
+            memset(q, 0, sizeof(*q));
+            q->hook = hook;
+            q->codelet = codelets[j].jbpf_codelet;
+            strncpy(q->event.hook_name, hook->name, JBPF_HOOK_NAME_LEN - 1);
+            strncpy(q->event.codelet_name, perf->codelet_name, JBPF_PERF_CODELET_NAME_LEN - 1);
+            q->event.runtime_threshold = codelets[j].time_thresh;
+            q->event.num_overruns = ck_pr_load_64(&perf->num_overruns);
+            q->event.timestamp = now;
+        }
     }
+    JBPF_HOOK_READ_END()
 
-    // Block until all structures with perf data are no longer accessible
-    ck_epoch_barrier(e_record);
+    // Unlink the quarantined codelets outside of the read-side section, as this waits for a grace period. The LCM
+    // marks the codelets of its codeletsets as unloaded, and a codelet that cannot be removed now is picked up again
+    // by the next check, since it stays on its hook
+    for (int i = 0; i < num_quarantined; i++) {
+        if (jbpf_quarantine_codelet(quarantined[i].hook, quarantined[i].codelet) != 0) {
+            continue;
+        }
+        jbpf_logger(
+            JBPF_WARN,
+            "Codelet %s quarantined: exceeded its runtime threshold of %ld ns on hook %s %ld times\n",
+            quarantined[i].event.codelet_name,
+            quarantined[i].event.runtime_threshold,
+            quarantined[i].event.hook_name,
+            quarantined[i].event.num_overruns);
+        hook_codelet_quarantined(&quarantined[i].event);
+    }
+#endif
+}
 
-    for (int i = 0; i < jbpf_s.num_reported_hooks; i++) {
-        tmp_perf_data = perf_data[i];
+static void
+jbpf_aggregate_perf_data(struct jbpf_perf_data* res, const struct jbpf_perf_thread_data* thread_perf_data)
+{
+    for (int j = 0; j < JBPF_MAX_NUM_REG_THREADS; j++) {
 
-        for (int j = 0; j < JBPF_MAX_NUM_REG_THREADS; j++) {
+        if (res->min == 0 || (res->min > thread_perf_data[j].min && thread_perf_data[j].min > 0))
+            res->min = thread_perf_data[j].min;
 
-            if (jbpf_s.perf_data[i].min == 0 ||
-                (jbpf_s.perf_data[i].min > tmp_perf_data[j].min && tmp_perf_data[j].min > 0))
-                jbpf_s.perf_data[i].min = tmp_perf_data[j].min;
+        if (res->max < thread_perf_data[j].max)
+            res->max = thread_perf_data[j].max;
 
-            if (jbpf_s.perf_data[i].max < tmp_perf_data[j].max)
-                jbpf_s.perf_data[i].max = tmp_perf_data[j].max;
+        res->num += thread_perf_data[j].num;
 
-            jbpf_s.perf_data[i].num += tmp_perf_data[j].num;
+        for (int k = 0; k < JBPF_PERF_NUM_COUNTERS; k++) {
+            res->counters[k] += thread_perf_data[j].counters[k];
+        }
 
-            for (int k = 0; k < JBPF_NUM_HIST_BINS; k++) {
-                jbpf_s.perf_data[i].hist[k] += tmp_perf_data[j].hist[k];
-            }
+        for (int k = 0; k < JBPF_NUM_HIST_BINS; k++) {
+            res->hist[k] += thread_perf_data[j].hist[k];
+        }
+    }
+}
+
+uint64_t
+jbpf_perf_hist_bin_max(uint32_t bin)
+{
+    uint32_t shift;
+
+    if (bin < 2 * JBPF_HIST_SUB_BUCKETS)
+        return bin;
+
+    /* The last bin also holds all the values that spill over the histogram */
+    if (bin >= JBPF_NUM_HIST_BINS - 1)
+        return UINT64_MAX;
+
+    shift = bin / JBPF_HIST_SUB_BUCKETS - 1;
+    return (((uint64_t)(bin - shift * JBPF_HIST_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+void
+jbpf_perf_compute_percentiles(struct jbpf_perf_data* perf_data)
+{
+    static const uint64_t permille[JBPF_NUM_PERCENTILES] = {500, 900, 990, 999};
+    uint64_t* percentiles[JBPF_NUM_PERCENTILES] = {&perf_data->p50, &perf_data->p90, &perf_data->p99, &perf_data->p999};
+    uint64_t count = 0, rank, value;
+    uint32_t bin = 0;
+
+    for (int i = 0; i < JBPF_NUM_PERCENTILES; i++) {
+        if (perf_data->num == 0) {
+            *percentiles[i] = 0;
+            continue;
+        }
+
+        /* Find the bin of the value with the given rank, starting from the bin of the previous percentile */
+        rank = (perf_data->num * permille[i] + 999) / 1000;
+        while (bin < JBPF_NUM_HIST_BINS - 1 && count + perf_data->hist[bin] < rank) {
+            count += perf_data->hist[bin];
+            bin++;
         }
-        jbpf_free_mem(tmp_perf_data);
+
+        value = jbpf_perf_hist_bin_max(bin);
+        if (value > perf_data->max)
+            value = perf_data->max;
+        if (value < perf_data->min)
+            value = perf_data->min;
+        *percentiles[i] = value;
+    }
+}
+
+/* Add the retired buffer to res, clear it and make it the active one. The hooks switch to it, while the buffer they
+ * were logging to becomes the retired buffer of the next report */
+static void
+jbpf_perf_buf_collect(struct jbpf_perf_buf* buf, struct jbpf_perf_data* res)
+{
+    struct jbpf_perf_thread_data* retired = buf->retired;
+
+    jbpf_aggregate_perf_data(res, retired);
+    jbpf_perf_compute_percentiles(res);
+    memset(retired, 0, JBPF_MAX_NUM_REG_THREADS * sizeof(struct jbpf_perf_thread_data));
+
+    buf->retired = buf->active;
+    ck_pr_store_ptr(&buf->active, retired);
+}
+
+#ifdef JBPF_CODELET_PERF_STATS
+/* Collect the perf data of all the codelets of a hook and add them to the reported codelets */
+static void
+jbpf_get_codelets_perf_data(struct jbpf_hook* hook, struct jbpf_perf_hook_list* jbpf_s)
+{
+    struct jbpf_hook_codelet* codelets;
+    struct jbpf_perf_codelet_data* res;
+
+    codelets = ck_pr_load_ptr(&hook->codelets);
+    if (!codelets) {
+        return;
     }
 
+    for (int i = 0; codelets[i].jbpf_codelet && jbpf_s->num_reported_codelets < MAX_NUM_PERF_CODELETS; i++) {
+        if (!codelets[i].perf || !codelets[i].perf->perf_data.active) {
+            continue;
+        }
+        res = &jbpf_s->codelet_perf_data[jbpf_s->num_reported_codelets];
+        jbpf_perf_buf_collect(&codelets[i].perf->perf_data, &res->perf_data);
+        strncpy(res->perf_data.hook_name, hook->name, JBPF_HOOK_NAME_LEN - 1);
+        strncpy(res->codelet_name, codelets[i].perf->codelet_name, JBPF_PERF_CODELET_NAME_LEN - 1);
+        res->num_filtered = jbpf_codelet_filter_collect(codelets[i].filter);
+        jbpf_s->num_reported_codelets++;
+    }
+}
+#endif
+
+/* Must be called with perf_report_mutex held */
+static void
+jbpf_report_perf_stats_locked(void)
+{
+
+    /* Too large for the stack with the histograms, and only used while holding perf_report_mutex */
+    static struct jbpf_perf_hook_list jbpf_s;
+    struct jbpf_hook* hook;
+
+    /* The buffers retired by the previous report are only collected once no hook can still log to them. Until then,
+     * the report is skipped and the hooks keep logging to their active buffers. The reporter drives the grace period
+     * forward itself, so an idle agent is not starved of reports */
+    if (perf_report_pending && !jbpf_ebr_poll_grace_period(perf_report_gp))
+        return;
+
+    memset(&jbpf_s, 0, sizeof(struct jbpf_perf_hook_list));
+
+#ifdef JBPF_CODELET_PERF_STATS
+    // The codelet lists of the hooks are only read inside a read-side section
+    JBPF_HOOK_READ_BEGIN()
+    for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
+        hook = jbpf_hook_list.jbpf_hook_p[i];
+        if (strncmp(hook->name, "report_stats", JBPF_HOOK_NAME_LEN) == 0)
+            continue;
+        jbpf_get_codelets_perf_data(hook, &jbpf_s);
+    }
+    JBPF_HOOK_READ_END()
+#endif
+
+    for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
+        hook = jbpf_hook_list.jbpf_hook_p[i];
+        if (strncmp(hook->name, "report_stats", JBPF_HOOK_NAME_LEN) == 0 || !hook->perf_data.active)
+            continue;
+        jbpf_perf_buf_collect(&hook->perf_data, &jbpf_s.perf_data[jbpf_s.num_reported_hooks]);
+        strncpy(jbpf_s.perf_data[jbpf_s.num_reported_hooks].hook_name, hook->name, JBPF_HOOK_NAME_LEN - 1);
+        jbpf_s.perf_data[jbpf_s.num_reported_hooks].hook_name[JBPF_HOOK_NAME_LEN - 1] = '\0';
+#ifdef JBPF_DEFERRED_HOOKS
+        jbpf_s.deferred_drops[jbpf_s.num_reported_hooks] = ck_pr_fas_64(&hook->deferred_drops, 0);
+#endif
+        jbpf_s.num_reported_hooks++;
+    }
+
+    jbpf_s.counters_type = jbpf_perf_counters_type();
+
+    perf_report_gp = jbpf_ebr_start_grace_period();
+    perf_report_pending = true;
+
+    jbpf_metrics_update_perf(&jbpf_s);
+
     // Run stats hook
     hook_report_stats(&jbpf_s, MAINTENANCE_CHECK_INTERVAL);
 }
+
+void
+jbpf_report_perf_stats(void)
+{
+    pthread_mutex_lock(&perf_report_mutex);
+    jbpf_report_perf_stats_locked();
+    pthread_mutex_unlock(&perf_report_mutex);
+}
+
+void
+jbpf_report_perf_stats_periodic(void)
+{
+    /* A report that runs already collects the same buffers, so the periodic one is skipped rather than waiting */
+    if (pthread_mutex_trylock(&perf_report_mutex) != 0)
+        return;
+    jbpf_report_perf_stats_locked();
+    pthread_mutex_unlock(&perf_report_mutex);
+}
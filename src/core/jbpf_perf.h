@@ -15,11 +15,17 @@
 
 #define JBPF_HOOK_PERF_DEFAULT_STATE true
 
+/* Maximum number of codelets quarantined by a single runtime budget check */
+#define JBPF_MAX_QUARANTINED_PER_CHECK (64)
+
 extern double g_jbpf_ticks_per_ns;
 extern uint64_t g_jbpf_tick_freq;
 
 void
 _jbpf_calibrate_ticks(void);
+/* Refine a measured tick frequency. Called periodically by the maintenance thread */
+void
+jbpf_refine_tick_calibration(void);
 
 int
 jbpf_init_perf(void);
@@ -85,11 +91,36 @@ jbpf_set_perf_hook(struct jbpf_hook* hook, bool active)
     __atomic_store(&hook->jbpf_perf_active, &active, __ATOMIC_RELAXED);
 }
 
-struct jbpf_perf_data*
+struct jbpf_perf_thread_data*
 jbpf_get_perf_data(struct jbpf_hook* hook);
 
+struct jbpf_codelet_perf*
+jbpf_codelet_perf_create(const char* codelet_name);
+void
+jbpf_codelet_perf_destroy(struct jbpf_codelet_perf* perf);
+
+void
+jbpf_init_runtime_budgets(const struct jbpf_agent_runtime_budget_config* config);
+void
+jbpf_enforce_runtime_budgets(void);
+void
+_jbpf_codelet_overrun(struct jbpf_codelet_perf* perf);
+
+/* Highest time counted in a histogram bin */
+uint64_t
+jbpf_perf_hist_bin_max(uint32_t bin);
+/* Compute the percentiles of aggregated perf data from its histogram */
+void
+jbpf_perf_compute_percentiles(struct jbpf_perf_data* perf_data);
+
+/* Collect the perf stats and pass them to the report_stats hook. The buffers retired by a report are collected by the
+ * next one, so each report carries the runtimes logged up to the previous report, and the first report is empty.
+ * Concurrent reports are serialized: jbpf_report_perf_stats() waits for the report that runs, while
+ * jbpf_report_perf_stats_periodic(), called by the maintenance thread, skips its report */
 void
 jbpf_report_perf_stats(void);
+void
+jbpf_report_perf_stats_periodic(void);
 
 #pragma once
 #ifdef __cplusplus
@@ -97,8 +128,25 @@ extern "C"
 {
 #endif
 
+    /* Bin of a time in the log-linear histogram. Times below JBPF_HIST_SUB_BUCKETS have a bin each, and every power of
+     * two above is split in JBPF_HIST_SUB_BUCKETS bins, indexed by the bits that follow the most significant one */
+    __attribute__((always_inline)) static uint32_t inline jbpf_perf_hist_bin(uint64_t et)
+    {
+        uint32_t shift;
+
+        if (et < JBPF_HIST_SUB_BUCKETS)
+            return (uint32_t)et;
+
+        /* Any value that is spilling should go to the last bin */
+        if (et >> JBPF_HIST_MAX_BITS)
+            return JBPF_NUM_HIST_BINS - 1;
+
+        shift = 63 - __builtin_clzll(et) - JBPF_HIST_SUB_BUCKET_BITS;
+        return shift * JBPF_HIST_SUB_BUCKETS + (uint32_t)(et >> shift);
+    }
+
     __attribute__((always_inline)) static int inline _jbpf_perf_log(
-        struct jbpf_perf_data* perf_data, uint64_t start_time, uint64_t end_time)
+        struct jbpf_perf_thread_data* perf_data, uint64_t start_time, uint64_t end_time)
     {
 
         /* Get the CPU id */
@@ -111,11 +159,7 @@ extern "C"
         if (et == 0)
             return -1;
 
-        // bin_idx = et / JBPF_NSECS_PER_BIN;
-        bin_idx = JBPF_NUM_HIST_BINS - 1 - __builtin_clzll(et);
-        /* Any value that is spilling should go to the last bin */
-        if (bin_idx >= JBPF_NUM_HIST_BINS)
-            bin_idx = JBPF_NUM_HIST_BINS - 1;
+        bin_idx = jbpf_perf_hist_bin(et);
 
         /* perf_idx is based on thread_id, so no need to lock */
         perf_data[perf_idx].num++;
@@ -131,6 +175,38 @@ extern "C"
         return 0;
     }
 
+    /* Quarantined codelets are skipped by the hooks until the maintenance thread removes them */
+    __attribute__((always_inline)) static bool inline jbpf_codelet_quarantined(const struct jbpf_hook_codelet* codelet)
+    {
+#ifdef JBPF_RUNTIME_BUDGETS
+        return codelet->perf && __atomic_load_n(&codelet->perf->quarantined, __ATOMIC_RELAXED);
+#else
+        return false;
+#endif
+    }
+
+    /* Log the runtime of a single codelet and check it against the runtime threshold of the codelet */
+    __attribute__((always_inline)) static void inline _jbpf_codelet_account(
+        const struct jbpf_hook* hook, const struct jbpf_hook_codelet* codelet, uint64_t start_time, uint64_t end_time)
+    {
+        struct jbpf_codelet_perf* perf = codelet->perf;
+
+        if (!perf)
+            return;
+
+#if defined(JBPF_CODELET_PERF_STATS) && !defined(DISABLE_JBPF_PERF_STATS)
+        if (JBPF_LIKELY(hook->jbpf_perf_active))
+            _jbpf_perf_log(__atomic_load_n(&perf->perf_data.active, __ATOMIC_ACQUIRE), start_time, end_time);
+#endif
+
+#ifdef JBPF_RUNTIME_BUDGETS
+        /* A threshold of 0 means that no threshold checking is performed */
+        if (codelet->time_thresh > 0 &&
+            JBPF_UNLIKELY(jbpf_get_time_diff_ns(start_time, end_time) > codelet->time_thresh))
+            _jbpf_codelet_overrun(perf);
+#endif
+    }
+
 #pragma once
 #ifdef __cplusplus
 }
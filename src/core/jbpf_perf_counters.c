@@ -0,0 +1,206 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "jbpf_perf_counters.h"
+#include "jbpf_int.h"
+#include "jbpf_logging.h"
+
+struct jbpf_perf_counters_state jbpf_perf_counters_states[JBPF_MAX_NUM_REG_THREADS];
+
+#ifdef JBPF_PERF_COUNTERS
+
+struct jbpf_perf_counter_event
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+static const struct jbpf_perf_counter_event hw_events[JBPF_PERF_NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const struct jbpf_perf_counter_event sw_events[JBPF_PERF_NUM_COUNTERS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+static jbpf_perf_counters_type_t counters_type = JBPF_PERF_COUNTERS_NONE;
+
+static void
+close_counters(struct jbpf_perf_counters_state* state)
+{
+    for (int i = 0; i < JBPF_PERF_NUM_COUNTERS; i++) {
+        if (state->pages[i]) {
+            munmap(state->pages[i], sysconf(_SC_PAGESIZE));
+        }
+        if (state->fds[i] >= 0) {
+            close(state->fds[i]);
+        }
+    }
+    memset(state, 0, sizeof(*state));
+}
+
+/* Open the counters of the calling thread, in user space only, as a group led by the first counter */
+static int
+open_counters(struct jbpf_perf_counters_state* state, jbpf_perf_counters_type_t type)
+{
+    const struct jbpf_perf_counter_event* events = type == JBPF_PERF_COUNTERS_HW ? hw_events : sw_events;
+    struct perf_event_attr attr;
+    void* page;
+
+    memset(state, 0, sizeof(*state));
+    for (int i = 0; i < JBPF_PERF_NUM_COUNTERS; i++) {
+        state->fds[i] = -1;
+    }
+
+    for (int i = 0; i < JBPF_PERF_NUM_COUNTERS; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        state->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : state->fds[0], PERF_FLAG_FD_CLOEXEC);
+        if (state->fds[i] < 0) {
+            int err = errno;
+            close_counters(state);
+            errno = err;
+            return -1;
+        }
+
+        /* Hardware counters are read with rdpmc if their page can be mapped */
+        if (type == JBPF_PERF_COUNTERS_HW) {
+            page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, state->fds[i], 0);
+            state->pages[i] = page == MAP_FAILED ? NULL : page;
+        }
+    }
+
+    state->open = true;
+    return 0;
+}
+
+void
+jbpf_perf_counters_init(void)
+{
+    struct jbpf_perf_counters_state state;
+
+    counters_type = JBPF_PERF_COUNTERS_NONE;
+
+    /* Hardware counters may not be available, e.g. in virtual machines, or not allowed by perf_event_paranoid */
+    if (open_counters(&state, JBPF_PERF_COUNTERS_HW) == 0) {
+        counters_type = JBPF_PERF_COUNTERS_HW;
+    } else {
+        jbpf_logger(
+            JBPF_WARN, "Cannot open hardware perf counters (%s), using software counters\n", strerror(errno));
+        if (open_counters(&state, JBPF_PERF_COUNTERS_SW) == 0) {
+            counters_type = JBPF_PERF_COUNTERS_SW;
+        } else {
+            jbpf_logger(JBPF_WARN, "Cannot open software perf counters (%s)\n", strerror(errno));
+            return;
+        }
+    }
+    close_counters(&state);
+
+    jbpf_logger(
+        JBPF_INFO, "Perf counters: %s\n", counters_type == JBPF_PERF_COUNTERS_HW ? "hardware" : "software");
+}
+
+void
+jbpf_perf_counters_stop(void)
+{
+    bool was_open[JBPF_MAX_NUM_REG_THREADS];
+
+    /* Other threads may still be reading their counters in a hook, so the counters are first marked closed, and their
+     * pages are only unmapped once the hooks that saw them open have returned */
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        was_open[i] = jbpf_perf_counters_states[i].open;
+        __atomic_store_n(&jbpf_perf_counters_states[i].open, false, __ATOMIC_RELEASE);
+    }
+    counters_type = JBPF_PERF_COUNTERS_NONE;
+
+    jbpf_call_barrier();
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        if (was_open[i]) {
+            close_counters(&jbpf_perf_counters_states[i]);
+        }
+    }
+}
+
+void
+jbpf_perf_counters_register_thread(int thread_id)
+{
+    struct jbpf_perf_counters_state* state;
+
+    if (counters_type == JBPF_PERF_COUNTERS_NONE || thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+
+    /* The counters of a thread id are kept until the thread is removed */
+    state = &jbpf_perf_counters_states[thread_id];
+    if (state->open) {
+        return;
+    }
+
+    if (open_counters(state, counters_type) != 0) {
+        jbpf_logger(JBPF_WARN, "Cannot open the perf counters of thread %d (%s)\n", thread_id, strerror(errno));
+    }
+}
+
+void
+jbpf_perf_counters_remove_thread(int thread_id)
+{
+    if (thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS || !jbpf_perf_counters_states[thread_id].open) {
+        return;
+    }
+    close_counters(&jbpf_perf_counters_states[thread_id]);
+}
+
+jbpf_perf_counters_type_t
+jbpf_perf_counters_type(void)
+{
+    return counters_type;
+}
+
+#else
+
+void
+jbpf_perf_counters_init(void)
+{
+}
+
+void
+jbpf_perf_counters_stop(void)
+{
+}
+
+void
+jbpf_perf_counters_register_thread(int thread_id)
+{
+}
+
+void
+jbpf_perf_counters_remove_thread(int thread_id)
+{
+}
+
+jbpf_perf_counters_type_t
+jbpf_perf_counters_type(void)
+{
+    return JBPF_PERF_COUNTERS_NONE;
+}
+
+#endif
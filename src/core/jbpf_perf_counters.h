@@ -0,0 +1,189 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_PERF_COUNTERS_H
+#define JBPF_PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+#include "jbpf_hook_defs.h"
+#include "jbpf_device_defs.h"
+#include "jbpf_utils.h"
+#include "jbpf.h"
+
+/* Performance counters of a registered thread. The counters of each thread are opened as a single group, so that they
+ * are all counting at the same time */
+struct jbpf_perf_counters_state
+{
+    bool open;
+    int fds[JBPF_PERF_NUM_COUNTERS];
+    /* Pages of the hardware counters mapped for rdpmc. NULL if the counters can only be read with read() */
+    struct perf_event_mmap_page* pages[JBPF_PERF_NUM_COUNTERS];
+} __attribute__((aligned(64)));
+
+extern struct jbpf_perf_counters_state jbpf_perf_counters_states[JBPF_MAX_NUM_REG_THREADS];
+
+/**
+ * @brief Select the events counted by the performance counters, by checking which ones the calling thread can open
+ * @ingroup core
+ */
+void
+jbpf_perf_counters_init(void);
+
+/**
+ * @brief Close the performance counters of all the threads. Waits for the hooks that may be reading them to return
+ * before unmapping their pages
+ * @ingroup core
+ */
+void
+jbpf_perf_counters_stop(void);
+
+/**
+ * @brief Open the performance counters of the calling thread
+ * @param thread_id The jbpf thread id of the calling thread
+ * @ingroup core
+ */
+void
+jbpf_perf_counters_register_thread(int thread_id);
+
+/**
+ * @brief Close the performance counters of the calling thread
+ * @param thread_id The jbpf thread id of the calling thread
+ * @ingroup core
+ */
+void
+jbpf_perf_counters_remove_thread(int thread_id);
+
+/**
+ * @brief Events counted by the performance counters
+ * @return JBPF_PERF_COUNTERS_NONE if jbpf is built without USE_JBPF_PERF_COUNTERS or no counter can be opened
+ * @ingroup core
+ */
+jbpf_perf_counters_type_t
+jbpf_perf_counters_type(void);
+
+/* Read the counters of the calling thread around the measured section of a hook or a codelet */
+#ifdef JBPF_PERF_COUNTERS
+#define JBPF_PERF_COUNTERS_START(var)           \
+    uint64_t var[JBPF_PERF_NUM_COUNTERS] = {0}; \
+    int var##_ret = _jbpf_perf_counters_read(var);
+#define JBPF_PERF_COUNTERS_STOP(var, perf_data) _jbpf_perf_counters_log(perf_data, var, var##_ret);
+#else
+#define JBPF_PERF_COUNTERS_START(var)
+#define JBPF_PERF_COUNTERS_STOP(var, perf_data)
+#endif
+
+/* With USE_JBPF_CODELET_PERF_STATS, the counters are also logged for each codelet */
+#if defined(JBPF_PERF_COUNTERS) && defined(JBPF_CODELET_PERF_STATS) && !defined(DISABLE_JBPF_PERF_STATS)
+#define JBPF_CODELET_COUNTERS_START(var) JBPF_PERF_COUNTERS_START(var)
+#define JBPF_CODELET_COUNTERS_STOP(var, hook, codelet) _jbpf_codelet_counters_log(hook, codelet, var, var##_ret);
+#else
+#define JBPF_CODELET_COUNTERS_START(var)
+#define JBPF_CODELET_COUNTERS_STOP(var, hook, codelet)
+#endif
+
+#pragma once
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Read a hardware counter from user space with rdpmc. Returns false if the counter is not currently scheduled on
+     * the PMU of this CPU or rdpmc is not allowed, in which case it must be read with read() */
+    __attribute__((always_inline)) static bool inline _jbpf_perf_counter_rdpmc(
+        volatile struct perf_event_mmap_page* page, uint64_t* value)
+    {
+#if defined(__x86_64__)
+        uint32_t seq, idx, lo, hi;
+        uint64_t count;
+        int64_t pmc;
+
+        do {
+            seq = page->lock;
+            __asm__ volatile("" ::: "memory");
+            idx = page->index;
+            if (!page->cap_user_rdpmc || idx == 0)
+                return false;
+            count = page->offset;
+            __asm__ volatile("rdpmc" : "=a"(lo), "=d"(hi) : "c"(idx - 1));
+            /* The counter is pmc_width bits wide, and must be sign extended */
+            pmc = (int64_t)(((uint64_t)hi << 32) | lo);
+            pmc <<= 64 - page->pmc_width;
+            pmc >>= 64 - page->pmc_width;
+            count += pmc;
+            __asm__ volatile("" ::: "memory");
+        } while (page->lock != seq);
+
+        *value = count;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /* Read the counters of the calling thread. Returns -1 if they could not be read, in which case values is not
+     * valid and the sample must be skipped */
+    __attribute__((always_inline)) static int inline _jbpf_perf_counters_read(uint64_t* values)
+    {
+        int thread_id = get_jbpf_hook_thread_id();
+        struct jbpf_perf_counters_state* state;
+        uint64_t group[JBPF_PERF_NUM_COUNTERS + 1];
+
+        if (JBPF_UNLIKELY(thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS))
+            return -1;
+
+        state = &jbpf_perf_counters_states[thread_id];
+        if (!__atomic_load_n(&state->open, __ATOMIC_ACQUIRE))
+            return -1;
+
+        for (int i = 0; i < JBPF_PERF_NUM_COUNTERS; i++) {
+            if (!state->pages[i] || !_jbpf_perf_counter_rdpmc(state->pages[i], &values[i]))
+                goto read_group;
+        }
+        return 0;
+
+    read_group:
+        /* A single read() of the group leader returns the number of counters followed by their values */
+        if (read(state->fds[0], group, sizeof(group)) != sizeof(group))
+            return -1;
+        memcpy(values, &group[1], JBPF_PERF_NUM_COUNTERS * sizeof(uint64_t));
+        return 0;
+    }
+
+    /* Add the counters since start to the perf data of the calling thread. start_ret is the return value of the read
+     * of start, and the sample is skipped if either read failed */
+    __attribute__((always_inline)) static void inline _jbpf_perf_counters_log(
+        struct jbpf_perf_thread_data* perf_data, const uint64_t* start, int start_ret)
+    {
+        int thread_id = get_jbpf_hook_thread_id();
+        uint64_t end[JBPF_PERF_NUM_COUNTERS] = {0};
+
+        if (JBPF_UNLIKELY(thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) || !perf_data || start_ret < 0)
+            return;
+
+        if (JBPF_UNLIKELY(_jbpf_perf_counters_read(end) < 0))
+            return;
+
+        /* perf_data is indexed by thread_id, so no need to lock */
+        for (int i = 0; i < JBPF_PERF_NUM_COUNTERS; i++)
+            perf_data[thread_id].counters[i] += end[i] - start[i];
+    }
+
+    __attribute__((always_inline)) static void inline _jbpf_codelet_counters_log(
+        const struct jbpf_hook* hook, const struct jbpf_hook_codelet* codelet, const uint64_t* start, int start_ret)
+    {
+        if (!codelet->perf || JBPF_UNLIKELY(!hook->jbpf_perf_active))
+            return;
+        _jbpf_perf_counters_log(
+            __atomic_load_n(&codelet->perf->perf_data.active, __ATOMIC_ACQUIRE), start, start_ret);
+    }
+
+#pragma once
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JBPF_PERF_COUNTERS_H */
@@ -6,28 +6,69 @@
 #include "jbpf_common_types.h"
 
 /* Change these values to adjust the histogram */
+/**
+ * @brief The histogram is log-linear: each power of two is split in 2^JBPF_HIST_SUB_BUCKET_BITS bins of equal width,
+ * so the width of a bin is at most 2^-JBPF_HIST_SUB_BUCKET_BITS of the values it holds
+ */
+#define JBPF_HIST_SUB_BUCKET_BITS 3
+
+/**
+ * @brief Times of 2^JBPF_HIST_MAX_BITS ns and above are counted in the last bin
+ */
+#define JBPF_HIST_MAX_BITS 32
+
+/**
+ * @brief Number of bins per power of two
+ */
+#define JBPF_HIST_SUB_BUCKETS (1U << JBPF_HIST_SUB_BUCKET_BITS)
+
 /**
  * @brief Number of histogram bins
  */
-#define JBPF_NUM_HIST_BINS 64
+#define JBPF_NUM_HIST_BINS ((JBPF_HIST_MAX_BITS - JBPF_HIST_SUB_BUCKET_BITS + 1) * JBPF_HIST_SUB_BUCKETS)
 
 /**
- * @brief Number of nanoseconds per bin
+ * @brief Number of performance counters measured for each hook and codelet
  */
-#define JBPF_NSECS_PER_BIN 100
+#define JBPF_PERF_NUM_COUNTERS 4
 
 /**
- * @brief Maximum number of hooks
+ * @brief Events counted by the performance counters
+ * @note With JBPF_PERF_COUNTERS_HW, the counters are, in order: instructions, CPU cycles, cache misses and branch
+ * misses. With JBPF_PERF_COUNTERS_SW, used when the hardware counters cannot be opened, they are: task clock in ns,
+ * context switches, page faults and CPU migrations
+ * @ingroup hooks
+ * @ingroup core
+ */
+typedef enum
+{
+    JBPF_PERF_COUNTERS_NONE = 0,
+    JBPF_PERF_COUNTERS_HW,
+    JBPF_PERF_COUNTERS_SW,
+} jbpf_perf_counters_type_t;
+
+/**
+ * @brief Maximum number of hooks, set with the JBPF_MAX_NUM_HOOKS build option. Each hook takes about 1.3KB in struct
+ * jbpf_perf_hook_list
  */
+#ifndef MAX_NUM_HOOKS
 #define MAX_NUM_HOOKS 128
+#endif
 
 /**
  * @brief JBPF performance data structure
  * @param num Number of times the hook was called
  * @param min Minimum time taken by the hook
  * @param max Maximum time taken by the hook
+ * @param p50 Median time taken by the hook
+ * @param p90 90th percentile of the time taken by the hook
+ * @param p99 99th percentile of the time taken by the hook
+ * @param p999 99.9th percentile of the time taken by the hook
+ * @param counters Sum over all the calls of the performance counters, see jbpf_perf_counters_type_t. Only set when jbpf
+ * is built with USE_JBPF_PERF_COUNTERS
  * @param hist Histogram of time taken by the hook
  * @param hook_name Name of the hook
+ * @note The percentiles are the upper bounds of the histogram bins they fall in, capped to max
  * @ingroup hooks
  * @ingroup core
  */
@@ -36,15 +77,81 @@ struct jbpf_perf_data
     uint64_t num;
     uint64_t min;
     uint64_t max;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t counters[JBPF_PERF_NUM_COUNTERS];
     uint32_t hist[JBPF_NUM_HIST_BINS];
     jbpf_hook_name_t hook_name;
 };
 
+/**
+ * @brief Maximum number of codelets with per-codelet performance data, set with the JBPF_MAX_NUM_PERF_CODELETS build
+ * option. Each codelet takes about 1.6KB in struct jbpf_perf_hook_list
+ */
+#ifndef MAX_NUM_PERF_CODELETS
+#define MAX_NUM_PERF_CODELETS 64
+#endif
+
+/**
+ * @brief Maximum length of a codelet name in the performance data
+ */
+#define JBPF_PERF_CODELET_NAME_LEN 256
+
+/**
+ * @brief JBPF per-codelet performance data structure
+ * @param perf_data Performance data of the codelet. perf_data.hook_name is the hook the codelet is loaded to
+ * @param codelet_name Name of the codelet
+ * @param num_filtered Number of calls of the hook that did not run the codelet because its pre-filter did not match.
+ * The calls that ran the codelet are in perf_data.num
+ * @ingroup hooks
+ * @ingroup core
+ */
+struct jbpf_perf_codelet_data
+{
+    struct jbpf_perf_data perf_data;
+    char codelet_name[JBPF_PERF_CODELET_NAME_LEN];
+    uint64_t num_filtered;
+};
+
+/**
+ * @brief Event reported when a codelet is quarantined for exceeding its runtime threshold too often
+ * @note This is the struct that is passed to the codelet_quarantined hook
+ * @param hook_name Name of the hook the codelet was loaded to
+ * @param codelet_name Name of the codelet
+ * @param runtime_threshold Runtime threshold of the codelet in ns
+ * @param num_overruns Number of times the codelet exceeded its runtime threshold
+ * @param timestamp Time of the quarantine in ns
+ * @ingroup hooks
+ * @ingroup core
+ */
+struct jbpf_codelet_quarantine_event
+{
+    jbpf_hook_name_t hook_name;
+    char codelet_name[JBPF_PERF_CODELET_NAME_LEN];
+    uint64_t runtime_threshold;
+    uint64_t num_overruns;
+    uint64_t timestamp;
+};
+
 /**
  * @brief JBPF performance hook list structure
  * @note This is the struct that is passed to the perf hook. See [here](../dosc/add_new_hook.md) for more information.
+ * The runtimes in each report are the ones logged between the two previous reports, as the hooks may still be logging
+ * to the buffers retired by the last report. The first report after the agent starts has no runtimes.
+ * Only the first num_reported_hooks and num_reported_codelets entries are set, but the arrays are sized for MAX_NUM_HOOKS
+ * hooks and MAX_NUM_PERF_CODELETS codelets, which makes the struct about 270KB with the default bounds. The codelets
+ * of the report_stats hook must be built with the same bounds as jbpf.
  * @param num_reported_hooks Number of hooks reported
  * @param perf_data Performance data for the hooks
+ * @param num_reported_codelets Number of codelets reported. Only set when jbpf is built with
+ * USE_JBPF_CODELET_PERF_STATS
+ * @param codelet_perf_data Performance data for each codelet of the reported hooks
+ * @param deferred_drops Number of calls of each reported hook, in the order of perf_data, that were dropped because
+ * the deferred ring of the calling thread was full or the context did not fit in a ring slot. Only set when jbpf is
+ * built with USE_JBPF_DEFERRED_HOOKS
+ * @param counters_type Events counted in the counters of perf_data and codelet_perf_data
  * @ingroup hooks
  * @ingroup core
  */
@@ -52,6 +159,10 @@ struct jbpf_perf_hook_list
 {
     uint8_t num_reported_hooks;
     struct jbpf_perf_data perf_data[MAX_NUM_HOOKS];
+    uint8_t num_reported_codelets;
+    struct jbpf_perf_codelet_data codelet_perf_data[MAX_NUM_PERF_CODELETS];
+    uint64_t deferred_drops[MAX_NUM_HOOKS];
+    jbpf_perf_counters_type_t counters_type;
 };
 
 #endif
@@ -0,0 +1,332 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+
+#include <elf.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ubpf.h"
+
+#include "jbpf_perf_map.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+#define JBPF_PERF_MAP_PATH_LEN (JBPF_RUN_PATH_LEN + 64)
+#define JBPF_PERF_MAP_SYMBOL_LEN (JBPF_CODELET_NAME_LEN + JBPF_HOOK_NAME_LEN + 8)
+/* Size of the buffer the codelets are translated to, to find the size of their native code */
+#define JBPF_PERF_MAP_MAX_CODE_SIZE (1 << 20)
+
+/* Format of the jitdump file, see tools/perf/Documentation/jitdump-specification.txt in the Linux sources */
+#define JITDUMP_MAGIC (0x4A695444)
+#define JITDUMP_VERSION (1)
+#define JIT_CODE_LOAD (0)
+#define JIT_CODE_CLOSE (3)
+
+struct jitdump_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitdump_record_prefix
+{
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+/* Followed by the null-terminated name of the function and its native code */
+struct jitdump_code_load
+{
+    struct jitdump_record_prefix prefix;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+};
+
+/* A codelet in the perf map */
+struct jbpf_perf_map_entry
+{
+    const void* code;
+    size_t code_size;
+    char symbol[JBPF_PERF_MAP_SYMBOL_LEN];
+    struct jbpf_perf_map_entry* next;
+};
+
+static pthread_mutex_t perf_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool perf_map_enabled = false;
+static struct jbpf_perf_map_entry* perf_map_entries = NULL;
+static char perf_map_path[JBPF_PERF_MAP_PATH_LEN];
+
+static FILE* jitdump_file = NULL;
+/* Marker mapping of the jitdump file, that perf record uses to find the file */
+static void* jitdump_marker = NULL;
+static uint64_t jitdump_code_index = 0;
+
+/* perf inject --jit expects the timestamps of the records in CLOCK_MONOTONIC, i.e. perf record -k mono */
+static uint64_t
+jitdump_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t
+jitdump_elf_mach(void)
+{
+#if defined(__x86_64__)
+    return EM_X86_64;
+#elif defined(__aarch64__)
+    return EM_AARCH64;
+#else
+    return EM_NONE;
+#endif
+}
+
+static int
+jitdump_open(const char* dir)
+{
+    char path[JBPF_PERF_MAP_PATH_LEN];
+    struct jitdump_header header = {0};
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/jit-%d.dump", dir, getpid());
+    fd = open(path, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        jbpf_logger(JBPF_ERROR, "Cannot create jitdump file %s\n", path);
+        return -1;
+    }
+
+    jitdump_marker = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (jitdump_marker == MAP_FAILED) {
+        jbpf_logger(JBPF_ERROR, "Cannot map jitdump file %s\n", path);
+        jitdump_marker = NULL;
+        close(fd);
+        return -1;
+    }
+
+    jitdump_file = fdopen(fd, "w");
+    if (!jitdump_file) {
+        munmap(jitdump_marker, sysconf(_SC_PAGESIZE));
+        jitdump_marker = NULL;
+        close(fd);
+        return -1;
+    }
+
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+    header.elf_mach = jitdump_elf_mach();
+    header.pid = getpid();
+    header.timestamp = jitdump_timestamp();
+    fwrite(&header, sizeof(header), 1, jitdump_file);
+    fflush(jitdump_file);
+
+    jbpf_logger(JBPF_INFO, "Writing the JIT-compiled codelets to %s\n", path);
+    return 0;
+}
+
+static void
+jitdump_write_code_load(const struct jbpf_perf_map_entry* entry)
+{
+    struct jitdump_code_load record = {0};
+    size_t name_len = strlen(entry->symbol) + 1;
+
+    record.prefix.id = JIT_CODE_LOAD;
+    record.prefix.total_size = sizeof(record) + name_len + entry->code_size;
+    record.prefix.timestamp = jitdump_timestamp();
+    record.pid = getpid();
+    record.tid = syscall(SYS_gettid);
+    record.vma = (uint64_t)(uintptr_t)entry->code;
+    record.code_addr = (uint64_t)(uintptr_t)entry->code;
+    record.code_size = entry->code_size;
+    record.code_index = jitdump_code_index++;
+
+    fwrite(&record, sizeof(record), 1, jitdump_file);
+    fwrite(entry->symbol, name_len, 1, jitdump_file);
+    fwrite(entry->code, entry->code_size, 1, jitdump_file);
+    fflush(jitdump_file);
+}
+
+static void
+jitdump_close(void)
+{
+    struct jitdump_record_prefix record = {0};
+
+    if (!jitdump_file) {
+        return;
+    }
+
+    record.id = JIT_CODE_CLOSE;
+    record.total_size = sizeof(record);
+    record.timestamp = jitdump_timestamp();
+    fwrite(&record, sizeof(record), 1, jitdump_file);
+    fclose(jitdump_file);
+    jitdump_file = NULL;
+
+    munmap(jitdump_marker, sysconf(_SC_PAGESIZE));
+    jitdump_marker = NULL;
+}
+
+/* The perf map cannot be edited in place, so it is written again with the loaded codelets, and replaces the previous
+ * one. perf only reads it when the profile is reported */
+static void
+perf_map_write(void)
+{
+    char tmp_path[JBPF_PERF_MAP_PATH_LEN + sizeof(".tmp")];
+    struct jbpf_perf_map_entry* entry;
+    FILE* f;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", perf_map_path);
+    f = fopen(tmp_path, "w");
+    if (!f) {
+        jbpf_logger(JBPF_WARN, "Cannot write perf map %s\n", tmp_path);
+        return;
+    }
+    for (entry = perf_map_entries; entry; entry = entry->next) {
+        fprintf(f, "%lx %lx %s\n", (uintptr_t)entry->code, entry->code_size, entry->symbol);
+    }
+    fclose(f);
+
+    if (rename(tmp_path, perf_map_path) != 0) {
+        jbpf_logger(JBPF_WARN, "Cannot write perf map %s\n", perf_map_path);
+        unlink(tmp_path);
+    }
+}
+
+/* ubpf does not expose the size of the compiled code, so the codelet is translated again to a scratch buffer */
+static size_t
+codelet_code_size(struct ubpf_vm* vm)
+{
+    size_t size = JBPF_PERF_MAP_MAX_CODE_SIZE;
+    uint8_t* buffer;
+    char* errmsg = NULL;
+
+    buffer = malloc(size);
+    if (!buffer) {
+        return 0;
+    }
+    if (ubpf_translate(vm, buffer, &size, &errmsg) < 0) {
+        jbpf_logger(JBPF_WARN, "Cannot find the size of the codelet code: %s\n", errmsg ? errmsg : "");
+        free(errmsg);
+        size = 0;
+    }
+    free(buffer);
+    return size;
+}
+
+int
+jbpf_perf_map_init(const struct jbpf_agent_perf_map_config* config)
+{
+    int res = 0;
+
+    pthread_mutex_lock(&perf_map_mutex);
+    perf_map_enabled = config->enable_perf_map;
+    if (perf_map_enabled) {
+        snprintf(perf_map_path, sizeof(perf_map_path), "/tmp/perf-%d.map", getpid());
+        perf_map_write();
+        jbpf_logger(JBPF_INFO, "Writing the JIT-compiled codelets to %s\n", perf_map_path);
+    }
+    if (config->enable_jitdump) {
+        res = jitdump_open(config->jitdump_dir);
+    }
+    pthread_mutex_unlock(&perf_map_mutex);
+    return res;
+}
+
+void
+jbpf_perf_map_stop(void)
+{
+    struct jbpf_perf_map_entry* entry;
+
+    pthread_mutex_lock(&perf_map_mutex);
+    while (perf_map_entries) {
+        entry = perf_map_entries;
+        perf_map_entries = entry->next;
+        jbpf_free_mem(entry);
+    }
+    if (perf_map_enabled) {
+        unlink(perf_map_path);
+        perf_map_enabled = false;
+    }
+    jitdump_close();
+    pthread_mutex_unlock(&perf_map_mutex);
+}
+
+void
+jbpf_perf_map_add_codelet(struct ubpf_vm* vm, const void* code, const char* codelet_name, const char* hook_name)
+{
+    struct jbpf_perf_map_entry* entry;
+
+    if (!__atomic_load_n(&perf_map_enabled, __ATOMIC_RELAXED) && !__atomic_load_n(&jitdump_file, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    entry = jbpf_calloc_mem(1, sizeof(struct jbpf_perf_map_entry));
+    if (!entry) {
+        jbpf_logger(JBPF_WARN, "Cannot add codelet %s to the perf map\n", codelet_name);
+        return;
+    }
+    entry->code = code;
+    entry->code_size = codelet_code_size(vm);
+    snprintf(entry->symbol, sizeof(entry->symbol), "jbpf:%s:%s", hook_name, codelet_name);
+
+    if (entry->code_size == 0) {
+        jbpf_free_mem(entry);
+        return;
+    }
+
+    pthread_mutex_lock(&perf_map_mutex);
+    if (jitdump_file) {
+        jitdump_write_code_load(entry);
+    }
+    if (perf_map_enabled) {
+        entry->next = perf_map_entries;
+        perf_map_entries = entry;
+        perf_map_write();
+        entry = NULL;
+    }
+    pthread_mutex_unlock(&perf_map_mutex);
+
+    jbpf_free_mem(entry);
+}
+
+void
+jbpf_perf_map_remove_codelet(const void* code)
+{
+    struct jbpf_perf_map_entry **prev, *entry;
+
+    if (!__atomic_load_n(&perf_map_enabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    pthread_mutex_lock(&perf_map_mutex);
+    for (prev = &perf_map_entries; (entry = *prev); prev = &entry->next) {
+        if (entry->code == code) {
+            *prev = entry->next;
+            jbpf_free_mem(entry);
+            perf_map_write();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&perf_map_mutex);
+}
@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_PERF_MAP_H
+#define JBPF_PERF_MAP_H
+
+#include <stddef.h>
+
+#include "jbpf_config.h"
+
+struct ubpf_vm;
+
+/**
+ * @brief Create the jitdump file, if enabled, and start recording the JIT-compiled codelets
+ * @param config The perf map configuration
+ * @return 0 on success, -1 if the jitdump file cannot be created
+ * @ingroup core
+ */
+int
+jbpf_perf_map_init(const struct jbpf_agent_perf_map_config* config);
+
+/**
+ * @brief Remove the perf map and close the jitdump file
+ * @note The jitdump file is kept, as it is needed by perf inject after jbpf has stopped
+ * @ingroup core
+ */
+void
+jbpf_perf_map_stop(void);
+
+/**
+ * @brief Add a JIT-compiled codelet to the perf map and the jitdump file
+ * @param vm The VM the codelet was compiled with
+ * @param code The native code of the codelet
+ * @param codelet_name The name of the codelet
+ * @param hook_name The name of the hook the codelet is loaded to
+ * @ingroup core
+ */
+void
+jbpf_perf_map_add_codelet(struct ubpf_vm* vm, const void* code, const char* codelet_name, const char* hook_name);
+
+/**
+ * @brief Remove a codelet from the perf map, before its native code is released
+ * @param code The native code of the codelet
+ * @ingroup core
+ */
+void
+jbpf_perf_map_remove_codelet(const void* code);
+
+#endif
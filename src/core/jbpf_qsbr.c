@@ -0,0 +1,214 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "ck_pr.h"
+#include "ck_stack.h"
+
+#include "jbpf_qsbr.h"
+#include "jbpf_device_defs.h"
+
+/* Number of busy polls before the writer starts sleeping while waiting for a grace period */
+#define JBPF_QSBR_SPIN_COUNT (1000)
+/* Sleep time in us between polls of a grace period */
+#define JBPF_QSBR_WAIT_INTERVAL (50)
+
+/* Quiescent state counter of a thread. 0 means that the thread is offline. */
+struct jbpf_qsbr_thread
+{
+    uint64_t ctr;
+    ck_stack_t deferred;
+} __attribute__((aligned(64)));
+
+static uint64_t qsbr_gp_ctr __attribute__((aligned(64))) = 1;
+static struct jbpf_qsbr_thread qsbr_threads[JBPF_MAX_NUM_REG_THREADS];
+
+/* Deferred callbacks that wait for the grace period qsbr_pending_gp */
+static pthread_mutex_t qsbr_reclaim_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ck_stack_entry_t* qsbr_pending = NULL;
+static uint64_t qsbr_pending_gp = 0;
+
+CK_STACK_CONTAINER(ck_epoch_entry_t, stack_entry, qsbr_entry_container)
+
+void
+jbpf_qsbr_init(void)
+{
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        ck_pr_store_64(&qsbr_threads[i].ctr, 0);
+        ck_stack_init(&qsbr_threads[i].deferred);
+    }
+}
+
+void
+jbpf_qsbr_thread_online(int thread_id)
+{
+    if (thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+    ck_pr_store_64(&qsbr_threads[thread_id].ctr, ck_pr_load_64(&qsbr_gp_ctr));
+    /* Reads of the thread must not be reordered before it is seen online */
+    ck_pr_fence_memory();
+}
+
+void
+jbpf_qsbr_thread_offline(int thread_id)
+{
+    if (thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+    ck_pr_fence_release();
+    ck_pr_store_64(&qsbr_threads[thread_id].ctr, 0);
+}
+
+void
+jbpf_qsbr_quiescent(int thread_id)
+{
+    uint64_t gp;
+
+    if (thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+    /* All previous reads must complete before the quiescent state is announced */
+    ck_pr_fence_release();
+    gp = ck_pr_load_64(&qsbr_gp_ctr);
+    ck_pr_fence_acquire();
+    ck_pr_store_64(&qsbr_threads[thread_id].ctr, gp);
+}
+
+uint64_t
+jbpf_qsbr_start_grace_period(void)
+{
+    uint64_t gp;
+
+    /* Make the updates of the writer visible before starting the grace period */
+    ck_pr_fence_memory();
+    gp = ck_pr_faa_64(&qsbr_gp_ctr, 1) + 1;
+    ck_pr_fence_memory();
+    return gp;
+}
+
+bool
+jbpf_qsbr_grace_period_elapsed(uint64_t gp)
+{
+    uint64_t ctr;
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        if (i == __thread_id) {
+            continue;
+        }
+        ctr = ck_pr_load_64(&qsbr_threads[i].ctr);
+        if (ctr != 0 && ctr < gp) {
+            return false;
+        }
+    }
+    ck_pr_fence_acquire();
+    return true;
+}
+
+void
+jbpf_qsbr_synchronize(void)
+{
+    uint64_t gp = jbpf_qsbr_start_grace_period();
+    int spins = 0;
+
+    while (!jbpf_qsbr_grace_period_elapsed(gp)) {
+        if (spins < JBPF_QSBR_SPIN_COUNT) {
+            ck_pr_stall();
+            spins++;
+        } else {
+            usleep(JBPF_QSBR_WAIT_INTERVAL);
+        }
+    }
+}
+
+void
+jbpf_qsbr_call(ck_epoch_entry_t* entry, ck_epoch_cb_t* cb)
+{
+    /* Threads that are not registered (e.g. in unit tests) share the first list */
+    int idx = (__thread_id < 0 || __thread_id >= JBPF_MAX_NUM_REG_THREADS) ? 0 : __thread_id;
+
+    entry->function = cb;
+    ck_stack_push_upmc(&qsbr_threads[idx].deferred, &entry->stack_entry);
+}
+
+static void
+qsbr_dispatch(ck_stack_entry_t* head)
+{
+    ck_stack_entry_t* next;
+    ck_epoch_entry_t* entry;
+
+    while (head) {
+        next = head->next;
+        entry = qsbr_entry_container(head);
+        entry->function(entry);
+        head = next;
+    }
+}
+
+static ck_stack_entry_t*
+qsbr_collect_deferred(void)
+{
+    ck_stack_entry_t *head = NULL, *batch, *tail;
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        batch = ck_stack_batch_pop_upmc(&qsbr_threads[i].deferred);
+        if (!batch) {
+            continue;
+        }
+        for (tail = batch; tail->next; tail = tail->next)
+            ;
+        tail->next = head;
+        head = batch;
+    }
+    return head;
+}
+
+void
+jbpf_qsbr_reclaim(void)
+{
+    if (pthread_mutex_trylock(&qsbr_reclaim_mutex) != 0) {
+        return;
+    }
+
+    if (qsbr_pending) {
+        if (!jbpf_qsbr_grace_period_elapsed(qsbr_pending_gp)) {
+            goto out;
+        }
+        qsbr_dispatch(qsbr_pending);
+        qsbr_pending = NULL;
+    }
+
+    /* Callbacks deferred so far wait for a new grace period */
+    qsbr_pending = qsbr_collect_deferred();
+    if (qsbr_pending) {
+        qsbr_pending_gp = jbpf_qsbr_start_grace_period();
+    }
+
+out:
+    pthread_mutex_unlock(&qsbr_reclaim_mutex);
+}
+
+void
+jbpf_qsbr_barrier(void)
+{
+    ck_stack_entry_t* deferred;
+
+    pthread_mutex_lock(&qsbr_reclaim_mutex);
+    deferred = qsbr_collect_deferred();
+    jbpf_qsbr_synchronize();
+    qsbr_dispatch(qsbr_pending);
+    qsbr_pending = NULL;
+    qsbr_dispatch(deferred);
+    pthread_mutex_unlock(&qsbr_reclaim_mutex);
+}
+
+void
+jbpf_qsbr_stop(void)
+{
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        ck_pr_store_64(&qsbr_threads[i].ctr, 0);
+    }
+    jbpf_qsbr_barrier();
+}
@@ -0,0 +1,176 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_QSBR_H
+#define JBPF_QSBR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ck_epoch.h"
+
+#include "jbpf.h"
+
+/*
+ * Memory reclamation used to protect the data read by hooks (codelet lists, perf data and hashmap nodes).
+ * By default, hooks enter an epoch section on every call (EBR). When jbpf is built with USE_JBPF_QSBR,
+ * hooks do not use any read-side primitive and instead, each registered thread periodically announces
+ * a quiescent state with jbpf_quiescent() or jbpf_maintenance().
+ */
+
+/**
+ * @brief Initialize the quiescent state of all threads
+ * @ingroup core
+ */
+void
+jbpf_qsbr_init(void);
+
+/**
+ * @brief Mark a registered thread as online, i.e. it can read data protected by jbpf
+ * @param thread_id The id of the thread
+ * @ingroup core
+ */
+void
+jbpf_qsbr_thread_online(int thread_id);
+
+/**
+ * @brief Mark a registered thread as offline, i.e. it will not be waited for by writers
+ * @param thread_id The id of the thread
+ * @ingroup core
+ */
+void
+jbpf_qsbr_thread_offline(int thread_id);
+
+/**
+ * @brief Announce that a thread holds no reference to data protected by jbpf
+ * @param thread_id The id of the thread
+ * @ingroup core
+ */
+void
+jbpf_qsbr_quiescent(int thread_id);
+
+/**
+ * @brief Wait until all online threads, except the caller, have gone through a quiescent state
+ * @ingroup core
+ */
+void
+jbpf_qsbr_synchronize(void);
+
+/**
+ * @brief Start a new grace period, without waiting for it
+ * @return The grace period, to pass to jbpf_qsbr_grace_period_elapsed()
+ * @ingroup core
+ */
+uint64_t
+jbpf_qsbr_start_grace_period(void);
+
+/**
+ * @brief Check if all online threads, except the caller, have gone through a quiescent state since a grace period
+ * started. Does not block.
+ * @param gp The grace period returned by jbpf_qsbr_start_grace_period()
+ * @return true if the grace period has elapsed
+ * @ingroup core
+ */
+bool
+jbpf_qsbr_grace_period_elapsed(uint64_t gp);
+
+/**
+ * @brief Defer a callback until all online threads have gone through a quiescent state
+ * @param entry The entry to pass to the callback
+ * @param cb The callback
+ * @note Deferred callbacks are dispatched by jbpf_qsbr_reclaim()
+ * @ingroup core
+ */
+void
+jbpf_qsbr_call(ck_epoch_entry_t* entry, ck_epoch_cb_t* cb);
+
+/**
+ * @brief Dispatch the deferred callbacks whose grace period has elapsed. Does not block.
+ * @note Only called from the maintenance thread
+ * @ingroup core
+ */
+void
+jbpf_qsbr_reclaim(void);
+
+/**
+ * @brief Wait for a grace period and dispatch all deferred callbacks
+ * @ingroup core
+ */
+void
+jbpf_qsbr_barrier(void);
+
+/**
+ * @brief Mark all threads as offline and dispatch all deferred callbacks
+ * @note Only called when jbpf is stopped
+ * @ingroup core
+ */
+void
+jbpf_qsbr_stop(void);
+
+/* Reclamation primitives used by the writers, matching the read-side primitives of the hooks */
+
+static inline void
+jbpf_ebr_call(ck_epoch_entry_t* entry, ck_epoch_cb_t* cb)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_call(entry, cb);
+#else
+    ck_epoch_call_strict(e_record, entry, cb);
+#endif
+}
+
+static inline void
+jbpf_ebr_synchronize(void)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_synchronize();
+#else
+    ck_epoch_synchronize(e_record);
+#endif
+}
+
+static inline void
+jbpf_ebr_barrier(void)
+{
+#ifdef JBPF_QSBR
+    jbpf_qsbr_barrier();
+#else
+    ck_epoch_barrier(e_record);
+#endif
+}
+
+/* Non-blocking grace period detection. With EBR, the readers that could see the data before the grace period started
+ * have all left their read-side section once the global epoch has advanced twice */
+static inline uint64_t
+jbpf_ebr_start_grace_period(void)
+{
+#ifdef JBPF_QSBR
+    return jbpf_qsbr_start_grace_period();
+#else
+    return ck_epoch_value(e_record->global);
+#endif
+}
+
+static inline bool
+jbpf_ebr_grace_period_elapsed(uint64_t gp)
+{
+#ifdef JBPF_QSBR
+    return jbpf_qsbr_grace_period_elapsed(gp);
+#else
+    return (unsigned int)(ck_epoch_value(e_record->global) - (unsigned int)gp) >= 2;
+#endif
+}
+
+/* Like jbpf_ebr_grace_period_elapsed(), but drives the grace period forward from the calling thread, which must not be
+ * in a read-side section. With EBR, the global epoch is otherwise only advanced by the writers that wait for it, so it
+ * would never advance on an idle system */
+static inline bool
+jbpf_ebr_poll_grace_period(uint64_t gp)
+{
+#ifndef JBPF_QSBR
+    for (int i = 0; i < 2 && !jbpf_ebr_grace_period_elapsed(gp); i++)
+        ck_epoch_poll(e_record);
+#endif
+    return jbpf_ebr_grace_period_elapsed(gp);
+}
+
+#endif
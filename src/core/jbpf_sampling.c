@@ -0,0 +1,75 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#include "jbpf_sampling.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+#define NSECS_PER_SEC (1000000000ULL)
+
+int
+jbpf_codelet_sampler_create(const jbpf_codelet_sampling_t* sampling, struct jbpf_codelet_sampler** sampler)
+{
+    struct jbpf_codelet_sampler* new_sampler;
+    uint64_t burst;
+
+    *sampler = NULL;
+
+    if (!sampling || sampling->type == JBPF_SAMPLING_NONE) {
+        return 0;
+    }
+
+    if (sampling->type > JBPF_SAMPLING_INTERVAL || sampling->value == 0) {
+        jbpf_logger(
+            JBPF_ERROR, "Invalid codelet sampling: type %u, value %lu\n", sampling->type, (uint64_t)sampling->value);
+        return -1;
+    }
+
+    /* Sampling 1 in 1 calls is the same as no sampling */
+    if (sampling->type == JBPF_SAMPLING_RATIO && sampling->value == 1) {
+        return 0;
+    }
+
+    new_sampler = jbpf_calloc_mem(1, sizeof(struct jbpf_codelet_sampler));
+    if (!new_sampler) {
+        goto alloc_error;
+    }
+
+    new_sampler->state = jbpf_calloc_mem(JBPF_MAX_NUM_REG_THREADS, sizeof(struct jbpf_codelet_sampler_state));
+    if (!new_sampler->state) {
+        jbpf_free_mem(new_sampler);
+        goto alloc_error;
+    }
+
+    new_sampler->type = sampling->type;
+    switch (sampling->type) {
+    case JBPF_SAMPLING_RATIO:
+        new_sampler->ratio = sampling->value;
+        break;
+    case JBPF_SAMPLING_RATE:
+        burst = sampling->burst > 0 ? sampling->burst : 1;
+        new_sampler->period_ns = sampling->value < NSECS_PER_SEC ? NSECS_PER_SEC / sampling->value : 1;
+        new_sampler->tolerance_ns = (burst - 1) * new_sampler->period_ns;
+        break;
+    case JBPF_SAMPLING_INTERVAL:
+        new_sampler->period_ns = sampling->value;
+        break;
+    }
+    new_sampler->start_time = jbpf_measure_start_time();
+
+    *sampler = new_sampler;
+    return 0;
+
+alloc_error:
+    jbpf_logger(JBPF_ERROR, "Failed to allocate memory for codelet sampling\n");
+    return -1;
+}
+
+void
+jbpf_codelet_sampler_destroy(struct jbpf_codelet_sampler* sampler)
+{
+    if (!sampler) {
+        return;
+    }
+    jbpf_free_mem(sampler->state);
+    jbpf_free_mem(sampler);
+}
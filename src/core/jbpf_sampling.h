@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_SAMPLING_H
+#define JBPF_SAMPLING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jbpf_hook_defs.h"
+#include "jbpf_device_defs.h"
+#include "jbpf_perf.h"
+#include "jbpf.h"
+
+/**
+ * @brief Create the sampler of a codelet
+ * @param sampling The sampling of the codelet
+ * @param sampler Set to the new sampler, or to NULL if the codelet is not sampled
+ * @return 0 on success, -1 if the sampling is invalid or the sampler cannot be allocated
+ * @ingroup core
+ */
+int
+jbpf_codelet_sampler_create(const jbpf_codelet_sampling_t* sampling, struct jbpf_codelet_sampler** sampler);
+
+/**
+ * @brief Release a sampler created with jbpf_codelet_sampler_create()
+ * @param sampler The sampler to release
+ * @note The caller must make sure that no hook can still use the sampler
+ * @ingroup core
+ */
+void
+jbpf_codelet_sampler_destroy(struct jbpf_codelet_sampler* sampler);
+
+#pragma once
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    __attribute__((always_inline)) static bool inline _jbpf_codelet_sample(struct jbpf_codelet_sampler* sampler)
+    {
+        int thread_id = get_jbpf_hook_thread_id();
+        struct jbpf_codelet_sampler_state* state;
+        uint64_t now;
+
+        if (JBPF_UNLIKELY(thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS))
+            return false;
+
+        /* The state of each thread is only updated by that thread, so no need to lock */
+        state = &sampler->state[thread_id];
+
+        if (sampler->type == JBPF_SAMPLING_RATIO) {
+            if (state->count > 0) {
+                state->count--;
+                return false;
+            }
+            state->count = sampler->ratio - 1;
+            return true;
+        }
+
+        now = jbpf_get_time_diff_ns(sampler->start_time, jbpf_measure_start_time());
+        if (now + sampler->tolerance_ns < state->next_time)
+            return false;
+        state->next_time = (state->next_time > now ? state->next_time : now) + sampler->period_ns;
+        return true;
+    }
+
+    /* Check whether the current call of the hook runs the codelet. Codelets without sampling run on every call */
+    __attribute__((always_inline)) static bool inline jbpf_codelet_sampled(const struct jbpf_hook_codelet* codelet)
+    {
+        struct jbpf_codelet_sampler* sampler = codelet->sampler;
+
+        if (JBPF_LIKELY(!sampler))
+            return true;
+        return _jbpf_codelet_sample(sampler);
+    }
+
+#pragma once
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JBPF_SAMPLING_H */
@@ -0,0 +1,279 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/ucontext.h>
+#include <linux/membarrier.h>
+
+#include "jbpf_static_key.h"
+#include "jbpf_hook.h"
+#include "jbpf_logging.h"
+
+#ifdef JBPF_HOOK_STATIC_KEYS
+
+#define STATIC_KEY_INSN_SIZE 5
+#define STATIC_KEY_JMP_OPCODE 0xe9
+#define STATIC_KEY_INT3_OPCODE 0xcc
+
+/* Maximum number of binaries with hook call sites, i.e. distinct __jbpf_static_keys sections */
+#define STATIC_KEY_MAX_SECTIONS 8
+
+static const uint8_t static_key_nop[STATIC_KEY_INSN_SIZE] = {0x0f, 0x1f, 0x44, 0x00, 0x00}; /* nopl 0x0(%rax,%rax,1) */
+
+bool jbpf_static_keys_active = false;
+
+static struct
+{
+    struct jbpf_static_key_entry* start;
+    struct jbpf_static_key_entry* stop;
+} static_key_sections[STATIC_KEY_MAX_SECTIONS];
+static int num_static_key_sections = 0;
+
+static struct sigaction static_key_old_sigtrap;
+static bool static_key_sigtrap_installed = false;
+
+/* A thread that runs into the int3 of a call site that is being patched resumes in the hook body, which is always
+ * safe since the hook body checks the codelets of the hook. Any other int3 is passed on to the previous handler */
+static void
+static_key_sigtrap(int sig, siginfo_t* info, void* ucontext)
+{
+    ucontext_t* uc = ucontext;
+    uint64_t site = (uint64_t)uc->uc_mcontext.gregs[REG_RIP] - 1;
+
+    for (int i = 0; i < num_static_key_sections; i++) {
+        for (struct jbpf_static_key_entry* entry = static_key_sections[i].start; entry < static_key_sections[i].stop;
+             entry++) {
+            if (entry->code == site) {
+                uc->uc_mcontext.gregs[REG_RIP] = (greg_t)entry->target;
+                return;
+            }
+        }
+    }
+
+    if (static_key_old_sigtrap.sa_flags & SA_SIGINFO) {
+        static_key_old_sigtrap.sa_sigaction(sig, info, ucontext);
+    } else if (static_key_old_sigtrap.sa_handler == SIG_DFL) {
+        signal(SIGTRAP, SIG_DFL);
+        raise(SIGTRAP);
+    } else if (static_key_old_sigtrap.sa_handler != SIG_IGN) {
+        static_key_old_sigtrap.sa_handler(sig);
+    }
+}
+
+/* Serialize the instruction stream of every thread of the process, so that none of them runs a stale copy of a
+ * call site that was just written */
+static void
+sync_cores(void)
+{
+    syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE, 0);
+}
+
+static int
+set_site_protection(const struct jbpf_static_key_entry* entry, int prot)
+{
+    uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    void* page = (void*)((uintptr_t)entry->code & ~(page_size - 1));
+
+    return mprotect(page, page_size, prot);
+}
+
+/* The site is patched as the kernel does with text_poke_bp(), as a running thread may fetch the instruction at any
+ * time: the first byte is turned into an int3, then the last 4 bytes are written, and then the first byte, with all
+ * the cores synchronized after each step. A thread sees either the old instruction, the int3 or the new instruction.
+ * The site is 8-byte aligned, so it never spans a page */
+static int
+patch_site(const struct jbpf_static_key_entry* entry, bool enable)
+{
+    uint8_t* code = (uint8_t*)(uintptr_t)entry->code;
+    uint8_t insn[STATIC_KEY_INSN_SIZE];
+
+    if (enable) {
+        int32_t rel32 = (int32_t)((int64_t)entry->target - (int64_t)(entry->code + STATIC_KEY_INSN_SIZE));
+        insn[0] = STATIC_KEY_JMP_OPCODE; /* jmp rel32 */
+        memcpy(&insn[1], &rel32, sizeof(rel32));
+    } else {
+        memcpy(insn, static_key_nop, STATIC_KEY_INSN_SIZE);
+    }
+
+    if (memcmp(insn, code, sizeof(insn)) == 0) {
+        return 0;
+    }
+
+    if (set_site_protection(entry, PROT_READ | PROT_WRITE | PROT_EXEC) < 0) {
+        jbpf_logger(JBPF_ERROR, "Failed to make hook call site %p writable\n", (void*)code);
+        return -1;
+    }
+
+    __atomic_store_n(&code[0], STATIC_KEY_INT3_OPCODE, __ATOMIC_SEQ_CST);
+    sync_cores();
+    for (int i = 1; i < STATIC_KEY_INSN_SIZE; i++) {
+        __atomic_store_n(&code[i], insn[i], __ATOMIC_RELAXED);
+    }
+    sync_cores();
+    __atomic_store_n(&code[0], insn[0], __ATOMIC_SEQ_CST);
+    sync_cores();
+
+    if (set_site_protection(entry, PROT_READ | PROT_EXEC) < 0) {
+        jbpf_logger(JBPF_WARN, "Failed to restore the protection of hook call site %p\n", (void*)code);
+    }
+    return 0;
+}
+
+static bool
+add_section(struct jbpf_static_key_entry* start, struct jbpf_static_key_entry* stop)
+{
+    for (int i = 0; i < num_static_key_sections; i++) {
+        if (static_key_sections[i].start == start) {
+            return true;
+        }
+    }
+    if (num_static_key_sections == STATIC_KEY_MAX_SECTIONS) {
+        return false;
+    }
+    static_key_sections[num_static_key_sections].start = start;
+    static_key_sections[num_static_key_sections].stop = stop;
+    num_static_key_sections++;
+    return true;
+}
+
+void
+jbpf_static_key_init(struct jbpf_hook** hooks, int num_hooks)
+{
+    struct sigaction sa;
+
+    if (__atomic_load_n(&jbpf_static_keys_active, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    for (int i = 0; i < num_hooks; i++) {
+        if (hooks[i]->static_keys_start && hooks[i]->static_keys_start < hooks[i]->static_keys_stop &&
+            !add_section(hooks[i]->static_keys_start, hooks[i]->static_keys_stop)) {
+            jbpf_logger(JBPF_WARN, "Too many binaries with hook call sites, the call sites are not patched\n");
+            return;
+        }
+    }
+
+    // The call sites of each binary must be writable, which W^X policies (e.g. SELinux execmod) may forbid
+    for (int i = 0; i < num_static_key_sections; i++) {
+        if (set_site_protection(static_key_sections[i].start, PROT_READ | PROT_WRITE | PROT_EXEC) < 0) {
+            jbpf_logger(JBPF_WARN, "Hook call sites cannot be made writable, the call sites are not patched\n");
+            return;
+        }
+        set_site_protection(static_key_sections[i].start, PROT_READ | PROT_EXEC);
+    }
+
+    if (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE, 0) < 0) {
+        jbpf_logger(JBPF_WARN, "Cores cannot be synchronized with membarrier, the call sites are not patched\n");
+        return;
+    }
+
+    if (!static_key_sigtrap_installed) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = static_key_sigtrap;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGTRAP, &sa, &static_key_old_sigtrap) < 0) {
+            jbpf_logger(JBPF_WARN, "Failed to install the SIGTRAP handler, the call sites are not patched\n");
+            return;
+        }
+        static_key_sigtrap_installed = true;
+    }
+
+    __atomic_store_n(&jbpf_static_keys_active, true, __ATOMIC_RELEASE);
+}
+
+bool
+jbpf_static_key_active(void)
+{
+    return __atomic_load_n(&jbpf_static_keys_active, __ATOMIC_ACQUIRE);
+}
+
+static int
+update_sites(const struct jbpf_hook* hook, bool enable)
+{
+    struct jbpf_static_key_entry* entry;
+
+    if (!hook->static_keys_start || !jbpf_static_key_active()) {
+        return 0;
+    }
+
+    for (entry = hook->static_keys_start; entry < hook->static_keys_stop; entry++) {
+        if (entry->hook != hook) {
+            continue;
+        }
+        if (patch_site(entry, enable) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int
+jbpf_static_key_enable(struct jbpf_hook* hook)
+{
+    return update_sites(hook, true);
+}
+
+int
+jbpf_static_key_disable(struct jbpf_hook* hook)
+{
+    return update_sites(hook, false);
+}
+
+bool
+jbpf_static_key_enabled(const struct jbpf_hook* hook)
+{
+    struct jbpf_static_key_entry* entry;
+
+    if (!jbpf_static_key_active()) {
+        return true;
+    }
+    if (!hook->static_keys_start) {
+        return false;
+    }
+
+    for (entry = hook->static_keys_start; entry < hook->static_keys_stop; entry++) {
+        if (entry->hook == hook && *(const uint8_t*)(uintptr_t)entry->code == STATIC_KEY_JMP_OPCODE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#else
+
+void
+jbpf_static_key_init(struct jbpf_hook** hooks, int num_hooks)
+{
+}
+
+bool
+jbpf_static_key_active(void)
+{
+    return false;
+}
+
+int
+jbpf_static_key_enable(struct jbpf_hook* hook)
+{
+    return 0;
+}
+
+int
+jbpf_static_key_disable(struct jbpf_hook* hook)
+{
+    return 0;
+}
+
+bool
+jbpf_static_key_enabled(const struct jbpf_hook* hook)
+{
+    return true;
+}
+
+#endif
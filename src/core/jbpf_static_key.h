@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_STATIC_KEY_H
+#define JBPF_STATIC_KEY_H
+
+#include <stdbool.h>
+
+#include "jbpf_hook_defs.h"
+
+/**
+ * @brief Check once whether the hook call sites can be patched, and if so enable the patching
+ * @param hooks The hooks
+ * @param num_hooks The number of hooks
+ * @note The call sites of every binary must be writable, and the cores must be synchronizable with membarrier. If
+ * they are not, e.g. under a W^X policy, a warning is logged and the call sites are left as NOPs that fall through to
+ * the hook body, which checks the codelets of the hook. Nothing is done if jbpf is built without
+ * USE_JBPF_STATIC_KEYS.
+ * @ingroup core
+ */
+void
+jbpf_static_key_init(struct jbpf_hook** hooks, int num_hooks);
+
+/**
+ * @brief Check whether the hook call sites are patched as codelets are added to and removed from the hooks
+ * @return true if jbpf_static_key_init() enabled the patching. Always false without USE_JBPF_STATIC_KEYS.
+ * @ingroup core
+ */
+bool
+jbpf_static_key_active(void);
+
+/**
+ * @brief Patch all the call sites of a hook to jump into the hook body
+ * @param hook The hook
+ * @return 0 on success, -1 if a call site could not be patched
+ * @note The call sites that were already patched are left enabled on failure. Must be called with the hook lock
+ * held. Nothing is done if the call sites are not patched (see jbpf_static_key_active()).
+ * @ingroup core
+ */
+int
+jbpf_static_key_enable(struct jbpf_hook* hook);
+
+/**
+ * @brief Patch all the call sites of a hook back into a NOP that skips the hook
+ * @param hook The hook
+ * @return 0 on success, -1 if a call site could not be patched
+ * @note Must be called with the hook lock held. Nothing is done if the call sites are not patched (see
+ * jbpf_static_key_active()).
+ * @ingroup core
+ */
+int
+jbpf_static_key_disable(struct jbpf_hook* hook);
+
+/**
+ * @brief Check whether the call sites of a hook jump into the hook body
+ * @param hook The hook
+ * @return true if at least one call site of the hook is enabled. Always true if the call sites are not patched.
+ * @ingroup core
+ */
+bool
+jbpf_static_key_enabled(const struct jbpf_hook* hook);
+
+#endif
@@ -0,0 +1,459 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jbpf_trace.h"
+#include "jbpf_int.h"
+#include "jbpf_perf.h"
+#include "jbpf_memory.h"
+#include "jbpf_logging.h"
+
+struct jbpf_trace_ring jbpf_trace_rings[JBPF_MAX_NUM_REG_THREADS];
+
+#ifdef JBPF_TRACE
+
+/* Maximum number of codelet ids. The ids of the unloaded codelets are reused, the oldest released first */
+#define JBPF_TRACE_MAX_CODELETS (1024)
+#define JBPF_TRACE_MAX_RING_SIZE (1U << 24)
+
+/* A codelet an id was assigned to, from start_time on */
+struct jbpf_trace_codelet_gen
+{
+    uint64_t start_time;
+    uint16_t hook_id;
+    char name[JBPF_PERF_CODELET_NAME_LEN];
+};
+
+/* The codelet of an id, and the codelet it had before, whose records may still be in the rings */
+struct jbpf_trace_codelet
+{
+    struct jbpf_trace_codelet_gen cur;
+    struct jbpf_trace_codelet_gen prev;
+    bool has_prev;
+    bool in_use;
+};
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t trace_ring_size = 0;
+/* Codelet names, indexed by codelet id. Id JBPF_TRACE_UNKNOWN_CODELET is not assigned */
+static struct jbpf_trace_codelet* trace_codelets = NULL;
+static uint32_t num_trace_codelets = 0;
+/* Released ids, in the order they were released */
+static uint16_t* trace_free_ids = NULL;
+static uint32_t trace_free_head = 0;
+static uint32_t trace_free_tail = 0;
+
+static int trace_dump_signal = 0;
+static struct sigaction trace_old_sigaction;
+static char trace_dump_dir[JBPF_RUN_PATH_LEN];
+static volatile sig_atomic_t trace_dump_requested = 0;
+static uint32_t num_trace_dumps = 0;
+
+static void
+trace_signal_handler(int signum)
+{
+    /* The dump is written by the maintenance thread, as it is not async-signal-safe */
+    trace_dump_requested = 1;
+}
+
+int
+jbpf_trace_init(const struct jbpf_agent_trace_config* config)
+{
+    struct sigaction sa;
+
+    if (config->ring_size == 0 || config->ring_size > JBPF_TRACE_MAX_RING_SIZE) {
+        jbpf_logger(
+            JBPF_ERROR, "The flight recorder ring size must be between 1 and %u\n", JBPF_TRACE_MAX_RING_SIZE);
+        return -1;
+    }
+
+    trace_codelets = jbpf_calloc_mem(JBPF_TRACE_MAX_CODELETS, sizeof(struct jbpf_trace_codelet));
+    trace_free_ids = jbpf_calloc_mem(JBPF_TRACE_MAX_CODELETS, sizeof(uint16_t));
+    if (!trace_codelets || !trace_free_ids) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate the flight recorder codelet names\n");
+        jbpf_free_mem(trace_codelets);
+        jbpf_free_mem(trace_free_ids);
+        trace_codelets = NULL;
+        trace_free_ids = NULL;
+        return -1;
+    }
+    num_trace_codelets = JBPF_TRACE_UNKNOWN_CODELET + 1;
+    trace_free_head = 0;
+    trace_free_tail = 0;
+    trace_ring_size = round_up_pow_of_two(config->ring_size);
+
+    strncpy(trace_dump_dir, config->dump_dir, JBPF_RUN_PATH_LEN - 1);
+    trace_dump_dir[JBPF_RUN_PATH_LEN - 1] = '\0';
+    trace_dump_requested = 0;
+    trace_dump_signal = 0;
+    if (config->dump_signal > 0) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = trace_signal_handler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(config->dump_signal, &sa, &trace_old_sigaction) != 0) {
+            jbpf_logger(JBPF_ERROR, "Failed to set the flight recorder dump signal %d\n", config->dump_signal);
+            jbpf_free_mem(trace_codelets);
+            jbpf_free_mem(trace_free_ids);
+            trace_codelets = NULL;
+            trace_free_ids = NULL;
+            return -1;
+        }
+        trace_dump_signal = config->dump_signal;
+    }
+
+    jbpf_logger(
+        JBPF_INFO,
+        "Flight recorder: %u records per thread, dump signal %d\n",
+        trace_ring_size,
+        trace_dump_signal);
+    return 0;
+}
+
+void
+jbpf_trace_stop(void)
+{
+    if (trace_dump_signal > 0) {
+        sigaction(trace_dump_signal, &trace_old_sigaction, NULL);
+        trace_dump_signal = 0;
+    }
+
+    pthread_mutex_lock(&trace_mutex);
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        jbpf_free_mem(jbpf_trace_rings[i].records);
+        memset(&jbpf_trace_rings[i], 0, sizeof(jbpf_trace_rings[i]));
+    }
+    jbpf_free_mem(trace_codelets);
+    jbpf_free_mem(trace_free_ids);
+    trace_codelets = NULL;
+    trace_free_ids = NULL;
+    num_trace_codelets = 0;
+    trace_free_head = 0;
+    trace_free_tail = 0;
+    trace_ring_size = 0;
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void
+jbpf_trace_register_thread(int thread_id)
+{
+    struct jbpf_trace_ring* ring;
+    struct jbpf_trace_record* records;
+
+    if (trace_ring_size == 0 || thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS) {
+        return;
+    }
+
+    /* The ring of a thread id is kept when the thread is cleaned up, and reused by the next thread with this id */
+    ring = &jbpf_trace_rings[thread_id];
+    if (ring->records) {
+        return;
+    }
+
+    records = jbpf_calloc_mem(trace_ring_size, sizeof(struct jbpf_trace_record));
+    if (!records) {
+        jbpf_logger(JBPF_ERROR, "Failed to allocate the flight recorder ring of thread %d\n", thread_id);
+        return;
+    }
+    pthread_mutex_lock(&trace_mutex);
+    ring->head = 0;
+    ring->mask = trace_ring_size - 1;
+    __atomic_store_n(&ring->records, records, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+uint16_t
+jbpf_trace_codelet_id(const struct jbpf_hook* hook, const char* codelet_name)
+{
+    uint16_t id = JBPF_TRACE_UNKNOWN_CODELET;
+    struct jbpf_trace_codelet* codelet;
+
+    pthread_mutex_lock(&trace_mutex);
+    if (!trace_codelets) {
+        pthread_mutex_unlock(&trace_mutex);
+        return id;
+    }
+
+    /* New ids are used first, so that a released id stays with its codelet for as long as possible */
+    if (num_trace_codelets < JBPF_TRACE_MAX_CODELETS) {
+        id = num_trace_codelets++;
+    } else if (trace_free_head != trace_free_tail) {
+        id = trace_free_ids[trace_free_head++ % JBPF_TRACE_MAX_CODELETS];
+    }
+
+    if (id != JBPF_TRACE_UNKNOWN_CODELET) {
+        codelet = &trace_codelets[id];
+        /* The records of the previous codelet of the id are told apart by their start time */
+        if (codelet->cur.name[0] != '\0') {
+            codelet->prev = codelet->cur;
+            codelet->has_prev = true;
+        }
+        codelet->in_use = true;
+        codelet->cur.start_time = jbpf_measure_start_time();
+        codelet->cur.hook_id = hook->id;
+        if (codelet_name) {
+            strncpy(codelet->cur.name, codelet_name, JBPF_PERF_CODELET_NAME_LEN - 1);
+            codelet->cur.name[JBPF_PERF_CODELET_NAME_LEN - 1] = '\0';
+        } else {
+            snprintf(codelet->cur.name, JBPF_PERF_CODELET_NAME_LEN, "codelet%u", id);
+        }
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    return id;
+}
+
+void
+jbpf_trace_codelet_release(uint16_t id)
+{
+    pthread_mutex_lock(&trace_mutex);
+    if (trace_codelets && id != JBPF_TRACE_UNKNOWN_CODELET && id < num_trace_codelets &&
+        trace_codelets[id].in_use) {
+        /* The name is kept, as the rings may still hold records of the codelet */
+        trace_codelets[id].in_use = false;
+        trace_free_ids[trace_free_tail++ % JBPF_TRACE_MAX_CODELETS] = id;
+    }
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+static void
+trace_write_name(FILE* f, uint16_t id, uint16_t hook_id, uint64_t start_time, const char* name)
+{
+    struct jbpf_trace_file_name file_name = {0};
+
+    file_name.id = id;
+    file_name.hook_id = hook_id;
+    file_name.start_time = start_time;
+    file_name.name_len = strlen(name);
+    fwrite(&file_name, sizeof(file_name), 1, f);
+    fwrite(name, file_name.name_len, 1, f);
+}
+
+/* Copy the records of a ring, from the oldest to the newest, while its thread keeps writing to it. Returns the
+ * number of records copied to buf */
+static uint32_t
+trace_copy_ring(const struct jbpf_trace_ring* ring, struct jbpf_trace_record* buf)
+{
+    uint64_t size = ring->mask + 1;
+    uint64_t head, first, valid, new_head;
+    uint32_t num = 0;
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    first = head > size ? head - size : 0;
+    for (uint64_t i = first; i < head; i++) {
+        buf[num++] = ring->records[i & ring->mask];
+    }
+
+    /* The records the thread wrote to since the copy started may be torn, including the one it may be writing */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    new_head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    valid = new_head + 1 > size ? new_head + 1 - size : 0;
+    if (valid <= first) {
+        return num;
+    }
+    if (valid >= head) {
+        return 0;
+    }
+    memmove(buf, &buf[valid - first], (head - valid) * sizeof(struct jbpf_trace_record));
+    return head - valid;
+}
+
+int
+jbpf_trace_dump(const char* path)
+{
+    struct jbpf_trace_file_header header = {0};
+    struct jbpf_trace_file_thread thread = {0};
+    struct jbpf_trace_record* buf;
+    struct timespec ts;
+    FILE* f;
+    int res = 0;
+
+    if (!path) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&trace_mutex);
+
+    if (!trace_codelets) {
+        jbpf_logger(JBPF_ERROR, "The flight recorder is not running\n");
+        pthread_mutex_unlock(&trace_mutex);
+        return -1;
+    }
+
+    buf = malloc(trace_ring_size * sizeof(struct jbpf_trace_record));
+    f = fopen(path, "wb");
+    if (!buf || !f) {
+        jbpf_logger(JBPF_ERROR, "Failed to dump the flight recorder to %s\n", path);
+        res = -1;
+        goto out;
+    }
+
+    header.magic = JBPF_TRACE_FILE_MAGIC;
+    header.version = JBPF_TRACE_FILE_VERSION;
+    header.record_size = sizeof(struct jbpf_trace_record);
+#ifdef JBPF_PERF_OPT
+    header.tick_freq = __atomic_load_n(&g_jbpf_tick_freq, __ATOMIC_RELAXED);
+#else
+    header.tick_freq = 1000000000ULL;
+#endif
+    header.ref_ticks = jbpf_measure_start_time();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.ref_realtime_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    header.num_hooks = jbpf_hook_list.num_hooks;
+    for (uint32_t i = JBPF_TRACE_UNKNOWN_CODELET + 1; i < num_trace_codelets; i++) {
+        header.num_codelets += trace_codelets[i].has_prev ? 2 : 1;
+    }
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        if (jbpf_trace_rings[i].records) {
+            header.num_threads++;
+        }
+    }
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (int i = 0; i < jbpf_hook_list.num_hooks; i++) {
+        trace_write_name(f, i, i, 0, jbpf_hook_list.jbpf_hook_p[i]->name);
+    }
+    /* The previous codelet of an id is written before the current one */
+    for (uint32_t i = JBPF_TRACE_UNKNOWN_CODELET + 1; i < num_trace_codelets; i++) {
+        const struct jbpf_trace_codelet* codelet = &trace_codelets[i];
+
+        if (codelet->has_prev) {
+            trace_write_name(f, i, codelet->prev.hook_id, codelet->prev.start_time, codelet->prev.name);
+        }
+        trace_write_name(f, i, codelet->cur.hook_id, codelet->cur.start_time, codelet->cur.name);
+    }
+
+    for (int i = 0; i < JBPF_MAX_NUM_REG_THREADS; i++) {
+        if (!jbpf_trace_rings[i].records) {
+            continue;
+        }
+        thread.thread_id = i;
+        thread.num_records = trace_copy_ring(&jbpf_trace_rings[i], buf);
+        fwrite(&thread, sizeof(thread), 1, f);
+        fwrite(buf, sizeof(struct jbpf_trace_record), thread.num_records, f);
+    }
+
+    if (ferror(f)) {
+        jbpf_logger(JBPF_ERROR, "Failed to write the flight recorder dump %s\n", path);
+        res = -1;
+    }
+
+out:
+    if (f) {
+        fclose(f);
+    }
+    free(buf);
+    pthread_mutex_unlock(&trace_mutex);
+    return res;
+}
+
+/* A requested dump file must stay in the dump directory, so its name cannot be absolute or contain ".." */
+static bool
+trace_dump_name_valid(const char* name)
+{
+    const char* c = name;
+
+    if (name[0] == '\0' || name[0] == '/') {
+        return false;
+    }
+    while (*c) {
+        if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0')) {
+            return false;
+        }
+        c = strchr(c, '/');
+        if (!c) {
+            break;
+        }
+        c++;
+    }
+    return true;
+}
+
+int
+jbpf_trace_dump_request(const char* name)
+{
+    char path[JBPF_RUN_PATH_LEN + JBPF_PATH_LEN];
+
+    if (!name || !trace_dump_name_valid(name)) {
+        jbpf_logger(JBPF_ERROR, "Invalid flight recorder dump name %s\n", name ? name : "(null)");
+        return -1;
+    }
+    if (snprintf(path, sizeof(path), "%s/%s", trace_dump_dir, name) >= (int)sizeof(path)) {
+        jbpf_logger(JBPF_ERROR, "The flight recorder dump name %s is too long\n", name);
+        return -1;
+    }
+    return jbpf_trace_dump(path);
+}
+
+void
+jbpf_trace_maintenance(void)
+{
+    char path[JBPF_RUN_PATH_LEN + 64];
+
+    if (JBPF_LIKELY(!trace_dump_requested)) {
+        return;
+    }
+    trace_dump_requested = 0;
+
+    snprintf(path, sizeof(path), "%s/jbpf_trace-%d-%u.bin", trace_dump_dir, getpid(), num_trace_dumps++);
+    if (jbpf_trace_dump(path) == 0) {
+        jbpf_logger(JBPF_INFO, "Dumped the flight recorder to %s\n", path);
+    }
+}
+
+#else
+
+int
+jbpf_trace_init(const struct jbpf_agent_trace_config* config)
+{
+    return 0;
+}
+
+void
+jbpf_trace_stop(void)
+{
+}
+
+void
+jbpf_trace_register_thread(int thread_id)
+{
+}
+
+uint16_t
+jbpf_trace_codelet_id(const struct jbpf_hook* hook, const char* codelet_name)
+{
+    return JBPF_TRACE_UNKNOWN_CODELET;
+}
+
+void
+jbpf_trace_codelet_release(uint16_t id)
+{
+}
+
+int
+jbpf_trace_dump(const char* path)
+{
+    jbpf_logger(JBPF_ERROR, "jbpf is built without USE_JBPF_TRACE\n");
+    return -1;
+}
+
+int
+jbpf_trace_dump_request(const char* name)
+{
+    jbpf_logger(JBPF_ERROR, "jbpf is built without USE_JBPF_TRACE\n");
+    return -1;
+}
+
+void
+jbpf_trace_maintenance(void)
+{
+}
+
+#endif
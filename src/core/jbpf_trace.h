@@ -0,0 +1,138 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_TRACE_H
+#define JBPF_TRACE_H
+
+#include <stdint.h>
+
+#include "jbpf_config.h"
+#include "jbpf_hook_defs.h"
+#include "jbpf_device_defs.h"
+#include "jbpf_trace_ext.h"
+#include "jbpf_utils.h"
+#include "jbpf.h"
+
+/* Flight recorder ring of a registered thread. Only the thread writes to its ring, and the records are overwritten
+ * once the ring is full, so the ring always holds the latest invocations of the thread */
+struct jbpf_trace_ring
+{
+    uint64_t head;
+    uint64_t mask;
+    struct jbpf_trace_record* records;
+} __attribute__((aligned(64)));
+
+extern struct jbpf_trace_ring jbpf_trace_rings[JBPF_MAX_NUM_REG_THREADS];
+
+/**
+ * @brief Start the flight recorder
+ * @param config The flight recorder configuration
+ * @return 0 on success, -1 otherwise
+ * @note Nothing is done if jbpf is built without USE_JBPF_TRACE
+ * @ingroup core
+ */
+int
+jbpf_trace_init(const struct jbpf_agent_trace_config* config);
+
+/**
+ * @brief Stop the flight recorder and release the rings
+ * @ingroup core
+ */
+void
+jbpf_trace_stop(void);
+
+/**
+ * @brief Allocate the flight recorder ring of the calling thread, if it does not have one yet
+ * @param thread_id The id of the calling registered thread
+ * @ingroup core
+ */
+void
+jbpf_trace_register_thread(int thread_id);
+
+/**
+ * @brief Assign an id to a codelet loaded to a hook, to be recorded with its invocations
+ * @param hook The hook
+ * @param codelet_name The name of the codelet. May be NULL
+ * @return The id of the codelet, or JBPF_TRACE_UNKNOWN_CODELET if all the ids are used
+ * @note The id may have been released by an unloaded codelet. The dump keeps the name of that codelet for its records
+ * made before the id was assigned again
+ * @ingroup core
+ */
+uint16_t
+jbpf_trace_codelet_id(const struct jbpf_hook* hook, const char* codelet_name);
+
+/**
+ * @brief Release the id of an unloaded codelet, so that it can be assigned to another codelet
+ * @param id The id returned by jbpf_trace_codelet_id()
+ * @ingroup core
+ */
+void
+jbpf_trace_codelet_release(uint16_t id);
+
+/**
+ * @brief Dump the rings to a file of the dump directory, on a request received over the LCM socket
+ * @param name The name of the file, relative to the dump directory. Absolute names and ".." components are rejected
+ * @return 0 if the dump was written, -1 otherwise
+ * @ingroup core
+ */
+int
+jbpf_trace_dump_request(const char* name);
+
+/**
+ * @brief Dump the rings if a dump was requested with the dump signal. Called by the maintenance thread
+ * @ingroup core
+ */
+void
+jbpf_trace_maintenance(void);
+
+/* Record the invocation of the codelet pointed to by hook_codelet_ptr */
+#ifdef JBPF_TRACE
+#define JBPF_TRACE_CODELET(hook, start_time, end_time, res) \
+    _jbpf_trace_log(hook, hook_codelet_ptr, start_time, end_time, res);
+#else
+#define JBPF_TRACE_CODELET(hook, start_time, end_time, res)
+#endif
+
+#pragma once
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    __attribute__((always_inline)) static void inline _jbpf_trace_log(
+        const struct jbpf_hook* hook,
+        const struct jbpf_hook_codelet* codelet,
+        uint64_t start_time,
+        uint64_t end_time,
+        uint64_t res)
+    {
+        int thread_id = get_jbpf_hook_thread_id();
+        struct jbpf_trace_ring* ring;
+        struct jbpf_trace_record* record;
+        uint64_t head, duration;
+
+        if (JBPF_UNLIKELY(thread_id < 0 || thread_id >= JBPF_MAX_NUM_REG_THREADS))
+            return;
+
+        ring = &jbpf_trace_rings[thread_id];
+        if (JBPF_UNLIKELY(!ring->records))
+            return;
+
+        head = ring->head;
+        duration = end_time - start_time;
+        record = &ring->records[head & ring->mask];
+        record->start_time = start_time;
+        record->ret = res;
+        record->duration = duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration;
+        record->hook_id = hook->id;
+        record->codelet_id = codelet->trace_id;
+
+        /* The dump only reads the records before head */
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+
+#pragma once
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JBPF_TRACE_H */
@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+#ifndef JBPF_TRACE_EXT_H
+#define JBPF_TRACE_EXT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Magic number of a trace dump file ("JBTR")
+ * @ingroup core
+ */
+#define JBPF_TRACE_FILE_MAGIC (0x5254424AU)
+
+/**
+ * @brief Version of the trace dump file format
+ * @ingroup core
+ */
+#define JBPF_TRACE_FILE_VERSION (2)
+
+/**
+ * @brief Codelet id of the codelets loaded while all the codelet ids were in use
+ * @ingroup core
+ */
+#define JBPF_TRACE_UNKNOWN_CODELET (0)
+
+/**
+ * @brief A codelet invocation recorded by the flight recorder
+ * @param start_time The time the codelet was called, in ticks
+ * @param ret The return value of the codelet
+ * @param duration The runtime of the codelet in ticks, saturated at UINT32_MAX
+ * @param hook_id The id of the hook, as listed in the dump file
+ * @param codelet_id The id of the codelet, as listed in the dump file
+ * @ingroup core
+ */
+struct jbpf_trace_record
+{
+    uint64_t start_time;
+    uint64_t ret;
+    uint32_t duration;
+    uint16_t hook_id;
+    uint16_t codelet_id;
+};
+
+/**
+ * @brief Header of a trace dump file, in the byte order of the agent
+ * @param magic JBPF_TRACE_FILE_MAGIC
+ * @param version JBPF_TRACE_FILE_VERSION
+ * @param record_size Size of struct jbpf_trace_record
+ * @param tick_freq Number of ticks per second
+ * @param ref_ticks Time of the dump in ticks
+ * @param ref_realtime_ns Time of the dump in ns since the epoch, to convert the times of the records
+ * @param num_hooks Number of hook names following the header
+ * @param num_codelets Number of codelet names following the hook names. An id reused after its codelet was unloaded
+ * has the name of its previous codelet followed by the name of its current codelet
+ * @param num_threads Number of threads following the codelet names. Each thread is a struct jbpf_trace_file_thread
+ * followed by its records, from the oldest to the newest
+ * @ingroup core
+ */
+struct jbpf_trace_file_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint64_t tick_freq;
+    uint64_t ref_ticks;
+    uint64_t ref_realtime_ns;
+    uint32_t num_hooks;
+    uint32_t num_codelets;
+    uint32_t num_threads;
+    uint32_t reserved;
+};
+
+/**
+ * @brief Name of a hook or a codelet in a trace dump file, followed by name_len characters without a terminating null
+ * @param id The id of the hook or the codelet
+ * @param hook_id The id of the hook of the codelet. Same as id for hooks
+ * @param name_len Length of the name
+ * @param start_time Time in ticks the id was assigned to the codelet. The records of the id made before belong to the
+ * previous name of the id. Always 0 for hooks
+ * @ingroup core
+ */
+struct jbpf_trace_file_name
+{
+    uint16_t id;
+    uint16_t hook_id;
+    uint16_t name_len;
+    uint16_t reserved;
+    uint64_t start_time;
+};
+
+/**
+ * @brief Records of a thread in a trace dump file, followed by num_records struct jbpf_trace_record
+ * @param thread_id The jbpf thread id
+ * @param num_records Number of records of the thread
+ * @ingroup core
+ */
+struct jbpf_trace_file_thread
+{
+    uint32_t thread_id;
+    uint32_t num_records;
+};
+
+#endif /* JBPF_TRACE_EXT_H */
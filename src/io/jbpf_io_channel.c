@@ -13,6 +13,7 @@
 
 #include "jbpf_io_channel.h"
 #include "jbpf_io_queue.h"
+#include "jbpf_io_ringbuf.h"
 #include "jbpf_io_utils.h"
 #include "jbpf_io_int.h"
 #include "jbpf_io_thread_mgmt.h"
@@ -89,9 +90,12 @@ io_channel_destructor(ck_epoch_entry_t* p)
         _jbpf_io_close_mem_fd(io_channel->primary_serde.lib_fd, io_channel->primary_serde.name);
     }
 
-    if (io_channel->type == JBPF_IO_CHANNEL_QUEUE || io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+    if (io_channel->type == JBPF_IO_CHANNEL_QUEUE) {
         jbpf_logger(JBPF_INFO, "Releasing queue\n");
         jbpf_io_queue_free(io_channel->channel_ptr);
+    } else if (io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_logger(JBPF_INFO, "Releasing ring buffer\n");
+        jbpf_io_ringbuf_free(io_channel->channel_ptr);
     }
     jbpf_free(io_channel);
 }
@@ -339,8 +343,20 @@ _jbpf_io_create_channel(
     io_channel->stream_id = chan_req->stream_id;
     io_channel->priority = LOW_IO_CHANNEL_PRIORITY;
 
-    if ((is_output && (chan_req->type == JBPF_IO_CHANNEL_QUEUE || chan_req->type == JBPF_IO_CHANNEL_RINGBUF)) ||
-        (!is_output && chan_req->type == JBPF_IO_CHANNEL_QUEUE)) {
+    if (is_output && chan_req->type == JBPF_IO_CHANNEL_RINGBUF) {
+
+        // The ring holds as many bytes as num_elems records of elem_size bytes, and more of the smaller records
+        elem_size = chan_req->elem_size + sizeof(jbpf_io_channel_elem_t);
+        io_channel->elem_size = chan_req->elem_size;
+        io_channel->channel_ptr = jbpf_io_ringbuf_create(
+            (uint32_t)chan_req->num_elems * JBPF_IO_RINGBUF_RECORD_SIZE(elem_size), elem_size, mem_ctx);
+
+        io_channel->type = JBPF_IO_CHANNEL_RINGBUF;
+        if (!io_channel->channel_ptr) {
+            jbpf_logger(JBPF_ERROR, "Error jbpf_io_ringbuf_create ring buffer for channel %s\n", name_lib);
+            goto free_io_channel;
+        }
+    } else if (chan_req->type == JBPF_IO_CHANNEL_QUEUE) {
 
         elem_size = chan_req->elem_size + sizeof(jbpf_io_channel_elem_t);
         io_channel->elem_size = chan_req->elem_size;
@@ -397,7 +413,11 @@ _jbpf_io_create_channel(
     return io_channel;
 
 mem_error:
-    jbpf_io_queue_free(io_channel->channel_ptr);
+    if (io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_io_ringbuf_free(io_channel->channel_ptr);
+    } else {
+        jbpf_io_queue_free(io_channel->channel_ptr);
+    }
 free_io_channel:
     jbpf_free(io_channel);
 error_exit:
@@ -557,7 +577,7 @@ jbpf_io_channel_pack_msg(struct jbpf_io_ctx* io_ctx, jbpf_channel_buf_ptr data,
 
     ser_buf_size = buf_len - msg_size;
 
-    bytes_written = serde->serialize(data, io_channel->elem_size, (char*)buf + msg_size, ser_buf_size);
+    bytes_written = serde->serialize(data, jbpf_io_channel_buf_size(data), (char*)buf + msg_size, ser_buf_size);
 
     if (bytes_written > 0) {
         msg_size += bytes_written;
@@ -659,6 +679,7 @@ jbpf_io_channel_send_data(struct jbpf_io_channel* channel, void* data, size_t si
 {
 
     int elem_size;
+    jbpf_io_channel_elem_t* elem;
     if (!channel || !data)
         return -1;
 
@@ -680,8 +701,20 @@ jbpf_io_channel_send_data(struct jbpf_io_channel* channel, void* data, size_t si
         return jbpf_io_channel_submit_buf(channel);
 
     } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
-        // TODO
-        return -1;
+        if (size == 0 || size > channel->elem_size) {
+            jbpf_logger(
+                JBPF_ERROR, "Error. Data size %d is invalid for the element size %d\n", size, channel->elem_size);
+            return -1;
+        }
+
+        // The record only takes the size of the data
+        elem = jbpf_io_ringbuf_reserve(channel->channel_ptr, size + sizeof(jbpf_io_channel_elem_t));
+        if (!elem) {
+            return -1;
+        }
+        elem->io_channel = channel;
+        memcpy(elem->data, data, size);
+        return jbpf_io_ringbuf_commit(channel->channel_ptr, elem, size + sizeof(jbpf_io_channel_elem_t));
     }
 
     return -1;
@@ -723,39 +756,70 @@ jbpf_channel_buf_ptr
 jbpf_io_channel_reserve_buf(struct jbpf_io_channel* channel)
 {
     jbpf_io_channel_elem_t* elem;
-    if (!channel || channel->type == JBPF_IO_CHANNEL_RINGBUF)
+    if (!channel)
         return NULL;
 
     if (channel->type == JBPF_IO_CHANNEL_QUEUE) {
         elem = jbpf_io_queue_reserve(channel->channel_ptr);
-        if (!elem) {
-            return NULL;
-        } else {
-            elem->io_channel = channel;
-            return elem->data;
-        }
+    } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        elem = jbpf_io_ringbuf_reserve_thread(channel->channel_ptr);
+    } else {
+        return NULL;
     }
 
-    return NULL;
+    if (!elem) {
+        return NULL;
+    } else {
+        elem->io_channel = channel;
+        return elem->data;
+    }
 }
 
 int
 jbpf_io_channel_submit_buf(struct jbpf_io_channel* channel)
 {
-    if (!channel || channel->type == JBPF_IO_CHANNEL_RINGBUF)
+    if (!channel)
+        return -1;
+
+    return jbpf_io_channel_submit_buf_size(channel, channel->elem_size);
+}
+
+int
+jbpf_io_channel_submit_buf_size(struct jbpf_io_channel* channel, size_t size)
+{
+    if (!channel || size == 0 || size > channel->elem_size)
         return -1;
 
     if (channel->type == JBPF_IO_CHANNEL_QUEUE) {
         return jbpf_io_queue_enqueue(channel->channel_ptr);
+    } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        return jbpf_io_ringbuf_submit_thread(channel->channel_ptr, size + sizeof(jbpf_io_channel_elem_t));
     }
 
     return -1;
 }
 
+void
+jbpf_io_channel_discard_buf(struct jbpf_io_channel* channel)
+{
+    if (!channel)
+        return;
+
+    if (channel->type == JBPF_IO_CHANNEL_QUEUE) {
+        jbpf_io_queue_discard(channel->channel_ptr);
+    } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_io_ringbuf_discard_thread(channel->channel_ptr);
+    }
+}
+
 void
 jbpf_io_channel_release_all_buf(struct jbpf_io_channel* channel)
 {
-    jbpf_io_queue_release_all(channel->channel_ptr);
+    if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_io_ringbuf_release_all(channel->channel_ptr);
+    } else {
+        jbpf_io_queue_release_all(channel->channel_ptr);
+    }
 }
 
 void
@@ -764,7 +828,29 @@ jbpf_io_channel_release_buf(jbpf_channel_buf_ptr buf_ptr)
     jbpf_io_channel_elem_t* elem;
     elem = container_of(buf_ptr, jbpf_io_channel_elem_t, data);
 
-    jbpf_io_queue_release(elem, false);
+    if (elem->io_channel && elem->io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_io_ringbuf_release(elem->io_channel->channel_ptr, elem);
+    } else {
+        jbpf_io_queue_release(elem, false);
+    }
+}
+
+int
+jbpf_io_channel_buf_size(jbpf_channel_buf_ptr buf_ptr)
+{
+    jbpf_io_channel_elem_t* elem;
+
+    if (!buf_ptr) {
+        return -1;
+    }
+
+    elem = container_of(buf_ptr, jbpf_io_channel_elem_t, data);
+
+    if (elem->io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        return jbpf_io_ringbuf_record_size(elem) - sizeof(jbpf_io_channel_elem_t);
+    }
+
+    return elem->io_channel->elem_size;
 }
 
 int
@@ -789,9 +875,13 @@ jbpf_io_channel_recv_data(struct jbpf_io_channel* channel, jbpf_channel_buf_ptr*
         }
 
     } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
-        // TODO
-        jbpf_logger(JBPF_WARN, "Ring buffer channel type not implemented for recv_data\n");
-        return -1;
+        for (num_collected = 0; num_collected < batch_size; num_collected++) {
+            elem = jbpf_io_ringbuf_consume(channel->channel_ptr);
+            if (!elem) {
+                return num_collected;
+            }
+            data_ptrs[num_collected] = elem->data;
+        }
     }
 
     return num_collected;
@@ -810,6 +900,22 @@ jbpf_io_channel_recv_data_copy(struct jbpf_io_channel* channel, void* buf, size_
         return -1;
     }
 
+    if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        elem = jbpf_io_ringbuf_consume(channel->channel_ptr);
+        if (!elem) {
+            return -1;
+        }
+        data_size = jbpf_io_channel_buf_size(elem->data);
+        if (data_size > buf_size) {
+            jbpf_logger(JBPF_ERROR, "Data size %d is larger than buffer size %zu\n", data_size, buf_size);
+            jbpf_io_ringbuf_release(channel->channel_ptr, elem);
+            return -1;
+        }
+        memcpy(buf, elem->data, data_size);
+        jbpf_io_ringbuf_release(channel->channel_ptr, elem);
+        return 1;
+    }
+
     data_size = channel->elem_size;
     elem = jbpf_io_queue_dequeue(channel->channel_ptr);
 
@@ -838,7 +944,32 @@ jbpf_io_channel_share_data_ptr(jbpf_channel_buf_ptr data_ptr)
     }
 
     elem = container_of(data_ptr, jbpf_io_channel_elem_t, data);
+
+    // A record of a ring buffer is released once, so it cannot be shared
+    if (elem->io_channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        jbpf_logger(JBPF_ERROR, "Buffers of ring buffer channels cannot be shared\n");
+        return NULL;
+    }
+
     jbpf_mbuf_share_data_ptr(elem);
 
     return elem->data;
 }
+
+int
+jbpf_io_channel_get_stats(struct jbpf_io_channel* channel, struct jbpf_io_channel_stats* stats)
+{
+    if (!channel || !stats) {
+        return -1;
+    }
+
+    if (channel->type == JBPF_IO_CHANNEL_QUEUE) {
+        stats->capacity = jbpf_io_queue_get_num_elems(channel->channel_ptr);
+        return jbpf_io_queue_get_stats(channel->channel_ptr, &stats->depth, &stats->num_drops);
+    } else if (channel->type == JBPF_IO_CHANNEL_RINGBUF) {
+        stats->capacity = jbpf_io_ringbuf_get_size(channel->channel_ptr);
+        return jbpf_io_ringbuf_get_stats(channel->channel_ptr, &stats->depth, &stats->num_drops);
+    }
+
+    return -1;
+}
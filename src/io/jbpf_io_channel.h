@@ -92,6 +92,29 @@ extern "C"
     int
     jbpf_io_channel_submit_buf(struct jbpf_io_channel* channel);
 
+    /**
+     * @brief Same as jbpf_io_channel_submit_buf(), but only the first size bytes of the buffer are sent.
+     * For ring buffer channels, the rest of the reserved buffer is given back to the channel, so that small messages
+     * only take the space they need.
+     *
+     * @param channel A pointer to the target jbpf_io_channel.
+     * @param size The number of bytes of the buffer to send. It cannot be larger than the element size of the channel.
+     * @return int 0 if the buffer was submitted or a negative value otherwise.
+     * @ingroup io
+     */
+    int
+    jbpf_io_channel_submit_buf_size(struct jbpf_io_channel* channel, size_t size);
+
+    /**
+     * @brief Gives back a buffer reserved by jbpf_io_channel_reserve_buf() without sending it.
+     * This function has to be called by the same thread that reserved the buffer.
+     *
+     * @param channel A pointer to the target jbpf_io_channel.
+     * @ingroup io
+     */
+    void
+    jbpf_io_channel_discard_buf(struct jbpf_io_channel* channel);
+
     /**
      * @brief Releases a buffer that was reserved by jbpf_io_channel_reserve_buf() and returns
      * it back to the memory pool. This function can be called by any thread and not necessarily from
@@ -105,6 +128,18 @@ extern "C"
     void
     jbpf_io_channel_release_buf(jbpf_channel_buf_ptr buf_ptr);
 
+    /**
+     * @brief Gets the size of the data of a buffer received from a channel. For queue channels, this is the element
+     * size of the channel. For ring buffer channels, this is the size of the message that was sent, which can be
+     * smaller than the element size.
+     *
+     * @param buf_ptr A pointer to the buffer.
+     * @return int The size of the data in bytes, or -1 if the buffer is invalid.
+     * @ingroup io
+     */
+    int
+    jbpf_io_channel_buf_size(jbpf_channel_buf_ptr buf_ptr);
+
     /**
      * @brief Releases all the buffers of a channel that have been reserved with jbpf_io_channel_reserve_buf()
      * by any thread of the process. For IPC communication, if this is an input channel, this can only be called by
@@ -191,14 +226,28 @@ extern "C"
 
     /**
      * @brief Increments the reference counter of a reserved data pointer of a channel.
+     * The buffers of ring buffer channels cannot be shared.
      *
      * @param data_ptr The reserved data pointer.
-     * @return jbpf_channel_buf_ptr A pointer to the same buffer, with the reference count incremented by one.
+     * @return jbpf_channel_buf_ptr A pointer to the same buffer, with the reference count incremented by one, or NULL
+     * if the buffer cannot be shared.
      * @ingroup io
      */
     jbpf_channel_buf_ptr
     jbpf_io_channel_share_data_ptr(jbpf_channel_buf_ptr data_ptr);
 
+    /**
+     * @brief Gets the occupancy of a jbpf_io_channel and the number of buffers dropped because it was full.
+     * Can be called by any thread of the process that created the channel, without blocking the threads that use it.
+     *
+     * @param channel A pointer to the target jbpf_io_channel.
+     * @param stats Will store the stats of the channel.
+     * @return int 0 on success or -1 otherwise.
+     * @ingroup io
+     */
+    int
+    jbpf_io_channel_get_stats(struct jbpf_io_channel* channel, struct jbpf_io_channel_stats* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,6 +65,20 @@ extern "C"
         char descriptor[JBPF_IO_MAX_DESCRIPTOR_SIZE];
     };
 
+    /**
+     * @brief Occupancy and drops of a channel. For ring buffer channels, the depth and the capacity are in bytes
+     * @param depth Number of buffers submitted to the channel and not received yet
+     * @param capacity Maximum number of buffers of the channel
+     * @param num_drops Number of buffers that could not be reserved or submitted because the channel was full
+     * @ingroup io
+     */
+    struct jbpf_io_channel_stats
+    {
+        uint32_t depth;
+        uint32_t capacity;
+        uint64_t num_drops;
+    };
+
     typedef struct jbpf_io_channel jbpf_io_channel_t;
 
     typedef struct jbpf_io_in_channel_list jbpf_in_channel_list;
@@ -138,6 +138,7 @@ jbpf_io_queue_reserve(jbpf_io_queue_ctx_t* ioq_ctx)
     mb = jbpf_mbuf_alloc(ioq_ctx->mempool);
 
     if (!mb) {
+        __atomic_store_n(&ioq_ctx->num_drops[thread_id], ioq_ctx->num_drops[thread_id] + 1, __ATOMIC_RELAXED);
         return NULL;
     }
 
@@ -157,6 +158,19 @@ jbpf_io_queue_release(void* iobuf, bool clean)
     jbpf_mbuf_free_from_data_ptr(iobuf, clean);
 }
 
+void
+jbpf_io_queue_discard(jbpf_io_queue_ctx_t* ioq_ctx)
+{
+    int thread_id = jbpf_io_get_thread_id();
+
+    if (thread_id < 0 || !ioq_ctx || !ioq_ctx->alloc_ptr[thread_id]) {
+        return;
+    }
+
+    jbpf_mbuf_free(ioq_ctx->alloc_ptr[thread_id], false);
+    ioq_ctx->alloc_ptr[thread_id] = NULL;
+}
+
 int
 jbpf_io_queue_enqueue(jbpf_io_queue_ctx_t* ioq_ctx)
 {
@@ -171,16 +185,20 @@ jbpf_io_queue_enqueue(jbpf_io_queue_ctx_t* ioq_ctx)
 
     if (ioq_ctx->type == JBPF_IO_CHANNEL_OUTPUT) {
         if (!ck_ring_enqueue_mpsc(&ioq_ctx->ring, ioq_ctx->ringbuffer, mb->data)) {
-            return -1;
+            goto drop;
         }
     } else {
         if (!ck_ring_enqueue_mpmc(&ioq_ctx->ring, ioq_ctx->ringbuffer, mb->data)) {
-            return -1;
+            goto drop;
         }
     }
 
     ioq_ctx->alloc_ptr[thread_id] = NULL;
     return 0;
+
+drop:
+    __atomic_store_n(&ioq_ctx->num_drops[thread_id], ioq_ctx->num_drops[thread_id] + 1, __ATOMIC_RELAXED);
+    return -1;
 }
 
 void*
@@ -225,3 +243,22 @@ jbpf_io_queue_get_num_elems(jbpf_io_queue_ctx_t* ioq_ctx)
 
     return ioq_ctx->num_elems;
 }
+
+int
+jbpf_io_queue_get_stats(jbpf_io_queue_ctx_t* ioq_ctx, uint32_t* depth, uint64_t* num_drops)
+{
+    if (!ioq_ctx || !depth || !num_drops) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO queue context for getting stats\n");
+        return -1;
+    }
+
+    *depth = ck_ring_size(&ioq_ctx->ring);
+
+    /* Each counter is only incremented by its thread, so they are summed without locking */
+    *num_drops = 0;
+    for (int thread_id = 0; thread_id < JBPF_IO_MAX_NUM_THREADS; thread_id++) {
+        *num_drops += __atomic_load_n(&ioq_ctx->num_drops[thread_id], __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
@@ -22,6 +22,10 @@ jbpf_io_queue_release_all(jbpf_io_queue_ctx_t* ioq_ctx);
 void
 jbpf_io_queue_release(void* iobuf, bool clean);
 
+/* Give back the buffer reserved by the calling thread, without enqueuing it */
+void
+jbpf_io_queue_discard(jbpf_io_queue_ctx_t* ioq_ctx);
+
 int
 jbpf_io_queue_enqueue(jbpf_io_queue_ctx_t* ioq_ctx);
 
@@ -34,4 +38,9 @@ jbpf_io_queue_get_elem_size(jbpf_io_queue_ctx_t* ioq_ctx);
 int
 jbpf_io_queue_get_num_elems(jbpf_io_queue_ctx_t* ioq_ctx);
 
+/* Number of elements enqueued and not yet dequeued, and number of elements dropped by all the threads.
+   Can be called by any thread */
+int
+jbpf_io_queue_get_stats(jbpf_io_queue_ctx_t* ioq_ctx, uint32_t* depth, uint64_t* num_drops);
+
 #endif
\ No newline at end of file
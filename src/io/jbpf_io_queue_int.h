@@ -18,6 +18,8 @@ struct jbpf_io_queue_ctx
     uint32_t elem_size;
     uint32_t num_elems;
     uint32_t ring_size;
+    /* Buffers that could not be reserved or enqueued, counted by the thread that tried */
+    uint64_t num_drops[JBPF_IO_MAX_NUM_THREADS];
 };
 
 #endif // JBPF_IO_QUEUE_INT_H
\ No newline at end of file
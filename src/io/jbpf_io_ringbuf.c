@@ -0,0 +1,384 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+#include <stdio.h>
+
+#include "ck_pr.h"
+
+#include "jbpf_io_ringbuf.h"
+#include "jbpf_io_ringbuf_int.h"
+#include "jbpf_io_thread_mgmt.h"
+#include "jbpf_io_utils.h"
+#include "jbpf_logging.h"
+
+static inline struct jbpf_io_ringbuf_hdr*
+jbpf_io_ringbuf_hdr_at(jbpf_io_ringbuf_ctx_t* rb_ctx, uint64_t pos)
+{
+    return (struct jbpf_io_ringbuf_hdr*)(rb_ctx->data + (pos & rb_ctx->mask));
+}
+
+static inline struct jbpf_io_ringbuf_hdr*
+jbpf_io_ringbuf_hdr_of(const void* record)
+{
+    return (struct jbpf_io_ringbuf_hdr*)record - 1;
+}
+
+static void
+jbpf_io_ringbuf_count_drop(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    int thread_id = jbpf_io_get_thread_id();
+
+    if (thread_id >= 0) {
+        __atomic_store_n(&rb_ctx->num_drops[thread_id], rb_ctx->num_drops[thread_id] + 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Move consumer_pos past the records that were released or discarded, to give their space back to the producers */
+static void
+jbpf_io_ringbuf_advance(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    struct jbpf_io_ringbuf_hdr* hdr;
+    uint64_t pos, end;
+
+    ck_spinlock_lock(&rb_ctx->consumer_lock);
+
+    pos = rb_ctx->consumer_pos;
+    end = ck_pr_load_64(&rb_ctx->read_pos);
+
+    while (pos < end) {
+        hdr = jbpf_io_ringbuf_hdr_at(rb_ctx, pos);
+        if (!(ck_pr_load_32(&hdr->flags) & (JBPF_IO_RINGBUF_CONSUMED | JBPF_IO_RINGBUF_DISCARD))) {
+            break;
+        }
+        pos += JBPF_IO_RINGBUF_RECORD_SIZE(hdr->len);
+    }
+
+    if (pos != rb_ctx->consumer_pos) {
+        /* The records must be read before the producers can overwrite them */
+        ck_pr_fence_release();
+        ck_pr_store_64(&rb_ctx->consumer_pos, pos);
+    }
+
+    ck_spinlock_unlock(&rb_ctx->consumer_lock);
+}
+
+void*
+jbpf_io_ringbuf_create(uint32_t size, uint32_t max_record_size, jbpf_mem_ctx_t* mem_ctx)
+{
+    struct jbpf_io_ringbuf_ctx* rb_ctx;
+
+    if (max_record_size == 0 || size < JBPF_IO_RINGBUF_RECORD_SIZE(max_record_size)) {
+        jbpf_logger(JBPF_ERROR, "Invalid size %u for a ring buffer of records of %u bytes\n", size, max_record_size);
+        return NULL;
+    }
+
+    rb_ctx = jbpf_calloc_ctx(mem_ctx, 1, sizeof(struct jbpf_io_ringbuf_ctx));
+
+    if (!rb_ctx) {
+        jbpf_logger(JBPF_ERROR, "Error allocating memory for IO ring buffer context\n");
+        return NULL;
+    }
+
+    rb_ctx->size = round_up_pow_of_two(size);
+    rb_ctx->mask = rb_ctx->size - 1;
+    rb_ctx->max_record_size = max_record_size;
+
+    rb_ctx->data = jbpf_calloc_ctx(mem_ctx, 1, (size_t)rb_ctx->size + max_record_size);
+
+    if (!rb_ctx->data) {
+        jbpf_logger(JBPF_ERROR, "Error allocating %u bytes for IO ring buffer\n", rb_ctx->size);
+        jbpf_free(rb_ctx);
+        return NULL;
+    }
+
+    ck_spinlock_init(&rb_ctx->producer_lock);
+    ck_spinlock_init(&rb_ctx->consumer_lock);
+
+    return rb_ctx;
+}
+
+void
+jbpf_io_ringbuf_free(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    if (!rb_ctx) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context for freeing\n");
+        return;
+    }
+
+    jbpf_free(rb_ctx->data);
+    jbpf_free(rb_ctx);
+}
+
+void*
+jbpf_io_ringbuf_reserve(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t size)
+{
+    struct jbpf_io_ringbuf_hdr* hdr;
+    uint64_t prod_pos, cons_pos;
+    uint32_t offset, pad = 0;
+    uint32_t record_size;
+
+    if (!rb_ctx || size == 0 || size > rb_ctx->max_record_size) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context or record size for reservation\n");
+        return NULL;
+    }
+
+    record_size = JBPF_IO_RINGBUF_RECORD_SIZE(size);
+
+    ck_spinlock_lock(&rb_ctx->producer_lock);
+
+    prod_pos = rb_ctx->producer_pos;
+    cons_pos = ck_pr_load_64(&rb_ctx->consumer_pos);
+
+    // A record that does not fit before the end of the data starts over at the beginning
+    offset = prod_pos & rb_ctx->mask;
+    if (offset + record_size > rb_ctx->size) {
+        pad = rb_ctx->size - offset;
+    }
+
+    if (prod_pos + pad + record_size - cons_pos > rb_ctx->size) {
+        ck_spinlock_unlock(&rb_ctx->producer_lock);
+        jbpf_io_ringbuf_count_drop(rb_ctx);
+        return NULL;
+    }
+
+    if (pad) {
+        hdr = jbpf_io_ringbuf_hdr_at(rb_ctx, prod_pos);
+        hdr->len = pad - sizeof(struct jbpf_io_ringbuf_hdr);
+        hdr->flags = JBPF_IO_RINGBUF_DISCARD;
+    }
+
+    hdr = jbpf_io_ringbuf_hdr_at(rb_ctx, prod_pos + pad);
+    hdr->len = size;
+    hdr->flags = JBPF_IO_RINGBUF_BUSY;
+
+    /* The headers must be visible before the consumer sees the new position */
+    ck_pr_fence_store();
+    ck_pr_store_64(&rb_ctx->producer_pos, prod_pos + pad + record_size);
+
+    ck_spinlock_unlock(&rb_ctx->producer_lock);
+
+    return hdr + 1;
+}
+
+int
+jbpf_io_ringbuf_commit(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record, uint32_t size)
+{
+    struct jbpf_io_ringbuf_hdr *hdr, *tail;
+    uint32_t record_size, new_record_size;
+    uint64_t offset;
+
+    if (!rb_ctx || !record) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context or record for commit\n");
+        return -1;
+    }
+
+    hdr = jbpf_io_ringbuf_hdr_of(record);
+
+    if (size == 0 || size > hdr->len) {
+        jbpf_logger(JBPF_ERROR, "Invalid size %u for a record of %u bytes\n", size, hdr->len);
+        return -1;
+    }
+
+    record_size = JBPF_IO_RINGBUF_RECORD_SIZE(hdr->len);
+    new_record_size = JBPF_IO_RINGBUF_RECORD_SIZE(size);
+
+    if (new_record_size < record_size) {
+        offset = (uint8_t*)hdr - rb_ctx->data;
+
+        ck_spinlock_lock(&rb_ctx->producer_lock);
+        if ((rb_ctx->producer_pos & rb_ctx->mask) == ((offset + record_size) & rb_ctx->mask)) {
+            // This is the last reserved record, so the rest of it can be reserved again right away
+            ck_pr_store_64(&rb_ctx->producer_pos, rb_ctx->producer_pos - (record_size - new_record_size));
+        } else {
+            // The rest of the record is skipped by the consumer
+            tail = (struct jbpf_io_ringbuf_hdr*)((uint8_t*)hdr + new_record_size);
+            tail->len = record_size - new_record_size - sizeof(struct jbpf_io_ringbuf_hdr);
+            tail->flags = JBPF_IO_RINGBUF_DISCARD;
+        }
+        ck_spinlock_unlock(&rb_ctx->producer_lock);
+    }
+
+    hdr->len = size;
+
+    /* The record must be written before the consumer sees it */
+    ck_pr_fence_store();
+    ck_pr_store_32(&hdr->flags, 0);
+
+    return 0;
+}
+
+void
+jbpf_io_ringbuf_discard(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record)
+{
+    if (!rb_ctx || !record) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context or record for discard\n");
+        return;
+    }
+
+    ck_pr_fence_store();
+    ck_pr_store_32(&jbpf_io_ringbuf_hdr_of(record)->flags, JBPF_IO_RINGBUF_DISCARD);
+}
+
+void*
+jbpf_io_ringbuf_reserve_thread(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    int thread_id;
+    void* record;
+
+    if (!rb_ctx) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context for reservation\n");
+        return NULL;
+    }
+
+    thread_id = jbpf_io_get_thread_id();
+
+    if (thread_id < 0) {
+        jbpf_logger(JBPF_ERROR, "Invalid thread ID for IO ring buffer reservation\n");
+        return NULL;
+    }
+
+    if (rb_ctx->reserved[thread_id]) {
+        return rb_ctx->reserved[thread_id];
+    }
+
+    record = jbpf_io_ringbuf_reserve(rb_ctx, rb_ctx->max_record_size);
+    rb_ctx->reserved[thread_id] = record;
+
+    return record;
+}
+
+int
+jbpf_io_ringbuf_submit_thread(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t size)
+{
+    int thread_id = jbpf_io_get_thread_id();
+    void* record;
+
+    if (thread_id < 0 || !rb_ctx || !rb_ctx->reserved[thread_id]) {
+        jbpf_logger(JBPF_ERROR, "Invalid thread ID or IO ring buffer context for submit\n");
+        return -2;
+    }
+
+    record = rb_ctx->reserved[thread_id];
+    rb_ctx->reserved[thread_id] = NULL;
+
+    return jbpf_io_ringbuf_commit(rb_ctx, record, size);
+}
+
+void
+jbpf_io_ringbuf_discard_thread(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    int thread_id = jbpf_io_get_thread_id();
+
+    if (thread_id < 0 || !rb_ctx || !rb_ctx->reserved[thread_id]) {
+        return;
+    }
+
+    jbpf_io_ringbuf_discard(rb_ctx, rb_ctx->reserved[thread_id]);
+    rb_ctx->reserved[thread_id] = NULL;
+}
+
+void
+jbpf_io_ringbuf_release_all(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    if (!rb_ctx) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context for releasing all records\n");
+        return;
+    }
+
+    for (int thread_id = 0; thread_id < JBPF_IO_MAX_NUM_THREADS; thread_id++) {
+        if (rb_ctx->reserved[thread_id]) {
+            jbpf_io_ringbuf_discard(rb_ctx, rb_ctx->reserved[thread_id]);
+            rb_ctx->reserved[thread_id] = NULL;
+        }
+    }
+}
+
+void*
+jbpf_io_ringbuf_consume(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    struct jbpf_io_ringbuf_hdr* hdr;
+    void* record = NULL;
+    bool skipped = false;
+    uint64_t pos;
+    uint32_t flags;
+
+    if (!rb_ctx)
+        return NULL;
+
+    pos = rb_ctx->read_pos;
+
+    while (pos != ck_pr_load_64(&rb_ctx->producer_pos)) {
+        ck_pr_fence_load();
+        hdr = jbpf_io_ringbuf_hdr_at(rb_ctx, pos);
+        flags = ck_pr_load_32(&hdr->flags);
+        if (flags & JBPF_IO_RINGBUF_BUSY) {
+            break;
+        }
+        ck_pr_fence_load();
+        pos += JBPF_IO_RINGBUF_RECORD_SIZE(hdr->len);
+        ck_pr_store_64(&rb_ctx->read_pos, pos);
+        if (flags & JBPF_IO_RINGBUF_DISCARD) {
+            skipped = true;
+            continue;
+        }
+        record = hdr + 1;
+        break;
+    }
+
+    if (skipped) {
+        jbpf_io_ringbuf_advance(rb_ctx);
+    }
+
+    return record;
+}
+
+void
+jbpf_io_ringbuf_release(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record)
+{
+    if (!rb_ctx || !record) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context or record for release\n");
+        return;
+    }
+
+    ck_pr_fence_release();
+    ck_pr_store_32(&jbpf_io_ringbuf_hdr_of(record)->flags, JBPF_IO_RINGBUF_CONSUMED);
+
+    jbpf_io_ringbuf_advance(rb_ctx);
+}
+
+uint32_t
+jbpf_io_ringbuf_record_size(const void* record)
+{
+    if (!record)
+        return 0;
+
+    return jbpf_io_ringbuf_hdr_of(record)->len;
+}
+
+uint32_t
+jbpf_io_ringbuf_get_size(jbpf_io_ringbuf_ctx_t* rb_ctx)
+{
+    if (!rb_ctx) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context for getting its size\n");
+        return 0;
+    }
+
+    return rb_ctx->size;
+}
+
+int
+jbpf_io_ringbuf_get_stats(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t* used, uint64_t* num_drops)
+{
+    if (!rb_ctx || !used || !num_drops) {
+        jbpf_logger(JBPF_ERROR, "Invalid IO ring buffer context for getting stats\n");
+        return -1;
+    }
+
+    *used = ck_pr_load_64(&rb_ctx->producer_pos) - ck_pr_load_64(&rb_ctx->consumer_pos);
+
+    /* Each counter is only incremented by its thread, so they are summed without locking */
+    *num_drops = 0;
+    for (int thread_id = 0; thread_id < JBPF_IO_MAX_NUM_THREADS; thread_id++) {
+        *num_drops += __atomic_load_n(&rb_ctx->num_drops[thread_id], __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef JBPF_IO_RINGBUF_H
+#define JBPF_IO_RINGBUF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jbpf_mem_mgmt.h"
+
+typedef struct jbpf_io_ringbuf_ctx jbpf_io_ringbuf_ctx_t;
+
+#define JBPF_IO_RINGBUF_ALIGN (8U)
+
+struct jbpf_io_ringbuf_hdr
+{
+    /* Size of the record, without the header */
+    uint32_t len;
+    uint32_t flags;
+};
+
+/* Number of bytes of the ring taken by a record of len bytes */
+#define JBPF_IO_RINGBUF_RECORD_SIZE(len) \
+    (((len) + (uint32_t)sizeof(struct jbpf_io_ringbuf_hdr) + JBPF_IO_RINGBUF_ALIGN - 1) & ~(JBPF_IO_RINGBUF_ALIGN - 1))
+
+/* Byte-granular ring buffer with multiple producers and a single consumer. Each record takes its own size plus an
+   8-byte header, rounded up to 8 bytes. The ring is allocated from mem_ctx, so that it can be shared with another
+   process. size is rounded up to a power of 2 */
+void*
+jbpf_io_ringbuf_create(uint32_t size, uint32_t max_record_size, jbpf_mem_ctx_t* mem_ctx);
+
+/* This assumes that no-one is using the ring buffer any longer */
+void
+jbpf_io_ringbuf_free(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Reserve a record of size bytes. Can be called by any producer thread. The record is not visible to the consumer,
+   and blocks the records reserved after it, until it is committed or discarded */
+void*
+jbpf_io_ringbuf_reserve(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t size);
+
+/* Make a reserved record visible to the consumer, with its first size bytes. If size is smaller than the reserved
+   size, the rest of the record is given back to the ring */
+int
+jbpf_io_ringbuf_commit(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record, uint32_t size);
+
+void
+jbpf_io_ringbuf_discard(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record);
+
+/* Reserve a record of max_record_size bytes for the calling thread, or return the record that the thread has already
+   reserved */
+void*
+jbpf_io_ringbuf_reserve_thread(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Commit the first size bytes of the record reserved by the calling thread */
+int
+jbpf_io_ringbuf_submit_thread(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t size);
+
+/* Discard the record reserved by the calling thread */
+void
+jbpf_io_ringbuf_discard_thread(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Discard the records reserved by all the threads */
+void
+jbpf_io_ringbuf_release_all(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Get the next committed record, in the order they were reserved. Can only be called by the consumer thread. The
+   space of the record is reused once it is released */
+void*
+jbpf_io_ringbuf_consume(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Release a record returned by jbpf_io_ringbuf_consume(). Can be called by any thread of the consumer process, and
+   in any order */
+void
+jbpf_io_ringbuf_release(jbpf_io_ringbuf_ctx_t* rb_ctx, void* record);
+
+uint32_t
+jbpf_io_ringbuf_record_size(const void* record);
+
+uint32_t
+jbpf_io_ringbuf_get_size(jbpf_io_ringbuf_ctx_t* rb_ctx);
+
+/* Number of bytes used by records that are not released yet, and number of records dropped by all the threads.
+   Can be called by any thread */
+int
+jbpf_io_ringbuf_get_stats(jbpf_io_ringbuf_ctx_t* rb_ctx, uint32_t* used, uint64_t* num_drops);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef JBPF_IO_RINGBUF_INT_H
+#define JBPF_IO_RINGBUF_INT_H
+
+#include "ck_cc.h"
+#include "ck_spinlock.h"
+#include "jbpf_io_ringbuf.h"
+#include "jbpf_io_thread_mgmt.h"
+
+/* Flags of the header of a record */
+#define JBPF_IO_RINGBUF_BUSY (1U)
+#define JBPF_IO_RINGBUF_DISCARD (2U)
+#define JBPF_IO_RINGBUF_CONSUMED (4U)
+
+/* The positions only grow, and are mapped to the data with mask. A record never wraps around the end of the data:
+   if it does not fit, the end of the data is skipped with a discarded record. The data is followed by
+   max_record_size bytes, so that a consumer that reads max_record_size bytes from a shorter record stays in bounds */
+struct jbpf_io_ringbuf_ctx
+{
+    /* Producers. The reservations are serialized by the lock, the commits are not */
+    uint64_t producer_pos CK_CC_CACHELINE;
+    ck_spinlock_t producer_lock;
+    /* Consumer. read_pos is the next record to consume, and consumer_pos the first record that is not released */
+    uint64_t read_pos CK_CC_CACHELINE;
+    uint64_t consumer_pos;
+    ck_spinlock_t consumer_lock;
+    uint32_t size;
+    uint32_t mask;
+    uint32_t max_record_size;
+    uint8_t* data;
+    void* reserved[JBPF_IO_MAX_NUM_THREADS];
+    /* Records that could not be reserved, counted by the thread that tried */
+    uint64_t num_drops[JBPF_IO_MAX_NUM_THREADS];
+};
+
+#endif // JBPF_IO_RINGBUF_INT_H
@@ -130,6 +130,12 @@ extern "C"
                                                                          *   @default 0
                                                                          */
         jbpf_linked_map_descriptor_s linked_maps[JBPF_MAX_LINKED_MAPS]; /**< Descriptors for linked maps. */
+        jbpf_codelet_sampling_t sampling;                               /**< Sampling of the hook calls that run the
+                                                                         *   codelet. Disabled if zeroed.
+                                                                         */
+        jbpf_codelet_filter_t filter;                                   /**< Pre-filter of the hook calls that run the
+                                                                         *   codelet. Disabled if zeroed.
+                                                                         */
     } jbpf_codelet_descriptor_s;
 
     /**
@@ -19,6 +19,7 @@ struct jbpf_lcm_ipc_server_ctx
     atomic_bool is_running;
     jbpf_codeletset_load_cb load_cb;
     jbpf_codeletset_unload_cb unload_cb;
+    jbpf_trace_dump_cb trace_dump_cb;
 };
 
 static int
@@ -88,6 +89,7 @@ jbpf_lcm_ipc_server_init(jbpf_lcm_ipc_server_config_t* config)
     server->is_running = ATOMIC_VAR_INIT(false);
     server->load_cb = config->load_cb;
     server->unload_cb = config->unload_cb;
+    server->trace_dump_cb = config->trace_dump_cb;
 
     server->un_addr.sun_family = AF_UNIX;
     strncpy(server->un_addr.sun_path, config->address.path, sizeof(server->un_addr.sun_path) - 1);
@@ -191,6 +193,22 @@ jbpf_lcm_ipc_server_start(jbpf_lcm_ipc_server_ctx_t server_ctx)
         case JBPF_LCM_IPC_CODELETSET_UNLOAD:
             outcome = server_ctx->unload_cb(&req_msg.msg.unload_req_msg.req, &resp_msg.err_msg);
             break;
+
+        case JBPF_LCM_IPC_TRACE_DUMP:
+            req_msg.msg.trace_dump_req_msg.path[JBPF_PATH_LEN - 1] = '\0';
+            if (server_ctx->trace_dump_cb) {
+                outcome = server_ctx->trace_dump_cb(req_msg.msg.trace_dump_req_msg.path);
+            } else {
+                outcome = -1;
+            }
+            if (outcome != 0) {
+                snprintf(
+                    resp_msg.err_msg.err_msg,
+                    sizeof(resp_msg.err_msg.err_msg),
+                    "Failed to dump the flight recorder to %s\n",
+                    req_msg.msg.trace_dump_req_msg.path);
+            }
+            break;
         default:
             jbpf_logger(
                 JBPF_ERROR,
@@ -247,4 +265,21 @@ jbpf_lcm_ipc_send_codeletset_unload_req(jbpf_lcm_ipc_address_t* address, jbpf_co
     msg.msg.unload_req_msg.req = *unload_req;
 
     return jbpf_lcm_ipc_send_req(address, &msg);
-}
\ No newline at end of file
+}
+
+int
+jbpf_lcm_ipc_send_trace_dump_req(jbpf_lcm_ipc_address_t* address, const char* path)
+{
+
+    jbpf_lcm_ipc_req_msg_s msg = {0};
+
+    if (!address || !path || strlen(path) >= JBPF_PATH_LEN) {
+        jbpf_logger(JBPF_ERROR, "Invalid address or dump path\n");
+        return -1;
+    }
+
+    msg.msg_type = JBPF_LCM_IPC_TRACE_DUMP;
+    strncpy(msg.msg.trace_dump_req_msg.path, path, JBPF_PATH_LEN - 1);
+
+    return jbpf_lcm_ipc_send_req(address, &msg);
+}
@@ -20,6 +20,7 @@ extern "C"
         struct jbpf_codeletset_load_req* load_req, jbpf_codeletset_load_error_s* err);
     typedef int (*jbpf_codeletset_unload_cb)(
         struct jbpf_codeletset_unload_req* unload_req, jbpf_codeletset_load_error_s* err);
+    typedef int (*jbpf_trace_dump_cb)(const char* path);
 
     typedef struct jbpf_lcm_ipc_address
     {
@@ -31,6 +32,8 @@ extern "C"
         jbpf_lcm_ipc_address_t address;
         jbpf_codeletset_load_cb load_cb;
         jbpf_codeletset_unload_cb unload_cb;
+        /* Optional. Flight recorder dumps are refused if NULL */
+        jbpf_trace_dump_cb trace_dump_cb;
     } jbpf_lcm_ipc_server_config_t;
 
     jbpf_lcm_ipc_server_ctx_t
@@ -47,6 +50,8 @@ extern "C"
     jbpf_lcm_ipc_send_codeletset_load_req(jbpf_lcm_ipc_address_t* address, jbpf_codeletset_load_req_s* load_req);
     int
     jbpf_lcm_ipc_send_codeletset_unload_req(jbpf_lcm_ipc_address_t* path, jbpf_codeletset_unload_req_s* unload_req);
+    int
+    jbpf_lcm_ipc_send_trace_dump_req(jbpf_lcm_ipc_address_t* address, const char* path);
 
 #pragma once
 #ifdef __cplusplus
@@ -12,6 +12,7 @@ typedef enum jbpf_lcm_ipc_req_msg_type
 {
     JBPF_LCM_IPC_CODELETSET_LOAD = 0,
     JBPF_LCM_IPC_CODELETSET_UNLOAD,
+    JBPF_LCM_IPC_TRACE_DUMP,
 } jbpf_lcm_ipc_req_msg_type_e;
 
 /**
@@ -42,6 +43,16 @@ typedef struct __attribute__((packed)) jbpf_lcm_ipc_codeletset_unload_req_msg
     jbpf_codeletset_unload_req_s req;
 } jbpf_lcm_ipc_codeletset_unload_req_msg_s;
 
+/**
+ * @brief JBPF LCM IPC flight recorder dump request message
+ * @ingroup lcm
+ */
+typedef struct __attribute__((packed)) jbpf_lcm_ipc_trace_dump_req_msg
+{
+    /* Name of the dump file, relative to the dump directory of the agent */
+    char path[JBPF_PATH_LEN];
+} jbpf_lcm_ipc_trace_dump_req_msg_s;
+
 /**
  * @brief JBPF LCM IPC request message
  * @ingroup lcm
@@ -53,6 +64,7 @@ typedef struct __attribute__((packed)) jbpf_lcm_ipc_req_msg
     {
         jbpf_lcm_ipc_codeletset_load_req_msg_s load_req_msg;
         jbpf_lcm_ipc_codeletset_unload_req_msg_s unload_req_msg;
+        jbpf_lcm_ipc_trace_dump_req_msg_s trace_dump_req_msg;
     } msg;
 } jbpf_lcm_ipc_req_msg_s;
 
@@ -23,6 +23,7 @@
 #define NUM_PERS_ENTRIES (10)
 
 static bool memory_initialized = false;
+static size_t memory_reserved_size = 0;
 
 bool
 _jbpf_transparent_hp_enabled(void)
@@ -367,6 +368,107 @@ jbpf_attach_memory(void* fixed_addr, size_t size, char* meta_path_name, char* me
     return addr;
 }
 
+void*
+jbpf_allocate_shared_region(
+    size_t size, char* meta_path_name, char* mem_name, struct jbpf_mmap_info* mmap_info, bool use_huge_pages)
+{
+    struct jbpf_huge_page_info hp_info[NUM_PERS_ENTRIES];
+    struct jbpf_huge_page_info* hp_pers_entry = NULL;
+    int num_hp_mounts;
+    void* addr = NULL;
+
+    // Only persistent huge pages can be shared, as transparent huge pages are anonymous memory
+    if (use_huge_pages) {
+        num_hp_mounts = _jbpf_get_persistent_hp_info(hp_info, NUM_PERS_ENTRIES);
+        for (int i = 0; i < num_hp_mounts; i++) {
+            if (hp_info[i].page_size == MAP_HUGE_2MB) {
+                hp_pers_entry = &hp_info[i];
+            }
+        }
+        if (hp_pers_entry) {
+            addr = _jbpf_mmap(
+                _jbpf_round_up_mem(size, JBPF_HUGEPAGE_SIZE_2MB),
+                meta_path_name,
+                mem_name,
+                mmap_info,
+                true,
+                hp_pers_entry,
+                NULL);
+            if (addr == MAP_FAILED || addr == NULL) {
+                if (mmap_info->fd != -1) {
+                    _jbpf_remove_file(mmap_info);
+                }
+                addr = NULL;
+            }
+        }
+        if (!addr) {
+            jbpf_logger(JBPF_WARN, "Could not allocate huge pages for %s, using regular pages\n", mem_name);
+        }
+    }
+
+    if (!addr) {
+        addr = _jbpf_mmap(
+            _jbpf_round_up_mem(size, sysconf(_SC_PAGESIZE)), meta_path_name, mem_name, mmap_info, true, NULL, NULL);
+        if (addr == MAP_FAILED || addr == NULL) {
+            jbpf_logger(JBPF_ERROR, "Could not allocate shared memory %s\n", mem_name);
+            if (mmap_info->fd != -1) {
+                _jbpf_remove_file(mmap_info);
+            }
+            return NULL;
+        }
+    }
+
+    mmap_info->addr = addr;
+    memset(addr, 0, mmap_info->len);
+    return addr;
+}
+
+void*
+jbpf_attach_memory_readonly(char* meta_path_name, char* mem_name, struct jbpf_mmap_info* mmap_info)
+{
+    struct jbpf_huge_page_info hp_info = {0};
+    char mount_name[4 * MAX_NAME_SIZE];
+    struct stat st;
+    void* addr;
+    int res;
+    int fd;
+
+    res = _jbpf_read_hp_alloc_info(&hp_info, meta_path_name, mem_name, strlen(mem_name));
+
+    if (res == -1) {
+        return NULL;
+    } else if (res == 0) {
+        fd = shm_open(mem_name, O_RDONLY, 0);
+    } else {
+        snprintf(mount_name, sizeof(mount_name), "%s/%s", hp_info.mount_point, mem_name);
+        fd = open(mount_name, O_RDONLY);
+    }
+
+    if (fd == -1) {
+        return NULL;
+    }
+
+    // The size is that of the region, as rounded up to its page size on allocation
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    // The mapping is not named, so that releasing it never removes the shared memory
+    memset(mmap_info, 0, sizeof(*mmap_info));
+    mmap_info->fd = -1;
+    mmap_info->addr = addr;
+    mmap_info->len = st.st_size;
+    return addr;
+}
+
 // jbpf follows the following allocation logic:
 // 1) If no flag is set, try to allocate transparent huge pages and
 // if that fails, allocate regular memory
@@ -582,6 +684,7 @@ jbpf_init_memory(size_t size, bool use_1g_huge_pages)
             jbpf_logger(JBPF_WARN, "Unable to reserve 1G huge pages\n");
         } else {
             done = true;
+            memory_reserved_size = num_1g_huge_pages * JBPF_HUGEPAGE_SIZE_1GB;
         }
     }
 
@@ -591,6 +694,7 @@ jbpf_init_memory(size_t size, bool use_1g_huge_pages)
             jbpf_logger(JBPF_ERROR, "Unable to reserve regular memory\n");
             return -1;
         }
+        memory_reserved_size = size;
     }
 
     jbpf_logger(JBPF_INFO, "Allocated memory for jbpf\n");
@@ -613,6 +717,7 @@ jbpf_destroy_memory()
 {
 
     memory_initialized = false;
+    memory_reserved_size = 0;
     mi_heap_delete(mi_heap_get_default());
     mi_option_disable(mi_option_limit_os_alloc);
 }
@@ -686,3 +791,24 @@ jbpf_free(void* ptr)
 {
     mi_free(ptr);
 }
+
+void
+jbpf_get_mem_stats(struct jbpf_mem_stats* stats)
+{
+    size_t elapsed_msecs, user_msecs, system_msecs, peak_rss, page_faults;
+
+    if (!stats) {
+        return;
+    }
+
+    stats->reserved_size = memory_reserved_size;
+    mi_process_info(
+        &elapsed_msecs,
+        &user_msecs,
+        &system_msecs,
+        &stats->rss,
+        &peak_rss,
+        &stats->committed_size,
+        &stats->peak_committed_size,
+        &page_faults);
+}
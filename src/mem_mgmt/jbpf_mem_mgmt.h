@@ -76,6 +76,22 @@ extern "C"
         char mem_name[MAX_NAME_SIZE];
     };
 
+    /**
+     * @brief Memory usage of the calling process.
+     * @param reserved_size Size of the memory reserved with jbpf_init_memory(), in bytes.
+     * @param committed_size Memory currently committed by the allocator, in bytes.
+     * @param peak_committed_size Highest memory committed by the allocator, in bytes.
+     * @param rss Resident set size of the process, in bytes.
+     * @ingroup mem_mgmt
+     */
+    struct jbpf_mem_stats
+    {
+        size_t reserved_size;
+        size_t committed_size;
+        size_t peak_committed_size;
+        size_t rss;
+    };
+
     /**
      * @brief Initializes the heap memory that will be used for the jbpf-io-lib operations on the calling process.
      * By default, attempts to allocate 2MB huge pages and falls back to allocating regular memory on failure.
@@ -256,6 +272,35 @@ extern "C"
     void*
     jbpf_attach_memory(void* fixed_addr, size_t size, char* meta_path_name, char* mem_name, size_t mem_name_len);
 
+    /**
+     * @brief Mmaps shared memory for a region that other processes map with jbpf_attach_memory_readonly(), such as
+     * the data of a map. Unlike jbpf_allocate_memory(), the size is only rounded up to the page size.
+     * @param size Size of the region in bytes.
+     * @param meta_path_name The name of the directory where memory related meta info is stored.
+     * @param mem_name The name of the shared memory, which must be unique.
+     * @param mmap_info Descriptor of the mmapped memory, to be passed to jbpf_free_memory().
+     * @param use_huge_pages If set to true, try to allocate 2MB persistent huge pages, and fall back to regular pages
+     * if no hugetlbfs mount is available or the allocation fails.
+     * @return The address of the zeroed, page-aligned region if successful, or NULL otherwise.
+     * @ingroup mem_mgmt
+     */
+    void*
+    jbpf_allocate_shared_region(
+        size_t size, char* meta_path_name, char* mem_name, struct jbpf_mmap_info* mmap_info, bool use_huge_pages);
+
+    /**
+     * @brief Attaches read-only to a shared memory region allocated with jbpf_allocate_shared_region() or
+     * jbpf_allocate_memory(). The whole region is mapped.
+     * @param meta_path_name The name of the directory where memory related meta info is stored.
+     * @param mem_name The name of the shared memory.
+     * @param mmap_info Descriptor of the mapping, with the size of the region. Passing it to jbpf_free_memory()
+     * unmaps the region without releasing the shared memory.
+     * @return The address of the mapping if successful, or NULL otherwise.
+     * @ingroup mem_mgmt
+     */
+    void*
+    jbpf_attach_memory_readonly(char* meta_path_name, char* mem_name, struct jbpf_mmap_info* mmap_info);
+
     /**
      * @brief Frees the memory allocated with jbpf_allocate_memory().
      * @param mmap_info Descriptor obtained through jbpf_allocate_memory.
@@ -267,6 +312,14 @@ extern "C"
     int
     jbpf_free_memory(struct jbpf_mmap_info* mmap_info, char* meta_path_name, bool release_shm);
 
+    /**
+     * @brief Gets the memory usage of the calling process. Can be called by any thread.
+     * @param stats Will store the memory usage.
+     * @ingroup mem_mgmt
+     */
+    void
+    jbpf_get_mem_stats(struct jbpf_mem_stats* stats);
+
 #ifdef __cplusplus
 }
 #endif
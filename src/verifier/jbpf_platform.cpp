@@ -31,6 +31,7 @@ std::vector<EbpfProgramType> jbpf_program_types = {
     jbpf_unspec_program_type,
     PTYPE("jbpf_generic", &g_jbpf_generic_descr, JBPF_PROG_TYPE_GENERIC, {"jbpf_generic"}),
     PTYPE("jbpf_stats", &g_jbpf_stats_descr, JBPF_PROG_TYPE_STATS, {"jbpf_stats"}),
+    PTYPE("jbpf_batch", &g_jbpf_batch_descr, JBPF_PROG_TYPE_BATCH, {"jbpf_batch"}),
 };
 
 void
@@ -73,6 +74,9 @@ std::vector<EbpfMapType> jbpf_map_types = {
     {JBPF_MAP_TYPE(PER_THREAD_ARRAY), true},
     {JBPF_MAP_TYPE(PER_THREAD_HASHMAP)},
     {JBPF_MAP_TYPE(OUTPUT)},
+    {JBPF_MAP_TYPE(CONCURRENT_HASHMAP)},
+    {JBPF_MAP_TYPE(LRU_HASHMAP)},
+    {JBPF_MAP_TYPE(PER_THREAD_LRU_HASHMAP)},
 };
 
 int
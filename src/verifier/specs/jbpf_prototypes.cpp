@@ -6,6 +6,7 @@
 const ebpf_context_descriptor_t g_jbpf_unspec_descr = jbpf_unspec_descr;
 const ebpf_context_descriptor_t g_jbpf_generic_descr = jbpf_generic_descr;
 const ebpf_context_descriptor_t g_jbpf_stats_descr = jbpf_stats_descr;
+const ebpf_context_descriptor_t g_jbpf_batch_descr = jbpf_batch_descr;
 
 /* Here we define all the prototypes for the helper functions used by jbpf */
 
@@ -241,6 +242,121 @@ static const struct EbpfHelperPrototype jbpf_send_output_proto = {
         },
 };
 
+/*
+ * int jbpf_map_reduce(&map, &key, &out, out_size, flags)
+ *     Return: number of thread copies reduced on success or a negative value
+ */
+static const struct EbpfHelperPrototype jbpf_map_reduce_proto = {
+    .name = "map_reduce",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP_KEY,
+            EBPF_ARGUMENT_TYPE_PTR_TO_WRITABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+            EBPF_ARGUMENT_TYPE_ANYTHING,
+        },
+};
+
+static const struct EbpfHelperPrototype jbpf_ringbuf_reserve_proto = {
+    .name = "ringbuf_reserve",
+    .return_type = EBPF_RETURN_TYPE_PTR_TO_MAP_VALUE_OR_NULL,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+        },
+};
+
+static const struct EbpfHelperPrototype jbpf_ringbuf_submit_proto = {
+    .name = "ringbuf_submit",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_ANYTHING,
+        },
+};
+
+static const struct EbpfHelperPrototype jbpf_ringbuf_discard_proto = {
+    .name = "ringbuf_discard",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+        },
+};
+
+/*
+ * int jbpf_map_lookup_batch(map, keys, keys_size, values, values_size)
+ *     Copy the found mask and the values of a batch of keys
+ *     Return: number of keys found or a negative value
+ */
+static const struct EbpfHelperPrototype jbpf_map_lookup_batch_proto = {
+    .name = "map_lookup_batch",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_PTR_TO_READABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+            EBPF_ARGUMENT_TYPE_PTR_TO_WRITABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+        },
+};
+
+/*
+ * int jbpf_map_update_batch(map, keys, keys_size, values, values_size)
+ *     Update a batch of keys
+ *     Return: number of keys updated or a negative value
+ */
+static const struct EbpfHelperPrototype jbpf_map_update_batch_proto = {
+    .name = "map_update_batch",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_PTR_TO_READABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+            EBPF_ARGUMENT_TYPE_PTR_TO_READABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+        },
+};
+
+/*
+ * int jbpf_map_delete_batch(map, keys, keys_size)
+ *     Delete a batch of keys
+ *     Return: number of keys deleted or a negative value
+ */
+static const struct EbpfHelperPrototype jbpf_map_delete_batch_proto = {
+    .name = "map_delete_batch",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_PTR_TO_READABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+        },
+};
+
+/*
+ * int jbpf_map_iterate(map, cursor, cursor_size, data, max_size)
+ *     Copy the next entries of a map, from a cursor
+ *     Return: number of entries copied or a negative value
+ */
+static const struct EbpfHelperPrototype jbpf_map_iterate_proto = {
+    .name = "map_iterate",
+    .return_type = EBPF_RETURN_TYPE_INTEGER,
+    .argument_type =
+        {
+            EBPF_ARGUMENT_TYPE_PTR_TO_MAP,
+            EBPF_ARGUMENT_TYPE_PTR_TO_WRITABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+            EBPF_ARGUMENT_TYPE_PTR_TO_WRITABLE_MEM,
+            EBPF_ARGUMENT_TYPE_CONST_SIZE,
+        },
+};
+
 #define FN(x) jbpf_##x##_proto
 // keep this on a round line
 std::vector<struct EbpfHelperPrototype> prototypes = {
@@ -263,6 +379,14 @@ std::vector<struct EbpfHelperPrototype> prototypes = {
     FN(control_input_receive),
     FN(get_output_buf),
     FN(send_output),
+    FN(map_reduce),
+    FN(ringbuf_reserve),
+    FN(ringbuf_submit),
+    FN(ringbuf_discard),
+    FN(map_lookup_batch),
+    FN(map_update_batch),
+    FN(map_delete_batch),
+    FN(map_iterate),
     /* EXTEND WITH THE NEW PROTOTYPES HERE */
 };
 
@@ -25,11 +25,23 @@ constexpr int jbpf_generic_regions = 3 * 8 + 4 * 1;
 /* Size of the context struct */
 constexpr int jbpf_stats_regions = 3 * 8 + 4 * 1;
 
+/* struct jbpf_batch_ctx {
+   uint64_t data;
+   uint64_t data_end;
+   uint64_t meta_data;
+   uint32_t ctx_id;
+   uint32_t num_elems;
+   } */
+/* Size of the context struct */
+constexpr int jbpf_batch_regions = 3 * 8 + 4 * 2;
+
 constexpr ebpf_context_descriptor_t jbpf_generic_descr = {jbpf_generic_regions, 0, 1 * 8, 2 * 8};
 constexpr ebpf_context_descriptor_t jbpf_stats_descr = {jbpf_stats_regions, 0, 1 * 8, 2 * 8};
+constexpr ebpf_context_descriptor_t jbpf_batch_descr = {jbpf_batch_regions, 0, 1 * 8, 2 * 8};
 // If no context is given, treat it as generic
 constexpr ebpf_context_descriptor_t jbpf_unspec_descr = jbpf_generic_descr;
 
 extern const ebpf_context_descriptor_t g_jbpf_unspec_descr;
 extern const ebpf_context_descriptor_t g_jbpf_generic_descr;
 extern const ebpf_context_descriptor_t g_jbpf_stats_descr;
+extern const ebpf_context_descriptor_t g_jbpf_batch_descr;
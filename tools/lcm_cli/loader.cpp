@@ -22,7 +22,8 @@ using namespace std;
 enum lcm_cli_type
 {
     load,
-    unload
+    unload,
+    dump_trace
 };
 
 union request
@@ -36,6 +37,7 @@ struct lcm_cli_config
     request req;
     lcm_cli_type typ;
     jbpf_lcm_ipc_address_t addr;
+    char trace_path[JBPF_PATH_LEN];
 };
 
 inline bool
@@ -56,7 +58,7 @@ parseArgs(int ac, char** av, lcm_cli_config* opts)
     bool set_config = false;
 
     for (;;) {
-        switch (getopt(ac, av, "a:c:lu")) {
+        switch (getopt(ac, av, "a:c:lut:")) {
         case 'a': {
             address = string(optarg);
             if (address.length() > JBPF_LCM_IPC_ADDRESS_LEN - 1) {
@@ -91,6 +93,23 @@ parseArgs(int ac, char** av, lcm_cli_config* opts)
             continue;
         }
 
+        case 't': {
+            if (set_direction) {
+                cout << "Invalid arguments: cannot specify -t with -l or -u" << endl;
+                return JBPF_LCM_CLI_INVALID_ARGS;
+            }
+            string trace_path = string(optarg);
+            if (trace_path.length() > JBPF_PATH_LEN - 1) {
+                cout << "-t length must be at most " << JBPF_PATH_LEN - 1 << endl;
+                return JBPF_LCM_CLI_INVALID_ARGS;
+            }
+            trace_path.copy(opts->trace_path, JBPF_PATH_LEN - 1);
+            opts->trace_path[trace_path.length()] = '\0';
+            (*opts).typ = dump_trace;
+            set_direction = true;
+            continue;
+        }
+
         case '?':
         case 'h':
         default:
@@ -100,6 +119,7 @@ parseArgs(int ac, char** av, lcm_cli_config* opts)
                  << "-c <config>\tcodeletset configuration file" << endl
                  << "-l\t\tload codeletset" << endl
                  << "-u\t\tunload codeletset" << endl
+                 << "-t <name>\tdump the flight recorder of the agent to name, in its dump directory" << endl
                  << endl;
 
             printf("Help/Usage Example\n");
@@ -115,13 +135,18 @@ parseArgs(int ac, char** av, lcm_cli_config* opts)
     address.copy(opts->addr.path, JBPF_LCM_IPC_NAME_LEN - 1);
     opts->addr.path[address.length()] = '\0';
 
+    // Flight recorder dumps do not need a codeletset configuration
+    if (set_direction && (*opts).typ == dump_trace) {
+        return JBPF_LCM_CLI_REQ_SUCCESS;
+    }
+
     if (!exists(filename)) {
         cout << "File " << filename << " does not exist" << endl;
         return JBPF_LCM_CLI_INVALID_ARGS;
     }
 
     if (!set_direction) {
-        cout << "Invalid arguments: must specify either -l or -u" << endl;
+        cout << "Invalid arguments: must specify either -l, -u or -t" << endl;
         return JBPF_LCM_CLI_INVALID_ARGS;
     }
 
@@ -139,6 +164,9 @@ parseArgs(int ac, char** av, lcm_cli_config* opts)
     case unload:
         parse_ret = jbpf_lcm_cli::parser::parse_jbpf_codeletset_unload_req(cfg, &(*opts).req.unload);
         break;
+
+    default:
+        return JBPF_LCM_CLI_INVALID_ARGS;
     }
 
     switch (parse_ret) {
@@ -172,6 +200,10 @@ run_loader(int ac, char** av)
         cout << "Unloading codelet set: " << conf.req.unload.codeletset_id.name << endl;
         ret = jbpf_lcm_ipc_send_codeletset_unload_req(&conf.addr, &conf.req.unload);
         break;
+    case dump_trace:
+        cout << "Dumping the flight recorder to: " << conf.trace_path << endl;
+        ret = jbpf_lcm_ipc_send_trace_dump_req(&conf.addr, conf.trace_path);
+        break;
     }
 
     switch (ret) {
@@ -5,6 +5,8 @@
 
 #include <iostream>
 #include <iomanip>
+#include <cstring>
+#include <map>
 #include <regex>
 #include "stream_id.hpp"
 
@@ -105,6 +107,124 @@ parse_jbpf_linked_map_descriptor(YAML::Node cfg, jbpf_linked_map_descriptor_s* d
     return JBPF_LCM_PARSE_REQ_SUCCESS;
 }
 
+parse_req_outcome
+parse_jbpf_codelet_sampling(YAML::Node cfg, jbpf_codelet_sampling_t* dest)
+{
+    memset(dest, 0, sizeof(*dest));
+    if (!cfg.IsDefined())
+        return JBPF_LCM_PARSE_REQ_SUCCESS;
+
+    if (!cfg["type"].IsDefined() || !cfg["value"].IsDefined()) {
+        cout << "codelet_descriptor[].sampling must have a type and a value" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+
+    auto type = cfg["type"].as<string>();
+    if (type == "ratio") {
+        dest->type = JBPF_SAMPLING_RATIO;
+    } else if (type == "rate") {
+        dest->type = JBPF_SAMPLING_RATE;
+    } else if (type == "interval") {
+        dest->type = JBPF_SAMPLING_INTERVAL;
+    } else {
+        cout << "codelet_descriptor[].sampling.type must be one of ratio, rate or interval" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+
+    dest->value = cfg["value"].as<uint64_t>();
+    if (dest->value == 0) {
+        cout << "codelet_descriptor[].sampling.value must be greater than 0" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+
+    if (cfg["burst"].IsDefined())
+        dest->burst = cfg["burst"].as<uint32_t>();
+
+    return JBPF_LCM_PARSE_REQ_SUCCESS;
+}
+
+parse_req_outcome
+parse_jbpf_codelet_filter_cond(YAML::Node cfg, jbpf_codelet_filter_cond_t* dest)
+{
+    static const map<string, jbpf_codelet_filter_op_e> ops = {
+        {"eq", JBPF_FILTER_OP_EQ},
+        {"ne", JBPF_FILTER_OP_NE},
+        {"lt", JBPF_FILTER_OP_LT},
+        {"le", JBPF_FILTER_OP_LE},
+        {"gt", JBPF_FILTER_OP_GT},
+        {"ge", JBPF_FILTER_OP_GE},
+        {"mask", JBPF_FILTER_OP_MASK}};
+
+    if (!cfg["offset"].IsDefined() || !cfg["size"].IsDefined() || !cfg["op"].IsDefined() ||
+        !cfg["value"].IsDefined()) {
+        cout << "codelet_descriptor[].filter.conditions[] must have an offset, a size, an op and a value" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+
+    dest->base = JBPF_FILTER_BASE_CTX;
+    if (cfg["base"].IsDefined()) {
+        auto base = cfg["base"].as<string>();
+        if (base == "data") {
+            dest->base = JBPF_FILTER_BASE_DATA;
+        } else if (base != "ctx") {
+            cout << "codelet_descriptor[].filter.conditions[].base must be ctx or data" << endl;
+            return JBPF_LCM_PARSE_REQ_FAILED;
+        }
+    }
+
+    auto op = ops.find(cfg["op"].as<string>());
+    if (op == ops.end()) {
+        cout << "codelet_descriptor[].filter.conditions[].op must be one of eq, ne, lt, le, gt, ge or mask" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+    dest->op = op->second;
+
+    auto size = cfg["size"].as<uint32_t>();
+    if (size != 1 && size != 2 && size != 4 && size != 8) {
+        cout << "codelet_descriptor[].filter.conditions[].size must be 1, 2, 4 or 8" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+    dest->size = size;
+    dest->offset = cfg["offset"].as<uint32_t>();
+    dest->value = cfg["value"].as<uint64_t>();
+
+    return JBPF_LCM_PARSE_REQ_SUCCESS;
+}
+
+parse_req_outcome
+parse_jbpf_codelet_filter(YAML::Node cfg, jbpf_codelet_filter_t* dest)
+{
+    memset(dest, 0, sizeof(*dest));
+    if (!cfg.IsDefined())
+        return JBPF_LCM_PARSE_REQ_SUCCESS;
+
+    if (!cfg["conditions"].IsDefined() || !cfg["conditions"].IsSequence() || cfg["conditions"].size() == 0 ||
+        cfg["conditions"].size() > JBPF_MAX_FILTER_CONDITIONS) {
+        cout << "codelet_descriptor[].filter.conditions must be a sequence of 1 to " << JBPF_MAX_FILTER_CONDITIONS
+             << " conditions" << endl;
+        return JBPF_LCM_PARSE_REQ_FAILED;
+    }
+
+    if (cfg["combine"].IsDefined()) {
+        auto combine = cfg["combine"].as<string>();
+        if (combine == "any") {
+            dest->combine = JBPF_FILTER_ANY;
+        } else if (combine != "all") {
+            cout << "codelet_descriptor[].filter.combine must be all or any" << endl;
+            return JBPF_LCM_PARSE_REQ_FAILED;
+        }
+    }
+
+    dest->num_conditions = cfg["conditions"].size();
+    for (uint32_t idx = 0; idx < dest->num_conditions; idx++) {
+        auto ret = parse_jbpf_codelet_filter_cond(cfg["conditions"][idx], &dest->conditions[idx]);
+        if (ret != JBPF_LCM_PARSE_REQ_SUCCESS)
+            return ret;
+    }
+
+    return JBPF_LCM_PARSE_REQ_SUCCESS;
+}
+
 parse_req_outcome
 parse_jbpf_codelet_descriptor(YAML::Node cfg, jbpf_codelet_descriptor_s* dest, vector<string> codelet_elems)
 {
@@ -152,6 +272,14 @@ parse_jbpf_codelet_descriptor(YAML::Node cfg, jbpf_codelet_descriptor_s* dest, v
         dest->runtime_threshold = runtime_threshold;
     }
 
+    auto sampling_ret = parse_jbpf_codelet_sampling(cfg["sampling"], &dest->sampling);
+    if (sampling_ret != JBPF_LCM_PARSE_REQ_SUCCESS)
+        return sampling_ret;
+
+    auto filter_ret = parse_jbpf_codelet_filter(cfg["filter"], &dest->filter);
+    if (filter_ret != JBPF_LCM_PARSE_REQ_SUCCESS)
+        return filter_ret;
+
     if (cfg["in_io_channel"].IsDefined()) {
         if (!cfg["in_io_channel"].IsSequence()) {
             cout << "codelet_descriptor[].in_io_channel must be a sequence" << endl;
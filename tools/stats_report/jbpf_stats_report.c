@@ -4,8 +4,6 @@
 #include "jbpf_stats_report.h"
 #include <string.h>
 
-#define NUM_HIST_BINS 64
-
 /* Code snippet to count __VA_ARGS__: https://gist.github.com/aprell/3722962*/
 #define VA_NARGS_IMPL(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, N, ...) N
 #define VA_NARGS(...) VA_NARGS_IMPL(_, ##__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
@@ -51,6 +49,7 @@ jbpf_main(void* state)
         return 1;
 
     out_hook_list->hook_perf_count = 0;
+    out_hook_list->counters_type = hook_list->counters_type;
 
     // DEFINE_STATS_HOOKS("test1", "report_stats", "test2", "test4")
 
@@ -68,12 +67,21 @@ jbpf_main(void* state)
             out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].max = hook_list->perf_data[i & 63].max;
             out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].min = hook_list->perf_data[i & 63].min;
             out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].num = hook_list->perf_data[i & 63].num;
+            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].p50 = hook_list->perf_data[i & 63].p50;
+            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].p90 = hook_list->perf_data[i & 63].p90;
+            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].p99 = hook_list->perf_data[i & 63].p99;
+            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].p999 = hook_list->perf_data[i & 63].p999;
+
+            memcpy(
+                out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].counters,
+                hook_list->perf_data[i & 63].counters,
+                JBPF_PERF_NUM_COUNTERS * sizeof(uint64_t));
 
-            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].hist_count = NUM_HIST_BINS;
+            out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].hist_count = JBPF_NUM_HIST_BINS;
             memcpy(
                 out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].hist,
                 hook_list->perf_data[i & 63].hist,
-                NUM_HIST_BINS * sizeof(uint64_t));
+                JBPF_NUM_HIST_BINS * sizeof(uint32_t));
             memcpy(
                 out_hook_list->hook_perf[out_hook_list->hook_perf_count & 31].hook_name,
                 hook_list->perf_data[i & 63].hook_name,
@@ -1,13 +1,20 @@
 #include <stdint.h>
 
+#include "jbpf_perf_ext.h"
+
 /* Struct definitions */
 typedef struct jbpf_hook_perf
 {
     uint64_t num;
     uint64_t min;
     uint64_t max;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t counters[JBPF_PERF_NUM_COUNTERS];
     uint32_t hist_count;
-    uint32_t hist[64];
+    uint32_t hist[JBPF_NUM_HIST_BINS];
     char hook_name[32];
 } jbpf_hook_perf;
 
@@ -15,6 +22,7 @@ typedef struct jbpf_out_perf_list
 {
     uint64_t timestamp;
     uint32_t meas_period;
+    uint32_t counters_type;
     uint32_t hook_perf_count;
     jbpf_hook_perf hook_perf[32];
 } jbpf_out_perf_list;
\ No newline at end of file
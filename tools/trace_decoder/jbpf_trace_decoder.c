@@ -0,0 +1,230 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+
+/*
+ * Decoder of the flight recorder dumps written by jbpf_trace_dump().
+ * Prints the codelet invocations of all the threads, ordered by time, with the names of their hooks and codelets.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jbpf_trace_ext.h"
+
+#define MAX_NAME_LEN (512)
+#define MAX_IDS (UINT16_MAX + 1)
+
+struct trace_name
+{
+    uint16_t id;
+    uint16_t hook_id;
+    uint64_t start_time;
+    /* The name the id had before this one */
+    const struct trace_name* prev;
+    char name[MAX_NAME_LEN];
+};
+
+/* A record with the thread it was read from */
+struct trace_entry
+{
+    struct jbpf_trace_record record;
+    uint32_t thread_id;
+};
+
+/* The name an id had when a record was made. by_id holds the latest name of each id */
+static const char*
+find_name(const struct trace_name* const* by_id, uint16_t id, uint64_t start_time)
+{
+    const struct trace_name* name = by_id[id];
+
+    while (name && start_time < name->start_time) {
+        name = name->prev;
+    }
+    return name ? name->name : "unknown";
+}
+
+/* Read the names and index them by id. The names of an id are listed from the oldest to the latest */
+static int
+read_names(FILE* f, struct trace_name* names, uint32_t num_names, const struct trace_name** by_id)
+{
+    struct jbpf_trace_file_name file_name;
+
+    for (uint32_t i = 0; i < num_names; i++) {
+        if (fread(&file_name, sizeof(file_name), 1, f) != 1 || file_name.name_len >= MAX_NAME_LEN ||
+            fread(names[i].name, 1, file_name.name_len, f) != file_name.name_len) {
+            return -1;
+        }
+        names[i].id = file_name.id;
+        names[i].hook_id = file_name.hook_id;
+        names[i].start_time = file_name.start_time;
+        names[i].name[file_name.name_len] = '\0';
+        names[i].prev = by_id[file_name.id];
+        by_id[file_name.id] = &names[i];
+    }
+    return 0;
+}
+
+static int
+compare_entries(const void* a, const void* b)
+{
+    const struct trace_entry* ea = a;
+    const struct trace_entry* eb = b;
+
+    if (ea->record.start_time != eb->record.start_time) {
+        return ea->record.start_time < eb->record.start_time ? -1 : 1;
+    }
+    return ea->thread_id < eb->thread_id ? -1 : ea->thread_id > eb->thread_id;
+}
+
+/* Convert a time in ticks to ns since the epoch, using the reference time of the dump */
+static uint64_t
+ticks_to_realtime_ns(const struct jbpf_trace_file_header* header, uint64_t ticks)
+{
+    unsigned __int128 diff_ns;
+
+    if (ticks <= header->ref_ticks) {
+        diff_ns = (unsigned __int128)(header->ref_ticks - ticks) * 1000000000ULL / header->tick_freq;
+        return header->ref_realtime_ns - (uint64_t)diff_ns;
+    }
+    diff_ns = (unsigned __int128)(ticks - header->ref_ticks) * 1000000000ULL / header->tick_freq;
+    return header->ref_realtime_ns + (uint64_t)diff_ns;
+}
+
+static void
+usage(const char* prog)
+{
+    printf("Usage: %s [-c] <dump file>\n", prog);
+    printf("Options:\n");
+    printf("-c\t\tprint the invocations as CSV\n");
+}
+
+int
+main(int argc, char** argv)
+{
+    struct jbpf_trace_file_header header;
+    struct jbpf_trace_file_thread thread;
+    struct trace_name *hooks = NULL, *codelets = NULL;
+    const struct trace_name **hooks_by_id = NULL, **codelets_by_id = NULL;
+    struct trace_entry* entries = NULL;
+    uint64_t num_entries = 0;
+    int csv = 0;
+    int opt, res = 1;
+    FILE* f;
+
+    while ((opt = getopt(argc, argv, "ch")) != -1) {
+        switch (opt) {
+        case 'c':
+            csv = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != JBPF_TRACE_FILE_MAGIC) {
+        fprintf(stderr, "%s is not a jbpf flight recorder dump\n", argv[optind]);
+        goto out;
+    }
+    if (header.version != JBPF_TRACE_FILE_VERSION || header.record_size != sizeof(struct jbpf_trace_record) ||
+        header.tick_freq == 0) {
+        fprintf(stderr, "Unsupported dump version %u\n", header.version);
+        goto out;
+    }
+
+    hooks = calloc(header.num_hooks + 1, sizeof(struct trace_name));
+    codelets = calloc(header.num_codelets + 1, sizeof(struct trace_name));
+    hooks_by_id = calloc(MAX_IDS, sizeof(struct trace_name*));
+    codelets_by_id = calloc(MAX_IDS, sizeof(struct trace_name*));
+    if (!hooks || !codelets || !hooks_by_id || !codelets_by_id ||
+        read_names(f, hooks, header.num_hooks, hooks_by_id) != 0 ||
+        read_names(f, codelets, header.num_codelets, codelets_by_id) != 0) {
+        fprintf(stderr, "Cannot read the hook and codelet names\n");
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < header.num_threads; i++) {
+        struct trace_entry* new_entries;
+
+        if (fread(&thread, sizeof(thread), 1, f) != 1) {
+            fprintf(stderr, "Truncated dump\n");
+            goto out;
+        }
+        new_entries = realloc(entries, (num_entries + thread.num_records + 1) * sizeof(struct trace_entry));
+        if (!new_entries) {
+            fprintf(stderr, "Out of memory\n");
+            goto out;
+        }
+        entries = new_entries;
+        for (uint32_t j = 0; j < thread.num_records; j++) {
+            if (fread(&entries[num_entries].record, sizeof(struct jbpf_trace_record), 1, f) != 1) {
+                fprintf(stderr, "Truncated dump\n");
+                goto out;
+            }
+            entries[num_entries++].thread_id = thread.thread_id;
+        }
+    }
+
+    qsort(entries, num_entries, sizeof(struct trace_entry), compare_entries);
+
+    if (csv) {
+        printf("time_ns,thread,hook,codelet,duration_ns,ret\n");
+    }
+    for (uint64_t i = 0; i < num_entries; i++) {
+        const struct jbpf_trace_record* record = &entries[i].record;
+        uint64_t time_ns = ticks_to_realtime_ns(&header, record->start_time);
+        uint64_t duration_ns = (unsigned __int128)record->duration * 1000000000ULL / header.tick_freq;
+        const char* hook = find_name(hooks_by_id, record->hook_id, record->start_time);
+        const char* codelet = find_name(codelets_by_id, record->codelet_id, record->start_time);
+
+        if (csv) {
+            printf(
+                "%" PRIu64 ",%u,%s,%s,%" PRIu64 ",%" PRIu64 "\n",
+                time_ns,
+                entries[i].thread_id,
+                hook,
+                codelet,
+                duration_ns,
+                record->ret);
+        } else {
+            time_t sec = time_ns / 1000000000ULL;
+            struct tm tm;
+            char date[32];
+
+            gmtime_r(&sec, &tm);
+            strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+            printf(
+                "%s.%09" PRIu64 "Z thread %-3u %-32s %-32s %10" PRIu64 " ns  ret %" PRIu64 "\n",
+                date,
+                (uint64_t)(time_ns % 1000000000ULL),
+                entries[i].thread_id,
+                hook,
+                codelet,
+                duration_ns,
+                record->ret);
+        }
+    }
+    res = 0;
+
+out:
+    fclose(f);
+    free(entries);
+    free(hooks);
+    free(codelets);
+    free(hooks_by_id);
+    free(codelets_by_id);
+    return res;
+}